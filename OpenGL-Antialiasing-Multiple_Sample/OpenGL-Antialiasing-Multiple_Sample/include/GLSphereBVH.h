@@ -0,0 +1,310 @@
+// GLSphereBVH.h
+// A bounding volume hierarchy over scene objects, each one a bounding sphere
+// (typically a GLFrame's origin and the radius of the batch it draws), for
+// frustum culling that only costs something for what is on screen. Cull()
+// walks the tree from the top: a box outside the frustum drops its whole
+// subtree in one test, a box inside accepts its whole subtree without testing
+// anything under it, and only boxes the frustum cuts through are opened up.
+//
+// The nodes are axis aligned boxes in one flat array in depth first order,
+// 32 bytes each, with each node's subtree followed by the next node to visit
+// when it is skipped. The objects are stored in leaf order, so the objects of
+// any subtree are one contiguous run.
+//
+//		bvh.SetCount(NUM_SPHERES);
+//		for(int i = 0; i < NUM_SPHERES; i++)
+//			bvh.SetSphere(i, spheres[i], 0.1f);
+//		bvh.Build();
+//		...
+//		viewFrustum.Transform(cameraFrame);			// or ExtractPlanes(mvp)
+//		int nVisible = bvh.Cull(viewFrustum, pVisibleIds);
+//
+// Moving objects: SetSphere() again and call Refit() before the next Cull().
+// Refit() only grows or shrinks the boxes above the objects that moved, so the
+// tree stays valid but gets looser as things wander; Build() again now and
+// then (when a lot of objects have moved a long way) to get it tight again.
+
+#ifndef __GLT_SPHERE_BVH
+#define __GLT_SPHERE_BVH
+
+#include <GLTools.h>
+#include <GLFrustum.h>
+#include <algorithm>
+#include <float.h>
+#include <vector>
+
+// Most objects per leaf
+#ifndef GLT_BVH_LEAF_SIZE
+#define GLT_BVH_LEAF_SIZE	8
+#endif
+
+class GLSphereBVH
+	{
+	public:
+		GLSphereBVH(void) { nObjects = 0; bBuilt = false; }
+
+		// Number of objects, with ids 0 to nCount - 1. Throws the tree away.
+		void SetCount(int nCount) {
+			nObjects = nCount;
+			x.assign(nCount, 0.0f); y.assign(nCount, 0.0f); z.assign(nCount, 0.0f); r.assign(nCount, 0.0f);
+			ids.resize(nCount);
+			slots.resize(nCount);
+			for(int i = 0; i < nCount; i++)
+				ids[i] = slots[i] = i;
+			nodes.clear();
+			bBuilt = false;
+			}
+
+		inline int GetCount(void) const { return nObjects; }
+
+		void SetSphere(int iObject, const M3DVector3f vCenter, float fRadius) {
+			int s = slots[iObject];
+			x[s] = vCenter[0]; y[s] = vCenter[1]; z[s] = vCenter[2]; r[s] = fRadius;
+			if(bBuilt)
+				MarkDirty(leafOf[s]);
+			}
+
+		void SetSphere(int iObject, GLFrame& frame, float fRadius) {
+			M3DVector3f vOrigin;
+			frame.GetOrigin(vOrigin);
+			SetSphere(iObject, vOrigin, fRadius);
+			}
+
+
+		///////////////////////////////////////////////////////////////////////
+		// Build the tree from scratch: each box is split in two at the middle
+		// object along its longest side until GLT_BVH_LEAF_SIZE objects are left.
+		void Build(void) {
+			// Objects go back to id order first, so a rebuild gives the same
+			// tree no matter how the last one sorted them
+			std::vector<float> tx(nObjects), ty(nObjects), tz(nObjects), tr(nObjects);
+			for(int s = 0; s < nObjects; s++) {
+				int id = ids[s];
+				tx[id] = x[s]; ty[id] = y[s]; tz[id] = z[s]; tr[id] = r[s];
+				}
+			x.swap(tx); y.swap(ty); z.swap(tz); r.swap(tr);
+			for(int i = 0; i < nObjects; i++)
+				ids[i] = i;
+
+			nodes.clear();
+			nodes.reserve(2 * (nObjects / GLT_BVH_LEAF_SIZE + 1));
+			parents.clear();
+			if(nObjects > 0)
+				BuildNode(0, nObjects, -1);
+
+			// Sphere data in leaf order
+			for(int s = 0; s < nObjects; s++) {
+				tx[s] = x[ids[s]]; ty[s] = y[ids[s]]; tz[s] = z[ids[s]]; tr[s] = r[ids[s]];
+				slots[ids[s]] = s;
+				}
+			x.swap(tx); y.swap(ty); z.swap(tz); r.swap(tr);
+
+			// The end marker, so a node's objects are [iFirst, next node's iFirst)
+			Node end;
+			end.iFirst = nObjects;
+			end.iSkip = int(nodes.size()) + 1;
+			nodes.push_back(end);
+
+			leafOf.resize(nObjects);
+			for(int n = 0; n < int(nodes.size()) - 1; n++)
+				if(IsLeaf(n))
+					for(int s = nodes[n].iFirst; s < nodes[n + 1].iFirst; s++)
+						leafOf[s] = n;
+
+			lastPlane.assign(nodes.size(), 0);
+			dirty.assign(nodes.size(), 0);
+			dirtyNodes.clear();
+			for(int n = int(nodes.size()) - 2; n >= 0; n--)
+				ComputeBounds(n);
+			bBuilt = true;
+			}
+
+		// Bring the boxes above every object moved since the last Build/Refit
+		// up to date. Children come after their parents, so going through the
+		// changed nodes from the highest index down does each node after all of
+		// its children.
+		void Refit(void) {
+			std::sort(dirtyNodes.begin(), dirtyNodes.end());
+			for(int i = int(dirtyNodes.size()) - 1; i >= 0; i--) {
+				ComputeBounds(dirtyNodes[i]);
+				dirty[dirtyNodes[i]] = 0;
+				}
+			dirtyNodes.clear();
+			}
+
+
+		///////////////////////////////////////////////////////////////////////
+		// Write the ids of the objects whose spheres are in the frustum to
+		// pVisible (room for GetCount() ids) and return how many there are. The
+		// same spheres pass as with frustum.TestSphere, just without testing
+		// every one. Uses the frustum's planes as they are now (Transform or
+		// ExtractPlanes).
+		int Cull(GLFrustum& frustum, int *pVisible) {
+			if(!bBuilt)
+				Build();
+			if(nObjects == 0)
+				return 0;
+
+			M3DVector4f planes[6];
+			frustum.GetPlanes(planes);
+
+			// Plane masks of the boxes we are inside, and where each one ends
+			struct Open { int iEnd; unsigned int iMask; };
+			Open stack[64];
+			int nOpen = 0;
+			unsigned int iMask = GLT_FRUSTUM_ALL_PLANES;
+			int nVisible = 0;
+			int nNodes = int(nodes.size()) - 1;
+
+			int n = 0;
+			while(n < nNodes) {
+				while(nOpen > 0 && stack[nOpen - 1].iEnd <= n)
+					nOpen--;
+				iMask = (nOpen > 0) ? stack[nOpen - 1].iMask : GLT_FRUSTUM_ALL_PLANES;
+
+				const Node& node = nodes[n];
+				unsigned int iNodeMask = iMask;
+				int iLast = lastPlane[n];
+				GLT_FRUSTUM_RESULT result = frustum.TestAABB(node.vMin, node.vMax, iNodeMask, iLast);
+				lastPlane[n] = (unsigned char)iLast;
+
+				if(result == GLT_FRUSTUM_OUTSIDE) {
+					n = node.iSkip;
+					continue;
+					}
+
+				if(result == GLT_FRUSTUM_INSIDE) {
+					// Everything under here, no more tests
+					for(int s = node.iFirst; s < nodes[node.iSkip].iFirst; s++)
+						pVisible[nVisible++] = ids[s];
+					n = node.iSkip;
+					continue;
+					}
+
+				if(IsLeaf(n)) {
+					// Only the planes the leaf's box crosses
+					for(int s = node.iFirst; s < nodes[n + 1].iFirst; s++) {
+						bool bIn = true;
+						for(int p = 0; p < 6 && bIn; p++)
+							if(iNodeMask & (1u << p))
+								bIn = !(x[s] * planes[p][0] + y[s] * planes[p][1] + z[s] * planes[p][2] + planes[p][3] + r[s] <= 0.0f);
+						if(bIn)
+							pVisible[nVisible++] = ids[s];
+						}
+					n++;
+					continue;
+					}
+
+				// Open it up; its children start from its mask
+				if(nOpen < 64) {
+					stack[nOpen].iEnd = node.iSkip;
+					stack[nOpen].iMask = iNodeMask;
+					nOpen++;
+					}
+				n++;
+				}
+
+			return nVisible;
+			}
+
+		// How many nodes, for stats
+		inline int GetNodeCount(void) const { return nodes.empty() ? 0 : int(nodes.size()) - 1; }
+
+	protected:
+		struct Node
+			{
+			M3DVector3f	vMin;
+			int			iSkip;		// The next node after this subtree
+			M3DVector3f	vMax;
+			int			iFirst;		// First object slot of this subtree
+			};
+
+		// A leaf's next node is its skip node
+		inline bool IsLeaf(int n) const { return nodes[n].iSkip == n + 1; }
+
+		void BuildNode(int iBegin, int iEnd, int iParent) {
+			int n = int(nodes.size());
+			nodes.push_back(Node());
+			parents.push_back(iParent);
+			nodes[n].iFirst = iBegin;
+
+			if(iEnd - iBegin > GLT_BVH_LEAF_SIZE) {
+				// Split at the median center along the longest side of the centers' box
+				float fMin[3] = { x[ids[iBegin]], y[ids[iBegin]], z[ids[iBegin]] };
+				float fMax[3] = { fMin[0], fMin[1], fMin[2] };
+				for(int s = iBegin + 1; s < iEnd; s++) {
+					float c[3] = { x[ids[s]], y[ids[s]], z[ids[s]] };
+					for(int a = 0; a < 3; a++) {
+						if(c[a] < fMin[a]) fMin[a] = c[a];
+						if(c[a] > fMax[a]) fMax[a] = c[a];
+						}
+					}
+				int iAxis = 0;
+				if(fMax[1] - fMin[1] > fMax[iAxis] - fMin[iAxis]) iAxis = 1;
+				if(fMax[2] - fMin[2] > fMax[iAxis] - fMin[iAxis]) iAxis = 2;
+				const float *pAxis = (iAxis == 0) ? &x[0] : (iAxis == 1) ? &y[0] : &z[0];
+
+				int iMid = (iBegin + iEnd) / 2;
+				std::nth_element(ids.begin() + iBegin, ids.begin() + iMid, ids.begin() + iEnd, AxisLess(pAxis));
+				BuildNode(iBegin, iMid, n);
+				BuildNode(iMid, iEnd, n);
+				}
+
+			nodes[n].iSkip = int(nodes.size());
+			}
+
+		struct AxisLess
+			{
+			const float *p;
+			AxisLess(const float *pAxis) : p(pAxis) {}
+			bool operator()(int a, int b) const { return p[a] < p[b] || (p[a] == p[b] && a < b); }
+			};
+
+		// Box around a leaf's spheres, or around a node's children's boxes
+		void ComputeBounds(int n) {
+			Node& node = nodes[n];
+			node.vMin[0] = node.vMin[1] = node.vMin[2] = FLT_MAX;
+			node.vMax[0] = node.vMax[1] = node.vMax[2] = -FLT_MAX;
+
+			if(IsLeaf(n)) {
+				for(int s = node.iFirst; s < nodes[n + 1].iFirst; s++) {
+					node.vMin[0] = std::min(node.vMin[0], x[s] - r[s]); node.vMax[0] = std::max(node.vMax[0], x[s] + r[s]);
+					node.vMin[1] = std::min(node.vMin[1], y[s] - r[s]); node.vMax[1] = std::max(node.vMax[1], y[s] + r[s]);
+					node.vMin[2] = std::min(node.vMin[2], z[s] - r[s]); node.vMax[2] = std::max(node.vMax[2], z[s] + r[s]);
+					}
+				return;
+				}
+
+			for(int c = n + 1; c < node.iSkip; c = nodes[c].iSkip)
+				for(int a = 0; a < 3; a++) {
+					node.vMin[a] = std::min(node.vMin[a], nodes[c].vMin[a]);
+					node.vMax[a] = std::max(node.vMax[a], nodes[c].vMax[a]);
+					}
+			}
+
+		// Queue a node and the ones above it for Refit
+		void MarkDirty(int n) {
+			for(; n >= 0 && !dirty[n]; n = parents[n]) {
+				dirty[n] = 1;
+				dirtyNodes.push_back(n);
+				}
+			}
+
+		int							nObjects;
+		bool						bBuilt;
+		std::vector<float>			x, y, z, r;		// Spheres, by slot (leaf order once built)
+		std::vector<int>			ids;			// Object id of each slot
+		std::vector<int>			slots;			// Slot of each object id
+		std::vector<int>			leafOf;			// Leaf node of each slot
+		std::vector<Node>			nodes;
+		std::vector<int>			parents;
+		std::vector<unsigned char>	lastPlane;		// Plane that last rejected each node
+		std::vector<unsigned char>	dirty;
+		std::vector<int>			dirtyNodes;
+
+	private:
+		GLSphereBVH(const GLSphereBVH&);
+		GLSphereBVH& operator=(const GLSphereBVH&);
+	};
+
+#endif
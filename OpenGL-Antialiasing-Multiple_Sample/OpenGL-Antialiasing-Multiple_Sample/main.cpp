@@ -179,17 +179,20 @@ void SetupRC() {
     GLfloat x = 700.0f;
     GLfloat y = 500.0f;
     GLfloat r = 50.0f;
-    GLfloat angle = 0.0f;
+    
+    // 0 ~ 2π，步长0.2弧度，共32个点，sin/cos 由 m3dMakeRing 一次算好
+    GLfloat fSin[32], fCos[32];
+    m3dMakeRing(fSin, fCos, 32, 0.0, 0.2);
     
     moonBatch.Begin(GL_TRIANGLE_FAN, 34);
     int nVerts = 0;
     vVerts[nVerts][0] = x;
     vVerts[nVerts][1] = y;
     vVerts[nVerts][2] = 0.0f;
-    for (angle = 0; angle < 2.0f * 3.141592f; angle += 0.2f) {
+    for (int i = 0; i < 32; i++) {
         nVerts++;
-        vVerts[nVerts][0] = x + float(cos(angle)) * r;
-        vVerts[nVerts][1] = y + float(sin(angle)) * r;
+        vVerts[nVerts][0] = x + fCos[i] * r;
+        vVerts[nVerts][1] = y + fSin[i] * r;
         vVerts[nVerts][2] = 0.0f;
     }
     nVerts++;
@@ -0,0 +1,231 @@
+//
+//  BenchBoxes.cpp
+//  OpenGL-Benchmark
+//
+//  10 万个细长的、随机朝向的盒子 (0.1 x 0.1 x 3~5)，分成 1000 簇，
+//  比较 GLFrustum 的 TestSphere / TestAABB / TestOBB，
+//  以及记住上次拒绝平面 (iLastPlane) 和按簇传递平面掩码的效果。
+//  TestAABB 和 TestOBB 的结果要和逐个检查 8 个角点的暴力算法一致。
+//
+
+#include "Benchmark.h"
+#include "GLTools.h"
+#include "GLFrustum.h"
+
+#include <math.h>
+#include <vector>
+
+#define NUM_CLUSTERS        1000
+#define OBJECTS_PER_CLUSTER 100
+#define NUM_OBJECTS         (NUM_CLUSTERS * OBJECTS_PER_CLUSTER)
+
+struct BoxObject {
+    M3DMatrix44f mModel;
+    M3DVector3f vLocalMin, vLocalMax;   // 物体自身坐标系里的盒子
+    M3DVector3f vMin, vMax;             // 包住它的世界坐标轴对齐盒子
+    M3DVector3f vCenter;                // 包围球
+    float fRadius;
+};
+
+// 暴力算法: 8 个角点全在某个平面外面就是 OUTSIDE，全在所有平面里面就是 INSIDE
+static int TestCorners(GLFrustum& frustum, const M3DVector3f vMin, const M3DVector3f vMax, const float *mModel) {
+    M3DVector4f vPlanes[6];
+    frustum.GetPlanes(vPlanes);
+    bool bAllInside = true;
+    for (int p = 0; p < 6; p++) {
+        int nIn = 0, nOut = 0;
+        for (int c = 0; c < 8; c++) {
+            M3DVector3f vCorner = { (c & 1) ? vMax[0] : vMin[0], (c & 2) ? vMax[1] : vMin[1], (c & 4) ? vMax[2] : vMin[2] };
+            M3DVector3f vWorld;
+            if (mModel) {
+                m3dTransformVector3(vWorld, vCorner, mModel);
+            }
+            else {
+                m3dCopyVector3(vWorld, vCorner);
+            }
+            float d = m3dGetDistanceToPlane(vWorld, vPlanes[p]);
+            if (d <= 0.0f) {
+                nOut++;
+            }
+            if (d >= 0.0f) {
+                nIn++;
+            }
+        }
+        if (nOut == 8) {
+            return GLT_FRUSTUM_OUTSIDE;
+        }
+        if (nIn != 8) {
+            bAllInside = false;
+        }
+    }
+    return bAllInside ? GLT_FRUSTUM_INSIDE : GLT_FRUSTUM_INTERSECTS;
+}
+
+static void GrowBox(M3DVector3f vMin, M3DVector3f vMax, const M3DVector3f v) {
+    for (int a = 0; a < 3; a++) {
+        if (v[a] < vMin[a]) {
+            vMin[a] = v[a];
+        }
+        if (v[a] > vMax[a]) {
+            vMax[a] = v[a];
+        }
+    }
+}
+
+int BenchBoxes(void) {
+    int nMismatches = 0;
+
+    GLFrustum frustum(35.0f, 1.333f, 1.0f, 100.0f);
+    GLFrame camera;
+    camera.SetOrigin(0.0f, 1.0f, 0.0f);
+    frustum.Transform(camera);
+
+    // 建场景
+    srand(1);
+    std::vector<BoxObject> objects(NUM_OBJECTS);
+    static M3DVector3f clusterMin[NUM_CLUSTERS], clusterMax[NUM_CLUSTERS];
+    for (int g = 0; g < NUM_CLUSTERS; g++) {
+        float cx = BenchRandom() * 120.0f, cy = BenchRandom() * 10.0f, cz = BenchRandom() * 120.0f;
+        m3dLoadVector3(clusterMin[g], 1e30f, 1e30f, 1e30f);
+        m3dLoadVector3(clusterMax[g], -1e30f, -1e30f, -1e30f);
+
+        for (int k = 0; k < OBJECTS_PER_CLUSTER; k++) {
+            BoxObject& box = objects[g * OBJECTS_PER_CLUSTER + k];
+            GLFrame frame;
+            frame.SetOrigin(cx + BenchRandom() * 3.0f, cy + BenchRandom() * 3.0f, cz + BenchRandom() * 3.0f);
+            frame.RotateLocalY(BenchRandom() * 3.0f);
+            frame.RotateLocalX(BenchRandom() * 3.0f);
+            frame.GetMatrix(box.mModel);
+
+            float fHalfLength = 1.5f + fabsf(BenchRandom());
+            m3dLoadVector3(box.vLocalMin, -0.05f, -0.05f, -fHalfLength);
+            m3dLoadVector3(box.vLocalMax, 0.05f, 0.05f, fHalfLength);
+
+            m3dLoadVector3(box.vMin, 1e30f, 1e30f, 1e30f);
+            m3dLoadVector3(box.vMax, -1e30f, -1e30f, -1e30f);
+            for (int c = 0; c < 8; c++) {
+                M3DVector3f vCorner = { (c & 1) ? box.vLocalMax[0] : box.vLocalMin[0],
+                                        (c & 2) ? box.vLocalMax[1] : box.vLocalMin[1],
+                                        (c & 4) ? box.vLocalMax[2] : box.vLocalMin[2] };
+                M3DVector3f vWorld;
+                m3dTransformVector3(vWorld, vCorner, box.mModel);
+                GrowBox(box.vMin, box.vMax, vWorld);
+            }
+            GrowBox(clusterMin[g], clusterMax[g], box.vMin);
+            GrowBox(clusterMin[g], clusterMax[g], box.vMax);
+
+            M3DVector3f vOrigin = { 0.0f, 0.0f, 0.0f };
+            m3dTransformVector3(box.vCenter, vOrigin, box.mModel);
+            box.fRadius = sqrtf(0.05f * 0.05f * 2.0f + fHalfLength * fHalfLength);
+        }
+    }
+
+    // 一致性: 和暴力算法比；从任意一个 iLastPlane 开始结果都一样；
+    // 用簇的掩码测试簇里的物体，结果也一样
+    for (int i = 0; i < NUM_OBJECTS; i++) {
+        BoxObject& box = objects[i];
+        int iAABB = frustum.TestAABB(box.vMin, box.vMax);
+        if (iAABB != TestCorners(frustum, box.vMin, box.vMax, NULL)) {
+            nMismatches++;
+        }
+        if (frustum.TestOBB(box.mModel, box.vLocalMin, box.vLocalMax) != TestCorners(frustum, box.vLocalMin, box.vLocalMax, box.mModel)) {
+            nMismatches++;
+        }
+        for (int p = 0; p < 6; p++) {
+            unsigned int iMask = GLT_FRUSTUM_ALL_PLANES;
+            int iLast = p;
+            if (frustum.TestAABB(box.vMin, box.vMax, iMask, iLast) != iAABB) {
+                nMismatches++;
+            }
+        }
+    }
+    for (int g = 0; g < NUM_CLUSTERS; g++) {
+        unsigned int iMask = GLT_FRUSTUM_ALL_PLANES;
+        int iLast = 0;
+        int iCluster = frustum.TestAABB(clusterMin[g], clusterMax[g], iMask, iLast);
+        for (int k = 0; k < OBJECTS_PER_CLUSTER; k++) {
+            BoxObject& box = objects[g * OBJECTS_PER_CLUSTER + k];
+            int iFull = frustum.TestAABB(box.vMin, box.vMax);
+            int iMasked = iCluster;
+            if (iCluster == GLT_FRUSTUM_INTERSECTS) {
+                unsigned int iChildMask = iMask;
+                int iChildLast = 0;
+                iMasked = frustum.TestAABB(box.vMin, box.vMax, iChildMask, iChildLast);
+            }
+            if (iMasked != iFull) {
+                nMismatches++;
+            }
+        }
+    }
+
+    // 计时，每个物体 (和每个簇) 各记一个 iLastPlane
+    std::vector<int> lastAABB(NUM_OBJECTS, 0), lastOBB(NUM_OBJECTS, 0), lastChild(NUM_OBJECTS, 0), lastCluster(NUM_CLUSTERS, 0);
+    int nVisible = 0;
+    printf("  test                                   time      visible\n");
+
+    double d = BenchBestOf(20, 1, [&]() {
+        nVisible = 0;
+        for (int i = 0; i < NUM_OBJECTS; i++) {
+            nVisible += frustum.TestSphere(objects[i].vCenter, objects[i].fRadius);
+        }
+    });
+    printf("  %-36s %6.2f ms   %d\n", "TestSphere", d * 1e3, nVisible);
+
+    d = BenchBestOf(20, 1, [&]() {
+        nVisible = 0;
+        for (int i = 0; i < NUM_OBJECTS; i++) {
+            nVisible += frustum.TestAABB(objects[i].vMin, objects[i].vMax) != GLT_FRUSTUM_OUTSIDE;
+        }
+    });
+    printf("  %-36s %6.2f ms   %d\n", "TestAABB", d * 1e3, nVisible);
+
+    d = BenchBestOf(20, 1, [&]() {
+        nVisible = 0;
+        for (int i = 0; i < NUM_OBJECTS; i++) {
+            unsigned int iMask = GLT_FRUSTUM_ALL_PLANES;
+            nVisible += frustum.TestAABB(objects[i].vMin, objects[i].vMax, iMask, lastAABB[i]) != GLT_FRUSTUM_OUTSIDE;
+        }
+    });
+    printf("  %-36s %6.2f ms   %d\n", "TestAABB + last plane", d * 1e3, nVisible);
+
+    d = BenchBestOf(20, 1, [&]() {
+        nVisible = 0;
+        for (int i = 0; i < NUM_OBJECTS; i++) {
+            nVisible += frustum.TestOBB(objects[i].mModel, objects[i].vLocalMin, objects[i].vLocalMax) != GLT_FRUSTUM_OUTSIDE;
+        }
+    });
+    printf("  %-36s %6.2f ms   %d\n", "TestOBB", d * 1e3, nVisible);
+
+    d = BenchBestOf(20, 1, [&]() {
+        nVisible = 0;
+        for (int i = 0; i < NUM_OBJECTS; i++) {
+            unsigned int iMask = GLT_FRUSTUM_ALL_PLANES;
+            nVisible += frustum.TestOBB(objects[i].mModel, objects[i].vLocalMin, objects[i].vLocalMax, iMask, lastOBB[i]) != GLT_FRUSTUM_OUTSIDE;
+        }
+    });
+    printf("  %-36s %6.2f ms   %d\n", "TestOBB + last plane", d * 1e3, nVisible);
+
+    // 先测簇: 整簇在外面或整簇在里面就不用再测里面的物体，
+    // 否则把簇剩下的平面掩码传给里面的物体
+    d = BenchBestOf(20, 1, [&]() {
+        nVisible = 0;
+        for (int g = 0; g < NUM_CLUSTERS; g++) {
+            unsigned int iMask = GLT_FRUSTUM_ALL_PLANES;
+            int iCluster = frustum.TestAABB(clusterMin[g], clusterMax[g], iMask, lastCluster[g]);
+            if (iCluster == GLT_FRUSTUM_INSIDE) {
+                nVisible += OBJECTS_PER_CLUSTER;
+            }
+            else if (iCluster == GLT_FRUSTUM_INTERSECTS) {
+                for (int k = 0; k < OBJECTS_PER_CLUSTER; k++) {
+                    int i = g * OBJECTS_PER_CLUSTER + k;
+                    unsigned int iChildMask = iMask;
+                    nVisible += frustum.TestAABB(objects[i].vMin, objects[i].vMax, iChildMask, lastChild[i]) != GLT_FRUSTUM_OUTSIDE;
+                }
+            }
+        }
+    });
+    printf("  %-36s %6.2f ms   %d\n", "clusters, masked AABB + last plane", d * 1e3, nVisible);
+
+    printf("  mismatches: %d\n", nMismatches);
+    return nMismatches;
+}
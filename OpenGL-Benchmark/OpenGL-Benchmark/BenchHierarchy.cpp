@@ -0,0 +1,91 @@
+//
+//  BenchHierarchy.cpp
+//  OpenGL-Benchmark
+//
+//  100 万个节点的变换层级，全部标脏后更新一遍:
+//  串行 Update() 和 GLTaskPool 上 1/2/4/8/16 个线程的 Update(pool) 比较。
+//  并行更新用的是同样的乘法，世界矩阵必须逐位一致。
+//
+
+#include "Benchmark.h"
+#include "GLTransformHierarchy.h"
+#include "GLTaskPool.h"
+
+#include <string.h>
+#include <thread>
+
+#define NUM_NODES   1000000
+#define NUM_ROOTS   1000
+
+// 1000 个根节点；其余节点四分之一挂在任意一个更早的节点下 (枝叶茂盛的子树)，
+// 其余挂在前面 8 个节点之一下 (很深的长链)
+static void BuildScene(GLTransformHierarchy& scene) {
+    srand(1);
+    for (int i = 0; i < NUM_NODES; i++) {
+        int iParent = -1;
+        if (i >= NUM_ROOTS) {
+            iParent = (rand() % 4 == 0) ? rand() % i : i - 1 - rand() % 8;
+        }
+        GLFrame frame;
+        frame.SetOrigin(BenchRandom(), BenchRandom(), BenchRandom());
+        frame.RotateLocalY(BenchRandom());
+        scene.AddNode(frame, iParent);
+    }
+}
+
+static void MarkAllDirty(GLTransformHierarchy& scene) {
+    for (int i = 0; i < NUM_NODES; i++) {
+        scene.MarkDirty(i);
+    }
+}
+
+int BenchHierarchy(void) {
+    static const int nThreadCounts[] = { 1, 2, 4, 8, 16 };
+    int nMismatches = 0;
+
+    GLTransformHierarchy serial, parallel;
+    BuildScene(serial);
+    BuildScene(parallel);
+    serial.Update();
+    parallel.Update();
+
+    // 串行更新的时间，取 5 次里最快的一次
+    double dSerial = 1e30;
+    for (int r = 0; r < 5; r++) {
+        MarkAllDirty(serial);
+        CStopWatch timer;
+        serial.Update();
+        double d = timer.GetElapsedSeconds();
+        if (d < dSerial) {
+            dSerial = d;
+        }
+    }
+
+    printf("  %d nodes, %u hardware threads\n", NUM_NODES, std::thread::hardware_concurrency());
+    printf("  threads   parallel   speedup vs serial (%.1f ms)\n", dSerial * 1e3);
+    for (int t = 0; t < 5; t++) {
+        GLTaskPool pool(nThreadCounts[t]);
+
+        double dParallel = 1e30;
+        for (int r = 0; r < 5; r++) {
+            MarkAllDirty(parallel);
+            CStopWatch timer;
+            int nUpdated = parallel.Update(pool);
+            double d = timer.GetElapsedSeconds();
+            if (d < dParallel) {
+                dParallel = d;
+            }
+            if (nUpdated != NUM_NODES) {
+                nMismatches++;
+            }
+        }
+        if (memcmp(parallel.GetWorldMatrices(), serial.GetWorldMatrices(), sizeof(M3DMatrix44f) * NUM_NODES) != 0) {
+            nMismatches++;
+        }
+
+        printf("  %7d %8.1f ms   %6.2fx\n", nThreadCounts[t], dParallel * 1e3, dSerial / dParallel);
+    }
+
+    printf("  mismatches: %d\n", nMismatches);
+    return nMismatches;
+}
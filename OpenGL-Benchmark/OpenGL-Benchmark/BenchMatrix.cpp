@@ -0,0 +1,102 @@
+//
+//  BenchMatrix.cpp
+//  OpenGL-Benchmark
+//
+//  libGLTools.a 里的 m3dMatrixMultiply44 / m3dInvertMatrix44，
+//  和 m3dFastMatrixMultiply44 / m3dFastInvertMatrix44 在每个 m3dSetSIMDLevel 档位下的对比。
+//  乘法要求逐位一致；SSE 求逆用的是 2x2 分块，只要求误差在最大元素的 1e-4 以内。
+//
+
+#include "Benchmark.h"
+#include "math3d.h"
+#include "math3dSIMD.h"
+
+#include <math.h>
+
+#define NUM_MATRICES 64
+
+int BenchMatrix(void) {
+    static const char *szLevels[] = { "none (library)", "SSE2", "AVX", "AVX-512" };
+    static M3DMatrix44f a[NUM_MATRICES], b[NUM_MATRICES];
+    int nMismatches = 0;
+    const int nReps = 5000000;
+
+    // 随机的仿射矩阵，保证可逆
+    for (int k = 0; k < NUM_MATRICES; k++) {
+        m3dRotationMatrix44(a[k], BenchRandom() * 3.0f, BenchRandom(), BenchRandom(), 1.0f);
+        a[k][12] = BenchRandom() * 10.0f; a[k][13] = BenchRandom() * 10.0f; a[k][14] = BenchRandom() * 10.0f;
+        for (int i = 0; i < 16; i++) {
+            b[k][i] = BenchRandom();
+        }
+    }
+
+    // 轮流用 64 组矩阵，避免每次都算同一组
+    M3DMatrix44f r;
+    int k = 0;
+    double dMult = BenchBestOf(3, nReps, [&]() {
+        k = (k + 1) & (NUM_MATRICES - 1);
+        m3dMatrixMultiply44(r, a[k], b[k]);
+        benchSink += r[5];
+    });
+    double dInvert = BenchBestOf(3, nReps, [&]() {
+        k = (k + 1) & (NUM_MATRICES - 1);
+        m3dInvertMatrix44(r, a[k]);
+        benchSink += r[5];
+    });
+    printf("  path             multiply   inverse   (ns/op)   inverse error\n");
+    printf("  %-16s %8.2f  %8.2f\n", "library", dMult * 1e9, dInvert * 1e9);
+
+    M3D_SIMD_LEVEL supported = m3dGetSupportedSIMDLevel();
+    for (int l = M3D_SIMD_LEVEL_NONE; l <= supported; l++) {
+        m3dSetSIMDLevel(M3D_SIMD_LEVEL(l));
+
+        // 乘法逐位一致，输出和输入是同一个矩阵时也一样
+        double dMaxError = 0.0;
+        for (k = 0; k < NUM_MATRICES; k++) {
+            M3DMatrix44f mRef, mFast, mAlias;
+            m3dMatrixMultiply44(mRef, a[k], b[k]);
+            m3dFastMatrixMultiply44(mFast, a[k], b[k]);
+            m3dCopyMatrix44(mAlias, a[k]);
+            m3dFastMatrixMultiply44(mAlias, mAlias, b[k]);
+            for (int i = 0; i < 16; i++) {
+                if (mFast[i] != mRef[i] || mAlias[i] != mRef[i]) {
+                    nMismatches++;
+                }
+            }
+
+            m3dInvertMatrix44(mRef, a[k]);
+            m3dFastInvertMatrix44(mFast, a[k]);
+            float fLargest = 0.0f;
+            for (int i = 0; i < 16; i++) {
+                if (fabsf(mRef[i]) > fLargest) {
+                    fLargest = fabsf(mRef[i]);
+                }
+            }
+            for (int i = 0; i < 16; i++) {
+                double dError = fabs(double(mFast[i]) - double(mRef[i])) / fLargest;
+                if (dError > dMaxError) {
+                    dMaxError = dError;
+                }
+            }
+        }
+        if (dMaxError > 1e-4) {
+            nMismatches++;
+        }
+
+        dMult = BenchBestOf(3, nReps, [&]() {
+            k = (k + 1) & (NUM_MATRICES - 1);
+            m3dFastMatrixMultiply44(r, a[k], b[k]);
+            benchSink += r[5];
+        });
+        dInvert = BenchBestOf(3, nReps, [&]() {
+            k = (k + 1) & (NUM_MATRICES - 1);
+            m3dFastInvertMatrix44(r, a[k]);
+            benchSink += r[5];
+        });
+        printf("  %-16s %8.2f  %8.2f              %.2g\n", szLevels[l], dMult * 1e9, dInvert * 1e9, dMaxError);
+    }
+    m3dSetSIMDLevel(supported);
+
+    printf("  mismatches: %d\n", nMismatches);
+    return nMismatches;
+}
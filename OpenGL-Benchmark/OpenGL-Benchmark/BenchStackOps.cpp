@@ -0,0 +1,123 @@
+//
+//  BenchStackOps.cpp
+//  OpenGL-Benchmark
+//
+//  DrawSongAndDance 那样的一组矩阵堆栈操作:
+//  PushMatrix / Translate / Rotate (绕 Y 轴) / Translate / Scale / PopMatrix。
+//  旧写法每一步先建一个完整的 4x4 矩阵再调用 m3dMatrixMultiply44，
+//  GLMatrixStack 现在用 m3dMultTranslation44 / m3dMultRotation44 / m3dMultScale44
+//  原地修改栈顶。两种写法的运算顺序相同，结果必须逐位一致。
+//
+
+#include "Benchmark.h"
+#include "GLMatrixStack.h"
+
+#include <string.h>
+
+// 改动之前的 GLMatrixStack: 建好整个矩阵，复制栈顶，再做一次完整的 4x4 乘法
+struct OldMatrixStack {
+    M3DMatrix44f stack[8];
+    int stackPointer;
+
+    OldMatrixStack(void) : stackPointer(0) {
+        m3dLoadIdentity44(stack[0]);
+    }
+
+    void LoadMatrix(const M3DMatrix44f m) {
+        m3dCopyMatrix44(stack[stackPointer], m);
+    }
+
+    void PushMatrix(void) {
+        stackPointer++;
+        m3dCopyMatrix44(stack[stackPointer], stack[stackPointer - 1]);
+    }
+
+    void PopMatrix(void) {
+        stackPointer--;
+    }
+
+    void MultMatrix(const M3DMatrix44f m) {
+        M3DMatrix44f mTemp;
+        m3dCopyMatrix44(mTemp, stack[stackPointer]);
+        m3dMatrixMultiply44(stack[stackPointer], mTemp, m);
+    }
+
+    void Translate(float x, float y, float z) {
+        M3DMatrix44f m;
+        m3dTranslationMatrix44(m, x, y, z);
+        MultMatrix(m);
+    }
+
+    void Rotate(float angle, float x, float y, float z) {
+        M3DMatrix44f m;
+        m3dRotationMatrix44(m, float(m3dDegToRad(angle)), x, y, z);
+        MultMatrix(m);
+    }
+
+    void Scale(float x, float y, float z) {
+        M3DMatrix44f m;
+        m3dScaleMatrix44(m, x, y, z);
+        MultMatrix(m);
+    }
+
+    const M3DMatrix44f& GetMatrix(void) { return stack[stackPointer]; }
+};
+
+// 同一组操作，两种堆栈都能用；Pop 之前的栈顶矩阵放到 mResult
+template <class Stack>
+static void SongAndDance(Stack& stack, float fAngle, M3DMatrix44f mResult) {
+    stack.PushMatrix();
+    stack.Translate(0.0f, 0.5f, -2.5f);
+    stack.Rotate(fAngle, 0.0f, 1.0f, 0.0f);
+    stack.Translate(0.8f, 0.0f, 0.0f);
+    stack.Scale(0.3f, 0.3f, 0.3f);
+    m3dCopyMatrix44(mResult, stack.GetMatrix());
+    stack.PopMatrix();
+}
+
+int BenchStackOps(void) {
+    int nMismatches = 0;
+
+    // 镜像那一遍的照相机矩阵: 带着 Scale(1, -1, 1)
+    GLMatrixStack newStack;
+    OldMatrixStack oldStack;
+    newStack.Rotate(20.0f, 1.0f, 0.0f, 0.0f);
+    newStack.Translate(0.0f, -0.4f, -5.0f);
+    newStack.Scale(1.0f, -1.0f, 1.0f);
+    oldStack.LoadMatrix(newStack.GetMatrix());
+
+    // 一致性: 10 万个角度，包括负角度和超过一圈的
+    for (int i = 0; i < 100000; i++) {
+        float fAngle = BenchRandom() * 720.0f;
+        M3DMatrix44f mOld, mNew;
+        SongAndDance(oldStack, fAngle, mOld);
+        SongAndDance(newStack, fAngle, mNew);
+        for (int k = 0; k < 16; k++) {
+            if (mOld[k] != mNew[k]) {
+                nMismatches++;
+            }
+        }
+    }
+    if (memcmp(oldStack.GetMatrix(), newStack.GetMatrix(), sizeof(M3DMatrix44f)) != 0) {
+        nMismatches++;
+    }
+
+    // 计时: 整组操作 (6 步) 的时间
+    const int nReps = 10000000;
+    M3DMatrix44f m;
+    int i = 0;
+    double dOld = BenchBestOf(3, nReps, [&]() {
+        SongAndDance(oldStack, float(i++ & 1023) * 0.35f, m);
+        benchSink += m[12];
+    });
+    i = 0;
+    double dNew = BenchBestOf(3, nReps, [&]() {
+        SongAndDance(newStack, float(i++ & 1023) * 0.35f, m);
+        benchSink += m[12];
+    });
+    printf("  path                               per sequence   per op   (ns)\n");
+    printf("  %-34s %10.1f %8.1f\n", "full matrix + m3dMatrixMultiply44", dOld * 1e9, dOld * 1e9 / 6.0);
+    printf("  %-34s %10.1f %8.1f\n", "in place m3dMult*44", dNew * 1e9, dNew * 1e9 / 6.0);
+    printf("  mismatches: %d\n", nMismatches);
+    return nMismatches;
+}
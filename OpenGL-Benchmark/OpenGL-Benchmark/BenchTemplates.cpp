@@ -0,0 +1,83 @@
+//
+//  BenchTemplates.cpp
+//  OpenGL-Benchmark
+//
+//  在矩阵堆栈上依次调用 LoadIdentity / Translate / Rotate / Scale，
+//  和用 math3dTemplates.h 的表达式一次算出再 LoadMatrix 比较。
+//  两种写法的运算顺序相同，结果必须逐位一致。
+//
+
+#include "Benchmark.h"
+#include "GLMatrixStack.h"
+#include "math3dTemplates.h"
+
+#include <string.h>
+
+int BenchTemplates(void) {
+    using namespace m3d;
+    int nMismatches = 0;
+    GLMatrixStack stack;
+
+    // 一致性: 基础矩阵乘上 1000 组不同的平移/旋转/缩放，= 和 *= 两种写法
+    stack.Rotate(20.0f, 1.0f, 0.0f, 0.0f);
+    stack.Translate(0.0f, 0.0f, -5.0f);
+    M3DMatrix44f mBase;
+    stack.GetMatrix(mBase);
+    for (int i = 0; i < 1000; i++) {
+        float x = float(i) * 0.01f;
+        float fAngle = float(i) * 0.3f;
+        float fRadians = float(m3dDegToRad(fAngle));
+
+        stack.LoadMatrix(mBase);
+        stack.Translate(x, 1.0f, 2.0f);
+        stack.Rotate(fAngle, 0.3f, 1.0f, 0.2f);
+        stack.Scale(2.0f, 3.0f, x + 1.0f);
+        M3DMatrix44f mRef;
+        stack.GetMatrix(mRef);
+
+        M3DMatrix44f m;
+        AsMat(m) = AsMat(mBase) * Translate(x, 1.0f, 2.0f) * Rotate(fRadians, 0.3f, 1.0f, 0.2f) * Scale(2.0f, 3.0f, x + 1.0f);
+        if (memcmp(m, mRef, sizeof(M3DMatrix44f)) != 0) {
+            nMismatches++;
+        }
+
+        stack.LoadMatrix(mBase);
+        stack.MultMatrix(Translate(x, 1.0f, 2.0f) * Rotate(fRadians, 0.3f, 1.0f, 0.2f) * Scale(2.0f, 3.0f, x + 1.0f));
+        if (memcmp(stack.GetMatrix(), mRef, sizeof(M3DMatrix44f)) != 0) {
+            nMismatches++;
+        }
+    }
+
+    // 计时: 每帧给一个物体设置模型矩阵的典型写法。
+    // 绕坐标轴旋转时矩阵堆栈有专门的快速路径，所以任意轴也测一遍
+    static const float fAxes[2][3] = { { 0.0f, 1.0f, 0.0f }, { 0.3f, 1.0f, 0.2f } };
+    static const char *szAxes[2] = { "Y axis", "any axis" };
+    const int nReps = 10000000;
+    printf("  rotation    stack ops   expression   expression, rotation built once   (ns)\n");
+    for (int a = 0; a < 2; a++) {
+        float ax = fAxes[a][0], ay = fAxes[a][1], az = fAxes[a][2];
+        int i = 0;
+        double dStack = BenchBestOf(3, nReps, [&]() {
+            stack.LoadIdentity();
+            stack.Translate(float(i++) * 1e-6f, 1.0f, 2.0f);
+            stack.Rotate(30.0f, ax, ay, az);
+            stack.Scale(2.0f, 2.0f, 2.0f);
+            benchSink += stack.GetMatrix()[12];
+        });
+        i = 0;
+        double dExpr = BenchBestOf(3, nReps, [&]() {
+            stack.LoadMatrix(Translate(float(i++) * 1e-6f, 1.0f, 2.0f) * Rotate(float(m3dDegToRad(30.0)), ax, ay, az) * Scale(2.0f, 2.0f, 2.0f));
+            benchSink += stack.GetMatrix()[12];
+        });
+        // 旋转矩阵的正弦余弦预先算好
+        RotateExpr<float> rotate(float(m3dDegToRad(30.0)), ax, ay, az);
+        i = 0;
+        double dPrebuilt = BenchBestOf(3, nReps, [&]() {
+            stack.LoadMatrix(Translate(float(i++) * 1e-6f, 1.0f, 2.0f) * rotate * Scale(2.0f, 2.0f, 2.0f));
+            benchSink += stack.GetMatrix()[12];
+        });
+        printf("  %-10s %10.1f %12.1f %20.1f\n", szAxes[a], dStack * 1e9, dExpr * 1e9, dPrebuilt * 1e9);
+    }
+    printf("  mismatches: %d\n", nMismatches);
+    return nMismatches;
+}
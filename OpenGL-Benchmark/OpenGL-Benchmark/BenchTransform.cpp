@@ -0,0 +1,73 @@
+//
+//  BenchTransform.cpp
+//  OpenGL-Benchmark
+//
+//  逐点调用 m3dTransformVector3，和 math3dSIMD.h 的
+//  m3dTransformVectorArray3 (AoS) / m3dTransformVectorStream3 (SoA) 比较。
+//  三种写法的运算顺序相同，结果必须逐位一致。
+//
+
+#include "Benchmark.h"
+#include "math3d.h"
+#include "math3dSIMD.h"
+
+#include <vector>
+
+int BenchTransform(void) {
+    static const int nSizes[] = { 1000, 100000, 10000000 };
+    int nMismatches = 0;
+
+    M3DMatrix44f m;
+    m3dRotationMatrix44(m, 0.7f, 1.0f, 2.0f, 3.0f);
+    m[12] = 1.0f; m[13] = -2.0f; m[14] = 3.0f;
+
+    printf("  points   per-point loop   AoS array   SoA stream   (ns per point)\n");
+    for (int s = 0; s < 3; s++) {
+        int n = nSizes[s];
+        std::vector<float> in(n * 3), loopOut(n * 3), arrayOut(n * 3);
+        std::vector<float> x(n), y(n), z(n), xOut(n), yOut(n), zOut(n);
+        for (int i = 0; i < n; i++) {
+            in[i * 3] = x[i] = BenchRandom();
+            in[i * 3 + 1] = y[i] = BenchRandom();
+            in[i * 3 + 2] = z[i] = BenchRandom();
+        }
+        const M3DVector3f *pIn = (const M3DVector3f *)&in[0];
+
+        // 总共处理大约 2000 万个点，小数组多跑几遍
+        int nReps = 20000000 / n;
+        if (nReps < 2) {
+            nReps = 2;
+        }
+
+        double dLoop = BenchBestOf(3, nReps, [&]() {
+            for (int i = 0; i < n; i++) {
+                m3dTransformVector3(&loopOut[i * 3], pIn[i], m);
+            }
+            benchSink += loopOut[n - 1];
+        });
+        double dArray = BenchBestOf(3, nReps, [&]() {
+            m3dTransformVectorArray3((M3DVector3f *)&arrayOut[0], pIn, m, n);
+            benchSink += arrayOut[n - 1];
+        });
+        double dStream = BenchBestOf(3, nReps, [&]() {
+            m3dTransformVectorStream3(&xOut[0], &yOut[0], &zOut[0], &x[0], &y[0], &z[0], m, n);
+            benchSink += xOut[n - 1];
+        });
+
+        for (int i = 0; i < n; i++) {
+            for (int c = 0; c < 3; c++) {
+                if (arrayOut[i * 3 + c] != loopOut[i * 3 + c]) {
+                    nMismatches++;
+                }
+            }
+            if (xOut[i] != loopOut[i * 3] || yOut[i] != loopOut[i * 3 + 1] || zOut[i] != loopOut[i * 3 + 2]) {
+                nMismatches++;
+            }
+        }
+
+        printf("  %-8d %10.2f       %9.2f   %10.2f\n", n, dLoop * 1e9 / n, dArray * 1e9 / n, dStream * 1e9 / n);
+    }
+
+    printf("  mismatches: %d\n", nMismatches);
+    return nMismatches;
+}
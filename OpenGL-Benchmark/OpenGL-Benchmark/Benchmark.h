@@ -0,0 +1,50 @@
+//
+//  Benchmark.h
+//  OpenGL-Benchmark
+//
+//  各个基准测试共用的小工具。每个测试先检查结果和参考实现是否一致，
+//  再计时，返回不一致的个数 (0 表示全部一致)。
+//
+
+#ifndef __BENCHMARK_H
+#define __BENCHMARK_H
+
+#include "StopWatch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// [-1, 1] 之间的随机数
+inline float BenchRandom(void) {
+    return float(rand()) / float(RAND_MAX) * 2.0f - 1.0f;
+}
+
+// 把结果累加到这里，防止编译器把被测代码整个优化掉
+extern volatile float benchSink;
+
+// 把 fn 连续运行 nReps 次，重复 nRounds 轮，返回最快一轮里每次运行的秒数
+template <class Fn>
+double BenchBestOf(int nRounds, int nReps, Fn fn) {
+    double dBest = 1e30;
+    for (int r = 0; r < nRounds; r++) {
+        CStopWatch timer;
+        for (int i = 0; i < nReps; i++) {
+            fn();
+        }
+        double d = timer.GetElapsedSeconds() / double(nReps);
+        if (d < dBest) {
+            dBest = d;
+        }
+    }
+    return dBest;
+}
+
+// 各个基准测试，见对应的 Bench*.cpp
+int BenchTransform(void);
+int BenchMatrix(void);
+int BenchStackOps(void);
+int BenchTemplates(void);
+int BenchHierarchy(void);
+int BenchBoxes(void);
+
+#endif
@@ -0,0 +1,469 @@
+// GLFrustum.h
+// Code by Richard S. Wright Jr.
+// Encapsulates a frustum... works in conjunction
+// with GLFrame
+/* Copyright (c) 2005-2009, Richard S. Wright Jr.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, 
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list 
+of conditions and the following disclaimer.
+
+Redistributions in binary form must reproduce the above copyright notice, this list 
+of conditions and the following disclaimer in the documentation and/or other 
+materials provided with the distribution.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used 
+to endorse or promote products derived from this software without specific prior 
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY 
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT 
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED 
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include "math3d.h"
+#include "math3dSIMD.h"
+#include "GLFrame.h"
+
+#ifndef __GL_FRAME_CLASS
+#define __GL_FRAME_CLASS
+
+
+// The planes in the order TestSphere tries them. Bit i of a plane mask
+// (see TestAABB) stands for plane i.
+enum GLT_FRUSTUM_PLANE { GLT_PLANE_NEAR = 0, GLT_PLANE_FAR, GLT_PLANE_LEFT, GLT_PLANE_RIGHT,
+                         GLT_PLANE_BOTTOM, GLT_PLANE_TOP };
+#define GLT_FRUSTUM_ALL_PLANES  0x3F
+
+// Box test results
+enum GLT_FRUSTUM_RESULT { GLT_FRUSTUM_OUTSIDE = 0, GLT_FRUSTUM_INTERSECTS, GLT_FRUSTUM_INSIDE };
+
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+class GLFrustum
+    {
+    public:
+        GLFrustum(void)       // Set some Reasonable Defaults
+            { SetOrthographic(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f); }
+
+        // Set the View Frustum
+        GLFrustum(GLfloat fFov, GLfloat fAspect, GLfloat fNear, GLfloat fFar)
+            { SetPerspective(fFov, fAspect, fNear, fFar); }
+
+		GLFrustum(GLfloat xMin, GLfloat xMax, GLfloat yMin, GLfloat yMax, GLfloat zMin, GLfloat zMax)
+			{ SetOrthographic(xMin, xMax, yMin, yMax, zMin, zMax); }
+
+		// Get the projection matrix for this guy
+		const M3DMatrix44f& GetProjectionMatrix(void) { return projMatrix; }
+
+        // Calculates the corners of the Frustum and sets the projection matrix.
+		// Orthographics Matrix Projection    
+		void SetOrthographic(GLfloat xMin, GLfloat xMax, GLfloat yMin, GLfloat yMax, GLfloat zMin, GLfloat zMax)
+			{
+			m3dMakeOrthographicMatrix(projMatrix, xMin, xMax, yMin, yMax, zMin, zMax);
+			projMatrix[15] = 1.0f;
+
+
+			// Fill in values for untransformed Frustum corners
+            // Near Upper Left
+            nearUL[0] = xMin; nearUL[1] = yMax; nearUL[2] = zMin; nearUL[3] = 1.0f;
+
+            // Near Lower Left
+            nearLL[0] = xMin; nearLL[1] = yMin; nearLL[2] = zMin; nearLL[3] = 1.0f;
+
+            // Near Upper Right
+            nearUR[0] = xMax; nearUR[1] = yMax; nearUR[2] = zMin; nearUR[3] = 1.0f;
+
+            // Near Lower Right
+            nearLR[0] = xMax; nearLR[1] = yMin; nearLR[2] = zMin; nearLR[3] = 1.0f;
+
+            // Far Upper Left
+            farUL[0] = xMin; farUL[1] = yMax; farUL[2] = zMax; farUL[3] = 1.0f;
+
+            // Far Lower Left
+            farLL[0] = xMin; farLL[1] = yMin; farLL[2] = zMax; farLL[3] = 1.0f;
+
+            // Far Upper Right
+            farUR[0] = xMax; farUR[1] = yMax; farUR[2] = zMax; farUR[3] = 1.0f;
+
+            // Far Lower Right
+            farLR[0] = xMax; farLR[1] = yMin; farLR[2] = zMax; farLR[3] = 1.0f;
+			}
+
+
+        // Calculates the corners of the Frustum and sets the projection matrix.
+		// Perspective Matrix Projection
+		void SetPerspective(float fFov, float fAspect, float fNear, float fFar)
+            {
+            float xmin, xmax, ymin, ymax;       // Dimensions of near clipping plane
+            float xFmin, xFmax, yFmin, yFmax;   // Dimensions of far clipping plane
+
+            // Do the Math for the near clipping plane
+            ymax = fNear * float(tan( fFov * M3D_PI / 360.0 ));
+            ymin = -ymax;
+            xmin = ymin * fAspect;
+            xmax = -xmin;
+              
+			// Construct the projection matrix
+            m3dLoadIdentity44(projMatrix);
+            projMatrix[0] = (2.0f * fNear)/(xmax - xmin);
+            projMatrix[5] = (2.0f * fNear)/(ymax - ymin);
+            projMatrix[8] = (xmax + xmin) / (xmax - xmin);
+            projMatrix[9] = (ymax + ymin) / (ymax - ymin);
+            projMatrix[10] = -((fFar + fNear)/(fFar - fNear));
+            projMatrix[11] = -1.0f;
+            projMatrix[14] = -((2.0f * fFar * fNear)/(fFar - fNear));
+			projMatrix[15] = 0.0f;
+          
+            // Do the Math for the far clipping plane
+            yFmax = fFar * float(tan(fFov * M3D_PI / 360.0));
+            yFmin = -yFmax;
+            xFmin = yFmin * fAspect;
+            xFmax = -xFmin;
+
+
+            // Fill in values for untransformed Frustum corners
+            // Near Upper Left
+            nearUL[0] = xmin; nearUL[1] = ymax; nearUL[2] = -fNear; nearUL[3] = 1.0f;
+
+            // Near Lower Left
+            nearLL[0] = xmin; nearLL[1] = ymin; nearLL[2] = -fNear; nearLL[3] = 1.0f;
+
+            // Near Upper Right
+            nearUR[0] = xmax; nearUR[1] = ymax; nearUR[2] = -fNear; nearUR[3] = 1.0f;
+
+            // Near Lower Right
+            nearLR[0] = xmax; nearLR[1] = ymin; nearLR[2] = -fNear; nearLR[3] = 1.0f;
+
+            // Far Upper Left
+            farUL[0] = xFmin; farUL[1] = yFmax; farUL[2] = -fFar; farUL[3] = 1.0f;
+
+            // Far Lower Left
+            farLL[0] = xFmin; farLL[1] = yFmin; farLL[2] = -fFar; farLL[3] = 1.0f;
+
+            // Far Upper Right
+            farUR[0] = xFmax; farUR[1] = yFmax; farUR[2] = -fFar; farUR[3] = 1.0f;
+
+            // Far Lower Right
+            farLR[0] = xFmax; farLR[1] = yFmin; farLR[2] = -fFar; farLR[3] = 1.0f;
+            }
+
+
+        // Builds a transformation matrix and transforms the corners of the Frustum,
+        // then derives the plane equations
+        void Transform(GLFrame& Camera)
+            {
+            // Workspace
+   			M3DMatrix44f rotMat;
+            M3DVector3f vForward, vUp, vCross;
+            M3DVector3f   vOrigin;
+
+            ///////////////////////////////////////////////////////////////////
+            // Create the transformation matrix. This was the trickiest part
+            // for me. The default view from OpenGL is down the negative Z
+            // axis. However, building a transformation axis from these 
+            // directional vectors points the frustum the wrong direction. So
+            // You must reverse them here, or build the initial frustum
+            // backwards - which to do is purely a matter of taste. I chose to
+            // compensate here to allow better operability with some of my other
+            // legacy code and projects. RSW
+            Camera.GetForwardVector(vForward);
+            vForward[0] = -vForward[0];
+            vForward[1] = -vForward[1];
+            vForward[2] = -vForward[2];
+
+            Camera.GetUpVector(vUp);
+            Camera.GetOrigin(vOrigin);
+   
+	   		// Calculate the right side (x) vector
+            m3dCrossProduct3(vCross, vUp, vForward);
+
+            // The Matrix
+   			// X Column
+	   		memcpy(rotMat, vCross, sizeof(float)*3);
+            rotMat[3] = 0.0f;
+           
+            // Y Column
+		   	memcpy(&rotMat[4], vUp, sizeof(float)*3);
+            rotMat[7] = 0.0f;       
+                                    
+            // Z Column
+		   	memcpy(&rotMat[8], vForward, sizeof(float)*3);
+            rotMat[11] = 0.0f;
+
+            // Translation
+			rotMat[12] = vOrigin[0];
+            rotMat[13] = vOrigin[1];
+            rotMat[14] = vOrigin[2];
+            rotMat[15] = 1.0f;
+
+            ////////////////////////////////////////////////////
+            // Transform the frustum corners
+            m3dTransformVector4(nearULT, nearUL, rotMat);
+            m3dTransformVector4(nearLLT, nearLL, rotMat);
+            m3dTransformVector4(nearURT, nearUR, rotMat);
+            m3dTransformVector4(nearLRT, nearLR, rotMat);
+            m3dTransformVector4(farULT, farUL, rotMat);
+            m3dTransformVector4(farLLT, farLL, rotMat);
+            m3dTransformVector4(farURT, farUR, rotMat);
+            m3dTransformVector4(farLRT, farLR, rotMat);
+
+            ////////////////////////////////////////////////////
+            // Derive Plane Equations from points... Points given in
+            // counter clockwise order to make normals point inside 
+            // the Frustum
+            // Near and Far Planes
+            m3dGetPlaneEquation(planes[GLT_PLANE_NEAR], nearULT, nearLLT, nearLRT);
+            m3dGetPlaneEquation(planes[GLT_PLANE_FAR], farULT, farURT, farLRT);
+            
+            // Top and Bottom Planes
+            m3dGetPlaneEquation(planes[GLT_PLANE_TOP], nearULT, nearURT, farURT);
+            m3dGetPlaneEquation(planes[GLT_PLANE_BOTTOM], nearLLT, farLLT, farLRT);
+
+            // Left and right planes
+            m3dGetPlaneEquation(planes[GLT_PLANE_LEFT], nearLLT, nearULT, farULT);
+            m3dGetPlaneEquation(planes[GLT_PLANE_RIGHT], nearLRT, farLRT, farURT);
+            }
+
+
+        // Set the planes straight from a projection or model-view-projection
+        // matrix, instead of from this frustum's own shape and a GLFrame
+        // (Gribb and Hartmann). A point p is inside the clip volume when
+        // -w <= x, y, z <= w for (x, y, z, w) = M * p, so each plane is the
+        // fourth row of M plus or minus one of the others. The planes come out
+        // in whatever space M starts from: eye space for a projection matrix,
+        // world space for projection * camera, model space for a full MVP. That
+        // makes it work for any matrix, including mirrored views (a
+        // Scale(1, -1, 1) in the model-view), shadow map light frusta and off
+        // axis projections. The planes are normalized, so the tests still get
+        // real distances to compare with the radii.
+        //
+        // Only the plane tests use the result; the corner points are left as
+        // they were.
+        void ExtractPlanes(const M3DMatrix44f mMatrix)
+            {
+            const float *m = mMatrix;
+
+            for(int i = 0; i < 3; i++) {
+                // Row i against row 3: +row is the left/bottom/near plane, -row
+                // the right/top/far one
+                float *pLow = planes[(i == 0) ? GLT_PLANE_LEFT : (i == 1) ? GLT_PLANE_BOTTOM : GLT_PLANE_NEAR];
+                float *pHigh = planes[(i == 0) ? GLT_PLANE_RIGHT : (i == 1) ? GLT_PLANE_TOP : GLT_PLANE_FAR];
+                for(int j = 0; j < 4; j++) {
+                    pLow[j] = m[j * 4 + 3] + m[j * 4 + i];
+                    pHigh[j] = m[j * 4 + 3] - m[j * 4 + i];
+                    }
+                }
+
+            // An infinite far plane comes out as (0, 0, 0, d), which is fine
+            // left as it is
+            for(int i = 0; i < 6; i++) {
+                float fLength = m3dGetVectorLength3(planes[i]);
+                if(fLength > 0.0f) {
+                    float fScale = 1.0f / fLength;
+                    planes[i][0] *= fScale;
+                    planes[i][1] *= fScale;
+                    planes[i][2] *= fScale;
+                    planes[i][3] *= fScale;
+                    }
+                }
+            }
+
+
+        // Allow expanded version of sphere test
+        bool TestSphere(float x, float y, float z, float fRadius)
+            {
+            M3DVector3f vPoint;
+            vPoint[0] = x;
+            vPoint[1] = y;
+            vPoint[2] = z;
+
+            return TestSphere(vPoint, fRadius);
+            }
+
+        // Test a point against all frustum planes. A negative distance for any
+        // single plane means it is outside the frustum. The radius value allows
+        // to test for a point (radius = 0), or a sphere. Possibly there might
+        // be some gain in an alternative function that saves the addition of 
+        // zero in this case.
+        // Returns false if it is not in the frustum, true if it intersects
+        // the Frustum.
+        bool TestSphere(M3DVector3f vPoint, float fRadius)
+            {
+            float fDist;
+
+            // Near Plane - See if it is behind me
+            fDist = m3dGetDistanceToPlane(vPoint, planes[GLT_PLANE_NEAR]);
+            if(fDist + fRadius <= 0.0)
+                return false;
+
+            // Distance to far plane
+            fDist = m3dGetDistanceToPlane(vPoint, planes[GLT_PLANE_FAR]);
+            if(fDist + fRadius <= 0.0)
+                return false;
+
+            fDist = m3dGetDistanceToPlane(vPoint, planes[GLT_PLANE_LEFT]);
+            if(fDist + fRadius <= 0.0)
+                return false;
+
+            fDist = m3dGetDistanceToPlane(vPoint, planes[GLT_PLANE_RIGHT]);
+            if(fDist + fRadius <= 0.0)
+                return false;
+
+            fDist = m3dGetDistanceToPlane(vPoint, planes[GLT_PLANE_BOTTOM]);
+            if(fDist + fRadius <= 0.0)
+                return false;
+
+            fDist = m3dGetDistanceToPlane(vPoint, planes[GLT_PLANE_TOP]);
+            if(fDist + fRadius <= 0.0)
+                return false;
+
+            return true;
+            }
+
+        // TestSphere for a whole array of spheres, centers and radii in SoA
+        // form (M3DVectorStream3 works), with the same results. Bit (i & 31)
+        // of pVisible[i >> 5] is set when sphere i is in the frustum, so
+        // pVisible needs (nCount + 31) / 32 words. The spheres go through the
+        // planes 4, 8 or 16 at a time (see m3dCullSphereStream). Returns the
+        // number of visible spheres.
+        int TestSpheres(const float *x, const float *y, const float *z, const float *fRadius,
+                        int nCount, unsigned int *pVisible)
+            {
+            return m3dCullSphereStream(pVisible, x, y, z, fRadius, nCount, planes, 6);
+            }
+
+        // The planes from the last Transform, in the order TestSphere tries
+        // them: near, far, left, right, bottom, top. Normals point inward.
+        void GetPlanes(M3DVector4f vPlanes[6])
+            { memcpy(vPlanes, planes, sizeof(planes)); }
+
+
+        // Axis aligned box test. For each plane only the box corner furthest
+        // along the plane normal (the p-vertex) has to be checked to see if
+        // the box is outside, and the nearest corner (the n-vertex) to see if
+        // it is all on the inside.
+        //
+        // iPlaneMask says which planes to test. A box that is all inside a
+        // plane gets that plane's bit cleared, so a child of this box inside a
+        // hierarchy can start from the mask this one returns and skip those
+        // planes; a box that ends up with no bits set is GLT_FRUSTUM_INSIDE.
+        // iLastPlane is the plane that rejected the object last time (keep one
+        // per object, starting at 0); it is tried first, and updated when a
+        // different plane rejects it. Objects that stay off screen are usually
+        // rejected by the same plane frame after frame, so that's one plane
+        // test instead of several.
+        GLT_FRUSTUM_RESULT TestAABB(const M3DVector3f vMin, const M3DVector3f vMax,
+                                    unsigned int& iPlaneMask, int& iLastPlane)
+            {
+            // iLastPlane first, then the rest in order
+            for(int n = -1; n < 6; n++) {
+                int i = (n < 0) ? iLastPlane : n;
+                if(!(iPlaneMask & (1u << i)) || (n >= 0 && i == iLastPlane))
+                    continue;
+
+                const float *p = planes[i];
+                float fFar = p[0] * ((p[0] > 0.0f) ? vMax[0] : vMin[0]) + p[1] * ((p[1] > 0.0f) ? vMax[1] : vMin[1]) +
+                             p[2] * ((p[2] > 0.0f) ? vMax[2] : vMin[2]) + p[3];
+                if(fFar <= 0.0f) {
+                    iLastPlane = i;
+                    return GLT_FRUSTUM_OUTSIDE;
+                    }
+                float fNear = p[0] * ((p[0] > 0.0f) ? vMin[0] : vMax[0]) + p[1] * ((p[1] > 0.0f) ? vMin[1] : vMax[1]) +
+                              p[2] * ((p[2] > 0.0f) ? vMin[2] : vMax[2]) + p[3];
+                if(fNear >= 0.0f)
+                    iPlaneMask &= ~(1u << i);
+                }
+
+            return (iPlaneMask == 0) ? GLT_FRUSTUM_INSIDE : GLT_FRUSTUM_INTERSECTS;
+            }
+
+        GLT_FRUSTUM_RESULT TestAABB(const M3DVector3f vMin, const M3DVector3f vMax)
+            {
+            unsigned int iPlaneMask = GLT_FRUSTUM_ALL_PLANES;
+            int iLastPlane = 0;
+            return TestAABB(vMin, vMax, iPlaneMask, iLastPlane);
+            }
+
+        // Oriented box: the box vMin..vMax in the object's own coordinates,
+        // placed in the world by mModel (a model matrix, GLFrame::GetMatrix,
+        // or a world matrix from GLTransformHierarchy; scales are fine). The
+        // box's reach along a plane normal is its half size along each of its
+        // axes times how much that axis points along the normal. Masks and
+        // iLastPlane work as for TestAABB.
+        GLT_FRUSTUM_RESULT TestOBB(const M3DMatrix44f mModel, const M3DVector3f vMin, const M3DVector3f vMax,
+                                   unsigned int& iPlaneMask, int& iLastPlane)
+            {
+            // Center and half size along the model's axes
+            M3DVector3f vLocalCenter, vHalf, vCenter;
+            vLocalCenter[0] = (vMin[0] + vMax[0]) * 0.5f; vHalf[0] = (vMax[0] - vMin[0]) * 0.5f;
+            vLocalCenter[1] = (vMin[1] + vMax[1]) * 0.5f; vHalf[1] = (vMax[1] - vMin[1]) * 0.5f;
+            vLocalCenter[2] = (vMin[2] + vMax[2]) * 0.5f; vHalf[2] = (vMax[2] - vMin[2]) * 0.5f;
+            m3dTransformVector3(vCenter, vLocalCenter, mModel);
+
+            for(int n = -1; n < 6; n++) {
+                int i = (n < 0) ? iLastPlane : n;
+                if(!(iPlaneMask & (1u << i)) || (n >= 0 && i == iLastPlane))
+                    continue;
+
+                const float *p = planes[i];
+                float fDist = m3dGetDistanceToPlane(vCenter, p);
+                float fReach = vHalf[0] * fabsf(p[0] * mModel[0] + p[1] * mModel[1] + p[2] * mModel[2]) +
+                               vHalf[1] * fabsf(p[0] * mModel[4] + p[1] * mModel[5] + p[2] * mModel[6]) +
+                               vHalf[2] * fabsf(p[0] * mModel[8] + p[1] * mModel[9] + p[2] * mModel[10]);
+                if(fDist + fReach <= 0.0f) {
+                    iLastPlane = i;
+                    return GLT_FRUSTUM_OUTSIDE;
+                    }
+                if(fDist - fReach >= 0.0f)
+                    iPlaneMask &= ~(1u << i);
+                }
+
+            return (iPlaneMask == 0) ? GLT_FRUSTUM_INSIDE : GLT_FRUSTUM_INTERSECTS;
+            }
+
+        GLT_FRUSTUM_RESULT TestOBB(const M3DMatrix44f mModel, const M3DVector3f vMin, const M3DVector3f vMax)
+            {
+            unsigned int iPlaneMask = GLT_FRUSTUM_ALL_PLANES;
+            int iLastPlane = 0;
+            return TestOBB(mModel, vMin, vMax, iPlaneMask, iLastPlane);
+            }
+
+        // The same for a box in a GLFrame's coordinates
+        GLT_FRUSTUM_RESULT TestOBB(GLFrame& frame, const M3DVector3f vMin, const M3DVector3f vMax,
+                                   unsigned int& iPlaneMask, int& iLastPlane)
+            {
+            M3DMatrix44f mModel;
+            frame.GetMatrix(mModel);
+            return TestOBB(mModel, vMin, vMax, iPlaneMask, iLastPlane);
+            }
+
+    protected:
+		// The projection matrix for this frustum
+		M3DMatrix44f projMatrix;	
+
+        // Untransformed corners of the frustum
+        M3DVector4f  nearUL, nearLL, nearUR, nearLR;
+        M3DVector4f  farUL,  farLL,  farUR,  farLR;
+
+        // Transformed corners of Frustum
+        M3DVector4f  nearULT, nearLLT, nearURT, nearLRT;
+        M3DVector4f  farULT,  farLLT,  farURT,  farLRT;
+
+        // Base and Transformed plane equations, indexed by GLT_FRUSTUM_PLANE
+        M3DVector4f planes[6];
+    };
+
+
+
+#endif
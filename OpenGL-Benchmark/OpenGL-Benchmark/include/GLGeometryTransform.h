@@ -0,0 +1,171 @@
+// GLGeometryTransform
+/*
+Copyright (c) 2009, Richard S. Wright Jr.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, 
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list 
+of conditions and the following disclaimer.
+
+Redistributions in binary form must reproduce the above copyright notice, this list 
+of conditions and the following disclaimer in the documentation and/or other 
+materials provided with the distribution.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used 
+to endorse or promote products derived from this software without specific prior 
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY 
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT 
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED 
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __GLT_GEOMETRY_PIPELINE
+#define __GLT_GEOMETRY_PIPELINE
+
+
+#include "GLTools.h"
+#include "GLFrame.h"
+#include "math3dSIMD.h"
+
+class GLGeometryTransform
+	{
+	public:
+		GLGeometryTransform(void) {
+			_mModelView = _mProjection = NULL;
+			InvalidateCache();
+			ResetCacheCounters();
+			}
+
+		inline void SetModelViewMatrixStack(GLMatrixStack& mModelView) { _mModelView = &mModelView; InvalidateCache(); }
+
+		inline void SetProjectionMatrixStack(GLMatrixStack& mProjection) { _mProjection = &mProjection; InvalidateCache(); }
+
+		inline void SetMatrixStacks(GLMatrixStack& mModelView, GLMatrixStack& mProjection) {
+			_mModelView = &mModelView;
+			_mProjection = &mProjection;
+			InvalidateCache();
+			}
+
+		// The model-view-projection and normal matrices are only worked out again
+		// when the stacks they come from have changed (see
+		// GLMatrixStack::GetGeneration), so asking for them twice per draw, or for
+		// several draws with the same matrices, costs nothing extra.
+		const M3DMatrix44f& GetModelViewProjectionMatrix(void)
+			{
+			unsigned int nModelView = _mModelView->GetGeneration();
+			unsigned int nProjection = _mProjection->GetGeneration();
+			if(_bMVPValid && nModelView == _nMVPModelView && nProjection == _nMVPProjection) {
+				_nMVPHits++;
+				return _mModelViewProjection;
+				}
+
+			m3dFastMatrixMultiply44(_mModelViewProjection, _mProjection->GetMatrix(), _mModelView->GetMatrix());
+			_nMVPModelView = nModelView;
+			_nMVPProjection = nProjection;
+			_bMVPValid = true;
+			_nMVPMisses++;
+			return _mModelViewProjection;
+			}
+
+		// Model-view and model-view-projection matrices for a whole array of objects
+		// in one pass. The current model-view matrix is the camera, and each frame
+		// (or matrix) places one object in the world, just like PushMatrix/MultMatrix/
+		// PopMatrix around each object would. Either output array may be NULL. The
+		// outputs are tightly packed, so they can be copied straight into a per-instance
+		// buffer.
+		void GetModelViewProjectionMatrices(const M3DMatrix44f *pModels, int nCount,
+											M3DMatrix44f *pModelView, M3DMatrix44f *pModelViewProjection)
+			{
+			const M3DMatrix44f& mViewProjection = GetModelViewProjectionMatrix();
+
+			if(pModelView)
+				m3dMatrixMultiplyArray44(pModelView, _mModelView->GetMatrix(), pModels, nCount);
+			if(pModelViewProjection)
+				m3dMatrixMultiplyArray44(pModelViewProjection, mViewProjection, pModels, nCount);
+			}
+
+		void GetModelViewProjectionMatrices(GLFrame *pFrames, int nCount,
+											M3DMatrix44f *pModelView, M3DMatrix44f *pModelViewProjection)
+			{
+			const M3DMatrix44f& mViewProjection = GetModelViewProjectionMatrix();
+
+			// Build the frame matrices a block at a time, so they are still in cache
+			// when they get multiplied
+			M3DMatrix44f mFrames[64];
+			for(int i = 0; i < nCount; i += 64) {
+				int nBlock = (nCount - i < 64) ? nCount - i : 64;
+				for(int j = 0; j < nBlock; j++)
+					pFrames[i + j].GetMatrix(mFrames[j]);
+
+				if(pModelView)
+					m3dMatrixMultiplyArray44(pModelView + i, _mModelView->GetMatrix(), mFrames, nBlock);
+				if(pModelViewProjection)
+					m3dMatrixMultiplyArray44(pModelViewProjection + i, mViewProjection, mFrames, nBlock);
+				}
+			}
+
+		inline const M3DMatrix44f& GetModelViewMatrix(void) { return _mModelView->GetMatrix(); }
+		inline const M3DMatrix44f& GetProjectionMatrix(void) { return _mProjection->GetMatrix(); }
+
+		const M3DMatrix33f& GetNormalMatrix(bool bNormalize = false)
+			{
+			unsigned int nModelView = _mModelView->GetGeneration();
+			if(_bNormalValid && nModelView == _nNormalModelView && bNormalize == _bNormalNormalized) {
+				_nNormalHits++;
+				return _mNormalMatrix;
+				}
+
+			_nNormalModelView = nModelView;
+			_bNormalNormalized = bNormalize;
+			_bNormalValid = true;
+			_nNormalMisses++;
+
+			m3dExtractRotationMatrix33(_mNormalMatrix, GetModelViewMatrix());
+
+			if(bNormalize) {
+				m3dNormalizeVector3(&_mNormalMatrix[0]);
+				m3dNormalizeVector3(&_mNormalMatrix[3]);
+				m3dNormalizeVector3(&_mNormalMatrix[6]);
+				}
+
+			return _mNormalMatrix;
+			}
+
+		// Cache statistics, to see how often the cached matrices get reused
+		inline unsigned int GetMVPCacheHits(void) const { return _nMVPHits; }
+		inline unsigned int GetMVPCacheMisses(void) const { return _nMVPMisses; }
+		inline unsigned int GetNormalCacheHits(void) const { return _nNormalHits; }
+		inline unsigned int GetNormalCacheMisses(void) const { return _nNormalMisses; }
+
+		void ResetCacheCounters(void) { _nMVPHits = _nMVPMisses = _nNormalHits = _nNormalMisses = 0; }
+
+		// Only needed if a matrix on one of the stacks was changed behind the
+		// stack's back (through a cast of GetMatrix(), for instance)
+		void InvalidateCache(void) { _bMVPValid = _bNormalValid = false; }
+
+	protected:
+		M3DMatrix44f	_mModelViewProjection;
+		M3DMatrix33f	_mNormalMatrix;
+
+		// Stack generations the cached matrices were made from
+		unsigned int	_nMVPModelView, _nMVPProjection;
+		unsigned int	_nNormalModelView;
+		bool			_bMVPValid, _bNormalValid, _bNormalNormalized;
+
+		unsigned int	_nMVPHits, _nMVPMisses;
+		unsigned int	_nNormalHits, _nNormalMisses;
+
+		GLMatrixStack*  _mModelView;
+		GLMatrixStack* _mProjection;
+};
+
+#endif
@@ -0,0 +1,316 @@
+// GLMatrixStack.h
+// Matrix stack functionality
+/*
+Copyright (c) 2009, Richard S. Wright Jr.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, 
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list 
+of conditions and the following disclaimer.
+
+Redistributions in binary form must reproduce the above copyright notice, this list 
+of conditions and the following disclaimer in the documentation and/or other 
+materials provided with the distribution.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used 
+to endorse or promote products derived from this software without specific prior 
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY 
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT 
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED 
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef __GLT_MATRIX_STACK
+#define __GLT_MATRIX_STACK
+
+#include "GLTools.h"
+#include "math3d.h"
+#include "GLFrame.h"
+#include "math3dSIMD.h"
+#include "math3dTemplates.h"
+
+enum GLT_STACK_ERROR { GLT_STACK_NOERROR = 0, GLT_STACK_OVERFLOW, GLT_STACK_UNDERFLOW }; 
+
+// What is known about each matrix on the stack, from least to most special. A
+// product is only as special as the least special of its two factors.
+enum GLT_MATRIX_CLASS { GLT_MATRIX_GENERAL = 0, GLT_MATRIX_AFFINE, GLT_MATRIX_RIGID };
+
+// The first few levels of every stack live inside the GLMatrixStack itself, so
+// shallow stacks never touch the heap. Define as 0 before including this file
+// to keep the object small instead.
+#ifndef GLT_MATRIX_STACK_INLINE_DEPTH
+#define GLT_MATRIX_STACK_INLINE_DEPTH	8
+#endif
+
+class GLMatrixStack
+	{
+	public:
+		// iStackDepth is only a starting size. The stack grows (doubling) when a
+		// push runs out of room, so deep hierarchies never overflow; the only
+		// GLT_STACK_OVERFLOW left is running out of memory. With the default of
+		// 0 nothing is allocated until the inline levels are used up.
+		GLMatrixStack(int iStackDepth = 0) {
+			stackDepth = 0;
+			stackPointer = 0;
+			pBlock = NULL;
+			pStack = NULL;
+#if GLT_MATRIX_STACK_INLINE_DEPTH > 0
+			unsigned char *pInline = inlineBlock + ((64 - (size_t(inlineBlock) & 63)) & 63);
+			SetStorage(pInline, GLT_MATRIX_STACK_INLINE_DEPTH);
+#endif
+			if(iStackDepth > stackDepth || stackDepth == 0)
+				Grow(iStackDepth);
+
+			m3dLoadIdentity44(pStack[0]);
+			pClass[0] = GLT_MATRIX_RIGID;
+			lastError = GLT_STACK_NOERROR;
+			pGeneration[0] = nLastGeneration = 0;
+			}
+		
+		
+		~GLMatrixStack(void) {
+			m3dAlignedFree(pBlock);
+			}
+
+		
+		inline void LoadIdentity(void) { 
+			m3dLoadIdentity44(pStack[stackPointer]); 
+			pClass[stackPointer] = GLT_MATRIX_RIGID;
+			Touch();
+			}
+		
+		inline void LoadMatrix(const M3DMatrix44f mMatrix) { 
+			m3dCopyMatrix44(pStack[stackPointer], mMatrix); 
+			pClass[stackPointer] = Classify(mMatrix);
+			Touch();
+			}
+            
+        inline void LoadMatrix(GLFrame& frame) {
+            frame.GetMatrix(pStack[stackPointer]);
+			pClass[stackPointer] = GLT_MATRIX_RIGID;
+			Touch();
+            }
+            
+		inline void MultMatrix(const M3DMatrix44f mMatrix) {
+			m3dFastMatrixMultiply44(pStack[stackPointer], pStack[stackPointer], mMatrix);
+			Combine(Classify(mMatrix));
+			}
+            
+		// Multiply by a whole m3d:: expression at once, straight into the top of
+		// the stack, e.g. MultMatrix(m3d::Translate(x, y, z) * m3d::Scale(s, s, s))
+		template <class E> inline void MultMatrix(const m3d::MatExpr<E, 4, float>& expr) {
+			m3d::AsMat(pStack[stackPointer]) *= expr;
+			Combine(GLT_MATRIX_CLASS(expr.Self().Class()));
+			}
+
+		template <class E> inline void LoadMatrix(const m3d::MatExpr<E, 4, float>& expr) {
+			m3d::AsMat(pStack[stackPointer]) = expr;
+			pClass[stackPointer] = GLT_MATRIX_CLASS(expr.Self().Class());
+			Touch();
+			}
+            
+        inline void MultMatrix(GLFrame& frame) {
+            M3DMatrix44f m;
+            frame.GetMatrix(m);
+			m3dFastMatrixMultiply44(pStack[stackPointer], pStack[stackPointer], m);
+			Touch();
+            }
+            				
+		inline void PushMatrix(void) {
+			if(stackPointer + 1 < stackDepth || Grow(stackDepth * 2)) {
+				stackPointer++;
+				m3dCopyMatrix44(pStack[stackPointer], pStack[stackPointer-1]);
+				pClass[stackPointer] = pClass[stackPointer-1];
+				pGeneration[stackPointer] = pGeneration[stackPointer-1];
+				}
+			else
+				lastError = GLT_STACK_OVERFLOW;
+			}
+		
+		inline void PopMatrix(void) {
+			if(stackPointer > 0)
+				stackPointer--;
+			else
+				lastError = GLT_STACK_UNDERFLOW;
+			}
+			
+		// These multiply the top matrix in place instead of building a whole
+		// matrix and doing a full 4x4 multiply (see m3dMultTranslation44 and friends)
+		void Scale(GLfloat x, GLfloat y, GLfloat z) {
+			m3dMultScale44(pStack[stackPointer], x, y, z);
+			Combine(GLT_MATRIX_AFFINE);
+			}
+			
+			
+		void Translate(GLfloat x, GLfloat y, GLfloat z) {
+			m3dMultTranslation44(pStack[stackPointer], x, y, z);
+			Touch();
+			}
+            			
+		void Rotate(GLfloat angle, GLfloat x, GLfloat y, GLfloat z) {
+			m3dMultRotation44(pStack[stackPointer], float(m3dDegToRad(angle)), x, y, z);
+			Touch();
+			}
+		
+		
+		// I've always wanted vector versions of these
+		void Scalev(const M3DVector3f vScale) {
+			m3dMultScale44(pStack[stackPointer], vScale[0], vScale[1], vScale[2]);
+			Combine(GLT_MATRIX_AFFINE);
+			}
+			
+        void Translatev(const M3DVector3f vTranslate) {
+			m3dMultTranslation44(pStack[stackPointer], vTranslate[0], vTranslate[1], vTranslate[2]);
+			Touch();
+            }
+        
+			
+		void Rotatev(GLfloat angle, M3DVector3f vAxis) {
+			m3dMultRotation44(pStack[stackPointer], float(m3dDegToRad(angle)), vAxis[0], vAxis[1], vAxis[2]);
+			Touch();
+			}
+			
+		
+		// I've also always wanted to be able to do this
+		void PushMatrix(const M3DMatrix44f mMatrix) {
+		 	if(stackPointer + 1 < stackDepth || Grow(stackDepth * 2)) {
+				stackPointer++;
+				m3dCopyMatrix44(pStack[stackPointer], mMatrix);
+				pClass[stackPointer] = Classify(mMatrix);
+				Touch();
+				}
+			else
+				lastError = GLT_STACK_OVERFLOW;
+			}
+			
+        void PushMatrix(GLFrame& frame) {
+		 	if(stackPointer + 1 < stackDepth || Grow(stackDepth * 2)) {
+				stackPointer++;
+				frame.GetMatrix(pStack[stackPointer]);
+				pClass[stackPointer] = GLT_MATRIX_RIGID;
+				Touch();
+				}
+			else
+				lastError = GLT_STACK_OVERFLOW;
+            }
+            
+		// Two different ways to get the matrix. Every level is 64 byte aligned,
+		// so aligned SIMD loads and stores are fine. The reference is only good
+		// until the next push, which may move the stack.
+		const M3DMatrix44f& GetMatrix(void) { return pStack[stackPointer]; }
+		void GetMatrix(M3DMatrix44f mMatrix) { m3dCopyMatrix44(mMatrix, pStack[stackPointer]); }
+
+		// Inverse of the top matrix. Stacks built only from frames, rotations and
+		// translations use the rigid body inverse, scales and other affine
+		// matrices use the affine inverse, and anything else (a projection) falls
+		// back to the general one.
+		void GetInverseMatrix(M3DMatrix44f mInverse) {
+			switch(pClass[stackPointer]) {
+				case GLT_MATRIX_RIGID:
+					m3dInvertRigid44(mInverse, pStack[stackPointer]);
+					break;
+				case GLT_MATRIX_AFFINE:
+					m3dInvertAffine44(mInverse, pStack[stackPointer]);
+					break;
+				default:
+					m3dFastInvertMatrix44(mInverse, pStack[stackPointer]);
+				}
+			}
+
+		inline GLT_MATRIX_CLASS GetMatrixClass(void) { return pClass[stackPointer]; }
+
+		// How deep the stack is now, and how deep it can get before it has to grow
+		inline int GetDepth(void) const { return stackPointer + 1; }
+		inline int GetCapacity(void) const { return stackDepth; }
+
+		// A number that changes whenever the top matrix does, so anything worked
+		// out from it can be cached against it. Every load or multiply hands out
+		// a new number; PushMatrix() copies the number along with the matrix, so
+		// after PopMatrix() the number is back to what it was before the push.
+		inline unsigned int GetGeneration(void) const { return pGeneration[stackPointer]; }
+
+
+		inline GLT_STACK_ERROR GetLastError(void) {
+			GLT_STACK_ERROR retval = lastError;
+			lastError = GLT_STACK_NOERROR;
+			return retval; 
+			}
+	
+	protected:
+		// Loaded matrices are only checked for the affine bottom row. Telling a
+		// rigid matrix from a scaled one is not worth it on every load.
+		static GLT_MATRIX_CLASS Classify(const M3DMatrix44f mMatrix) {
+			return m3dIsAffine44(mMatrix) ? GLT_MATRIX_AFFINE : GLT_MATRIX_GENERAL;
+			}
+
+		// Called after every multiply into the top matrix
+		inline void Combine(GLT_MATRIX_CLASS matrixClass) {
+			if(matrixClass < pClass[stackPointer])
+				pClass[stackPointer] = matrixClass;
+			Touch();
+			}
+
+		inline void Touch(void) { pGeneration[stackPointer] = ++nLastGeneration; }
+
+		// Matrices, then generations, then classes, all in one block
+		static size_t StorageSize(int nLevels) {
+			return (sizeof(M3DMatrix44f) + sizeof(unsigned int) + sizeof(GLT_MATRIX_CLASS)) * size_t(nLevels);
+			}
+
+		void SetStorage(unsigned char *p, int nLevels) {
+			pStack = (M3DMatrix44f *)p;
+			pGeneration = (unsigned int *)(p + sizeof(M3DMatrix44f) * nLevels);
+			pClass = (GLT_MATRIX_CLASS *)(pGeneration + nLevels);
+			stackDepth = nLevels;
+			}
+
+		// Move to a bigger (64 byte aligned) block, keeping every level in use
+		bool Grow(int nLevels) {
+			if(nLevels < 16)
+				nLevels = 16;
+			unsigned char *p = (unsigned char *)m3dAlignedAlloc(StorageSize(nLevels), 64);
+			if(p == NULL)
+				return false;
+
+			if(pStack != NULL) {
+				int nUsed = stackPointer + 1;
+				memcpy(p, pStack, sizeof(M3DMatrix44f) * nUsed);
+				memcpy(p + sizeof(M3DMatrix44f) * nLevels, pGeneration, sizeof(unsigned int) * nUsed);
+				memcpy(p + (sizeof(M3DMatrix44f) + sizeof(unsigned int)) * nLevels, pClass, sizeof(GLT_MATRIX_CLASS) * nUsed);
+				}
+			m3dAlignedFree(pBlock);
+
+			pBlock = p;
+			SetStorage(p, nLevels);
+			return true;
+			}
+
+		GLT_STACK_ERROR		lastError;
+		int					stackDepth;
+		int					stackPointer;
+		M3DMatrix44f		*pStack;
+		GLT_MATRIX_CLASS	*pClass;
+		unsigned int		*pGeneration;
+		unsigned int		nLastGeneration;
+		unsigned char		*pBlock;		// Heap storage, NULL while the inline levels are enough
+
+#if GLT_MATRIX_STACK_INLINE_DEPTH > 0
+		unsigned char		inlineBlock[(sizeof(M3DMatrix44f) + sizeof(unsigned int) + sizeof(GLT_MATRIX_CLASS)) * GLT_MATRIX_STACK_INLINE_DEPTH + 63];
+#endif
+
+	private:
+		// The stack may point into itself, so no copying
+		GLMatrixStack(const GLMatrixStack&);
+		GLMatrixStack& operator=(const GLMatrixStack&);
+	};
+
+#endif
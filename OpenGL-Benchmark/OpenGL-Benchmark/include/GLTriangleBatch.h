@@ -0,0 +1,123 @@
+/*
+ *  GLTriangleBatch.h
+ *  OpenGL SuperBible
+ *
+Copyright (c) 2007-2009, Richard S. Wright Jr.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, 
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list 
+of conditions and the following disclaimer.
+
+Redistributions in binary form must reproduce the above copyright notice, this list 
+of conditions and the following disclaimer in the documentation and/or other 
+materials provided with the distribution.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used 
+to endorse or promote products derived from this software without specific prior 
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY 
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT 
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED 
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ *  This class allows you to simply add triangles as if this class were a 
+ *  container. The AddTriangle() function searches the current list of triangles
+ *  and determines if the vertex/normal/texcoord is a duplicate. If so, it addes
+ *  an entry to the index array instead of the list of vertices.
+ *  When finished, call EndMesh() to free up extra unneeded memory that is reserved
+ *  as workspace when you call BeginMesh().
+ *
+ *  This class can easily be extended to contain other vertex attributes, and to 
+ *  save itself and load itself from disk (thus forming the beginnings of a custom
+ *  model file format).
+ *
+ */
+
+#ifndef __TRIANGLE_BATCH
+#define __TRIANGLE_BATCH 
+
+
+// Bring in OpenGL 
+// Windows
+#ifdef WIN32
+#include <windows.h>		// Must have for Windows platform builds
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+
+#include <gl\glew.h>			// OpenGL Extension "autoloader"
+#include <gl\gl.h>			// Microsoft OpenGL headers (version 1.1 by themselves)
+#endif
+
+// Mac OS X
+#ifdef __APPLE__
+#include <TargetConditionals.h>
+#if TARGET_OS_IPHONE | TARGET_IPHONE_SIMULATOR
+#include <OpenGLES/ES2/gl.h>
+#include <OpenGLES/ES2/glext.h>
+#define OPENGL_ES
+#else
+#include "GL/glew.h"
+#include <OpenGL/gl.h>		// Apple OpenGL haders (version depends on OS X SDK version)
+#endif
+#endif
+
+// Linux
+#ifdef linux
+#define GLEW_STATIC
+#include <glew.h>
+#endif
+
+#include "math3d.h"
+#include "GLBatchBase.h"
+#include "GLShaderManager.h"
+
+#define VERTEX_DATA     0
+#define NORMAL_DATA     1
+#define TEXTURE_DATA    2
+#define INDEX_DATA      3
+
+class GLTriangleBatch : public GLBatchBase
+    {
+    public:
+        GLTriangleBatch(void);
+        virtual ~GLTriangleBatch(void);
+        
+        // Use these three functions to add triangles
+        void BeginMesh(GLuint nMaxVerts);
+        void AddTriangle(M3DVector3f verts[3], M3DVector3f vNorms[3], M3DVector2f vTexCoords[3]);
+        void End(void);
+
+        // Useful for statistics
+        inline GLuint GetIndexCount(void) { return nNumIndexes; }
+        inline GLuint GetVertexCount(void) { return nNumVerts; }
+
+        
+        // Draw - make sure you call glEnableClientState for these arrays
+        virtual void Draw(void);
+        
+    protected:
+        GLushort  *pIndexes;        // Array of indexes
+        M3DVector3f *pVerts;        // Array of vertices
+        M3DVector3f *pNorms;        // Array of normals
+        M3DVector2f *pTexCoords;    // Array of texture coordinates
+        
+        GLuint nMaxIndexes;         // Maximum workspace
+        GLuint nNumIndexes;         // Number of indexes currently used
+        GLuint nNumVerts;           // Number of vertices actually used
+        
+        GLuint bufferObjects[4];
+		GLuint vertexArrayBufferObject;
+    };
+
+
+#endif
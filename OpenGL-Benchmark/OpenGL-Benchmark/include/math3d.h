@@ -0,0 +1,980 @@
+// Math3d.h
+// Math3D Library, version 0.95
+
+/* Copyright (c) 2009, Richard S. Wright Jr.
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without modification, 
+are permitted provided that the following conditions are met:
+
+Redistributions of source code must retain the above copyright notice, this list 
+of conditions and the following disclaimer.
+
+Redistributions in binary form must reproduce the above copyright notice, this list 
+of conditions and the following disclaimer in the documentation and/or other 
+materials provided with the distribution.
+
+Neither the name of Richard S. Wright Jr. nor the names of other contributors may be used 
+to endorse or promote products derived from this software without specific prior 
+written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY 
+EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES 
+OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT 
+SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED 
+TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR 
+BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN 
+ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Header file for the Math3d library. The C-Runtime has math.h, this file and the
+// accompanying math3d.cpp are meant to suppliment math.h by adding geometry/math routines
+// useful for graphics, simulation, and physics applications (3D stuff).
+// This library is meant to be useful on Win32, Mac OS X, various Linux/Unix distros,
+// and mobile platforms. Although designed with OpenGL in mind, there are no OpenGL 
+// dependencies. Other than standard math routines, the only other outside routine
+// used is memcpy (for faster copying of vector arrays).
+// Richard S. Wright Jr.
+
+#ifndef _MATH3D_LIBRARY__
+#define _MATH3D_LIBRARY__
+
+#include <math.h>
+#include <string.h>	// Memcpy lives here on most systems
+
+///////////////////////////////////////////////////////////////////////////////
+// Data structures and containers
+// Much thought went into how these are declared. Many libraries declare these
+// as structures with x, y, z data members. However structure alignment issues
+// could limit the portability of code based on such structures, or the binary
+// compatibility of data files (more likely) that contain such structures across
+// compilers/platforms. Arrays are always tightly packed, and are more efficient 
+// for moving blocks of data around (usually).
+// Sigh... yes, I probably should use GLfloat, etc. But that requires that we
+// always include OpenGL. Since this library is also useful for non-graphical
+// applications, I shall risk the wrath of the portability gods...
+
+typedef float	M3DVector2f[2];		// 3D points = 3D Vectors, but we need a 
+typedef double	M3DVector2d[2];		// 2D representations sometimes... (x,y) order
+
+typedef float	M3DVector3f[3];		// Vector of three floats (x, y, z)
+typedef double	M3DVector3d[3];		// Vector of three doubles (x, y, z)
+
+typedef float	M3DVector4f[4];		// Lesser used... Do we really need these?
+typedef double	M3DVector4d[4];		// Yes, occasionaly we do need a trailing w component
+
+
+
+// 3x3 matrix - column major. X vector is 0, 1, 2, etc.
+//		0	3	6	
+//		1	4	7
+//		2	5	8
+typedef float	M3DMatrix33f[9];		// A 3 x 3 matrix, column major (floats) - OpenGL Style
+typedef double	M3DMatrix33d[9];		// A 3 x 3 matrix, column major (doubles) - OpenGL Style
+
+
+// 4x4 matrix - column major. X vector is 0, 1, 2, etc.
+//	0	4	8	12
+//	1	5	9	13
+//	2	6	10	14
+//	3	7	11	15
+typedef float M3DMatrix44f[16];		// A 4 X 4 matrix, column major (floats) - OpenGL style
+typedef double M3DMatrix44d[16];	// A 4 x 4 matrix, column major (doubles) - OpenGL style
+
+
+// 3x4 affine matrix - row major. The top three rows of a 4x4 whose bottom row
+// is always 0, 0, 0, 1, so it is 25% smaller. Each row is one SIMD register,
+// and three rows are what a shader needs per instance (three vec4 attributes).
+//	0	1	2	3
+//	4	5	6	7
+//	8	9	10	11
+typedef float M3DMatrix34f[12];		// A 3 x 4 affine matrix, row major (floats)
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Useful constants
+#define M3D_PI (3.14159265358979323846)
+#define M3D_2PI (2.0 * M3D_PI)
+#define M3D_PI_DIV_180 (0.017453292519943296)
+#define M3D_INV_PI_DIV_180 (57.2957795130823229)
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Useful shortcuts and macros
+// Radians are king... but we need a way to swap back and forth for programmers and presentation.
+// Leaving these as Macros instead of inline functions, causes constants
+// to be evaluated at compile time instead of run time, e.g. m3dDegToRad(90.0)
+#define m3dDegToRad(x)	((x)*M3D_PI_DIV_180)
+#define m3dRadToDeg(x)	((x)*M3D_INV_PI_DIV_180)
+
+// Hour angles
+#define m3dHrToDeg(x)	((x) * (1.0 / 15.0))
+#define m3dHrToRad(x)	m3dDegToRad(m3dHrToDeg(x))
+
+#define m3dDegToHr(x)	((x) * 15.0))
+#define m3dRadToHr(x)	m3dDegToHr(m3dRadToDeg(x))
+
+
+// Returns the same number if it is a power of
+// two. Returns a larger integer if it is not a 
+// power of two. The larger integer is the next
+// highest power of two.
+inline unsigned int m3dIsPOW2(unsigned int iValue)
+    {
+    unsigned int nPow2 = 1;
+    
+    while(iValue > nPow2)
+        nPow2 = (nPow2 << 1);
+    
+    return nPow2;
+    }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Inline accessor functions (Macros) for people who just can't count to 3 or 4
+// Really... you should learn to count before you learn to program ;-)
+// 0 = x
+// 1 = y
+// 2 = z
+// 3 = w
+#define	m3dGetVectorX(v) (v[0])
+#define m3dGetVectorY(v) (v[1])
+#define m3dGetVectorZ(v) (v[2])
+#define m3dGetVectorW(v) (v[3])
+
+#define m3dSetVectorX(v, x)	((v)[0] = (x))
+#define m3dSetVectorY(v, y)	((v)[1] = (y))
+#define m3dSetVectorZ(v, z)	((v)[2] = (z))
+#define m3dSetVectorW(v, w)	((v)[3] = (w))
+
+///////////////////////////////////////////////////////////////////////////////
+// Inline vector functions
+// Load Vector with (x, y, z, w).
+inline void m3dLoadVector2(M3DVector2f v, const float x, const float y)
+    { v[0] = x; v[1] = y; }
+inline void m3dLoadVector2(M3DVector2d v, const float x, const float y)
+    { v[0] = x; v[1] = y; }
+inline void m3dLoadVector3(M3DVector3f v, const float x, const float y, const float z) 
+	{ v[0] = x; v[1] = y; v[2] = z; }
+inline void m3dLoadVector3(M3DVector3d v, const double x, const double y, const double z)
+	{ v[0] = x; v[1] = y; v[2] = z; }
+inline void m3dLoadVector4(M3DVector4f v, const float x, const float y, const float z, const float w) 
+	{ v[0] = x; v[1] = y; v[2] = z; v[3] = w;}
+inline void m3dLoadVector4(M3DVector4d v, const double x, const double y, const double z, const double w)
+	{ v[0] = x; v[1] = y; v[2] = z; v[3] = w;}
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Copy vector src into vector dst
+inline void	m3dCopyVector2(M3DVector2f dst, const M3DVector2f src) { memcpy(dst, src, sizeof(M3DVector2f)); }
+inline void	m3dCopyVector2(M3DVector2d dst, const M3DVector2d src) { memcpy(dst, src, sizeof(M3DVector2d)); }
+
+inline void	m3dCopyVector3(M3DVector3f dst, const M3DVector3f src) { memcpy(dst, src, sizeof(M3DVector3f)); }
+inline void	m3dCopyVector3(M3DVector3d dst, const M3DVector3d src) { memcpy(dst, src, sizeof(M3DVector3d)); }
+
+inline void	m3dCopyVector4(M3DVector4f dst, const M3DVector4f src) { memcpy(dst, src, sizeof(M3DVector4f)); }
+inline void	m3dCopyVector4(M3DVector4d dst, const M3DVector4d src) { memcpy(dst, src, sizeof(M3DVector4d)); }
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Add Vectors (r, a, b) r = a + b
+inline void m3dAddVectors2(M3DVector2f r, const M3DVector2f a, const M3DVector2f b)
+	{ r[0] = a[0] + b[0];	r[1] = a[1] + b[1];  }
+inline void m3dAddVectors2(M3DVector2d r, const M3DVector2d a, const M3DVector2d b)
+	{ r[0] = a[0] + b[0];	r[1] = a[1] + b[1];  }
+
+inline void m3dAddVectors3(M3DVector3f r, const M3DVector3f a, const M3DVector3f b)
+	{ r[0] = a[0] + b[0];	r[1] = a[1] + b[1]; r[2] = a[2] + b[2]; }
+inline void m3dAddVectors3(M3DVector3d r, const M3DVector3d a, const M3DVector3d b)
+	{ r[0] = a[0] + b[0];	r[1] = a[1] + b[1]; r[2] = a[2] + b[2]; }
+
+inline void m3dAddVectors4(M3DVector4f r, const M3DVector4f a, const M3DVector4f b)
+	{ r[0] = a[0] + b[0];	r[1] = a[1] + b[1]; r[2] = a[2] + b[2]; r[3] = a[3] + b[3]; }
+inline void m3dAddVectors4(M3DVector4d r, const M3DVector4d a, const M3DVector4d b)
+	{ r[0] = a[0] + b[0];	r[1] = a[1] + b[1]; r[2] = a[2] + b[2]; r[3] = a[3] + b[3]; }
+
+////////////////////////////////////////////////////////////////////////////////
+// Subtract Vectors (r, a, b) r = a - b
+inline void m3dSubtractVectors2(M3DVector2f r, const M3DVector2f a, const M3DVector2f b)
+	{ r[0] = a[0] - b[0]; r[1] = a[1] - b[1];  }
+inline void m3dSubtractVectors2(M3DVector2d r, const M3DVector2d a, const M3DVector2d b)
+	{ r[0] = a[0] - b[0]; r[1] = a[1] - b[1]; }
+
+inline void m3dSubtractVectors3(M3DVector3f r, const M3DVector3f a, const M3DVector3f b)
+	{ r[0] = a[0] - b[0]; r[1] = a[1] - b[1]; r[2] = a[2] - b[2]; }
+inline void m3dSubtractVectors3(M3DVector3d r, const M3DVector3d a, const M3DVector3d b)
+	{ r[0] = a[0] - b[0]; r[1] = a[1] - b[1]; r[2] = a[2] - b[2]; }
+
+inline void m3dSubtractVectors4(M3DVector4f r, const M3DVector4f a, const M3DVector4f b)
+	{ r[0] = a[0] - b[0]; r[1] = a[1] - b[1]; r[2] = a[2] - b[2]; r[3] = a[3] - b[3]; }
+inline void m3dSubtractVectors4(M3DVector4d r, const M3DVector4d a, const M3DVector4d b)
+	{ r[0] = a[0] - b[0]; r[1] = a[1] - b[1]; r[2] = a[2] - b[2]; r[3] = a[3] - b[3]; }
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////
+// Scale Vectors (in place)
+inline void m3dScaleVector2(M3DVector2f v, const float scale) 
+	{ v[0] *= scale; v[1] *= scale; }
+inline void m3dScaleVector2(M3DVector2d v, const double scale) 
+	{ v[0] *= scale; v[1] *= scale; }
+
+inline void m3dScaleVector3(M3DVector3f v, const float scale) 
+	{ v[0] *= scale; v[1] *= scale; v[2] *= scale; }
+inline void m3dScaleVector3(M3DVector3d v, const double scale) 
+	{ v[0] *= scale; v[1] *= scale; v[2] *= scale; }
+
+inline void m3dScaleVector4(M3DVector4f v, const float scale) 
+	{ v[0] *= scale; v[1] *= scale; v[2] *= scale; v[3] *= scale; }
+inline void m3dScaleVector4(M3DVector4d v, const double scale) 
+	{ v[0] *= scale; v[1] *= scale; v[2] *= scale; v[3] *= scale; }
+
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Cross Product
+// u x v = result
+// 3 component vectors only.
+inline void m3dCrossProduct3(M3DVector3f result, const M3DVector3f u, const M3DVector3f v)
+	{
+	result[0] = u[1]*v[2] - v[1]*u[2];
+	result[1] = -u[0]*v[2] + v[0]*u[2];
+	result[2] = u[0]*v[1] - v[0]*u[1];
+	}
+
+inline void m3dCrossProduct3(M3DVector3d result, const M3DVector3d u, const M3DVector3d v)
+	{
+	result[0] = u[1]*v[2] - v[1]*u[2];
+	result[1] = -u[0]*v[2] + v[0]*u[2];
+	result[2] = u[0]*v[1] - v[0]*u[1];
+	}
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Dot Product, only for three component vectors
+// return u dot v
+inline float m3dDotProduct3(const M3DVector3f u, const M3DVector3f v)
+	{ return u[0]*v[0] + u[1]*v[1] + u[2]*v[2]; }
+
+inline double m3dDotProduct3(const M3DVector3d u, const M3DVector3d v)
+	{ return u[0]*v[0] + u[1]*v[1] + u[2]*v[2]; }
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Angle between vectors, only for three component vectors. Angle is in radians...
+inline float m3dGetAngleBetweenVectors3(const M3DVector3f u, const M3DVector3f v)
+    {
+    float dTemp = m3dDotProduct3(u, v);
+    return float(acos(double(dTemp)));	// Double cast just gets rid of compiler warning, no real need
+    }
+
+inline double m3dGetAngleBetweenVectors3(const M3DVector3d u, const M3DVector3d v)
+    {
+    double dTemp = m3dDotProduct3(u, v);
+    return acos(dTemp);
+    }
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Get Square of a vectors length
+// Only for three component vectors
+inline float m3dGetVectorLengthSquared3(const M3DVector3f u)
+	{ return (u[0] * u[0]) + (u[1] * u[1]) + (u[2] * u[2]); }
+
+inline double m3dGetVectorLengthSquared3(const M3DVector3d u)
+	{ return (u[0] * u[0]) + (u[1] * u[1]) + (u[2] * u[2]); }
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Get lenght of vector
+// Only for three component vectors.
+inline float m3dGetVectorLength3(const M3DVector3f u)
+	{ return sqrtf(m3dGetVectorLengthSquared3(u)); }
+
+inline double m3dGetVectorLength3(const M3DVector3d u)
+	{ return sqrt(m3dGetVectorLengthSquared3(u)); }
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Normalize a vector
+// Scale a vector to unit length. Easy, just scale the vector by it's length
+inline void m3dNormalizeVector3(M3DVector3f u)
+	{ m3dScaleVector3(u, 1.0f / m3dGetVectorLength3(u)); }
+
+inline void m3dNormalizeVector3(M3DVector3d u)
+	{ m3dScaleVector3(u, 1.0 / m3dGetVectorLength3(u)); }
+
+
+//////////////////////////////////////////////////////////////////////////////////////
+// Get the distance between two points. The distance between two points is just
+// the magnitude of the difference between two vectors
+// Located in math.cpp
+float m3dGetDistanceSquared3(const M3DVector3f u, const M3DVector3f v);
+double m3dGetDistanceSquared3(const M3DVector3d u, const M3DVector3d v);
+
+inline double m3dGetDistance3(const M3DVector3d u, const M3DVector3d v)
+{ return sqrt(m3dGetDistanceSquared3(u, v)); }
+
+inline float m3dGetDistance3(const M3DVector3f u, const M3DVector3f v)
+{ return sqrtf(m3dGetDistanceSquared3(u, v)); }
+
+inline float m3dGetMagnitudeSquared3(const M3DVector3f u) { return u[0]*u[0] + u[1]*u[1] + u[2]*u[2]; }
+inline double m3dGetMagnitudeSquared3(const M3DVector3d u) { return u[0]*u[0] + u[1]*u[1] + u[2]*u[2]; }
+
+inline float m3dGetMagnitude3(const M3DVector3f u) { return sqrtf(m3dGetMagnitudeSquared3(u)); }
+inline double m3dGetMagnitude3(const M3DVector3d u) { return sqrt(m3dGetMagnitudeSquared3(u)); }
+
+	
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Matrix functions
+// Both floating point and double precision 3x3 and 4x4 matricies are supported.
+// No support is included for arbitrarily dimensioned matricies on purpose, since
+// the 3x3 and 4x4 matrix routines are the most common for the purposes of this
+// library. Matrices are column major, like OpenGL matrices.
+// Unlike the vector functions, some of these are going to have to not be inlined,
+// although many will be.
+
+// Copy Matrix
+// Brain-dead memcpy
+inline void m3dCopyMatrix33(M3DMatrix33f dst, const M3DMatrix33f src)
+	{ memcpy(dst, src, sizeof(M3DMatrix33f)); }
+
+inline void m3dCopyMatrix33(M3DMatrix33d dst, const M3DMatrix33d src)
+	{ memcpy(dst, src, sizeof(M3DMatrix33d)); }
+
+inline void m3dCopyMatrix44(M3DMatrix44f dst, const M3DMatrix44f src)
+	{ memcpy(dst, src, sizeof(M3DMatrix44f)); }
+
+inline void m3dCopyMatrix44(M3DMatrix44d dst, const M3DMatrix44d src)
+	{ memcpy(dst, src, sizeof(M3DMatrix44d)); }
+
+// LoadIdentity
+// Implemented in Math3d.cpp
+void m3dLoadIdentity33(M3DMatrix33f m);
+void m3dLoadIdentity33(M3DMatrix33d m);
+void m3dLoadIdentity44(M3DMatrix44f m);
+void m3dLoadIdentity44(M3DMatrix44d m);
+
+/////////////////////////////////////////////////////////////////////////////
+// Get/Set Column.
+inline void m3dGetMatrixColumn33(M3DVector3f dst, const M3DMatrix33f src, const int column)
+	{ memcpy(dst, src + (3 * column), sizeof(float) * 3); }
+
+inline void m3dGetMatrixColumn33(M3DVector3d dst, const M3DMatrix33d src, const int column)
+	{ memcpy(dst, src + (3 * column), sizeof(double) * 3); }
+
+inline void m3dSetMatrixColumn33(M3DMatrix33f dst, const M3DVector3f src, const int column)
+	{ memcpy(dst + (3 * column), src, sizeof(float) * 3); }
+
+inline void m3dSetMatrixColumn33(M3DMatrix33d dst, const M3DVector3d src, const int column)
+	{ memcpy(dst + (3 * column), src, sizeof(double) * 3); }
+
+inline void m3dGetMatrixColumn44(M3DVector4f dst, const M3DMatrix44f src, const int column)
+	{ memcpy(dst, src + (4 * column), sizeof(float) * 4); }
+
+inline void m3dGetMatrixColumn44(M3DVector4d dst, const M3DMatrix44d src, const int column)
+	{ memcpy(dst, src + (4 * column), sizeof(double) * 4); }
+
+inline void m3dSetMatrixColumn44(M3DMatrix44f dst, const M3DVector4f src, const int column)
+	{ memcpy(dst + (4 * column), src, sizeof(float) * 4); }
+
+inline void m3dSetMatrixColumn44(M3DMatrix44d dst, const M3DVector4d src, const int column)
+	{ memcpy(dst + (4 * column), src, sizeof(double) * 4); }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Extract a rotation matrix from a 4x4 matrix
+// Extracts the rotation matrix (3x3) from a 4x4 matrix
+inline void m3dExtractRotationMatrix33(M3DMatrix33f dst, const M3DMatrix44f src)
+	{	
+	memcpy(dst, src, sizeof(float) * 3); // X column
+	memcpy(dst + 3, src + 4, sizeof(float) * 3); // Y column
+	memcpy(dst + 6, src + 8, sizeof(float) * 3); // Z column
+	}
+
+// Ditto above, but for doubles
+inline void m3dExtractRotationMatrix33(M3DMatrix33d dst, const M3DMatrix44d src)
+	{
+	memcpy(dst, src, sizeof(double) * 3); // X column
+	memcpy(dst + 3, src + 4, sizeof(double) * 3); // Y column
+	memcpy(dst + 6, src + 8, sizeof(double) * 3); // Z column
+	}
+
+// Inject Rotation (3x3) into a full 4x4 matrix...
+inline void m3dInjectRotationMatrix44(M3DMatrix44f dst, const M3DMatrix33f src)
+	{
+	memcpy(dst, src, sizeof(float) * 4);
+	memcpy(dst + 4, src + 4, sizeof(float) * 4);
+	memcpy(dst + 8, src + 8, sizeof(float) * 4);
+	}
+
+// Ditto above for doubles
+inline void m3dInjectRotationMatrix44(M3DMatrix44d dst, const M3DMatrix33d src)
+	{
+	memcpy(dst, src, sizeof(double) * 4);
+	memcpy(dst + 4, src + 4, sizeof(double) * 4);
+	memcpy(dst + 8, src + 8, sizeof(double) * 4);
+	}
+
+////////////////////////////////////////////////////////////////////////////////
+// MultMatrix
+// Implemented in Math.cpp
+void m3dMatrixMultiply44(M3DMatrix44f product, const M3DMatrix44f a, const M3DMatrix44f b);
+void m3dMatrixMultiply44(M3DMatrix44d product, const M3DMatrix44d a, const M3DMatrix44d b);
+void m3dMatrixMultiply33(M3DMatrix33f product, const M3DMatrix33f a, const M3DMatrix33f b);
+void m3dMatrixMultiply33(M3DMatrix33d product, const M3DMatrix33d a, const M3DMatrix33d b);
+
+
+// Transform - Does rotation and translation via a 4x4 matrix. Transforms
+// a point or vector.
+// By-the-way __inline means I'm asking the compiler to do a cost/benefit analysis. If 
+// these are used frequently, they may not be inlined to save memory. I'm experimenting
+// with this....
+// Just transform a 3 compoment vector
+__inline void m3dTransformVector3(M3DVector3f vOut, const M3DVector3f v, const M3DMatrix44f m)
+    {
+    vOut[0] = m[0] * v[0] + m[4] * v[1] + m[8] *  v[2] + m[12];// * v[3];	// Assuming 1 
+    vOut[1] = m[1] * v[0] + m[5] * v[1] + m[9] *  v[2] + m[13];// * v[3];	
+    vOut[2] = m[2] * v[0] + m[6] * v[1] + m[10] * v[2] + m[14];// * v[3];	
+	//vOut[3] = m[3] * v[0] + m[7] * v[1] + m[11] * v[2] + m[15] * v[3];
+    }
+
+// Ditto above, but for doubles
+__inline void m3dTransformVector3(M3DVector3d vOut, const M3DVector3d v, const M3DMatrix44d m)
+    {
+    vOut[0] = m[0] * v[0] + m[4] * v[1] + m[8] *  v[2] + m[12];// * v[3];	 
+    vOut[1] = m[1] * v[0] + m[5] * v[1] + m[9] *  v[2] + m[13];// * v[3];	
+    vOut[2] = m[2] * v[0] + m[6] * v[1] + m[10] * v[2] + m[14];// * v[3];	
+	//vOut[3] = m[3] * v[0] + m[7] * v[1] + m[11] * v[2] + m[15] * v[3];
+    }
+
+// Full four component transform
+__inline void m3dTransformVector4(M3DVector4f vOut, const M3DVector4f v, const M3DMatrix44f m)
+    {
+    vOut[0] = m[0] * v[0] + m[4] * v[1] + m[8] *  v[2] + m[12] * v[3];	 
+    vOut[1] = m[1] * v[0] + m[5] * v[1] + m[9] *  v[2] + m[13] * v[3];	
+    vOut[2] = m[2] * v[0] + m[6] * v[1] + m[10] * v[2] + m[14] * v[3];	
+	vOut[3] = m[3] * v[0] + m[7] * v[1] + m[11] * v[2] + m[15] * v[3];
+    }
+
+// Ditto above, but for doubles
+__inline void m3dTransformVector4(M3DVector4d vOut, const M3DVector4d v, const M3DMatrix44d m)
+    {
+    vOut[0] = m[0] * v[0] + m[4] * v[1] + m[8] *  v[2] + m[12] * v[3];	 
+    vOut[1] = m[1] * v[0] + m[5] * v[1] + m[9] *  v[2] + m[13] * v[3];	
+    vOut[2] = m[2] * v[0] + m[6] * v[1] + m[10] * v[2] + m[14] * v[3];	
+	vOut[3] = m[3] * v[0] + m[7] * v[1] + m[11] * v[2] + m[15] * v[3];
+    }
+
+
+
+// Just do the rotation, not the translation... this is usually done with a 3x3
+// Matrix.
+__inline void m3dRotateVector(M3DVector3f vOut, const M3DVector3f p, const M3DMatrix33f m)
+	{
+    vOut[0] = m[0] * p[0] + m[3] * p[1] + m[6] * p[2];	
+    vOut[1] = m[1] * p[0] + m[4] * p[1] + m[7] * p[2];	
+    vOut[2] = m[2] * p[0] + m[5] * p[1] + m[8] * p[2];	
+	}
+
+// Ditto above, but for doubles
+__inline void m3dRotateVector(M3DVector3d vOut, const M3DVector3d p, const M3DMatrix33d m)
+	{
+    vOut[0] = m[0] * p[0] + m[3] * p[1] + m[6] * p[2];	
+    vOut[1] = m[1] * p[0] + m[4] * p[1] + m[7] * p[2];	
+    vOut[2] = m[2] * p[0] + m[5] * p[1] + m[8] * p[2];	
+	}
+
+
+// Create a Scaling Matrix
+inline void m3dScaleMatrix33(M3DMatrix33f m, float xScale, float yScale, float zScale)
+	{ m3dLoadIdentity33(m); m[0] = xScale; m[4] = yScale; m[8] = zScale; }
+	
+inline void m3dScaleMatrix33(M3DMatrix33f m, const M3DVector3f vScale)
+	{ m3dLoadIdentity33(m); m[0] = vScale[0]; m[4] = vScale[1]; m[8] = vScale[2]; }
+	
+inline void m3dScaleMatrix33(M3DMatrix33d m, double xScale, double yScale, double zScale)
+	{ m3dLoadIdentity33(m); m[0] = xScale; m[4] = yScale; m[8] = zScale; }
+	
+inline void m3dScaleMatrix33(M3DMatrix33d m, const M3DVector3d vScale)
+	{ m3dLoadIdentity33(m); m[0] = vScale[0]; m[4] = vScale[1]; m[8] = vScale[2]; }
+
+inline void m3dScaleMatrix44(M3DMatrix44f m, float xScale, float yScale, float zScale)
+	{ m3dLoadIdentity44(m); m[0] = xScale; m[5] = yScale; m[10] = zScale; }
+	
+inline void m3dScaleMatrix44(M3DMatrix44f m, const M3DVector3f vScale)
+	{ m3dLoadIdentity44(m); m[0] = vScale[0]; m[5] = vScale[1]; m[10] = vScale[2]; }
+	
+inline void m3dScaleMatrix44(M3DMatrix44d m, double xScale, double yScale, double zScale)
+	{ m3dLoadIdentity44(m); m[0] = xScale; m[5] = yScale; m[10] = zScale; }
+	
+inline void m3dScaleMatrix44(M3DMatrix44d m, const M3DVector3d vScale)
+	{ m3dLoadIdentity44(m); m[0] = vScale[0]; m[5] = vScale[1]; m[10] = vScale[2]; }
+
+	
+void m3dMakePerspectiveMatrix(M3DMatrix44f mProjection, float fFov, float fAspect, float zMin, float zMax);
+void m3dMakeOrthographicMatrix(M3DMatrix44f mProjection, float xMin, float xMax, float yMin, float yMax, float zMin, float zMax);
+
+
+// Create a Rotation matrix
+// Implemented in math3d.cpp
+void m3dRotationMatrix33(M3DMatrix33f m, float angle, float x, float y, float z);
+void m3dRotationMatrix33(M3DMatrix33d m, double angle, double x, double y, double z);
+void m3dRotationMatrix44(M3DMatrix44f m, float angle, float x, float y, float z);
+void m3dRotationMatrix44(M3DMatrix44d m, double angle, double x, double y, double z);
+
+// Create a Translation matrix. Only 4x4 matrices have translation components
+inline void m3dTranslationMatrix44(M3DMatrix44f m, float x, float y, float z)
+{ m3dLoadIdentity44(m); m[12] = x; m[13] = y; m[14] = z; }
+
+inline void m3dTranslationMatrix44(M3DMatrix44d m, double x, double y, double z)
+{ m3dLoadIdentity44(m); m[12] = x; m[13] = y; m[14] = z; }
+
+void m3dInvertMatrix44(M3DMatrix44f mInverse, const M3DMatrix44f m);
+void m3dInvertMatrix44(M3DMatrix44d mInverse, const M3DMatrix44d m);
+
+///////////////////////////////////////////////////////////////////////////////
+// Inverse of an affine matrix (bottom row is 0, 0, 0, 1). The upper 3x3 is
+// inverted by cofactors, and the translation is just carried through it. This is
+// about a third of the work of the general inverse above.
+// mInverse may be the same matrix as m.
+inline void m3dInvertAffine44(M3DMatrix44f mInverse, const M3DMatrix44f m)
+	{
+	// Rows of the inverse are the cross products of the columns
+	M3DVector3f r0, r1, r2, t;
+	m3dCrossProduct3(r0, m + 4, m + 8);
+	m3dCrossProduct3(r1, m + 8, m);
+	m3dCrossProduct3(r2, m, m + 4);
+	m3dCopyVector3(t, m + 12);
+
+	float fInvDet = 1.0f / m3dDotProduct3(m, r0);
+	m3dScaleVector3(r0, fInvDet);
+	m3dScaleVector3(r1, fInvDet);
+	m3dScaleVector3(r2, fInvDet);
+
+	mInverse[0] = r0[0]; mInverse[4] = r0[1]; mInverse[8]  = r0[2]; mInverse[12] = -m3dDotProduct3(r0, t);
+	mInverse[1] = r1[0]; mInverse[5] = r1[1]; mInverse[9]  = r1[2]; mInverse[13] = -m3dDotProduct3(r1, t);
+	mInverse[2] = r2[0]; mInverse[6] = r2[1]; mInverse[10] = r2[2]; mInverse[14] = -m3dDotProduct3(r2, t);
+	mInverse[3] = 0.0f;  mInverse[7] = 0.0f;  mInverse[11] = 0.0f;  mInverse[15] = 1.0f;
+	}
+
+// Ditto above, but for doubles
+inline void m3dInvertAffine44(M3DMatrix44d mInverse, const M3DMatrix44d m)
+	{
+	M3DVector3d r0, r1, r2, t;
+	m3dCrossProduct3(r0, m + 4, m + 8);
+	m3dCrossProduct3(r1, m + 8, m);
+	m3dCrossProduct3(r2, m, m + 4);
+	m3dCopyVector3(t, m + 12);
+
+	double dInvDet = 1.0 / m3dDotProduct3(m, r0);
+	m3dScaleVector3(r0, dInvDet);
+	m3dScaleVector3(r1, dInvDet);
+	m3dScaleVector3(r2, dInvDet);
+
+	mInverse[0] = r0[0]; mInverse[4] = r0[1]; mInverse[8]  = r0[2]; mInverse[12] = -m3dDotProduct3(r0, t);
+	mInverse[1] = r1[0]; mInverse[5] = r1[1]; mInverse[9]  = r1[2]; mInverse[13] = -m3dDotProduct3(r1, t);
+	mInverse[2] = r2[0]; mInverse[6] = r2[1]; mInverse[10] = r2[2]; mInverse[14] = -m3dDotProduct3(r2, t);
+	mInverse[3] = 0.0;   mInverse[7] = 0.0;   mInverse[11] = 0.0;   mInverse[15] = 1.0;
+	}
+
+// Inverse of a rigid body matrix (orthonormal rotation plus translation), like
+// the ones GLFrame makes. The rotation is transposed and the translation is
+// rotated back the other way. mInverse may be the same matrix as m.
+inline void m3dInvertRigid44(M3DMatrix44f mInverse, const M3DMatrix44f m)
+	{
+	M3DVector3f x, y, z, t;
+	m3dCopyVector3(x, m);
+	m3dCopyVector3(y, m + 4);
+	m3dCopyVector3(z, m + 8);
+	m3dCopyVector3(t, m + 12);
+
+	mInverse[0] = x[0]; mInverse[4] = x[1]; mInverse[8]  = x[2]; mInverse[12] = -m3dDotProduct3(x, t);
+	mInverse[1] = y[0]; mInverse[5] = y[1]; mInverse[9]  = y[2]; mInverse[13] = -m3dDotProduct3(y, t);
+	mInverse[2] = z[0]; mInverse[6] = z[1]; mInverse[10] = z[2]; mInverse[14] = -m3dDotProduct3(z, t);
+	mInverse[3] = 0.0f; mInverse[7] = 0.0f; mInverse[11] = 0.0f; mInverse[15] = 1.0f;
+	}
+
+// Ditto above, but for doubles
+inline void m3dInvertRigid44(M3DMatrix44d mInverse, const M3DMatrix44d m)
+	{
+	M3DVector3d x, y, z, t;
+	m3dCopyVector3(x, m);
+	m3dCopyVector3(y, m + 4);
+	m3dCopyVector3(z, m + 8);
+	m3dCopyVector3(t, m + 12);
+
+	mInverse[0] = x[0]; mInverse[4] = x[1]; mInverse[8]  = x[2]; mInverse[12] = -m3dDotProduct3(x, t);
+	mInverse[1] = y[0]; mInverse[5] = y[1]; mInverse[9]  = y[2]; mInverse[13] = -m3dDotProduct3(y, t);
+	mInverse[2] = z[0]; mInverse[6] = z[1]; mInverse[10] = z[2]; mInverse[14] = -m3dDotProduct3(z, t);
+	mInverse[3] = 0.0;  mInverse[7] = 0.0;  mInverse[11] = 0.0;  mInverse[15] = 1.0;
+	}
+
+// True if the bottom row is 0, 0, 0, 1, so m3dInvertAffine44 can be used
+inline bool m3dIsAffine44(const M3DMatrix44f m)
+	{ return m[3] == 0.0f && m[7] == 0.0f && m[11] == 0.0f && m[15] == 1.0f; }
+
+inline bool m3dIsAffine44(const M3DMatrix44d m)
+	{ return m[3] == 0.0 && m[7] == 0.0 && m[11] == 0.0 && m[15] == 1.0; }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// 3x4 affine matrices (see M3DMatrix34f). Multiplies live in math3dSIMD.h.
+inline void m3dLoadIdentity34(M3DMatrix34f m)
+	{
+	static const M3DMatrix34f identity = { 1.0f, 0.0f, 0.0f, 0.0f,
+										   0.0f, 1.0f, 0.0f, 0.0f,
+										   0.0f, 0.0f, 1.0f, 0.0f };
+	memcpy(m, identity, sizeof(M3DMatrix34f));
+	}
+
+inline void m3dCopyMatrix34(M3DMatrix34f dst, const M3DMatrix34f src)
+	{ memcpy(dst, src, sizeof(M3DMatrix34f)); }
+
+// To and from the column major 4x4. The bottom row of m is dropped, so m
+// should be affine (m3dIsAffine44).
+inline void m3dMatrix44ToAffine34(M3DMatrix34f a, const M3DMatrix44f m)
+	{
+	a[0] = m[0]; a[1] = m[4]; a[2]  = m[8];  a[3]  = m[12];
+	a[4] = m[1]; a[5] = m[5]; a[6]  = m[9];  a[7]  = m[13];
+	a[8] = m[2]; a[9] = m[6]; a[10] = m[10]; a[11] = m[14];
+	}
+
+inline void m3dAffine34ToMatrix44(M3DMatrix44f m, const M3DMatrix34f a)
+	{
+	m[0] = a[0]; m[4] = a[1]; m[8]  = a[2];  m[12] = a[3];
+	m[1] = a[4]; m[5] = a[5]; m[9]  = a[6];  m[13] = a[7];
+	m[2] = a[8]; m[6] = a[9]; m[10] = a[10]; m[14] = a[11];
+	m[3] = 0.0f; m[7] = 0.0f; m[11] = 0.0f;  m[15] = 1.0f;
+	}
+
+// Transform a point (w = 1) by a 3x4 matrix
+inline void m3dTransformVector34(M3DVector3f vOut, const M3DVector3f v, const M3DMatrix34f m)
+	{
+	float x = v[0], y = v[1], z = v[2];
+	vOut[0] = m[0] * x + m[1] * y + m[2]  * z + m[3];
+	vOut[1] = m[4] * x + m[5] * y + m[6]  * z + m[7];
+	vOut[2] = m[8] * x + m[9] * y + m[10] * z + m[11];
+	}
+
+// Same as m3dInvertAffine44. The rows of the 3x3 part are the columns of the
+// 4x4 version, so the cross products swap over. mInverse may be the same matrix as m.
+inline void m3dInvertAffine34(M3DMatrix34f mInverse, const M3DMatrix34f m)
+	{
+	M3DVector3f c0, c1, c2, t;
+	c0[0] = m[0]; c0[1] = m[4]; c0[2] = m[8];
+	c1[0] = m[1]; c1[1] = m[5]; c1[2] = m[9];
+	c2[0] = m[2]; c2[1] = m[6]; c2[2] = m[10];
+	t[0] = m[3]; t[1] = m[7]; t[2] = m[11];
+
+	// Rows of the inverse are the cross products of the columns
+	M3DVector3f r0, r1, r2;
+	m3dCrossProduct3(r0, c1, c2);
+	m3dCrossProduct3(r1, c2, c0);
+	m3dCrossProduct3(r2, c0, c1);
+
+	float fInvDet = 1.0f / m3dDotProduct3(c0, r0);
+	m3dScaleVector3(r0, fInvDet);
+	m3dScaleVector3(r1, fInvDet);
+	m3dScaleVector3(r2, fInvDet);
+
+	mInverse[0] = r0[0]; mInverse[1] = r0[1]; mInverse[2]  = r0[2]; mInverse[3]  = -m3dDotProduct3(r0, t);
+	mInverse[4] = r1[0]; mInverse[5] = r1[1]; mInverse[6]  = r1[2]; mInverse[7]  = -m3dDotProduct3(r1, t);
+	mInverse[8] = r2[0]; mInverse[9] = r2[1]; mInverse[10] = r2[2]; mInverse[11] = -m3dDotProduct3(r2, t);
+	}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+// Other Miscellaneous functions
+
+// Find a normal from three points
+// Implemented in math3d.cpp
+void m3dFindNormal(M3DVector3f result, const M3DVector3f point1, const M3DVector3f point2, 
+							const M3DVector3f point3);
+void m3dFindNormal(M3DVector3d result, const M3DVector3d point1, const M3DVector3d point2, 
+							const M3DVector3d point3);
+
+
+// Calculates the signed distance of a point to a plane
+inline float m3dGetDistanceToPlane(const M3DVector3f point, const M3DVector4f plane)
+           { return point[0]*plane[0] + point[1]*plane[1] + point[2]*plane[2] + plane[3]; }
+
+inline double m3dGetDistanceToPlane(const M3DVector3d point, const M3DVector4d plane)
+           { return point[0]*plane[0] + point[1]*plane[1] + point[2]*plane[2] + plane[3]; }
+
+
+// Get plane equation from three points
+void m3dGetPlaneEquation(M3DVector4f planeEq, const M3DVector3f p1, const M3DVector3f p2, const M3DVector3f p3);
+void m3dGetPlaneEquation(M3DVector4d planeEq, const M3DVector3d p1, const M3DVector3d p2, const M3DVector3d p3);
+
+// Determine if a ray intersects a sphere
+// Return value is < 0 if the ray does not intersect
+// Return value is 0.0 if ray is tangent
+// Positive value is distance to the intersection point
+double m3dRaySphereTest(const M3DVector3d point, const M3DVector3d ray, const M3DVector3d sphereCenter, double sphereRadius);
+float m3dRaySphereTest(const M3DVector3f point, const M3DVector3f ray, const M3DVector3f sphereCenter, float sphereRadius);
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////
+// Faster (and one shortcut) replacements for gluProject
+void m3dProjectXY( M3DVector2f vPointOut, const M3DMatrix44f mModelView, const M3DMatrix44f mProjection, const int iViewPort[4], const M3DVector3f vPointIn);    
+void m3dProjectXYZ(M3DVector3f vPointOut, const M3DMatrix44f mModelView, const M3DMatrix44f mProjection, const int iViewPort[4], const M3DVector3f vPointIn);
+
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// This function does a three dimensional Catmull-Rom "spline" interpolation between p1 and p2
+void m3dCatmullRom(M3DVector3f vOut, const M3DVector3f vP0, const M3DVector3f vP1, const M3DVector3f vP2, const M3DVector3f vP3, float t);
+void m3dCatmullRom(M3DVector3d vOut, const M3DVector3d vP0, const M3DVector3d vP1, const M3DVector3d vP2, const M3DVector3d vP3, double t);
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// Compare floats and doubles... 
+inline bool m3dCloseEnough(const float fCandidate, const float fCompare, const float fEpsilon)
+    {
+    return (fabs(fCandidate - fCompare) < fEpsilon);
+    }
+    
+inline bool m3dCloseEnough(const double dCandidate, const double dCompare, const double dEpsilon)
+    {
+    return (fabs(dCandidate - dCompare) < dEpsilon);
+    }    
+ 
+////////////////////////////////////////////////////////////////////////////
+// Used for normal mapping. Finds the tangent bases for a triangle...
+// Only a floating point implementation is provided. This has no practical use as doubles.
+void m3dCalculateTangentBasis(M3DVector3f vTangent, const M3DVector3f pvTriangle[3], const M3DVector2f pvTexCoords[3], const M3DVector3f N);
+
+////////////////////////////////////////////////////////////////////////////
+// Smoothly step between 0 and 1 between edge1 and edge 2
+double m3dSmoothStep(const double edge1, const double edge2, const double x);
+float m3dSmoothStep(const float edge1, const float edge2, const float x);
+
+/////////////////////////////////////////////////////////////////////////////
+// Planar shadow Matrix
+void m3dMakePlanarShadowMatrix(M3DMatrix44d proj, const M3DVector4d planeEq, const M3DVector3d vLightPos);
+void m3dMakePlanarShadowMatrix(M3DMatrix44f proj, const M3DVector4f planeEq, const M3DVector3f vLightPos);
+
+/////////////////////////////////////////////////////////////////////////////
+// Closest point on a ray to another point in space
+double m3dClosestPointOnRay(M3DVector3d vPointOnRay, const M3DVector3d vRayOrigin, const M3DVector3d vUnitRayDir, 
+							const M3DVector3d vPointInSpace);
+
+float m3dClosestPointOnRay(M3DVector3f vPointOnRay, const M3DVector3f vRayOrigin, const M3DVector3f vUnitRayDir, 
+							const M3DVector3f vPointInSpace);
+
+/////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
+// Fast sine and cosine
+// Both at once, with the reduction done once. The angle is reduced to
+// [-pi/4, pi/4] with a three part pi/2, then short minimax polynomials are
+// used. For |fAngle| < 8192 the error is at most 1.2e-7 absolute, which is
+// about one float ulp of the result. Past that the reduction loses accuracy.
+// m3dSinCosStream in math3dSIMD.h does the same thing 4 or 8 at a time and
+// gives the same bits.
+#define M3D_2_DIV_PI_F		0.636619772367581f
+#define M3D_PI_DIV_2_F_A	1.5703125f
+#define M3D_PI_DIV_2_F_B	4.837512969970703125e-4f
+#define M3D_PI_DIV_2_F_C	7.54978995489188216e-8f
+
+// The two polynomials, only good on [-pi/4, pi/4]
+inline float m3dSinPoly(float x, float x2)
+	{ return ((-1.9515295891e-4f * x2 + 8.3321608736e-3f) * x2 - 1.6666654611e-1f) * x2 * x + x; }
+
+inline float m3dCosPoly(float x2)
+	{ return ((2.443315711809948e-5f * x2 - 1.388731625493765e-3f) * x2 + 4.166664568298827e-2f) * x2 * x2 - 0.5f * x2 + 1.0f; }
+
+inline void m3dSinCos(float fAngle, float &fSin, float &fCos)
+	{
+	float k = nearbyintf(fAngle * M3D_2_DIV_PI_F);
+	float x = ((fAngle - k * M3D_PI_DIV_2_F_A) - k * M3D_PI_DIV_2_F_B) - k * M3D_PI_DIV_2_F_C;
+	float x2 = x * x;
+	float s = m3dSinPoly(x, x2);
+	float c = m3dCosPoly(x2);
+
+	// Quadrant
+	int q = int(k) & 3;
+	if(q & 1) { float t = s; s = c; c = -t; }
+	if(q & 2) { s = -s; c = -c; }
+	fSin = s;
+	fCos = c;
+	}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Sines and cosines of nCount evenly spaced angles, fStart + i * fStep, by
+// rotating one step at a time instead of calling sin/cos for every angle.
+// The rotation is carried in double precision, so the error stays below 1e-7
+// (one float ulp) even for millions of steps. Pass fStep = M3D_2PI / n for
+// the n points of a circle. Either output may be NULL.
+inline void m3dMakeRing(float *pSin, float *pCos, int nCount, double fStart, double fStep)
+	{
+	double s = sin(fStart), c = cos(fStart);
+	double ds = sin(fStep), dc = cos(fStep);
+
+	for(int i = 0; i < nCount; i++)
+		{
+		if(pSin) pSin[i] = float(s);
+		if(pCos) pCos[i] = float(c);
+
+		double t = s * dc + c * ds;
+		c = c * dc - s * ds;
+		s = t;
+		}
+	}
+
+
+/////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
+// Quaternions
+// Stored (x, y, z, w), with w the scalar part, so they line up with an
+// M3DVector4f. Only unit quaternions are rotations, and all of these assume
+// unit length unless noted. Only a floating point implementation is provided.
+typedef float	M3DQuaternion[4];
+
+inline void m3dQuatLoadIdentity(M3DQuaternion q)
+	{ q[0] = 0.0f; q[1] = 0.0f; q[2] = 0.0f; q[3] = 1.0f; }
+
+inline void m3dQuatConjugate(M3DQuaternion r, const M3DQuaternion q)
+	{ r[0] = -q[0]; r[1] = -q[1]; r[2] = -q[2]; r[3] = q[3]; }
+
+// Rotation of fAngle radians around (x, y, z). The axis does not need to be unit length.
+inline void m3dQuatFromAxisAngle(M3DQuaternion q, float fAngle, float x, float y, float z)
+	{
+	float fMag = sqrtf(x*x + y*y + z*z);
+	if(fMag == 0.0f) {
+		m3dQuatLoadIdentity(q);
+		return;
+		}
+
+	float fScale = sinf(fAngle * 0.5f) / fMag;
+	q[0] = x * fScale;
+	q[1] = y * fScale;
+	q[2] = z * fScale;
+	q[3] = cosf(fAngle * 0.5f);
+	}
+
+// r = a * b, the rotation b followed by the rotation a (same order as m3dMatrixMultiply44).
+// r may be the same as a or b.
+inline void m3dQuatMultiply(M3DQuaternion r, const M3DQuaternion a, const M3DQuaternion b)
+	{
+	float x = a[3]*b[0] + a[0]*b[3] + a[1]*b[2] - a[2]*b[1];
+	float y = a[3]*b[1] - a[0]*b[2] + a[1]*b[3] + a[2]*b[0];
+	float z = a[3]*b[2] + a[0]*b[1] - a[1]*b[0] + a[2]*b[3];
+	float w = a[3]*b[3] - a[0]*b[0] - a[1]*b[1] - a[2]*b[2];
+	r[0] = x; r[1] = y; r[2] = z; r[3] = w;
+	}
+
+// Works on any quaternion, and is cheap enough to call after every multiply
+inline void m3dQuatNormalize(M3DQuaternion q)
+	{
+	float fScale = 1.0f / sqrtf(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+	q[0] *= fScale; q[1] *= fScale; q[2] *= fScale; q[3] *= fScale;
+	}
+
+// Rotate a vector, v' = v + 2w(u x v) + 2u x (u x v). 15 multiplies, no matrix.
+// vOut may be the same as v.
+inline void m3dQuatRotateVector(M3DVector3f vOut, const M3DQuaternion q, const M3DVector3f v)
+	{
+	M3DVector3f t, c;
+	m3dCrossProduct3(t, q, v);
+	t[0] += t[0]; t[1] += t[1]; t[2] += t[2];
+	m3dCrossProduct3(c, q, t);
+	vOut[0] = v[0] + q[3] * t[0] + c[0];
+	vOut[1] = v[1] + q[3] * t[1] + c[1];
+	vOut[2] = v[2] + q[3] * t[2] + c[2];
+	}
+
+// The three columns of the rotation matrix, without building the matrix
+inline void m3dQuatGetAxes(M3DVector3f vX, M3DVector3f vY, M3DVector3f vZ, const M3DQuaternion q)
+	{
+	float x2 = q[0] + q[0], y2 = q[1] + q[1], z2 = q[2] + q[2];
+	float xx = q[0] * x2, yy = q[1] * y2, zz = q[2] * z2;
+	float xy = q[0] * y2, xz = q[0] * z2, yz = q[1] * z2;
+	float wx = q[3] * x2, wy = q[3] * y2, wz = q[3] * z2;
+
+	if(vX) { vX[0] = 1.0f - (yy + zz); vX[1] = xy + wz; vX[2] = xz - wy; }
+	if(vY) { vY[0] = xy - wz; vY[1] = 1.0f - (xx + zz); vY[2] = yz + wx; }
+	if(vZ) { vZ[0] = xz + wy; vZ[1] = yz - wx; vZ[2] = 1.0f - (xx + yy); }
+	}
+
+inline void m3dQuatToMatrix33(M3DMatrix33f m, const M3DQuaternion q)
+	{ m3dQuatGetAxes(m, m + 3, m + 6, q); }
+
+inline void m3dQuatToMatrix44(M3DMatrix44f m, const M3DQuaternion q)
+	{
+	m3dQuatGetAxes(m, m + 4, m + 8, q);
+	m[3] = 0.0f; m[7] = 0.0f; m[11] = 0.0f;
+	m[12] = 0.0f; m[13] = 0.0f; m[14] = 0.0f; m[15] = 1.0f;
+	}
+
+// Rotation from three orthonormal axes (the columns of a rotation matrix).
+// Picks the largest diagonal term to divide by, so it is stable for any rotation.
+inline void m3dQuatFromAxes(M3DQuaternion q, const M3DVector3f vX, const M3DVector3f vY, const M3DVector3f vZ)
+	{
+	float fTrace = vX[0] + vY[1] + vZ[2];
+	float s;
+
+	if(fTrace > 0.0f) {
+		s = 0.5f / sqrtf(fTrace + 1.0f);
+		q[3] = 0.25f / s;
+		q[0] = (vY[2] - vZ[1]) * s;
+		q[1] = (vZ[0] - vX[2]) * s;
+		q[2] = (vX[1] - vY[0]) * s;
+		}
+	else if(vX[0] > vY[1] && vX[0] > vZ[2]) {
+		s = 2.0f * sqrtf(1.0f + vX[0] - vY[1] - vZ[2]);
+		q[3] = (vY[2] - vZ[1]) / s;
+		q[0] = 0.25f * s;
+		q[1] = (vY[0] + vX[1]) / s;
+		q[2] = (vZ[0] + vX[2]) / s;
+		}
+	else if(vY[1] > vZ[2]) {
+		s = 2.0f * sqrtf(1.0f + vY[1] - vX[0] - vZ[2]);
+		q[3] = (vZ[0] - vX[2]) / s;
+		q[0] = (vY[0] + vX[1]) / s;
+		q[1] = 0.25f * s;
+		q[2] = (vZ[1] + vY[2]) / s;
+		}
+	else {
+		s = 2.0f * sqrtf(1.0f + vZ[2] - vX[0] - vY[1]);
+		q[3] = (vX[1] - vY[0]) / s;
+		q[0] = (vZ[0] + vX[2]) / s;
+		q[1] = (vZ[1] + vY[2]) / s;
+		q[2] = 0.25f * s;
+		}
+	}
+
+inline void m3dQuatFromMatrix44(M3DQuaternion q, const M3DMatrix44f m)
+	{ m3dQuatFromAxes(q, m, m + 4, m + 8); }
+
+// Spherical linear interpolation from a (t = 0) to b (t = 1), along the shorter arc.
+// Very close rotations fall back to a normalized lerp, which is what slerp turns
+// into anyway and avoids dividing by sin(0). r may be the same as a or b.
+inline void m3dQuatSlerp(M3DQuaternion r, const M3DQuaternion a, const M3DQuaternion b, float t)
+	{
+	float fCos = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+	float fSign = 1.0f;
+	if(fCos < 0.0f) {
+		fCos = -fCos;
+		fSign = -1.0f;
+		}
+
+	float fA, fB;
+	if(fCos > 0.9995f) {
+		fA = 1.0f - t;
+		fB = t;
+		}
+	else {
+		float fTheta = acosf(fCos);
+		float fInvSin = 1.0f / sinf(fTheta);
+		fA = sinf((1.0f - t) * fTheta) * fInvSin;
+		fB = sinf(t * fTheta) * fInvSin;
+		}
+	fB *= fSign;
+
+	r[0] = fA * a[0] + fB * b[0];
+	r[1] = fA * a[1] + fB * b[1];
+	r[2] = fA * a[2] + fB * b[2];
+	r[3] = fA * a[3] + fB * b[3];
+	m3dQuatNormalize(r);
+	}
+
+#endif
+
@@ -0,0 +1,69 @@
+//
+//  main.cpp
+//  OpenGL-Benchmark
+//
+//  命令行基准测试，链接和示例程序同一个 libGLTools.a。
+//  用法: OpenGL-Benchmark [测试名 ...]
+//  不带参数时依次运行全部测试；有结果不一致时返回 1。
+//
+
+#include "Benchmark.h"
+
+#include <string.h>
+
+volatile float benchSink = 0.0f;
+
+struct BenchEntry {
+    const char *szName;
+    int (*pRun)(void);
+    const char *szInfo;
+};
+
+static const BenchEntry benchmarks[] = {
+    { "transform", BenchTransform, "m3dTransformVector3 loop vs array/stream kernels (1K/100K/10M points)" },
+    { "matrix",    BenchMatrix,    "library 4x4 multiply/inverse vs m3dFast* at every SIMD level" },
+    { "stackops",  BenchStackOps,  "push/translate/rotate/translate/scale/pop, full 4x4 multiply vs in-place m3dMult*44" },
+    { "templates", BenchTemplates, "matrix stack op sequence vs one math3dTemplates expression" },
+    { "hierarchy", BenchHierarchy, "1M-node transform hierarchy, serial Update vs GLTaskPool at 1-16 threads" },
+    { "boxes",     BenchBoxes,     "frustum TestSphere vs TestAABB/TestOBB, last-plane caching and cluster masks (100K boxes)" },
+};
+static const int nBenchmarks = int(sizeof(benchmarks) / sizeof(benchmarks[0]));
+
+static void PrintUsage(const char *szProgram) {
+    printf("usage: %s [benchmark ...]\n", szProgram);
+    for (int i = 0; i < nBenchmarks; i++) {
+        printf("  %-12s %s\n", benchmarks[i].szName, benchmarks[i].szInfo);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int nMismatches = 0;
+
+    // 不带参数: 全部运行
+    if (argc < 2) {
+        for (int i = 0; i < nBenchmarks; i++) {
+            printf("== %s\n", benchmarks[i].szName);
+            nMismatches += benchmarks[i].pRun();
+        }
+    }
+    else {
+        for (int a = 1; a < argc; a++) {
+            int i = 0;
+            while (i < nBenchmarks && strcmp(argv[a], benchmarks[i].szName) != 0) {
+                i++;
+            }
+            if (i == nBenchmarks) {
+                PrintUsage(argv[0]);
+                return 2;
+            }
+            printf("== %s\n", benchmarks[i].szName);
+            nMismatches += benchmarks[i].pRun();
+        }
+    }
+
+    if (nMismatches != 0) {
+        printf("%d results differ from the reference code\n", nMismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+// GLAffineInstanceBuffer.h
+// Per-instance 3x4 transforms (M3DMatrix34f) for instanced drawing. The
+// matrices go into one buffer object, 48 bytes each instead of 64 for a mat4,
+// and are bound as three vec4 attributes that advance once per instance, one
+// attribute per row. The vertex shader rebuilds the point with three dot
+// products:
+//
+//		in vec4 vInstance0;		// GLT_ATTRIBUTE_INSTANCE0
+//		in vec4 vInstance1;		// GLT_ATTRIBUTE_INSTANCE0 + 1
+//		in vec4 vInstance2;		// GLT_ATTRIBUTE_INSTANCE0 + 2
+//		...
+//		vec4 v = vec4(vVertex.xyz, 1.0);
+//		vec3 p = vec3(dot(vInstance0, v), dot(vInstance1, v), dot(vInstance2, v));
+//		gl_Position = mvpMatrix * vec4(p, 1.0);
+//
+// Each frame: fill an array (m3dMatrixMultiplyArray34 or a GLAffineMatrixStack),
+// Upload() it, bind the batch's vertex array object, call Bind(), and draw with
+// glDrawArraysInstanced/glDrawElementsInstanced. Instancing needs OpenGL 3.3,
+// so there is no OpenGL ES version.
+
+#ifndef __GLT_AFFINE_INSTANCE_BUFFER
+#define __GLT_AFFINE_INSTANCE_BUFFER
+
+#include <GLTools.h>
+#include <GLShaderManager.h>
+#include <math3d.h>
+
+#ifndef OPENGL_ES
+
+// After the stock attributes and GLT_ATTRIBUTE_TANGENT. Uses three slots.
+#define GLT_ATTRIBUTE_INSTANCE0		(GLT_ATTRIBUTE_LAST + 1)
+
+class GLAffineInstanceBuffer
+	{
+	public:
+		GLAffineInstanceBuffer(void) { instanceBuffer = 0; nInstances = nCapacity = 0; }
+
+		~GLAffineInstanceBuffer(void)
+			{
+			if(instanceBuffer != 0)
+				glDeleteBuffers(1, &instanceBuffer);
+			}
+
+		// Replace the instance data. The buffer only grows; when it doesn't need
+		// to, the old storage is orphaned so the upload never waits for the GPU
+		// to finish drawing with the last frame's data.
+		void Upload(const M3DMatrix34f *pMatrices, GLsizei nCount)
+			{
+			if(instanceBuffer == 0)
+				glGenBuffers(1, &instanceBuffer);
+			glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+			if(nCount > nCapacity)
+				nCapacity = nCount;
+			glBufferData(GL_ARRAY_BUFFER, sizeof(M3DMatrix34f) * nCapacity, NULL, GL_STREAM_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(M3DMatrix34f) * nCount, pMatrices);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			nInstances = nCount;
+			}
+
+		// Point the three instance attributes at the buffer. The attribute state
+		// belongs to the bound vertex array object, so with one VAO per batch
+		// this only has to be done once per batch.
+		void Bind(GLuint iFirstAttribute = GLT_ATTRIBUTE_INSTANCE0)
+			{
+			glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+			for(GLuint i = 0; i < 3; i++) {
+				glEnableVertexAttribArray(iFirstAttribute + i);
+				glVertexAttribPointer(iFirstAttribute + i, 4, GL_FLOAT, GL_FALSE, sizeof(M3DMatrix34f),
+									  (const GLvoid *)(sizeof(GLfloat) * 4 * i));
+				glVertexAttribDivisor(iFirstAttribute + i, 1);
+				}
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			}
+
+		void Unbind(GLuint iFirstAttribute = GLT_ATTRIBUTE_INSTANCE0)
+			{
+			for(GLuint i = 0; i < 3; i++) {
+				glVertexAttribDivisor(iFirstAttribute + i, 0);
+				glDisableVertexAttribArray(iFirstAttribute + i);
+				}
+			}
+
+		inline GLsizei GetCount(void) const { return nInstances; }
+
+	protected:
+		GLuint	instanceBuffer;
+		GLsizei	nInstances;
+		GLsizei	nCapacity;
+
+	private:
+		GLAffineInstanceBuffer(const GLAffineInstanceBuffer&);
+		GLAffineInstanceBuffer& operator=(const GLAffineInstanceBuffer&);
+	};
+
+#endif
+#endif
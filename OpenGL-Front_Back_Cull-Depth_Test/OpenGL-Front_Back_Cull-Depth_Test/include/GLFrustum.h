@@ -30,12 +30,23 @@ CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
 ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include <math3d.h>
+#include <math3dSIMD.h>
 #include <GLFrame.h>
 
 #ifndef __GL_FRAME_CLASS
 #define __GL_FRAME_CLASS
 
 
+// The planes in the order TestSphere tries them. Bit i of a plane mask
+// (see TestAABB) stands for plane i.
+enum GLT_FRUSTUM_PLANE { GLT_PLANE_NEAR = 0, GLT_PLANE_FAR, GLT_PLANE_LEFT, GLT_PLANE_RIGHT,
+                         GLT_PLANE_BOTTOM, GLT_PLANE_TOP };
+#define GLT_FRUSTUM_ALL_PLANES  0x3F
+
+// Box test results
+enum GLT_FRUSTUM_RESULT { GLT_FRUSTUM_OUTSIDE = 0, GLT_FRUSTUM_INTERSECTS, GLT_FRUSTUM_INSIDE };
+
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -212,19 +223,62 @@ class GLFrustum
             // counter clockwise order to make normals point inside 
             // the Frustum
             // Near and Far Planes
-            m3dGetPlaneEquation(nearPlane, nearULT, nearLLT, nearLRT);
-            m3dGetPlaneEquation(farPlane, farULT, farURT, farLRT);
+            m3dGetPlaneEquation(planes[GLT_PLANE_NEAR], nearULT, nearLLT, nearLRT);
+            m3dGetPlaneEquation(planes[GLT_PLANE_FAR], farULT, farURT, farLRT);
             
             // Top and Bottom Planes
-            m3dGetPlaneEquation(topPlane, nearULT, nearURT, farURT);
-            m3dGetPlaneEquation(bottomPlane, nearLLT, farLLT, farLRT);
+            m3dGetPlaneEquation(planes[GLT_PLANE_TOP], nearULT, nearURT, farURT);
+            m3dGetPlaneEquation(planes[GLT_PLANE_BOTTOM], nearLLT, farLLT, farLRT);
 
             // Left and right planes
-            m3dGetPlaneEquation(leftPlane, nearLLT, nearULT, farULT);
-            m3dGetPlaneEquation(rightPlane, nearLRT, farLRT, farURT);
+            m3dGetPlaneEquation(planes[GLT_PLANE_LEFT], nearLLT, nearULT, farULT);
+            m3dGetPlaneEquation(planes[GLT_PLANE_RIGHT], nearLRT, farLRT, farURT);
+            }
+
+
+        // Set the planes straight from a projection or model-view-projection
+        // matrix, instead of from this frustum's own shape and a GLFrame
+        // (Gribb and Hartmann). A point p is inside the clip volume when
+        // -w <= x, y, z <= w for (x, y, z, w) = M * p, so each plane is the
+        // fourth row of M plus or minus one of the others. The planes come out
+        // in whatever space M starts from: eye space for a projection matrix,
+        // world space for projection * camera, model space for a full MVP. That
+        // makes it work for any matrix, including mirrored views (a
+        // Scale(1, -1, 1) in the model-view), shadow map light frusta and off
+        // axis projections. The planes are normalized, so the tests still get
+        // real distances to compare with the radii.
+        //
+        // Only the plane tests use the result; the corner points are left as
+        // they were.
+        void ExtractPlanes(const M3DMatrix44f mMatrix)
+            {
+            const float *m = mMatrix;
+
+            for(int i = 0; i < 3; i++) {
+                // Row i against row 3: +row is the left/bottom/near plane, -row
+                // the right/top/far one
+                float *pLow = planes[(i == 0) ? GLT_PLANE_LEFT : (i == 1) ? GLT_PLANE_BOTTOM : GLT_PLANE_NEAR];
+                float *pHigh = planes[(i == 0) ? GLT_PLANE_RIGHT : (i == 1) ? GLT_PLANE_TOP : GLT_PLANE_FAR];
+                for(int j = 0; j < 4; j++) {
+                    pLow[j] = m[j * 4 + 3] + m[j * 4 + i];
+                    pHigh[j] = m[j * 4 + 3] - m[j * 4 + i];
+                    }
+                }
+
+            // An infinite far plane comes out as (0, 0, 0, d), which is fine
+            // left as it is
+            for(int i = 0; i < 6; i++) {
+                float fLength = m3dGetVectorLength3(planes[i]);
+                if(fLength > 0.0f) {
+                    float fScale = 1.0f / fLength;
+                    planes[i][0] *= fScale;
+                    planes[i][1] *= fScale;
+                    planes[i][2] *= fScale;
+                    planes[i][3] *= fScale;
+                    }
+                }
             }
 
-        
 
         // Allow expanded version of sphere test
         bool TestSphere(float x, float y, float z, float fRadius)
@@ -249,34 +303,151 @@ class GLFrustum
             float fDist;
 
             // Near Plane - See if it is behind me
-            fDist = m3dGetDistanceToPlane(vPoint, nearPlane);
+            fDist = m3dGetDistanceToPlane(vPoint, planes[GLT_PLANE_NEAR]);
             if(fDist + fRadius <= 0.0)
                 return false;
 
             // Distance to far plane
-            fDist = m3dGetDistanceToPlane(vPoint, farPlane);
+            fDist = m3dGetDistanceToPlane(vPoint, planes[GLT_PLANE_FAR]);
             if(fDist + fRadius <= 0.0)
                 return false;
 
-            fDist = m3dGetDistanceToPlane(vPoint, leftPlane);
+            fDist = m3dGetDistanceToPlane(vPoint, planes[GLT_PLANE_LEFT]);
             if(fDist + fRadius <= 0.0)
                 return false;
 
-            fDist = m3dGetDistanceToPlane(vPoint, rightPlane);
+            fDist = m3dGetDistanceToPlane(vPoint, planes[GLT_PLANE_RIGHT]);
             if(fDist + fRadius <= 0.0)
                 return false;
 
-            fDist = m3dGetDistanceToPlane(vPoint, bottomPlane);
+            fDist = m3dGetDistanceToPlane(vPoint, planes[GLT_PLANE_BOTTOM]);
             if(fDist + fRadius <= 0.0)
                 return false;
 
-            fDist = m3dGetDistanceToPlane(vPoint, topPlane);
+            fDist = m3dGetDistanceToPlane(vPoint, planes[GLT_PLANE_TOP]);
             if(fDist + fRadius <= 0.0)
                 return false;
 
             return true;
             }
 
+        // TestSphere for a whole array of spheres, centers and radii in SoA
+        // form (M3DVectorStream3 works), with the same results. Bit (i & 31)
+        // of pVisible[i >> 5] is set when sphere i is in the frustum, so
+        // pVisible needs (nCount + 31) / 32 words. The spheres go through the
+        // planes 4, 8 or 16 at a time (see m3dCullSphereStream). Returns the
+        // number of visible spheres.
+        int TestSpheres(const float *x, const float *y, const float *z, const float *fRadius,
+                        int nCount, unsigned int *pVisible)
+            {
+            return m3dCullSphereStream(pVisible, x, y, z, fRadius, nCount, planes, 6);
+            }
+
+        // The planes from the last Transform, in the order TestSphere tries
+        // them: near, far, left, right, bottom, top. Normals point inward.
+        void GetPlanes(M3DVector4f vPlanes[6])
+            { memcpy(vPlanes, planes, sizeof(planes)); }
+
+
+        // Axis aligned box test. For each plane only the box corner furthest
+        // along the plane normal (the p-vertex) has to be checked to see if
+        // the box is outside, and the nearest corner (the n-vertex) to see if
+        // it is all on the inside.
+        //
+        // iPlaneMask says which planes to test. A box that is all inside a
+        // plane gets that plane's bit cleared, so a child of this box inside a
+        // hierarchy can start from the mask this one returns and skip those
+        // planes; a box that ends up with no bits set is GLT_FRUSTUM_INSIDE.
+        // iLastPlane is the plane that rejected the object last time (keep one
+        // per object, starting at 0); it is tried first, and updated when a
+        // different plane rejects it. Objects that stay off screen are usually
+        // rejected by the same plane frame after frame, so that's one plane
+        // test instead of several.
+        GLT_FRUSTUM_RESULT TestAABB(const M3DVector3f vMin, const M3DVector3f vMax,
+                                    unsigned int& iPlaneMask, int& iLastPlane)
+            {
+            // iLastPlane first, then the rest in order
+            for(int n = -1; n < 6; n++) {
+                int i = (n < 0) ? iLastPlane : n;
+                if(!(iPlaneMask & (1u << i)) || (n >= 0 && i == iLastPlane))
+                    continue;
+
+                const float *p = planes[i];
+                float fFar = p[0] * ((p[0] > 0.0f) ? vMax[0] : vMin[0]) + p[1] * ((p[1] > 0.0f) ? vMax[1] : vMin[1]) +
+                             p[2] * ((p[2] > 0.0f) ? vMax[2] : vMin[2]) + p[3];
+                if(fFar <= 0.0f) {
+                    iLastPlane = i;
+                    return GLT_FRUSTUM_OUTSIDE;
+                    }
+                float fNear = p[0] * ((p[0] > 0.0f) ? vMin[0] : vMax[0]) + p[1] * ((p[1] > 0.0f) ? vMin[1] : vMax[1]) +
+                              p[2] * ((p[2] > 0.0f) ? vMin[2] : vMax[2]) + p[3];
+                if(fNear >= 0.0f)
+                    iPlaneMask &= ~(1u << i);
+                }
+
+            return (iPlaneMask == 0) ? GLT_FRUSTUM_INSIDE : GLT_FRUSTUM_INTERSECTS;
+            }
+
+        GLT_FRUSTUM_RESULT TestAABB(const M3DVector3f vMin, const M3DVector3f vMax)
+            {
+            unsigned int iPlaneMask = GLT_FRUSTUM_ALL_PLANES;
+            int iLastPlane = 0;
+            return TestAABB(vMin, vMax, iPlaneMask, iLastPlane);
+            }
+
+        // Oriented box: the box vMin..vMax in the object's own coordinates,
+        // placed in the world by mModel (a model matrix, GLFrame::GetMatrix,
+        // or a world matrix from GLTransformHierarchy; scales are fine). The
+        // box's reach along a plane normal is its half size along each of its
+        // axes times how much that axis points along the normal. Masks and
+        // iLastPlane work as for TestAABB.
+        GLT_FRUSTUM_RESULT TestOBB(const M3DMatrix44f mModel, const M3DVector3f vMin, const M3DVector3f vMax,
+                                   unsigned int& iPlaneMask, int& iLastPlane)
+            {
+            // Center and half size along the model's axes
+            M3DVector3f vLocalCenter, vHalf, vCenter;
+            vLocalCenter[0] = (vMin[0] + vMax[0]) * 0.5f; vHalf[0] = (vMax[0] - vMin[0]) * 0.5f;
+            vLocalCenter[1] = (vMin[1] + vMax[1]) * 0.5f; vHalf[1] = (vMax[1] - vMin[1]) * 0.5f;
+            vLocalCenter[2] = (vMin[2] + vMax[2]) * 0.5f; vHalf[2] = (vMax[2] - vMin[2]) * 0.5f;
+            m3dTransformVector3(vCenter, vLocalCenter, mModel);
+
+            for(int n = -1; n < 6; n++) {
+                int i = (n < 0) ? iLastPlane : n;
+                if(!(iPlaneMask & (1u << i)) || (n >= 0 && i == iLastPlane))
+                    continue;
+
+                const float *p = planes[i];
+                float fDist = m3dGetDistanceToPlane(vCenter, p);
+                float fReach = vHalf[0] * fabsf(p[0] * mModel[0] + p[1] * mModel[1] + p[2] * mModel[2]) +
+                               vHalf[1] * fabsf(p[0] * mModel[4] + p[1] * mModel[5] + p[2] * mModel[6]) +
+                               vHalf[2] * fabsf(p[0] * mModel[8] + p[1] * mModel[9] + p[2] * mModel[10]);
+                if(fDist + fReach <= 0.0f) {
+                    iLastPlane = i;
+                    return GLT_FRUSTUM_OUTSIDE;
+                    }
+                if(fDist - fReach >= 0.0f)
+                    iPlaneMask &= ~(1u << i);
+                }
+
+            return (iPlaneMask == 0) ? GLT_FRUSTUM_INSIDE : GLT_FRUSTUM_INTERSECTS;
+            }
+
+        GLT_FRUSTUM_RESULT TestOBB(const M3DMatrix44f mModel, const M3DVector3f vMin, const M3DVector3f vMax)
+            {
+            unsigned int iPlaneMask = GLT_FRUSTUM_ALL_PLANES;
+            int iLastPlane = 0;
+            return TestOBB(mModel, vMin, vMax, iPlaneMask, iLastPlane);
+            }
+
+        // The same for a box in a GLFrame's coordinates
+        GLT_FRUSTUM_RESULT TestOBB(GLFrame& frame, const M3DVector3f vMin, const M3DVector3f vMax,
+                                   unsigned int& iPlaneMask, int& iLastPlane)
+            {
+            M3DMatrix44f mModel;
+            frame.GetMatrix(mModel);
+            return TestOBB(mModel, vMin, vMax, iPlaneMask, iLastPlane);
+            }
+
     protected:
 		// The projection matrix for this frustum
 		M3DMatrix44f projMatrix;	
@@ -289,9 +460,8 @@ class GLFrustum
         M3DVector4f  nearULT, nearLLT, nearURT, nearLRT;
         M3DVector4f  farULT,  farLLT,  farURT,  farLRT;
 
-        // Base and Transformed plane equations
-        M3DVector4f nearPlane, farPlane, leftPlane, rightPlane;
-        M3DVector4f topPlane, bottomPlane;
+        // Base and Transformed plane equations, indexed by GLT_FRUSTUM_PLANE
+        M3DVector4f planes[6];
     };
 
 
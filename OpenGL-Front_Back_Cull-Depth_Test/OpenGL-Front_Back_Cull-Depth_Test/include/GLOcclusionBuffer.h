@@ -0,0 +1,416 @@
+// GLOcclusionBuffer.h
+// Software occlusion culling. A few big occluders (walls, the torus) are drawn
+// on the CPU into a small depth buffer, and then the bounding boxes of the
+// objects that might be hidden behind them are tested against it, so objects
+// that are in the frustum but fully covered never get a draw call.
+//
+// The buffer is low resolution (256 x 128 by default) and split into 8 x 8
+// pixel tiles. AddOccluder() transforms, clips and sets up the triangles and
+// drops each one into the bins of the tiles it overlaps; Rasterize() then
+// fills the tiles one at a time, eight pixels of a row at once with SSE, each
+// row's coverage as a lane mask over the depth update. Tiles do not share
+// anything, so Rasterize(GLTaskPool&) hands them out to threads. Each tile
+// keeps its farthest depth too, so most occludee tests never look at pixels.
+//
+//		occlusion.Begin(mViewProjection);
+//		occlusion.AddOccluder(mTorusModel, pTorusVerts, nTorusVerts, pTorusIndexes, nTorusIndexes);
+//		occlusion.Rasterize(taskPool);
+//		...
+//		if(occlusion.TestSphere(vCenter, fRadius))
+//			sphereBatch.Draw();
+//
+// Do this at the top of the frame, before the first GL call: the GPU is still
+// busy with the frame just swapped while the CPU rasterizes.
+//
+// Occluders are plain indexed triangle arrays (gltMakeTorusArrays and friends
+// in GLShapeArrays.h), since GLBatch and GLTriangleBatch keep no copy of their
+// vertices once End() has sent them to the GPU. Coverage is sampled at pixel
+// centers, so an occluder should be no bigger than what it stands in for.
+// Depth is stored as 1/w, which interpolates linearly across the screen; bigger
+// is nearer, and an empty pixel is 0.
+
+#ifndef __GLT_OCCLUSION_BUFFER
+#define __GLT_OCCLUSION_BUFFER
+
+#include <GLTools.h>
+#include <math3dSIMD.h>
+#include <GLTaskPool.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+// Tile size in pixels, each way. Rows are rasterized 8 pixels at a time.
+#define GLT_OCCLUSION_TILE	8
+
+class GLOcclusionBuffer
+	{
+	public:
+		// Rounded up to whole tiles
+		GLOcclusionBuffer(int iWidth = 256, int iHeight = 128) {
+			nTilesX = (iWidth + GLT_OCCLUSION_TILE - 1) / GLT_OCCLUSION_TILE;
+			nTilesY = (iHeight + GLT_OCCLUSION_TILE - 1) / GLT_OCCLUSION_TILE;
+			nWidth = nTilesX * GLT_OCCLUSION_TILE;
+			nHeight = nTilesY * GLT_OCCLUSION_TILE;
+			int nTiles = nTilesX * nTilesY;
+			pDepth = (float *)m3dAlignedAlloc(sizeof(float) * size_t(nWidth) * size_t(nHeight), 64);
+			pTileMin = (float *)m3dAlignedAlloc(sizeof(float) * size_t(nTiles), 64);
+			bins.resize(nTiles);
+			bCullFace = false;
+			pTaskPool = NULL;
+			m3dLoadIdentity44(mViewProjection);
+			Begin(mViewProjection);
+			Rasterize();
+			}
+
+		~GLOcclusionBuffer(void) {
+			m3dAlignedFree(pDepth);
+			m3dAlignedFree(pTileMin);
+			}
+
+		inline int GetWidth(void) const { return nWidth; }
+		inline int GetHeight(void) const { return nHeight; }
+
+		// Like glEnable(GL_CULL_FACE): skip clockwise triangles. Saves about
+		// half the work on closed, consistently wound occluders.
+		inline void SetCullFace(bool bCull) { bCullFace = bCull; }
+
+		// Start a new frame with the camera's projection * view matrix; both the
+		// occluders and the occludee tests are in world space from here on.
+		void Begin(const M3DMatrix44f mVP) {
+			m3dCopyMatrix44(mViewProjection, mVP);
+			tris.clear();
+			for(size_t t = 0; t < bins.size(); t++)
+				bins[t].clear();
+			nBinned = 0;
+			}
+
+		// An occluder mesh with its model (object to world) matrix
+		void AddOccluder(const M3DMatrix44f mModel, const M3DVector3f *pVerts, int nVerts, const GLuint *pIndexes, int nIndexes) {
+			AddMesh(mModel, pVerts, nVerts, pIndexes, nIndexes);
+			}
+
+		void AddOccluder(const M3DMatrix44f mModel, const M3DVector3f *pVerts, int nVerts, const GLushort *pIndexes, int nIndexes) {
+			AddMesh(mModel, pVerts, nVerts, pIndexes, nIndexes);
+			}
+
+
+		///////////////////////////////////////////////////////////////////////
+		// Fill the depth buffer from everything added since Begin()
+		void Rasterize(void) {
+			RasterizeTiles(0, nTilesX * nTilesY);
+			}
+
+		// The same, one tile row per task
+		void Rasterize(GLTaskPool& pool) {
+			GLTask task = { RasterizeTask, this, 0, nTilesY, 0 };
+			pTaskPool = &pool;
+			pool.Run(task);
+			}
+
+
+		///////////////////////////////////////////////////////////////////////
+		// False if the world space box is hidden behind the occluders (or off
+		// the screen altogether); true if any of it might show. Only reads the
+		// buffer, so any number of threads can test at once after Rasterize().
+		bool TestAABB(const M3DVector3f vMin, const M3DVector3f vMax) const {
+			float fMinX = 1e30f, fMinY = 1e30f, fMaxX = -1e30f, fMaxY = -1e30f, fNearest = 0.0f;
+			for(int i = 0; i < 8; i++) {
+				float x = (i & 1) ? vMax[0] : vMin[0];
+				float y = (i & 2) ? vMax[1] : vMin[1];
+				float z = (i & 4) ? vMax[2] : vMin[2];
+				const float *m = mViewProjection;
+				float cx = m[0] * x + m[4] * y + m[8] * z + m[12];
+				float cy = m[1] * x + m[5] * y + m[9] * z + m[13];
+				float cw = m[3] * x + m[7] * y + m[11] * z + m[15];
+
+				// A corner at or behind the eye; the box may cover anything
+				if(!(cw > 1e-6f))
+					return true;
+
+				float fInvW = 1.0f / cw;
+				float sx = (cx * fInvW * 0.5f + 0.5f) * float(nWidth);
+				float sy = (cy * fInvW * 0.5f + 0.5f) * float(nHeight);
+				fMinX = std::min(fMinX, sx); fMaxX = std::max(fMaxX, sx);
+				fMinY = std::min(fMinY, sy); fMaxY = std::max(fMaxY, sy);
+				fNearest = std::max(fNearest, fInvW);
+				}
+
+			// Every pixel the box's screen rectangle touches
+			if(fMaxX < 0.0f || fMaxY < 0.0f || fMinX >= float(nWidth) || fMinY >= float(nHeight))
+				return false;
+			int x0 = (fMinX > 0.0f) ? int(fMinX) : 0;
+			int y0 = (fMinY > 0.0f) ? int(fMinY) : 0;
+			int x1 = (fMaxX < float(nWidth - 1)) ? int(fMaxX) : nWidth - 1;
+			int y1 = (fMaxY < float(nHeight - 1)) ? int(fMaxY) : nHeight - 1;
+
+			for(int ty = y0 / GLT_OCCLUSION_TILE; ty <= y1 / GLT_OCCLUSION_TILE; ty++)
+				for(int tx = x0 / GLT_OCCLUSION_TILE; tx <= x1 / GLT_OCCLUSION_TILE; tx++) {
+					int t = ty * nTilesX + tx;
+					// Everything in this tile is nearer than the box
+					if(pTileMin[t] > fNearest)
+						continue;
+
+					int px0 = tx * GLT_OCCLUSION_TILE, py0 = ty * GLT_OCCLUSION_TILE;
+					int iFrom = (x0 > px0) ? x0 - px0 : 0;
+					int iTo = (x1 < px0 + GLT_OCCLUSION_TILE - 1) ? x1 - px0 : GLT_OCCLUSION_TILE - 1;
+					int yFrom = (y0 > py0) ? y0 - py0 : 0;
+					int yTo = (y1 < py0 + GLT_OCCLUSION_TILE - 1) ? y1 - py0 : GLT_OCCLUSION_TILE - 1;
+					const float *pTile = pDepth + t * GLT_OCCLUSION_TILE * GLT_OCCLUSION_TILE;
+					for(int y = yFrom; y <= yTo; y++) {
+						const float *pRow = pTile + y * GLT_OCCLUSION_TILE;
+						for(int x = iFrom; x <= iTo; x++)
+							if(pRow[x] <= fNearest)
+								return true;
+						}
+					}
+			return false;
+			}
+
+		bool TestSphere(const M3DVector3f vCenter, float fRadius) const {
+			M3DVector3f vMin = { vCenter[0] - fRadius, vCenter[1] - fRadius, vCenter[2] - fRadius };
+			M3DVector3f vMax = { vCenter[0] + fRadius, vCenter[1] + fRadius, vCenter[2] + fRadius };
+			return TestAABB(vMin, vMax);
+			}
+
+		// 1/w at a pixel, 0 where nothing was drawn (for debugging)
+		inline float GetDepth(int x, int y) const {
+			int t = (y / GLT_OCCLUSION_TILE) * nTilesX + x / GLT_OCCLUSION_TILE;
+			return pDepth[t * GLT_OCCLUSION_TILE * GLT_OCCLUSION_TILE + (y % GLT_OCCLUSION_TILE) * GLT_OCCLUSION_TILE + x % GLT_OCCLUSION_TILE];
+			}
+
+		// Triangles set up this frame (after clipping and face culling), and
+		// how many tile bins they landed in
+		inline int GetTriangleCount(void) const { return int(tris.size()); }
+		inline int GetBinnedCount(void) const { return nBinned; }
+
+	protected:
+		// A screen space triangle: three edge functions A*x + B*y + C, all >= 0
+		// inside, and 1/w as the plane A*x + B*y + C
+		struct Tri
+			{
+			float	e[3][3];
+			float	z[3];
+			int		iMinY, iMaxY;	// Rows the triangle touches
+			};
+
+		template <class INDEX>
+		void AddMesh(const M3DMatrix44f mModel, const M3DVector3f *pVerts, int nVerts, const INDEX *pIndexes, int nIndexes) {
+			M3DMatrix44f m;
+			m3dMatrixMultiply44(m, mViewProjection, mModel);
+			clip.resize(size_t(nVerts) * 4);
+			for(int i = 0; i < nVerts; i++) {
+				const float *v = pVerts[i];
+				float *c = &clip[size_t(i) * 4];
+				c[0] = m[0] * v[0] + m[4] * v[1] + m[8] * v[2] + m[12];
+				c[1] = m[1] * v[0] + m[5] * v[1] + m[9] * v[2] + m[13];
+				c[2] = m[2] * v[0] + m[6] * v[1] + m[10] * v[2] + m[14];
+				c[3] = m[3] * v[0] + m[7] * v[1] + m[11] * v[2] + m[15];
+				}
+
+			for(int i = 0; i + 2 < nIndexes; i += 3) {
+				const float *a = &clip[size_t(pIndexes[i]) * 4];
+				const float *b = &clip[size_t(pIndexes[i + 1]) * 4];
+				const float *c = &clip[size_t(pIndexes[i + 2]) * 4];
+				float da = a[2] + a[3], db = b[2] + b[3], dc = c[2] + c[3];
+				if(da >= 0.0f && db >= 0.0f && dc >= 0.0f) {
+					AddTriangle(a, b, c);
+					continue;
+					}
+				if(da < 0.0f && db < 0.0f && dc < 0.0f)
+					continue;
+
+				// Clip against the near plane (z = -w); one or two triangles are left
+				const float *pIn[3] = { a, b, c };
+				float d[3] = { da, db, dc };
+				float poly[4][4];
+				int n = 0;
+				for(int k = 0; k < 3; k++) {
+					int j = (k + 1) % 3;
+					if(d[k] >= 0.0f) {
+						poly[n][0] = pIn[k][0]; poly[n][1] = pIn[k][1]; poly[n][2] = pIn[k][2]; poly[n][3] = pIn[k][3];
+						n++;
+						}
+					if((d[k] >= 0.0f) != (d[j] >= 0.0f)) {
+						float t = d[k] / (d[k] - d[j]);
+						for(int l = 0; l < 4; l++)
+							poly[n][l] = pIn[k][l] + t * (pIn[j][l] - pIn[k][l]);
+						n++;
+						}
+					}
+				AddTriangle(poly[0], poly[1], poly[2]);
+				if(n == 4)
+					AddTriangle(poly[0], poly[2], poly[3]);
+				}
+			}
+
+		// Project, set up and bin one clip space triangle in front of the near plane
+		void AddTriangle(const float *a, const float *b, const float *c) {
+			float x[3], y[3], z[3];
+			const float *v[3] = { a, b, c };
+			for(int k = 0; k < 3; k++) {
+				z[k] = 1.0f / v[k][3];
+				x[k] = (v[k][0] * z[k] * 0.5f + 0.5f) * float(nWidth);
+				y[k] = (v[k][1] * z[k] * 0.5f + 0.5f) * float(nHeight);
+				}
+
+			float fArea = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+			if(!(fArea != 0.0f) || (bCullFace && fArea < 0.0f))
+				return;
+			if(fArea < 0.0f) {
+				float t;
+				t = x[1]; x[1] = x[2]; x[2] = t;
+				t = y[1]; y[1] = y[2]; y[2] = t;
+				t = z[1]; z[1] = z[2]; z[2] = t;
+				fArea = -fArea;
+				}
+
+			// Pixels whose centers are in the triangle's bounding box
+			float fMinX = std::min(x[0], std::min(x[1], x[2])), fMaxX = std::max(x[0], std::max(x[1], x[2]));
+			float fMinY = std::min(y[0], std::min(y[1], y[2])), fMaxY = std::max(y[0], std::max(y[1], y[2]));
+			if(fMaxX < 0.5f || fMaxY < 0.5f || fMinX > float(nWidth) - 0.5f || fMinY > float(nHeight) - 0.5f)
+				return;
+			int x0 = (fMinX > 0.5f) ? int(ceilf(fMinX - 0.5f)) : 0;
+			int y0 = (fMinY > 0.5f) ? int(ceilf(fMinY - 0.5f)) : 0;
+			int x1 = (fMaxX < float(nWidth) - 0.5f) ? int(floorf(fMaxX - 0.5f)) : nWidth - 1;
+			int y1 = (fMaxY < float(nHeight) - 0.5f) ? int(floorf(fMaxY - 0.5f)) : nHeight - 1;
+			if(x0 > x1 || y0 > y1)
+				return;
+
+			Tri tri;
+			tri.iMinY = y0;
+			tri.iMaxY = y1;
+			for(int k = 0; k < 3; k++) {
+				int j = (k + 1) % 3;
+				tri.e[k][0] = y[k] - y[j];
+				tri.e[k][1] = x[j] - x[k];
+				tri.e[k][2] = x[k] * y[j] - x[j] * y[k];
+				}
+
+			// 1/w's plane, pulled back by half a pixel's worth of slope so each
+			// pixel gets the farthest depth the triangle has anywhere in it
+			float fInvArea = 1.0f / fArea;
+			float dzdx = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) * fInvArea;
+			float dzdy = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) * fInvArea;
+			tri.z[0] = dzdx;
+			tri.z[1] = dzdy;
+			tri.z[2] = z[0] - dzdx * x[0] - dzdy * y[0] - 0.5f * (fabsf(dzdx) + fabsf(dzdy));
+
+			int iTri = int(tris.size());
+			tris.push_back(tri);
+			for(int ty = y0 / GLT_OCCLUSION_TILE; ty <= y1 / GLT_OCCLUSION_TILE; ty++)
+				for(int tx = x0 / GLT_OCCLUSION_TILE; tx <= x1 / GLT_OCCLUSION_TILE; tx++)
+					bins[ty * nTilesX + tx].push_back(iTri);
+			nBinned += (y1 / GLT_OCCLUSION_TILE - y0 / GLT_OCCLUSION_TILE + 1) * (x1 / GLT_OCCLUSION_TILE - x0 / GLT_OCCLUSION_TILE + 1);
+			}
+
+
+		///////////////////////////////////////////////////////////////////////
+		// Clear and draw tiles [iBegin, iEnd)
+		void RasterizeTiles(int iBegin, int iEnd) {
+			for(int t = iBegin; t < iEnd; t++) {
+				float *pTile = pDepth + t * GLT_OCCLUSION_TILE * GLT_OCCLUSION_TILE;
+				float fX = float((t % nTilesX) * GLT_OCCLUSION_TILE) + 0.5f;
+				int iY = (t / nTilesX) * GLT_OCCLUSION_TILE;
+				const std::vector<int>& bin = bins[t];
+				for(int i = 0; i < GLT_OCCLUSION_TILE * GLT_OCCLUSION_TILE; i++)
+					pTile[i] = 0.0f;
+				for(size_t i = 0; i < bin.size(); i++)
+					{
+					const Tri& tri = tris[bin[i]];
+					int iFrom = std::max(tri.iMinY - iY, 0);
+					int iTo = std::min(tri.iMaxY - iY, GLT_OCCLUSION_TILE - 1);
+					RasterizeTile(pTile, fX, iY, iFrom, iTo, tri);
+					}
+
+				float fMin = pTile[0];
+				for(int i = 1; i < GLT_OCCLUSION_TILE * GLT_OCCLUSION_TILE; i++)
+					fMin = std::min(fMin, pTile[i]);
+				pTileMin[t] = fMin;
+				}
+			}
+
+#ifdef M3D_SIMD_SSE2
+		// Rows iFrom to iTo of a tile whose top left pixel center is (fX, iY + 0.5).
+		// Each row is two halves of four pixels; a pixel is covered when all
+		// three edge functions are >= 0 at its center, and only covered pixels
+		// take the nearer depth.
+		void RasterizeTile(float *pTile, float fX, int iY, int iFrom, int iTo, const Tri& tri) {
+			__m128 vX0 = _mm_add_ps(_mm_set1_ps(fX), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+			__m128 vX1 = _mm_add_ps(vX0, _mm_set1_ps(4.0f));
+			__m128 vZero = _mm_setzero_ps();
+			__m128 eX0[3], eX1[3];
+			for(int k = 0; k < 3; k++) {
+				eX0[k] = _mm_mul_ps(_mm_set1_ps(tri.e[k][0]), vX0);
+				eX1[k] = _mm_mul_ps(_mm_set1_ps(tri.e[k][0]), vX1);
+				}
+			__m128 zX0 = _mm_mul_ps(_mm_set1_ps(tri.z[0]), vX0);
+			__m128 zX1 = _mm_mul_ps(_mm_set1_ps(tri.z[0]), vX1);
+
+			pTile += iFrom * GLT_OCCLUSION_TILE;
+			for(int y = iFrom; y <= iTo; y++, pTile += GLT_OCCLUSION_TILE) {
+				float fRowY = float(iY + y) + 0.5f;
+				__m128 m0 = _mm_castsi128_ps(_mm_set1_epi32(-1)), m1 = m0;
+				for(int k = 0; k < 3; k++) {
+					__m128 eY = _mm_set1_ps(tri.e[k][1] * fRowY + tri.e[k][2]);
+					m0 = _mm_and_ps(m0, _mm_cmpge_ps(_mm_add_ps(eX0[k], eY), vZero));
+					m1 = _mm_and_ps(m1, _mm_cmpge_ps(_mm_add_ps(eX1[k], eY), vZero));
+					}
+				if(_mm_movemask_ps(_mm_or_ps(m0, m1)) == 0)
+					continue;
+
+				__m128 zY = _mm_set1_ps(tri.z[1] * fRowY + tri.z[2]);
+				__m128 d0 = _mm_load_ps(pTile), d1 = _mm_load_ps(pTile + 4);
+				__m128 n0 = _mm_max_ps(d0, _mm_add_ps(zX0, zY));
+				__m128 n1 = _mm_max_ps(d1, _mm_add_ps(zX1, zY));
+				_mm_store_ps(pTile, _mm_or_ps(_mm_and_ps(m0, n0), _mm_andnot_ps(m0, d0)));
+				_mm_store_ps(pTile + 4, _mm_or_ps(_mm_and_ps(m1, n1), _mm_andnot_ps(m1, d1)));
+				}
+			}
+#else
+		void RasterizeTile(float *pTile, float fX, int iY, int iFrom, int iTo, const Tri& tri) {
+			pTile += iFrom * GLT_OCCLUSION_TILE;
+			for(int y = iFrom; y <= iTo; y++, pTile += GLT_OCCLUSION_TILE) {
+				float fRowY = float(iY + y) + 0.5f;
+				for(int x = 0; x < GLT_OCCLUSION_TILE; x++) {
+					float fColX = fX + float(x);
+					bool bIn = true;
+					for(int k = 0; k < 3; k++)
+						bIn = bIn && (tri.e[k][0] * fColX + (tri.e[k][1] * fRowY + tri.e[k][2]) >= 0.0f);
+					if(bIn)
+						pTile[x] = std::max(pTile[x], tri.z[0] * fColX + (tri.z[1] * fRowY + tri.z[2]));
+					}
+				}
+			}
+#endif
+
+		// One task of Rasterize(GLTaskPool&): tile rows [iBegin, iEnd), split in
+		// half until it is one row
+		static void RasterizeTask(void *pContext, int iBegin, int iEnd, int iParam, int iThread) {
+			GLOcclusionBuffer *pThis = (GLOcclusionBuffer *)pContext;
+			while(iEnd - iBegin > 1) {
+				int iMid = (iBegin + iEnd) / 2;
+				GLTask half = { RasterizeTask, pThis, iMid, iEnd, iParam };
+				pThis->pTaskPool->Spawn(iThread, half);
+				iEnd = iMid;
+				}
+			pThis->RasterizeTiles(iBegin * pThis->nTilesX, iEnd * pThis->nTilesX);
+			}
+
+		int							nWidth, nHeight;
+		int							nTilesX, nTilesY;
+		float						*pDepth;		// Tile by tile, each tile row by row
+		float						*pTileMin;		// Farthest depth in each tile
+		M3DMatrix44f				mViewProjection;
+		bool						bCullFace;
+		std::vector<Tri>			tris;
+		std::vector< std::vector<int> >	bins;		// Triangles overlapping each tile
+		int							nBinned;
+		std::vector<float>			clip;			// Clip space vertices of the mesh being added
+		GLTaskPool					*pTaskPool;		// For Rasterize(GLTaskPool&)
+
+	private:
+		GLOcclusionBuffer(const GLOcclusionBuffer&);
+		GLOcclusionBuffer& operator=(const GLOcclusionBuffer&);
+	};
+
+#endif
@@ -0,0 +1,463 @@
+// GLTransformHierarchy.h
+// A transform hierarchy (scene graph) in place of hand written PushMatrix/
+// PopMatrix nesting. Each node has a local transform, either a GLFrame or a
+// matrix, relative to its parent, and a world matrix that Update() works out.
+// Update() only recomputes subtrees under a node whose local transform changed;
+// everything else keeps last frame's world matrices.
+//
+// The nodes are kept in one flat array in depth first order, so a parent always
+// comes before its children and every subtree is a contiguous run. Update() is
+// one linear pass that jumps over clean subtrees, and the world matrices of a
+// subtree can be handed to GLGeometryTransform::GetModelViewProjectionMatrices
+// in one go:
+//
+//		transformPipeline.GetModelViewProjectionMatrices(scene.GetWorldMatrices() + scene.GetSlot(iNode),
+//				scene.GetSubtreeSize(iNode), mModelView, NULL);
+//
+// or one node at a time, with the existing stock shader calls:
+//
+//		scene.PushWorldMatrix(modelViewMatrix, iTorus);
+//		shaderManager.UseStockShader(GLT_SHADER_FLAT, transformPipeline.GetModelViewProjectionMatrix(), vColor);
+//		torusBatch.Draw();
+//		modelViewMatrix.PopMatrix();
+//
+// With thousands of nodes, Update(GLTaskPool&) spreads the work over threads
+// (see GLTaskPool.h) and gives the same matrices as Update().
+//
+// Nodes are named by the handle AddNode() returns. Adding nodes changes the
+// order, so slots (GetSlot) are only good until the next AddNode().
+
+#ifndef __GLT_TRANSFORM_HIERARCHY
+#define __GLT_TRANSFORM_HIERARCHY
+
+#include "GLMatrixStack.h"
+#include "GLTaskPool.h"
+
+class GLTransformHierarchy
+	{
+	public:
+		GLTransformHierarchy(void) {
+			nNodes = nCapacity = nLaidOut = 0;
+			pFrames = NULL;
+			pLocal = pWorld = NULL;
+			pParent = pEnd = pSlot = pHandle = NULL;
+			pFlags = NULL;
+			bLayoutDirty = false;
+			pTaskPool = NULL;
+			pCounters = NULL;
+			nCounters = nTaskGrain = 0;
+			}
+
+		~GLTransformHierarchy(void) {
+			Free();
+			m3dAlignedFree(pCounters);
+			}
+
+		// Add a node under iParent (a handle, or -1 for a root). The new node's
+		// local transform is the identity frame.
+		int AddNode(int iParent = -1) {
+			if(nNodes == nCapacity)
+				Reserve((nCapacity < 64) ? 64 : nCapacity * 2);
+
+			// New nodes go on the end in handle order; Layout() sorts them in later
+			int h = nNodes++;
+			pSlot[h] = h;
+			pHandle[h] = h;
+			pParent[h] = iParent;
+			pFrames[h] = GLFrame();
+			pFlags[h] = GLT_NODE_LOCAL_DIRTY | GLT_NODE_SUBTREE_DIRTY;
+			bLayoutDirty = true;
+			return h;
+			}
+
+		int AddNode(const GLFrame& frame, int iParent = -1) {
+			int h = AddNode(iParent);
+			pFrames[h] = frame;
+			return h;
+			}
+
+		// Make room for nNewCapacity nodes up front
+		void Reserve(int nNewCapacity) {
+			if(nNewCapacity <= nCapacity)
+				return;
+			Layout();
+
+			GLFrame *pNewFrames = new GLFrame[nNewCapacity];
+			M3DMatrix44f *pNewLocal = (M3DMatrix44f *)m3dAlignedAlloc(sizeof(M3DMatrix44f) * 2 * nNewCapacity, 64);
+			int *pNewInts = new int[nNewCapacity * 4];
+			unsigned char *pNewFlags = new unsigned char[nNewCapacity];
+
+			for(int i = 0; i < nNodes; i++)
+				pNewFrames[i] = pFrames[i];
+			if(nNodes > 0) {
+				memcpy(pNewLocal, pLocal, sizeof(M3DMatrix44f) * nNodes);
+				memcpy(pNewLocal + nNewCapacity, pWorld, sizeof(M3DMatrix44f) * nNodes);
+				memcpy(pNewInts, pParent, sizeof(int) * nNodes);
+				memcpy(pNewInts + nNewCapacity, pEnd, sizeof(int) * nNodes);
+				memcpy(pNewInts + nNewCapacity * 2, pSlot, sizeof(int) * nNodes);
+				memcpy(pNewInts + nNewCapacity * 3, pHandle, sizeof(int) * nNodes);
+				memcpy(pNewFlags, pFlags, nNodes);
+				}
+			int nKeep = nNodes;
+			Free();
+			nNodes = nLaidOut = nKeep;
+
+			pFrames = pNewFrames;
+			pLocal = pNewLocal;
+			pWorld = pNewLocal + nNewCapacity;
+			pParent = pNewInts;
+			pEnd = pNewInts + nNewCapacity;
+			pSlot = pNewInts + nNewCapacity * 2;
+			pHandle = pNewInts + nNewCapacity * 3;
+			pFlags = pNewFlags;
+			nCapacity = nNewCapacity;
+			}
+
+
+		///////////////////////////////////////////////////////////////////////
+		// Local transforms. Anything that changes one marks the node dirty.
+		inline const GLFrame& GetFrame(int iNode) { Layout(); return pFrames[pSlot[iNode]]; }
+
+		// Change the frame in place, e.g. EditFrame(iNode).RotateLocalY(fAngle).
+		// The reference is only good until the next AddNode().
+		inline GLFrame& EditFrame(int iNode) {
+			Layout();
+			int s = pSlot[iNode];
+			pFlags[s] &= ~GLT_NODE_USE_MATRIX;
+			MarkDirtySlot(s);
+			return pFrames[s];
+			}
+
+		inline void SetFrame(int iNode, const GLFrame& frame) { EditFrame(iNode) = frame; }
+
+		// A local matrix instead of a frame, for scales or anything else a frame
+		// can't describe. Used until the next EditFrame/SetFrame.
+		void SetLocalMatrix(int iNode, const M3DMatrix44f mLocal) {
+			Layout();
+			int s = pSlot[iNode];
+			m3dCopyMatrix44(pLocal[s], mLocal);
+			pFlags[s] |= GLT_NODE_USE_MATRIX;
+			MarkDirtySlot(s);
+			}
+
+		// For anything changed behind the hierarchy's back
+		inline void MarkDirty(int iNode) { Layout(); MarkDirtySlot(pSlot[iNode]); }
+
+
+		///////////////////////////////////////////////////////////////////////
+		// Recompute the world matrix of every node under a changed node. Clean
+		// subtrees are skipped without looking at their nodes. Returns how many
+		// world matrices were recomputed.
+		int Update(void) {
+			Layout();
+			return UpdateDirty(0, nNodes);
+			}
+
+		// The same update spread over a GLTaskPool. Subtrees bigger than nGrain
+		// nodes are split: the subtree's root is done first, then its children's
+		// subtrees become tasks of their own, so parents are always finished
+		// before their children start. Small sibling subtrees are batched into
+		// tasks of about nGrain nodes. Every world matrix comes from the same
+		// multiply of the same two matrices as in Update(), so the result is
+		// identical whatever the thread count.
+		int Update(GLTaskPool& pool, int nGrain = 4096) {
+			Layout();
+			int nThreads = pool.GetThreadCount();
+			if(nThreads == 1 || nNodes <= nGrain * 2)
+				return UpdateDirty(0, nNodes);
+
+			// One counter per thread, each on its own cache line
+			if(nThreads > nCounters) {
+				m3dAlignedFree(pCounters);
+				pCounters = (int *)m3dAlignedAlloc(64 * nThreads, 64);
+				nCounters = nThreads;
+				}
+			for(int t = 0; t < nThreads; t++)
+				pCounters[t * 16] = 0;
+
+			pTaskPool = &pool;
+			nTaskGrain = (nGrain < 1) ? 1 : nGrain;
+			GLTask task = { UpdateTask, this, 0, nNodes, 0 };
+			pool.Run(task);
+			pTaskPool = NULL;
+
+			int nUpdated = 0;
+			for(int t = 0; t < nThreads; t++)
+				nUpdated += pCounters[t * 16];
+			return nUpdated;
+			}
+
+		inline const M3DMatrix44f& GetWorldMatrix(int iNode) { Layout(); return pWorld[pSlot[iNode]]; }
+		inline const M3DMatrix44f& GetLocalMatrix(int iNode) { Layout(); return pLocal[pSlot[iNode]]; }
+
+		// Push the current top of modelView times the node's world matrix, the
+		// same as PushMatrix() and then the chain of transforms down to the node
+		void PushWorldMatrix(GLMatrixStack& modelView, int iNode) {
+			modelView.PushMatrix();
+			modelView.MultMatrix(GetWorldMatrix(iNode));
+			}
+
+
+		///////////////////////////////////////////////////////////////////////
+		// The flat arrays. A node's subtree is GetSubtreeSize() entries starting
+		// at its slot, the node itself first.
+		inline int GetCount(void) const { return nNodes; }
+		inline int GetParent(int iNode) { Layout(); return pParent[pSlot[iNode]] < 0 ? -1 : pHandle[pParent[pSlot[iNode]]]; }
+		inline int GetSlot(int iNode) { Layout(); return pSlot[iNode]; }
+		inline int GetSubtreeSize(int iNode) { Layout(); return pEnd[pSlot[iNode]] - pSlot[iNode]; }
+		inline const M3DMatrix44f *GetWorldMatrices(void) { Layout(); return pWorld; }
+
+	protected:
+		enum { GLT_NODE_LOCAL_DIRTY = 1,		// Local transform changed
+			   GLT_NODE_SUBTREE_DIRTY = 2,		// Something below changed
+			   GLT_NODE_USE_MATRIX = 4 };		// pLocal was set directly, not from the frame
+
+		// Flag the node, and mark the way down to it from the root
+		void MarkDirtySlot(int s) {
+			pFlags[s] |= GLT_NODE_LOCAL_DIRTY;
+			for(int p = pParent[s]; p >= 0 && (pFlags[p] & GLT_NODE_SUBTREE_DIRTY) == 0; p = pParent[p])
+				pFlags[p] |= GLT_NODE_SUBTREE_DIRTY;
+			}
+
+		// [iBegin, iEnd) is a run of whole subtrees whose parents are up to date
+		int UpdateDirty(int iBegin, int iEnd) {
+			int nUpdated = 0;
+			int i = iBegin;
+			while(i < iEnd) {
+				unsigned char flags = pFlags[i];
+				if((flags & (GLT_NODE_LOCAL_DIRTY | GLT_NODE_SUBTREE_DIRTY)) == 0) {
+					i = pEnd[i];		// Nothing under here changed
+					continue;
+					}
+
+				if((flags & GLT_NODE_LOCAL_DIRTY) == 0) {
+					pFlags[i] = flags & ~GLT_NODE_SUBTREE_DIRTY;	// Something further down changed
+					i++;
+					continue;
+					}
+
+				// This node changed, so every world matrix under it changes too
+				int nEnd = pEnd[i];
+				UpdateRange(i, nEnd);
+				nUpdated += nEnd - i;
+				i = nEnd;
+				}
+			return nUpdated;
+			}
+
+		// One task of Update(GLTaskPool&): a run of whole subtrees, all of them
+		// updated if iParam is set (an ancestor changed), else the dirty ones
+		static void UpdateTask(void *pContext, int iBegin, int iEnd, int iParam, int iThread) {
+			GLTransformHierarchy *pThis = (GLTransformHierarchy *)pContext;
+			pThis->pCounters[iThread * 16] += pThis->UpdateRun(iBegin, iEnd, iParam != 0, iThread);
+			}
+
+		int UpdateRun(int iBegin, int iEnd, bool bAll, int iThread) {
+			if(iEnd - iBegin <= nTaskGrain * 2) {
+				if(!bAll)
+					return UpdateDirty(iBegin, iEnd);
+				UpdateRange(iBegin, iEnd);
+				return iEnd - iBegin;
+				}
+
+			int nUpdated = 0;
+			int iBatch = iBegin;	// Small subtrees not handed out yet start here
+			int r = iBegin;
+			while(r < iEnd) {
+				int rEnd = pEnd[r];
+				if(rEnd - r <= nTaskGrain) {
+					r = rEnd;
+					if(r - iBatch >= nTaskGrain) {
+						GLTask batch = { UpdateTask, this, iBatch, r, bAll };
+						pTaskPool->Spawn(iThread, batch);
+						iBatch = r;
+						}
+					continue;
+					}
+
+				if(iBatch < r) {
+					GLTask batch = { UpdateTask, this, iBatch, r, bAll };
+					pTaskPool->Spawn(iThread, batch);
+					}
+
+				// A big subtree: its root here, then its children as another task
+				unsigned char flags = pFlags[r];
+				bool bChildren = bAll || (flags & GLT_NODE_LOCAL_DIRTY) != 0;
+				if(bChildren) {
+					UpdateRange(r, r + 1);
+					nUpdated++;
+					}
+				else if(flags & GLT_NODE_SUBTREE_DIRTY)
+					pFlags[r] = flags & ~GLT_NODE_SUBTREE_DIRTY;
+				else {
+					r = iBatch = rEnd;		// Clean
+					continue;
+					}
+
+				GLTask children = { UpdateTask, this, r + 1, rEnd, bChildren };
+				pTaskPool->Spawn(iThread, children);
+				r = iBatch = rEnd;
+				}
+
+			// Whatever is left is less than a task's worth
+			if(iBatch < iEnd && bAll) {
+				UpdateRange(iBatch, iEnd);
+				nUpdated += iEnd - iBatch;
+				}
+			else if(iBatch < iEnd)
+				nUpdated += UpdateDirty(iBatch, iEnd);
+			return nUpdated;
+			}
+
+		// Parents come first, so one pass in slot order is enough
+		void UpdateRange(int iBegin, int iEnd) {
+			for(int j = iBegin; j < iEnd; j++) {
+				unsigned char flags = pFlags[j];
+				if((flags & (GLT_NODE_LOCAL_DIRTY | GLT_NODE_USE_MATRIX)) == GLT_NODE_LOCAL_DIRTY)
+					pFrames[j].GetMatrix(pLocal[j]);
+
+				int p = pParent[j];
+				if(p >= 0)
+					m3dFastMatrixMultiply44(pWorld[j], pWorld[p], pLocal[j]);
+				else
+					m3dCopyMatrix44(pWorld[j], pLocal[j]);
+				pFlags[j] = flags & GLT_NODE_USE_MATRIX;
+				}
+			}
+
+		// Put the nodes in depth first order. Until this runs, nodes added since
+		// the last layout are in handle order and pParent holds handles.
+		void Layout(void) {
+			if(!bLayoutDirty)
+				return;
+			bLayoutDirty = false;
+
+			// Parents as handles for every node
+			int *pParentHandle = new int[nNodes];
+			for(int s = 0; s < nNodes; s++) {
+				int h = pHandle[s];
+				int p = pParent[s];
+				// Old nodes store their parent's slot, new ones (slot == handle,
+				// appended since the last layout) already store a handle
+				pParentHandle[h] = (p < 0 || s >= nLaidOut) ? p : pHandle[p];
+				}
+
+			// Children of each handle as linked lists, kept in handle order
+			int *pFirstChild = new int[nNodes * 3];
+			int *pNextSibling = pFirstChild + nNodes;
+			int *pOrder = pFirstChild + nNodes * 2;
+			for(int h = 0; h < nNodes; h++)
+				pFirstChild[h] = -1;
+			for(int h = nNodes - 1; h >= 0; h--) {
+				int p = pParentHandle[h];
+				if(p >= 0) {
+					pNextSibling[h] = pFirstChild[p];
+					pFirstChild[p] = h;
+					}
+				}
+
+			// Depth first, roots in handle order, into pOrder
+			int nOut = 0;
+			int *pStack = new int[nNodes];
+			for(int r = 0; r < nNodes; r++) {
+				if(pParentHandle[r] >= 0)
+					continue;
+				int nStack = 0;
+				pStack[nStack++] = r;
+				while(nStack > 0) {
+					int h = pStack[--nStack];
+					pOrder[nOut++] = h;
+					// Push children in reverse so the first child comes out first
+					int nFirst = nStack;
+					for(int c = pFirstChild[h]; c >= 0; c = pNextSibling[c])
+						pStack[nStack++] = c;
+					for(int a = nFirst, b = nStack - 1; a < b; a++, b--) {
+						int t = pStack[a]; pStack[a] = pStack[b]; pStack[b] = t;
+						}
+					}
+				}
+			delete [] pStack;
+
+			// Move everything into the new order
+			GLFrame *pNewFrames = new GLFrame[nCapacity];
+			M3DMatrix44f *pNewLocal = (M3DMatrix44f *)m3dAlignedAlloc(sizeof(M3DMatrix44f) * 2 * nCapacity, 64);
+			unsigned char *pNewFlags = new unsigned char[nCapacity];
+			for(int s = 0; s < nNodes; s++) {
+				int hOld = pOrder[s];
+				int sOld = pSlot[hOld];
+				pNewFrames[s] = pFrames[sOld];
+				m3dCopyMatrix44(pNewLocal[s], pLocal[sOld]);
+				m3dCopyMatrix44(pNewLocal[nCapacity + s], pWorld[sOld]);
+				pNewFlags[s] = pFlags[sOld];
+				}
+			for(int s = 0; s < nNodes; s++)
+				pSlot[pOrder[s]] = s;
+			for(int s = 0; s < nNodes; s++) {
+				int h = pOrder[s];
+				pHandle[s] = h;
+				pParent[s] = (pParentHandle[h] < 0) ? -1 : pSlot[pParentHandle[h]];
+				}
+
+			// Subtree ends, children before parents
+			for(int s = 0; s < nNodes; s++)
+				pEnd[s] = s + 1;
+			for(int s = nNodes - 1; s > 0; s--)
+				if(pParent[s] >= 0 && pEnd[s] > pEnd[pParent[s]])
+					pEnd[pParent[s]] = pEnd[s];
+
+			delete [] pFrames;
+			m3dAlignedFree(pLocal);
+			delete [] pFlags;
+			pFrames = pNewFrames;
+			pLocal = pNewLocal;
+			pWorld = pNewLocal + nCapacity;
+			pFlags = pNewFlags;
+
+			// New nodes still need their world matrices, so mark the way to them
+			for(int s = 0; s < nNodes; s++)
+				if(pFlags[s] & GLT_NODE_LOCAL_DIRTY)
+					MarkDirtySlot(s);
+
+			nLaidOut = nNodes;
+			delete [] pFirstChild;
+			delete [] pParentHandle;
+			}
+
+		void Free(void) {
+			delete [] pFrames;
+			m3dAlignedFree(pLocal);
+			delete [] pParent;
+			delete [] pFlags;
+			pFrames = NULL;
+			pLocal = pWorld = NULL;
+			pParent = pEnd = pSlot = pHandle = NULL;
+			pFlags = NULL;
+			nNodes = nCapacity = nLaidOut = 0;
+			}
+
+		// Everything is by slot except pSlot, which maps handles to slots
+		int				nNodes;
+		int				nCapacity;
+		int				nLaidOut;		// Nodes that were there at the last Layout()
+		bool			bLayoutDirty;
+		GLFrame			*pFrames;
+		M3DMatrix44f	*pLocal;		// Local and world matrices share one 64 byte aligned block
+		M3DMatrix44f	*pWorld;
+		int				*pParent;		// Parent slot, or -1 for a root
+		int				*pEnd;			// One past the last slot of the subtree
+		int				*pSlot;
+		int				*pHandle;
+		unsigned char	*pFlags;
+
+		// For Update(GLTaskPool&)
+		GLTaskPool		*pTaskPool;
+		int				nTaskGrain;
+		int				*pCounters;		// Nodes updated, per thread, 64 bytes apart
+		int				nCounters;
+
+	private:
+		GLTransformHierarchy(const GLTransformHierarchy&);
+		GLTransformHierarchy& operator=(const GLTransformHierarchy&);
+	};
+
+#endif
@@ -84,6 +84,15 @@ typedef float M3DMatrix44f[16];		// A 4 X 4 matrix, column major (floats) - Open
 typedef double M3DMatrix44d[16];	// A 4 x 4 matrix, column major (doubles) - OpenGL style
 
 
+// 3x4 affine matrix - row major. The top three rows of a 4x4 whose bottom row
+// is always 0, 0, 0, 1, so it is 25% smaller. Each row is one SIMD register,
+// and three rows are what a shader needs per instance (three vec4 attributes).
+//	0	1	2	3
+//	4	5	6	7
+//	8	9	10	11
+typedef float M3DMatrix34f[12];		// A 3 x 4 affine matrix, row major (floats)
+
+
 ///////////////////////////////////////////////////////////////////////////////
 // Useful constants
 #define M3D_PI (3.14159265358979323846)
@@ -521,6 +530,156 @@ inline void m3dTranslationMatrix44(M3DMatrix44d m, double x, double y, double z)
 void m3dInvertMatrix44(M3DMatrix44f mInverse, const M3DMatrix44f m);
 void m3dInvertMatrix44(M3DMatrix44d mInverse, const M3DMatrix44d m);
 
+///////////////////////////////////////////////////////////////////////////////
+// Inverse of an affine matrix (bottom row is 0, 0, 0, 1). The upper 3x3 is
+// inverted by cofactors, and the translation is just carried through it. This is
+// about a third of the work of the general inverse above.
+// mInverse may be the same matrix as m.
+inline void m3dInvertAffine44(M3DMatrix44f mInverse, const M3DMatrix44f m)
+	{
+	// Rows of the inverse are the cross products of the columns
+	M3DVector3f r0, r1, r2, t;
+	m3dCrossProduct3(r0, m + 4, m + 8);
+	m3dCrossProduct3(r1, m + 8, m);
+	m3dCrossProduct3(r2, m, m + 4);
+	m3dCopyVector3(t, m + 12);
+
+	float fInvDet = 1.0f / m3dDotProduct3(m, r0);
+	m3dScaleVector3(r0, fInvDet);
+	m3dScaleVector3(r1, fInvDet);
+	m3dScaleVector3(r2, fInvDet);
+
+	mInverse[0] = r0[0]; mInverse[4] = r0[1]; mInverse[8]  = r0[2]; mInverse[12] = -m3dDotProduct3(r0, t);
+	mInverse[1] = r1[0]; mInverse[5] = r1[1]; mInverse[9]  = r1[2]; mInverse[13] = -m3dDotProduct3(r1, t);
+	mInverse[2] = r2[0]; mInverse[6] = r2[1]; mInverse[10] = r2[2]; mInverse[14] = -m3dDotProduct3(r2, t);
+	mInverse[3] = 0.0f;  mInverse[7] = 0.0f;  mInverse[11] = 0.0f;  mInverse[15] = 1.0f;
+	}
+
+// Ditto above, but for doubles
+inline void m3dInvertAffine44(M3DMatrix44d mInverse, const M3DMatrix44d m)
+	{
+	M3DVector3d r0, r1, r2, t;
+	m3dCrossProduct3(r0, m + 4, m + 8);
+	m3dCrossProduct3(r1, m + 8, m);
+	m3dCrossProduct3(r2, m, m + 4);
+	m3dCopyVector3(t, m + 12);
+
+	double dInvDet = 1.0 / m3dDotProduct3(m, r0);
+	m3dScaleVector3(r0, dInvDet);
+	m3dScaleVector3(r1, dInvDet);
+	m3dScaleVector3(r2, dInvDet);
+
+	mInverse[0] = r0[0]; mInverse[4] = r0[1]; mInverse[8]  = r0[2]; mInverse[12] = -m3dDotProduct3(r0, t);
+	mInverse[1] = r1[0]; mInverse[5] = r1[1]; mInverse[9]  = r1[2]; mInverse[13] = -m3dDotProduct3(r1, t);
+	mInverse[2] = r2[0]; mInverse[6] = r2[1]; mInverse[10] = r2[2]; mInverse[14] = -m3dDotProduct3(r2, t);
+	mInverse[3] = 0.0;   mInverse[7] = 0.0;   mInverse[11] = 0.0;   mInverse[15] = 1.0;
+	}
+
+// Inverse of a rigid body matrix (orthonormal rotation plus translation), like
+// the ones GLFrame makes. The rotation is transposed and the translation is
+// rotated back the other way. mInverse may be the same matrix as m.
+inline void m3dInvertRigid44(M3DMatrix44f mInverse, const M3DMatrix44f m)
+	{
+	M3DVector3f x, y, z, t;
+	m3dCopyVector3(x, m);
+	m3dCopyVector3(y, m + 4);
+	m3dCopyVector3(z, m + 8);
+	m3dCopyVector3(t, m + 12);
+
+	mInverse[0] = x[0]; mInverse[4] = x[1]; mInverse[8]  = x[2]; mInverse[12] = -m3dDotProduct3(x, t);
+	mInverse[1] = y[0]; mInverse[5] = y[1]; mInverse[9]  = y[2]; mInverse[13] = -m3dDotProduct3(y, t);
+	mInverse[2] = z[0]; mInverse[6] = z[1]; mInverse[10] = z[2]; mInverse[14] = -m3dDotProduct3(z, t);
+	mInverse[3] = 0.0f; mInverse[7] = 0.0f; mInverse[11] = 0.0f; mInverse[15] = 1.0f;
+	}
+
+// Ditto above, but for doubles
+inline void m3dInvertRigid44(M3DMatrix44d mInverse, const M3DMatrix44d m)
+	{
+	M3DVector3d x, y, z, t;
+	m3dCopyVector3(x, m);
+	m3dCopyVector3(y, m + 4);
+	m3dCopyVector3(z, m + 8);
+	m3dCopyVector3(t, m + 12);
+
+	mInverse[0] = x[0]; mInverse[4] = x[1]; mInverse[8]  = x[2]; mInverse[12] = -m3dDotProduct3(x, t);
+	mInverse[1] = y[0]; mInverse[5] = y[1]; mInverse[9]  = y[2]; mInverse[13] = -m3dDotProduct3(y, t);
+	mInverse[2] = z[0]; mInverse[6] = z[1]; mInverse[10] = z[2]; mInverse[14] = -m3dDotProduct3(z, t);
+	mInverse[3] = 0.0;  mInverse[7] = 0.0;  mInverse[11] = 0.0;  mInverse[15] = 1.0;
+	}
+
+// True if the bottom row is 0, 0, 0, 1, so m3dInvertAffine44 can be used
+inline bool m3dIsAffine44(const M3DMatrix44f m)
+	{ return m[3] == 0.0f && m[7] == 0.0f && m[11] == 0.0f && m[15] == 1.0f; }
+
+inline bool m3dIsAffine44(const M3DMatrix44d m)
+	{ return m[3] == 0.0 && m[7] == 0.0 && m[11] == 0.0 && m[15] == 1.0; }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// 3x4 affine matrices (see M3DMatrix34f). Multiplies live in math3dSIMD.h.
+inline void m3dLoadIdentity34(M3DMatrix34f m)
+	{
+	static const M3DMatrix34f identity = { 1.0f, 0.0f, 0.0f, 0.0f,
+										   0.0f, 1.0f, 0.0f, 0.0f,
+										   0.0f, 0.0f, 1.0f, 0.0f };
+	memcpy(m, identity, sizeof(M3DMatrix34f));
+	}
+
+inline void m3dCopyMatrix34(M3DMatrix34f dst, const M3DMatrix34f src)
+	{ memcpy(dst, src, sizeof(M3DMatrix34f)); }
+
+// To and from the column major 4x4. The bottom row of m is dropped, so m
+// should be affine (m3dIsAffine44).
+inline void m3dMatrix44ToAffine34(M3DMatrix34f a, const M3DMatrix44f m)
+	{
+	a[0] = m[0]; a[1] = m[4]; a[2]  = m[8];  a[3]  = m[12];
+	a[4] = m[1]; a[5] = m[5]; a[6]  = m[9];  a[7]  = m[13];
+	a[8] = m[2]; a[9] = m[6]; a[10] = m[10]; a[11] = m[14];
+	}
+
+inline void m3dAffine34ToMatrix44(M3DMatrix44f m, const M3DMatrix34f a)
+	{
+	m[0] = a[0]; m[4] = a[1]; m[8]  = a[2];  m[12] = a[3];
+	m[1] = a[4]; m[5] = a[5]; m[9]  = a[6];  m[13] = a[7];
+	m[2] = a[8]; m[6] = a[9]; m[10] = a[10]; m[14] = a[11];
+	m[3] = 0.0f; m[7] = 0.0f; m[11] = 0.0f;  m[15] = 1.0f;
+	}
+
+// Transform a point (w = 1) by a 3x4 matrix
+inline void m3dTransformVector34(M3DVector3f vOut, const M3DVector3f v, const M3DMatrix34f m)
+	{
+	float x = v[0], y = v[1], z = v[2];
+	vOut[0] = m[0] * x + m[1] * y + m[2]  * z + m[3];
+	vOut[1] = m[4] * x + m[5] * y + m[6]  * z + m[7];
+	vOut[2] = m[8] * x + m[9] * y + m[10] * z + m[11];
+	}
+
+// Same as m3dInvertAffine44. The rows of the 3x3 part are the columns of the
+// 4x4 version, so the cross products swap over. mInverse may be the same matrix as m.
+inline void m3dInvertAffine34(M3DMatrix34f mInverse, const M3DMatrix34f m)
+	{
+	M3DVector3f c0, c1, c2, t;
+	c0[0] = m[0]; c0[1] = m[4]; c0[2] = m[8];
+	c1[0] = m[1]; c1[1] = m[5]; c1[2] = m[9];
+	c2[0] = m[2]; c2[1] = m[6]; c2[2] = m[10];
+	t[0] = m[3]; t[1] = m[7]; t[2] = m[11];
+
+	// Rows of the inverse are the cross products of the columns
+	M3DVector3f r0, r1, r2;
+	m3dCrossProduct3(r0, c1, c2);
+	m3dCrossProduct3(r1, c2, c0);
+	m3dCrossProduct3(r2, c0, c1);
+
+	float fInvDet = 1.0f / m3dDotProduct3(c0, r0);
+	m3dScaleVector3(r0, fInvDet);
+	m3dScaleVector3(r1, fInvDet);
+	m3dScaleVector3(r2, fInvDet);
+
+	mInverse[0] = r0[0]; mInverse[1] = r0[1]; mInverse[2]  = r0[2]; mInverse[3]  = -m3dDotProduct3(r0, t);
+	mInverse[4] = r1[0]; mInverse[5] = r1[1]; mInverse[6]  = r1[2]; mInverse[7]  = -m3dDotProduct3(r1, t);
+	mInverse[8] = r2[0]; mInverse[9] = r2[1]; mInverse[10] = r2[2]; mInverse[11] = -m3dDotProduct3(r2, t);
+	}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
@@ -600,4 +759,222 @@ double m3dClosestPointOnRay(M3DVector3d vPointOnRay, const M3DVector3d vRayOrigi
 float m3dClosestPointOnRay(M3DVector3f vPointOnRay, const M3DVector3f vRayOrigin, const M3DVector3f vUnitRayDir, 
 							const M3DVector3f vPointInSpace);
 
+/////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
+// Fast sine and cosine
+// Both at once, with the reduction done once. The angle is reduced to
+// [-pi/4, pi/4] with a three part pi/2, then short minimax polynomials are
+// used. For |fAngle| < 8192 the error is at most 1.2e-7 absolute, which is
+// about one float ulp of the result. Past that the reduction loses accuracy.
+// m3dSinCosStream in math3dSIMD.h does the same thing 4 or 8 at a time and
+// gives the same bits.
+#define M3D_2_DIV_PI_F		0.636619772367581f
+#define M3D_PI_DIV_2_F_A	1.5703125f
+#define M3D_PI_DIV_2_F_B	4.837512969970703125e-4f
+#define M3D_PI_DIV_2_F_C	7.54978995489188216e-8f
+
+// The two polynomials, only good on [-pi/4, pi/4]
+inline float m3dSinPoly(float x, float x2)
+	{ return ((-1.9515295891e-4f * x2 + 8.3321608736e-3f) * x2 - 1.6666654611e-1f) * x2 * x + x; }
+
+inline float m3dCosPoly(float x2)
+	{ return ((2.443315711809948e-5f * x2 - 1.388731625493765e-3f) * x2 + 4.166664568298827e-2f) * x2 * x2 - 0.5f * x2 + 1.0f; }
+
+inline void m3dSinCos(float fAngle, float &fSin, float &fCos)
+	{
+	float k = nearbyintf(fAngle * M3D_2_DIV_PI_F);
+	float x = ((fAngle - k * M3D_PI_DIV_2_F_A) - k * M3D_PI_DIV_2_F_B) - k * M3D_PI_DIV_2_F_C;
+	float x2 = x * x;
+	float s = m3dSinPoly(x, x2);
+	float c = m3dCosPoly(x2);
+
+	// Quadrant
+	int q = int(k) & 3;
+	if(q & 1) { float t = s; s = c; c = -t; }
+	if(q & 2) { s = -s; c = -c; }
+	fSin = s;
+	fCos = c;
+	}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Sines and cosines of nCount evenly spaced angles, fStart + i * fStep, by
+// rotating one step at a time instead of calling sin/cos for every angle.
+// The rotation is carried in double precision, so the error stays below 1e-7
+// (one float ulp) even for millions of steps. Pass fStep = M3D_2PI / n for
+// the n points of a circle. Either output may be NULL.
+inline void m3dMakeRing(float *pSin, float *pCos, int nCount, double fStart, double fStep)
+	{
+	double s = sin(fStart), c = cos(fStart);
+	double ds = sin(fStep), dc = cos(fStep);
+
+	for(int i = 0; i < nCount; i++)
+		{
+		if(pSin) pSin[i] = float(s);
+		if(pCos) pCos[i] = float(c);
+
+		double t = s * dc + c * ds;
+		c = c * dc - s * ds;
+		s = t;
+		}
+	}
+
+
+/////////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
+// Quaternions
+// Stored (x, y, z, w), with w the scalar part, so they line up with an
+// M3DVector4f. Only unit quaternions are rotations, and all of these assume
+// unit length unless noted. Only a floating point implementation is provided.
+typedef float	M3DQuaternion[4];
+
+inline void m3dQuatLoadIdentity(M3DQuaternion q)
+	{ q[0] = 0.0f; q[1] = 0.0f; q[2] = 0.0f; q[3] = 1.0f; }
+
+inline void m3dQuatConjugate(M3DQuaternion r, const M3DQuaternion q)
+	{ r[0] = -q[0]; r[1] = -q[1]; r[2] = -q[2]; r[3] = q[3]; }
+
+// Rotation of fAngle radians around (x, y, z). The axis does not need to be unit length.
+inline void m3dQuatFromAxisAngle(M3DQuaternion q, float fAngle, float x, float y, float z)
+	{
+	float fMag = sqrtf(x*x + y*y + z*z);
+	if(fMag == 0.0f) {
+		m3dQuatLoadIdentity(q);
+		return;
+		}
+
+	float fScale = sinf(fAngle * 0.5f) / fMag;
+	q[0] = x * fScale;
+	q[1] = y * fScale;
+	q[2] = z * fScale;
+	q[3] = cosf(fAngle * 0.5f);
+	}
+
+// r = a * b, the rotation b followed by the rotation a (same order as m3dMatrixMultiply44).
+// r may be the same as a or b.
+inline void m3dQuatMultiply(M3DQuaternion r, const M3DQuaternion a, const M3DQuaternion b)
+	{
+	float x = a[3]*b[0] + a[0]*b[3] + a[1]*b[2] - a[2]*b[1];
+	float y = a[3]*b[1] - a[0]*b[2] + a[1]*b[3] + a[2]*b[0];
+	float z = a[3]*b[2] + a[0]*b[1] - a[1]*b[0] + a[2]*b[3];
+	float w = a[3]*b[3] - a[0]*b[0] - a[1]*b[1] - a[2]*b[2];
+	r[0] = x; r[1] = y; r[2] = z; r[3] = w;
+	}
+
+// Works on any quaternion, and is cheap enough to call after every multiply
+inline void m3dQuatNormalize(M3DQuaternion q)
+	{
+	float fScale = 1.0f / sqrtf(q[0]*q[0] + q[1]*q[1] + q[2]*q[2] + q[3]*q[3]);
+	q[0] *= fScale; q[1] *= fScale; q[2] *= fScale; q[3] *= fScale;
+	}
+
+// Rotate a vector, v' = v + 2w(u x v) + 2u x (u x v). 15 multiplies, no matrix.
+// vOut may be the same as v.
+inline void m3dQuatRotateVector(M3DVector3f vOut, const M3DQuaternion q, const M3DVector3f v)
+	{
+	M3DVector3f t, c;
+	m3dCrossProduct3(t, q, v);
+	t[0] += t[0]; t[1] += t[1]; t[2] += t[2];
+	m3dCrossProduct3(c, q, t);
+	vOut[0] = v[0] + q[3] * t[0] + c[0];
+	vOut[1] = v[1] + q[3] * t[1] + c[1];
+	vOut[2] = v[2] + q[3] * t[2] + c[2];
+	}
+
+// The three columns of the rotation matrix, without building the matrix
+inline void m3dQuatGetAxes(M3DVector3f vX, M3DVector3f vY, M3DVector3f vZ, const M3DQuaternion q)
+	{
+	float x2 = q[0] + q[0], y2 = q[1] + q[1], z2 = q[2] + q[2];
+	float xx = q[0] * x2, yy = q[1] * y2, zz = q[2] * z2;
+	float xy = q[0] * y2, xz = q[0] * z2, yz = q[1] * z2;
+	float wx = q[3] * x2, wy = q[3] * y2, wz = q[3] * z2;
+
+	if(vX) { vX[0] = 1.0f - (yy + zz); vX[1] = xy + wz; vX[2] = xz - wy; }
+	if(vY) { vY[0] = xy - wz; vY[1] = 1.0f - (xx + zz); vY[2] = yz + wx; }
+	if(vZ) { vZ[0] = xz + wy; vZ[1] = yz - wx; vZ[2] = 1.0f - (xx + yy); }
+	}
+
+inline void m3dQuatToMatrix33(M3DMatrix33f m, const M3DQuaternion q)
+	{ m3dQuatGetAxes(m, m + 3, m + 6, q); }
+
+inline void m3dQuatToMatrix44(M3DMatrix44f m, const M3DQuaternion q)
+	{
+	m3dQuatGetAxes(m, m + 4, m + 8, q);
+	m[3] = 0.0f; m[7] = 0.0f; m[11] = 0.0f;
+	m[12] = 0.0f; m[13] = 0.0f; m[14] = 0.0f; m[15] = 1.0f;
+	}
+
+// Rotation from three orthonormal axes (the columns of a rotation matrix).
+// Picks the largest diagonal term to divide by, so it is stable for any rotation.
+inline void m3dQuatFromAxes(M3DQuaternion q, const M3DVector3f vX, const M3DVector3f vY, const M3DVector3f vZ)
+	{
+	float fTrace = vX[0] + vY[1] + vZ[2];
+	float s;
+
+	if(fTrace > 0.0f) {
+		s = 0.5f / sqrtf(fTrace + 1.0f);
+		q[3] = 0.25f / s;
+		q[0] = (vY[2] - vZ[1]) * s;
+		q[1] = (vZ[0] - vX[2]) * s;
+		q[2] = (vX[1] - vY[0]) * s;
+		}
+	else if(vX[0] > vY[1] && vX[0] > vZ[2]) {
+		s = 2.0f * sqrtf(1.0f + vX[0] - vY[1] - vZ[2]);
+		q[3] = (vY[2] - vZ[1]) / s;
+		q[0] = 0.25f * s;
+		q[1] = (vY[0] + vX[1]) / s;
+		q[2] = (vZ[0] + vX[2]) / s;
+		}
+	else if(vY[1] > vZ[2]) {
+		s = 2.0f * sqrtf(1.0f + vY[1] - vX[0] - vZ[2]);
+		q[3] = (vZ[0] - vX[2]) / s;
+		q[0] = (vY[0] + vX[1]) / s;
+		q[1] = 0.25f * s;
+		q[2] = (vZ[1] + vY[2]) / s;
+		}
+	else {
+		s = 2.0f * sqrtf(1.0f + vZ[2] - vX[0] - vY[1]);
+		q[3] = (vX[1] - vY[0]) / s;
+		q[0] = (vZ[0] + vX[2]) / s;
+		q[1] = (vZ[1] + vY[2]) / s;
+		q[2] = 0.25f * s;
+		}
+	}
+
+inline void m3dQuatFromMatrix44(M3DQuaternion q, const M3DMatrix44f m)
+	{ m3dQuatFromAxes(q, m, m + 4, m + 8); }
+
+// Spherical linear interpolation from a (t = 0) to b (t = 1), along the shorter arc.
+// Very close rotations fall back to a normalized lerp, which is what slerp turns
+// into anyway and avoids dividing by sin(0). r may be the same as a or b.
+inline void m3dQuatSlerp(M3DQuaternion r, const M3DQuaternion a, const M3DQuaternion b, float t)
+	{
+	float fCos = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+	float fSign = 1.0f;
+	if(fCos < 0.0f) {
+		fCos = -fCos;
+		fSign = -1.0f;
+		}
+
+	float fA, fB;
+	if(fCos > 0.9995f) {
+		fA = 1.0f - t;
+		fB = t;
+		}
+	else {
+		float fTheta = acosf(fCos);
+		float fInvSin = 1.0f / sinf(fTheta);
+		fA = sinf((1.0f - t) * fTheta) * fInvSin;
+		fB = sinf(t * fTheta) * fInvSin;
+		}
+	fB *= fSign;
+
+	r[0] = fA * a[0] + fB * b[0];
+	r[1] = fA * a[1] + fB * b[1];
+	r[2] = fA * a[2] + fB * b[2];
+	r[3] = fA * a[3] + fB * b[3];
+	m3dQuatNormalize(r);
+	}
+
 #endif
+
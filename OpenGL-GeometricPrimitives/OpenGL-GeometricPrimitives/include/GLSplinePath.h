@@ -0,0 +1,352 @@
+// GLSplinePath.h
+// A Catmull-Rom spline through a list of points, evaluated by distance along
+// the path instead of by the spline parameter. m3dCatmullRom moves faster on
+// long segments than on short ones, so a camera that steps t at a fixed rate
+// speeds up and slows down. SetPoints samples every segment once and keeps a
+// table of arc length and speed against t; after that a distance is turned
+// back into a segment and t with a binary search and a cubic Hermite step
+// between samples, and equal steps in distance are (very nearly) equal steps
+// along the curve.
+//
+//		GLSplinePath tour;
+//		tour.SetPoints(vPoints, nPoints, true);
+//		...
+//		tour.GetFrame(fSeconds * fSpeed, cameraFrame);
+//
+// Evaluate does a whole array of distances in one call (SIMD when available),
+// for drawing the path or placing objects along it.
+
+#ifndef __GL_SPLINE_PATH
+#define __GL_SPLINE_PATH
+
+#include <math3d.h>
+#include <math3dSIMD.h>
+#include <GLFrame.h>
+
+class GLSplinePath
+	{
+	public:
+		GLSplinePath(void)
+			{
+			pPoints = NULL;
+			pArcLength = NULL;
+			pSpeed = NULL;
+			pCoef = NULL;
+			nPoints = nSegments = nSamples = 0;
+			bLoop = false;
+			}
+
+		~GLSplinePath(void) { Free(); }
+
+		// The path goes through every point. An open path starts at the first
+		// point and ends at the last, a looped path joins the last point back
+		// up to the first. nSamplesPerSegment sets the size of the arc length
+		// table; 16 keeps the speed within a fraction of a percent even around
+		// fairly tight corners. Returns false if there are too few points.
+		bool SetPoints(const M3DVector3f *vPoints, int nNewPoints, bool bLooped = false, int nSamplesPerSegment = 16)
+			{
+			Free();
+			if(nNewPoints < 2 || (bLooped && nNewPoints < 3) || nSamplesPerSegment < 1)
+				return false;
+
+			nPoints = nNewPoints;
+			bLoop = bLooped;
+			nSegments = bLoop ? nPoints : nPoints - 1;
+			nSamples = nSamplesPerSegment;
+
+			pPoints = new M3DVector3f[nPoints];
+			memcpy(pPoints, vPoints, sizeof(M3DVector3f) * nPoints);
+			pArcLength = new float[nSegments * nSamples + 1];
+			pSpeed = new float[nSegments * nSamples + 1];
+			pCoef = new float[nSegments * 12];
+
+			// Power basis form of the m3dCatmullRom cubic, c0 + t*(c1 + t*(c2 + t*c3)),
+			// stored SoA by coefficient and axis for Evaluate
+			for(int s = 0; s < nSegments; s++)
+				{
+				const float *p0, *p1, *p2, *p3;
+				GetControlPoints(s, p0, p1, p2, p3);
+				for(int i = 0; i < 3; i++)
+					{
+					pCoef[(0 + i) * nSegments + s] = p1[i];
+					pCoef[(3 + i) * nSegments + s] = 0.5f * (-p0[i] + p2[i]);
+					pCoef[(6 + i) * nSegments + s] = 0.5f * (2.0f * p0[i] - 5.0f * p1[i] + 4.0f * p2[i] - p3[i]);
+					pCoef[(9 + i) * nSegments + s] = 0.5f * (-p0[i] + 3.0f * p1[i] - 3.0f * p2[i] + p3[i]);
+					}
+				}
+
+			// Speed (length of the derivative) at every sample, and the
+			// cumulative length with Simpson's rule between samples. The curve
+			// is C1, so the speed where two segments meet is the same from
+			// either side.
+			double dLength = 0.0;
+			float fStep = 1.0f / float(nSamples);
+			pArcLength[0] = 0.0f;
+			pSpeed[0] = GetSpeed(0, 0.0f);
+			for(int s = 0; s < nSegments; s++)
+				for(int k = 1; k <= nSamples; k++)
+					{
+					int n = s * nSamples + k;
+					float fMid = GetSpeed(s, (float(k) - 0.5f) * fStep);
+					pSpeed[n] = GetSpeed(s, float(k) * fStep);
+					dLength += (double(pSpeed[n - 1]) + 4.0 * double(fMid) + double(pSpeed[n])) * (fStep / 6.0);
+					pArcLength[n] = float(dLength);
+					}
+
+			return true;
+			}
+
+		inline float GetLength(void) const { return (pArcLength != NULL) ? pArcLength[nSegments * nSamples] : 0.0f; }
+		inline int GetSegmentCount(void) const { return nSegments; }
+		inline bool IsLooped(void) const { return bLoop; }
+
+		// Point on the path fDistance units from the start. Distances past
+		// either end wrap around a looped path and stop at the ends of an open one.
+		void GetPosition(float fDistance, M3DVector3f vPosition) const
+			{
+			int iSegment;
+			float t;
+			Locate(fDistance, iSegment, t);
+
+			const float *p0, *p1, *p2, *p3;
+			GetControlPoints(iSegment, p0, p1, p2, p3);
+			m3dCatmullRom(vPosition, p0, p1, p2, p3, t);
+			}
+
+		// Unit direction of travel at fDistance
+		void GetTangent(float fDistance, M3DVector3f vTangent) const
+			{
+			int iSegment;
+			float t;
+			Locate(fDistance, iSegment, t);
+
+			for(int i = 0; i < 3; i++)
+				vTangent[i] = Coef(1, i, iSegment) + t * (2.0f * Coef(2, i, iSegment) + t * 3.0f * Coef(3, i, iSegment));
+			m3dNormalizeVector3(vTangent);
+			}
+
+		// Put a frame on the path looking along it, with its up vector as close
+		// to world up (+Y) as it can be. If the path runs straight up or down
+		// the frame keeps the up vector it already had.
+		void GetFrame(float fDistance, GLFrame &frame) const
+			{
+			M3DVector3f vPosition, vForward, vRight, vUp;
+			GetPosition(fDistance, vPosition);
+			GetTangent(fDistance, vForward);
+
+			M3DVector3f vWorldUp = { 0.0f, 1.0f, 0.0f };
+			m3dCrossProduct3(vRight, vForward, vWorldUp);
+			if(m3dGetVectorLengthSquared3(vRight) < 0.000001f)
+				frame.GetUpVector(vWorldUp);
+			m3dCrossProduct3(vRight, vForward, vWorldUp);
+			m3dNormalizeVector3(vRight);
+			m3dCrossProduct3(vUp, vRight, vForward);
+
+			frame.SetOrigin(vPosition);
+			frame.SetForwardVector(vForward);
+			frame.SetUpVector(vUp);
+			}
+
+		// Positions (and optionally unit tangents) for a whole array of
+		// distances. The distance to segment lookup is scalar; the cubic and its
+		// derivative are evaluated four or eight distances at a time. Results
+		// match GetPosition/GetTangent to within rounding. tx, ty and tz may be NULL.
+		void Evaluate(const float *pDistances, int nCount, float *x, float *y, float *z,
+					  float *tx = NULL, float *ty = NULL, float *tz = NULL) const
+			{
+			// Blocks of segment coefficients, gathered SoA so the SIMD loop can
+			// load them straight into registers
+			float c[12][64];
+			float t[64];
+
+			for(int nBase = 0; nBase < nCount; nBase += 64)
+				{
+				int n = (nCount - nBase < 64) ? nCount - nBase : 64;
+				for(int i = 0; i < n; i++)
+					{
+					int iSegment;
+					Locate(pDistances[nBase + i], iSegment, t[i]);
+					for(int k = 0; k < 12; k++)
+						c[k][i] = pCoef[k * nSegments + iSegment];
+					}
+
+				EvaluateBlock(c, t, n, x + nBase, y + nBase, z + nBase,
+							  tx ? tx + nBase : NULL, ty ? ty + nBase : NULL, tz ? tz + nBase : NULL);
+				}
+			}
+
+	protected:
+		M3DVector3f	*pPoints;
+		float		*pArcLength;		// nSegments * nSamples + 1 cumulative lengths
+		float		*pSpeed;			// ds/dt at the same samples
+		float		*pCoef;				// 12 streams of nSegments: c0..c3 for x, y, z
+		int			nPoints;
+		int			nSegments;
+		int			nSamples;
+		bool		bLoop;
+
+		void Free(void)
+			{
+			delete [] pPoints;
+			delete [] pArcLength;
+			delete [] pSpeed;
+			delete [] pCoef;
+			pPoints = NULL;
+			pArcLength = NULL;
+			pSpeed = NULL;
+			pCoef = NULL;
+			nPoints = nSegments = nSamples = 0;
+			}
+
+		inline float Coef(int iPower, int iAxis, int iSegment) const { return pCoef[(iPower * 3 + iAxis) * nSegments + iSegment]; }
+
+		float GetSpeed(int iSegment, float t) const
+			{
+			M3DVector3f d;
+			for(int i = 0; i < 3; i++)
+				d[i] = Coef(1, i, iSegment) + t * (2.0f * Coef(2, i, iSegment) + t * 3.0f * Coef(3, i, iSegment));
+			return m3dGetVectorLength3(d);
+			}
+
+		// Segment s runs from point s to point s + 1. The outer control points
+		// wrap on a loop and repeat the end points on an open path.
+		void GetControlPoints(int s, const float *&p0, const float *&p1, const float *&p2, const float *&p3) const
+			{
+			if(bLoop) {
+				p0 = pPoints[(s + nPoints - 1) % nPoints];
+				p1 = pPoints[s];
+				p2 = pPoints[(s + 1) % nPoints];
+				p3 = pPoints[(s + 2) % nPoints];
+				}
+			else {
+				p0 = pPoints[(s > 0) ? s - 1 : 0];
+				p1 = pPoints[s];
+				p2 = pPoints[s + 1];
+				p3 = pPoints[(s + 2 < nPoints) ? s + 2 : nPoints - 1];
+				}
+			}
+
+		// Distance to segment and spline parameter, through the arc length table
+		void Locate(float fDistance, int &iSegment, float &t) const
+			{
+			float fLength = GetLength();
+			if(bLoop && fLength > 0.0f && (fDistance < 0.0f || fDistance >= fLength)) {
+				fDistance = fmodf(fDistance, fLength);
+				if(fDistance < 0.0f)
+					fDistance += fLength;
+				}
+			if(fDistance <= 0.0f) {
+				iSegment = 0;
+				t = 0.0f;
+				return;
+				}
+			if(fDistance >= fLength) {
+				iSegment = nSegments - 1;
+				t = 1.0f;
+				return;
+				}
+
+			// Last sample at or before fDistance. Written so the compiler can use
+			// a conditional move instead of a hard to predict branch.
+			int lo = 0, n = nSegments * nSamples;
+			while(n > 1)
+				{
+				int half = n >> 1;
+				lo = (pArcLength[lo + half] <= fDistance) ? lo + half : lo;
+				n -= half;
+				}
+
+			// Cubic Hermite for t(s) across the sample interval, using dt/ds =
+			// 1 / speed at both ends. A straight linear step would let the speed
+			// sag wherever the curve bends sharply inside one interval.
+			float fSpan = pArcLength[lo + 1] - pArcLength[lo];
+			float fOffset = 0.0f;
+			if(fSpan > 0.0f) {
+				float u = (fDistance - pArcLength[lo]) / fSpan;
+				float fStep = 1.0f / float(nSamples);
+				float m0 = (pSpeed[lo] > 0.0f) ? fSpan / (pSpeed[lo] * fStep) : 1.0f;
+				float m1 = (pSpeed[lo + 1] > 0.0f) ? fSpan / (pSpeed[lo + 1] * fStep) : 1.0f;
+				float u2 = u * u, u3 = u2 * u;
+				fOffset = (3.0f * u2 - 2.0f * u3) + (u3 - 2.0f * u2 + u) * m0 + (u3 - u2) * m1;
+				if(fOffset < 0.0f) fOffset = 0.0f;
+				if(fOffset > 1.0f) fOffset = 1.0f;
+				}
+			iSegment = lo / nSamples;
+			t = (float(lo % nSamples) + fOffset) / float(nSamples);
+			}
+
+		static void EvaluateBlock(const float c[12][64], const float *t, int n, float *x, float *y, float *z,
+								  float *tx, float *ty, float *tz)
+			{
+			float *pOut[3] = { x, y, z };
+			float *pTan[3] = { tx, ty, tz };
+			bool bTangents = (tx != NULL && ty != NULL && tz != NULL);
+			int i = 0;
+
+#if defined(M3D_SIMD_AVX)
+			for(; i + 8 <= n; i += 8)
+				{
+				__m256 vt = _mm256_loadu_ps(t + i);
+				__m256 d[3];
+				for(int a = 0; a < 3; a++)
+					{
+					__m256 c1 = _mm256_loadu_ps(c[3 + a] + i), c2 = _mm256_loadu_ps(c[6 + a] + i), c3 = _mm256_loadu_ps(c[9 + a] + i);
+					_mm256_storeu_ps(pOut[a] + i, _mm256_add_ps(_mm256_loadu_ps(c[a] + i),
+									 _mm256_mul_ps(vt, _mm256_add_ps(c1, _mm256_mul_ps(vt, _mm256_add_ps(c2, _mm256_mul_ps(vt, c3)))))));
+					d[a] = _mm256_add_ps(c1, _mm256_mul_ps(vt, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), c2),
+									 _mm256_mul_ps(_mm256_mul_ps(vt, _mm256_set1_ps(3.0f)), c3))));
+					}
+				if(bTangents) {
+					__m256 s = _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(
+									_mm256_mul_ps(d[0], d[0]), _mm256_mul_ps(d[1], d[1])), _mm256_mul_ps(d[2], d[2]))));
+					for(int a = 0; a < 3; a++)
+						_mm256_storeu_ps(pTan[a] + i, _mm256_mul_ps(d[a], s));
+					}
+				}
+#endif
+
+#if defined(M3D_SIMD_SSE)
+			for(; i + 4 <= n; i += 4)
+				{
+				__m128 vt = _mm_loadu_ps(t + i);
+				__m128 d[3];
+				for(int a = 0; a < 3; a++)
+					{
+					__m128 c1 = _mm_loadu_ps(c[3 + a] + i), c2 = _mm_loadu_ps(c[6 + a] + i), c3 = _mm_loadu_ps(c[9 + a] + i);
+					_mm_storeu_ps(pOut[a] + i, _mm_add_ps(_mm_loadu_ps(c[a] + i),
+								  _mm_mul_ps(vt, _mm_add_ps(c1, _mm_mul_ps(vt, _mm_add_ps(c2, _mm_mul_ps(vt, c3)))))));
+					d[a] = _mm_add_ps(c1, _mm_mul_ps(vt, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.0f), c2),
+								  _mm_mul_ps(_mm_mul_ps(vt, _mm_set1_ps(3.0f)), c3))));
+					}
+				if(bTangents) {
+					__m128 s = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+								_mm_mul_ps(d[0], d[0]), _mm_mul_ps(d[1], d[1])), _mm_mul_ps(d[2], d[2]))));
+					for(int a = 0; a < 3; a++)
+						_mm_storeu_ps(pTan[a] + i, _mm_mul_ps(d[a], s));
+					}
+				}
+#endif
+
+			for(; i < n; i++)
+				{
+				float d[3];
+				for(int a = 0; a < 3; a++)
+					{
+					pOut[a][i] = c[a][i] + t[i] * (c[3 + a][i] + t[i] * (c[6 + a][i] + t[i] * c[9 + a][i]));
+					d[a] = c[3 + a][i] + t[i] * (2.0f * c[6 + a][i] + t[i] * 3.0f * c[9 + a][i]);
+					}
+				if(bTangents) {
+					float s = 1.0f / sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+					for(int a = 0; a < 3; a++)
+						pTan[a][i] = d[a] * s;
+					}
+				}
+			}
+
+	private:
+		// Paths own their tables, so no copying
+		GLSplinePath(const GLSplinePath&);
+		GLSplinePath& operator=(const GLSplinePath&);
+	};
+
+#endif
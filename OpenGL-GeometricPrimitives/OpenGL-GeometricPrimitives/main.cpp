@@ -28,8 +28,8 @@
 /*
  GLMatrixStack 变化管线使用的矩阵堆栈
  
- GLMatrixStack 构造函数允许指定堆栈的最大深度、默认的堆栈深度为64，这个矩阵堆栈在初始化时已经在堆栈中包含了单位矩阵
- GLMatrixStack::GLMatrixStack(int iStackDepth = 64);
+ GLMatrixStack 构造函数允许指定堆栈的初始深度，堆栈用完时会自动增长，默认为0(先使用内置的8层)，这个矩阵堆栈在初始化时已经在堆栈中包含了单位矩阵
+ GLMatrixStack::GLMatrixStack(int iStackDepth = 0);
  
  void GLMatrixStack::LoadIdentity(void);     // 通过调用顶部载入这个单位矩阵
  
@@ -166,15 +166,17 @@ void SetupRC() {
     vPoints[nVerts][1] = 0.0f;
     vPoints[nVerts][2] = 0.0f;
     
-    // M3D_2PI 表示一个圆的角度
-    for (GLfloat angle = 0; angle < M3D_2PI; angle += M3D_2PI / 6.0f) {
+    // M3D_2PI 表示一个圆的角度，m3dMakeRing 一次算出圆上6个点的 sin/cos，不用每个点都调用 sin/cos
+    GLfloat fSin[6], fCos[6];
+    m3dMakeRing(fSin, fCos, 6, 0.0, M3D_2PI / 6.0);
+    for (int i = 0; i < 6; i++) {
         // 数组下标自增（每自增1次就表示一个顶点）
         nVerts++;
         // 弧长 = 半径 * 角度，这里的角度是弧度制，不是平时的角度制
         // x 点坐标 cos(angle) * 半径
-        vPoints[nVerts][0] = float(cos(angle)) * r;
+        vPoints[nVerts][0] = fCos[i] * r;
         // y 点坐标 sin(angle) * 半径
-        vPoints[nVerts][1] = float(cos(angle)) * r;
+        vPoints[nVerts][1] = fSin[i] * r;
         // z 点坐标
         vPoints[nVerts][2] = -0.5f;
     }
@@ -196,11 +198,13 @@ void SetupRC() {
     int iCounter = 0;
     // 半径
     GLfloat radius = 3.0f;
-    // 从0度～360度，以0.3弧度为步长
-    for (GLfloat angle = 0.0f; angle <= M3D_2PI; angle += 0.3f) {
+    // 从0度～360度，以0.3弧度为步长，共21个点
+    GLfloat fStripSin[21], fStripCos[21];
+    m3dMakeRing(fStripSin, fStripCos, 21, 0.0, 0.3);
+    for (int i = 0; i < 21; i++) {
         // 获取圆形的顶点的x, y
-        GLfloat x = radius * cos(angle);
-        GLfloat y = radius * sin(angle);
+        GLfloat x = radius * fStripCos[i];
+        GLfloat y = radius * fStripSin[i];
         
         // 绘制2个三角形（顶点的(x, y)值一样，z值不一样）
         vPoints[iCounter][0] = x;
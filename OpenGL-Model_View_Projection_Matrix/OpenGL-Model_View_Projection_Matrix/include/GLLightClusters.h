@@ -0,0 +1,513 @@
+// GLLightClusters.h
+// Clustered forward lighting for lots of point lights. The stock point light
+// shaders take one light per draw; here the view frustum is cut into a grid of
+// clusters (tiles across the screen, slices in depth) and every cluster gets a
+// list of the lights that reach into it, so a fragment only has to light
+// itself with the few lights of the cluster it falls in.
+//
+// GLLightClusters does the CPU side. The depth slices are spaced
+// exponentially, so clusters stay roughly cube shaped from near to far. Each
+// cluster is bounded by a box in eye space, and Assign() tests the light
+// spheres against the boxes with m3dSphereBoxStream: first against a whole
+// slice, then against each row of the slice with the lights that survived,
+// and only then against the clusters of the row. Slices are independent, so
+// Assign(GLTaskPool&, ...) does them on all threads.
+//
+// GLClusteredLightShader is the GPU side: a point light diffuse shader like
+// GLT_SHADER_POINT_LIGHT_DIFF that takes the light lists from textures.
+//
+//		lightClusters.SetProjection(viewFrustum.GetProjectionMatrix());		// in ChangeSize
+//		...
+//		lightClusters.Assign(taskPool, mCamera, lightX, lightY, lightZ, lightRadius, NUM_LIGHTS);
+//		clusteredShader.Upload(lightClusters, lightColors);
+//		clusteredShader.Use(transformPipeline.GetModelViewMatrix(), transformPipeline.GetProjectionMatrix(),
+//				vColor, windowWidth, windowHeight);
+//		sphereBatch.Draw();
+
+#ifndef __GLT_LIGHT_CLUSTERS
+#define __GLT_LIGHT_CLUSTERS
+
+#include "GLTools.h"
+#include "GLShaderManager.h"
+#include "math3dSIMD.h"
+#include "GLTaskPool.h"
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+// Default grid: tiles across, tiles up, depth slices
+#define GLT_CLUSTERS_X		16
+#define GLT_CLUSTERS_Y		8
+#define GLT_CLUSTERS_Z		24
+
+class GLLightClusters
+	{
+	public:
+		GLLightClusters(int nX = GLT_CLUSTERS_X, int nY = GLT_CLUSTERS_Y, int nZ = GLT_CLUSTERS_Z) {
+			nGridX = nX; nGridY = nY; nGridZ = nZ;
+			nLights = 0;
+			pTaskPool = NULL;
+			pLightX = pLightY = pLightZ = pLightR = NULL;
+			offsets.assign(GetClusterCount() + 1, 0);
+			sliceLists.resize(nZ);
+			M3DMatrix44f mProjection;
+			m3dMakePerspectiveMatrix(mProjection, float(m3dDegToRad(35.0f)), 1.0f, 1.0f, 100.0f);
+			SetProjection(mProjection);
+			}
+
+		inline int GetGridX(void) const { return nGridX; }
+		inline int GetGridY(void) const { return nGridY; }
+		inline int GetGridZ(void) const { return nGridZ; }
+		inline int GetClusterCount(void) const { return nGridX * nGridY * nGridZ; }
+
+		// Cluster (x, y, z): x tiles from the left, y from the bottom, z slices
+		// from the near plane
+		inline int GetCluster(int x, int y, int z) const { return (z * nGridY + y) * nGridX + x; }
+
+
+		///////////////////////////////////////////////////////////////////////
+		// Lay the grid out in a perspective projection (GLFrustum::
+		// GetProjectionMatrix). Call again whenever the projection changes.
+		void SetProjection(const M3DMatrix44f mProjection) {
+			// Near and far distances, and how x and y over distance map to -1..1
+			fNear = mProjection[14] / (mProjection[10] - 1.0f);
+			fFar = mProjection[14] / (mProjection[10] + 1.0f);
+			float fLogRatio = logf(fFar / fNear);
+			fSliceScale = float(nGridZ) / fLogRatio;
+			fSliceBias = -float(nGridZ) * logf(fNear) / fLogRatio;
+
+			int nClusters = GetClusterCount();
+			boxes.resize(size_t(nClusters) * 6);
+			rowBoxes.resize(size_t(nGridZ) * nGridY * 6);
+			sliceBoxes.resize(size_t(nGridZ) * 6);
+
+			for(int z = 0; z < nGridZ; z++) {
+				float d0 = fNear * expf(fLogRatio * float(z) / float(nGridZ));
+				float d1 = (z == nGridZ - 1) ? fFar : fNear * expf(fLogRatio * float(z + 1) / float(nGridZ));
+				float fLeft, fRight, fBottom, fTop;
+				Span(fLeft, fRight, 0, nGridX, nGridX, mProjection[0], mProjection[8], d0, d1);
+				Span(fBottom, fTop, 0, nGridY, nGridY, mProjection[5], mProjection[9], d0, d1);
+				SetBox(&sliceBoxes[size_t(z) * 6], fLeft, fBottom, -d1, fRight, fTop, -d0);
+
+				for(int y = 0; y < nGridY; y++) {
+					float fRowBottom, fRowTop;
+					Span(fRowBottom, fRowTop, y, y + 1, nGridY, mProjection[5], mProjection[9], d0, d1);
+					SetBox(&rowBoxes[size_t(z * nGridY + y) * 6], fLeft, fRowBottom, -d1, fRight, fRowTop, -d0);
+
+					for(int x = 0; x < nGridX; x++) {
+						float fColLeft, fColRight;
+						Span(fColLeft, fColRight, x, x + 1, nGridX, mProjection[0], mProjection[8], d0, d1);
+						SetBox(&boxes[size_t(GetCluster(x, y, z)) * 6], fColLeft, fRowBottom, -d1, fColRight, fRowTop, -d0);
+						}
+					}
+				}
+			}
+
+		// A fragment at eye space distance d (-z) is in slice
+		// floor(log(d) * fScale + fBias), clamped to the grid
+		inline void GetSliceParams(float& fScale, float& fBias) const { fScale = fSliceScale; fBias = fSliceBias; }
+
+		// A cluster's box in eye space
+		inline void GetClusterBox(int iCluster, M3DVector3f vMin, M3DVector3f vMax) const {
+			const float *p = &boxes[size_t(iCluster) * 6];
+			vMin[0] = p[0]; vMin[1] = p[1]; vMin[2] = p[2];
+			vMax[0] = p[3]; vMax[1] = p[4]; vMax[2] = p[5];
+			}
+
+
+		///////////////////////////////////////////////////////////////////////
+		// Build every cluster's light list. The lights are world space spheres
+		// (SoA); mView is the camera matrix (GLFrame::GetCameraMatrix). Returns
+		// the total length of the lists.
+		int Assign(const M3DMatrix44f mView, const float *x, const float *y, const float *z, const float *r, int nCount) {
+			PrepareLights(mView, x, y, z, r, nCount, 1);
+			AssignSlices(0, nGridZ, 0);
+			return GatherLists();
+			}
+
+		// The same, a slice per task
+		int Assign(GLTaskPool& pool, const M3DMatrix44f mView, const float *x, const float *y, const float *z, const float *r, int nCount) {
+			PrepareLights(mView, x, y, z, r, nCount, pool.GetThreadCount());
+			pTaskPool = &pool;
+			GLTask task = { AssignTask, this, 0, nGridZ, 0 };
+			pool.Run(task);
+			return GatherLists();
+			}
+
+		// Cluster c's lights are GetLightIndexes()[GetClusterOffsets()[c]] up to
+		// (not including) GetLightIndexes()[GetClusterOffsets()[c + 1]], in
+		// ascending order
+		inline const unsigned int *GetClusterOffsets(void) const { return &offsets[0]; }
+		inline const unsigned int *GetLightIndexes(void) const { return indexes.empty() ? NULL : &indexes[0]; }
+		inline int GetIndexCount(void) const { return int(indexes.size()); }
+
+		// The lights from the last Assign(), in eye space
+		inline int GetLightCount(void) const { return nLights; }
+		inline const float *GetEyeX(void) const { return pLightX; }
+		inline const float *GetEyeY(void) const { return pLightY; }
+		inline const float *GetEyeZ(void) const { return pLightZ; }
+		inline const float *GetRadius(void) const { return pLightR; }
+
+	protected:
+		// Eye space span, over distances d0 to d1, of the tiles iFrom to iTo
+		// (of nTiles) along one axis of the projection (scale and offset terms
+		// p and q: ndc = (p * x + q * z) / -z)
+		static void Span(float& fLow, float& fHigh, int iFrom, int iTo, int nTiles, float p, float q, float d0, float d1) {
+			float s0 = (-1.0f + 2.0f * float(iFrom) / float(nTiles) + q) / p;
+			float s1 = (-1.0f + 2.0f * float(iTo) / float(nTiles) + q) / p;
+			fLow = (s0 * d0 < s0 * d1) ? s0 * d0 : s0 * d1;
+			fHigh = (s1 * d0 > s1 * d1) ? s1 * d0 : s1 * d1;
+			}
+
+		static void SetBox(float *p, float x0, float y0, float z0, float x1, float y1, float z1) {
+			p[0] = x0; p[1] = y0; p[2] = z0;
+			p[3] = x1; p[4] = y1; p[5] = z1;
+			}
+
+		// Lights into eye space, and room for nThreads threads to work
+		void PrepareLights(const M3DMatrix44f mView, const float *x, const float *y, const float *z, const float *r, int nCount, int nThreads) {
+			nLights = nCount;
+			lights.resize(size_t(nCount) * 4 + 1);
+			pLightX = &lights[0];
+			pLightY = pLightX + nCount;
+			pLightZ = pLightY + nCount;
+			pLightR = pLightZ + nCount;
+			m3dTransformVectorStream3(pLightX, pLightY, pLightZ, x, y, z, mView, nCount);
+			if(nCount > 0)
+				memcpy(pLightR, r, sizeof(float) * size_t(nCount));
+
+			if(int(scratch.size()) < nThreads)
+				scratch.resize(nThreads);
+			for(int t = 0; t < nThreads; t++)
+				scratch[t].Reserve(nCount);
+			}
+
+		// The lights that passed one level of tests, copied together so the
+		// next level runs on contiguous streams
+		struct Candidates
+			{
+			std::vector<float>	x, y, z, r;
+			std::vector<int>	ids;
+			int					nCount;
+
+			void Gather(const Candidates& from, const int *pHits, int nHits) {
+				for(int i = 0; i < nHits; i++) {
+					int j = pHits[i];
+					x[i] = from.x[j]; y[i] = from.y[j]; z[i] = from.z[j]; r[i] = from.r[j];
+					ids[i] = from.ids[j];
+					}
+				nCount = nHits;
+				}
+			};
+
+		struct Scratch
+			{
+			Candidates			slice, row;
+			std::vector<int>	hits;
+
+			void Reserve(int n) {
+				size_t s = size_t(n) + 1;
+				if(hits.size() >= s)
+					return;
+				hits.resize(s);
+				Candidates *c[2] = { &slice, &row };
+				for(int i = 0; i < 2; i++) {
+					c[i]->x.resize(s); c[i]->y.resize(s); c[i]->z.resize(s); c[i]->r.resize(s);
+					c[i]->ids.resize(s);
+					}
+				}
+			};
+
+		// Light lists of slices [iBegin, iEnd): each slice's lists go to its own
+		// array, so threads never share output
+		void AssignSlices(int iBegin, int iEnd, int iThread) {
+			Scratch& s = scratch[iThread];
+			int *pHits = &s.hits[0];
+
+			for(int z = iBegin; z < iEnd; z++) {
+				std::vector<unsigned int>& list = sliceLists[z];
+				list.clear();
+
+				const float *pBox = &sliceBoxes[size_t(z) * 6];
+				int nHits = m3dSphereBoxStream(pHits, pLightX, pLightY, pLightZ, pLightR, nLights, pBox, pBox + 3);
+				for(int i = 0; i < nHits; i++) {
+					int j = pHits[i];
+					s.slice.x[i] = pLightX[j]; s.slice.y[i] = pLightY[j]; s.slice.z[i] = pLightZ[j]; s.slice.r[i] = pLightR[j];
+					s.slice.ids[i] = j;
+					}
+				s.slice.nCount = nHits;
+
+				for(int y = 0; y < nGridY; y++) {
+					const float *pRow = &rowBoxes[size_t(z * nGridY + y) * 6];
+					nHits = m3dSphereBoxStream(pHits, &s.slice.x[0], &s.slice.y[0], &s.slice.z[0], &s.slice.r[0],
+											   s.slice.nCount, pRow, pRow + 3);
+					s.row.Gather(s.slice, pHits, nHits);
+
+					for(int x = 0; x < nGridX; x++) {
+						int c = GetCluster(x, y, z);
+						const float *pCluster = &boxes[size_t(c) * 6];
+						nHits = m3dSphereBoxStream(pHits, &s.row.x[0], &s.row.y[0], &s.row.z[0], &s.row.r[0],
+												   s.row.nCount, pCluster, pCluster + 3);
+						for(int i = 0; i < nHits; i++)
+							list.push_back((unsigned int)s.row.ids[pHits[i]]);
+						offsets[c + 1] = (unsigned int)nHits;
+						}
+					}
+				}
+			}
+
+		// One task of Assign(GLTaskPool&): slices [iBegin, iEnd), split in half
+		// until it is one slice
+		static void AssignTask(void *pContext, int iBegin, int iEnd, int iParam, int iThread) {
+			GLLightClusters *pThis = (GLLightClusters *)pContext;
+			while(iEnd - iBegin > 1) {
+				int iMid = (iBegin + iEnd) / 2;
+				GLTask half = { AssignTask, pThis, iMid, iEnd, iParam };
+				pThis->pTaskPool->Spawn(iThread, half);
+				iEnd = iMid;
+				}
+			pThis->AssignSlices(iBegin, iEnd, iThread);
+			}
+
+		// Counts into offsets, slice lists into one array
+		int GatherLists(void) {
+			int nClusters = GetClusterCount();
+			offsets[0] = 0;
+			for(int c = 0; c < nClusters; c++)
+				offsets[c + 1] += offsets[c];
+
+			indexes.resize(offsets[nClusters]);
+			size_t n = 0;
+			for(int z = 0; z < nGridZ; z++) {
+				if(!sliceLists[z].empty())
+					memcpy(&indexes[n], &sliceLists[z][0], sizeof(unsigned int) * sliceLists[z].size());
+				n += sliceLists[z].size();
+				}
+			return int(n);
+			}
+
+		int						nGridX, nGridY, nGridZ;
+		float					fNear, fFar;
+		float					fSliceScale, fSliceBias;
+		std::vector<float>		boxes;			// Min and max corner of each cluster, eye space
+		std::vector<float>		rowBoxes;		// ... of each row of clusters in a slice
+		std::vector<float>		sliceBoxes;		// ... of each slice
+
+		int						nLights;
+		std::vector<float>		lights;			// Eye space x, y, z and radius streams
+		float					*pLightX, *pLightY, *pLightZ, *pLightR;
+
+		std::vector<unsigned int>	offsets;
+		std::vector<unsigned int>	indexes;
+		std::vector< std::vector<unsigned int> >	sliceLists;
+		std::vector<Scratch>	scratch;		// One per thread
+		GLTaskPool				*pTaskPool;		// For Assign(GLTaskPool&)
+
+	private:
+		GLLightClusters(const GLLightClusters&);
+		GLLightClusters& operator=(const GLLightClusters&);
+	};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The shader side. Four float textures, GLT_CLUSTER_TEXTURE_WIDTH texels wide:
+// each cluster's first index and count, the index lists, and each light's eye
+// space position and radius, and its color. A light's diffuse term falls off
+// as (1 - distance / radius)^2, reaching zero at the radius Assign() culled
+// with. Needs ARB_texture_float (any Mac, any GL 3 card).
+#define GLT_CLUSTER_TEXTURE_WIDTH	1024		// Also written into Fetch() below
+
+// The shader source. Inline variables need C++17, but a class template's
+// static members can be defined in a header.
+template <int N> struct GLClusteredLightShaderSource
+	{
+	static const char *szVertex;
+	static const char *szFragment;
+	};
+
+template <int N> const char *GLClusteredLightShaderSource<N>::szVertex =
+	"#version 120\n"
+	"uniform mat4 mvMatrix;\n"
+	"uniform mat4 pMatrix;\n"
+	"attribute vec4 vVertex;\n"
+	"attribute vec3 vNormal;\n"
+	"varying vec3 vEyePosition;\n"
+	"varying vec3 vEyeNormal;\n"
+	"void main(void)\n"
+	"    {\n"
+	"    vec4 vPosition = mvMatrix * vVertex;\n"
+	"    vEyePosition = vPosition.xyz / vPosition.w;\n"
+	"    vEyeNormal = mat3(mvMatrix) * vNormal;\n"
+	"    gl_Position = pMatrix * vPosition;\n"
+	"    }\n";
+
+template <int N> const char *GLClusteredLightShaderSource<N>::szFragment =
+	"#version 120\n"
+	"uniform vec4 vColor;\n"
+	"uniform vec3 vGrid;\n"				// Clusters across, up and deep
+	"uniform vec2 vTileScale;\n"		// Clusters per pixel across and up
+	"uniform vec2 vSlice;\n"			// slice = log(distance) * x + y
+	"uniform vec2 vRows;\n"				// Rows of the index and light textures
+	"uniform sampler2D clusterTable;\n"
+	"uniform sampler2D lightIndexes;\n"
+	"uniform sampler2D lightPositions;\n"
+	"uniform sampler2D lightColors;\n"
+	"varying vec3 vEyePosition;\n"
+	"varying vec3 vEyeNormal;\n"
+	"vec4 Fetch(sampler2D tex, float i, float fRows)\n"
+	"    {\n"
+	"    float fRow = floor(i / 1024.0);\n"
+	"    return texture2D(tex, vec2((i - fRow * 1024.0 + 0.5) / 1024.0, (fRow + 0.5) / fRows));\n"
+	"    }\n"
+	"void main(void)\n"
+	"    {\n"
+	"    vec3 vNormal = normalize(vEyeNormal);\n"
+	"    float fSlice = clamp(floor(log(-vEyePosition.z) * vSlice.x + vSlice.y), 0.0, vGrid.z - 1.0);\n"
+	"    vec2 vTile = clamp(floor(gl_FragCoord.xy * vTileScale), vec2(0.0), vGrid.xy - 1.0);\n"
+	"    vec4 vCluster = texture2D(clusterTable, vec2((vTile.x + vTile.y * vGrid.x + 0.5) / (vGrid.x * vGrid.y), (fSlice + 0.5) / vGrid.z));\n"
+	"    vec3 vDiffuse = vec3(0.0);\n"
+	"    int nCount = int(vCluster.a);\n"
+	"    for(int i = 0; i < nCount; i++)\n"
+	"        {\n"
+	"        float fLight = Fetch(lightIndexes, vCluster.r + float(i), vRows.x).r;\n"
+	"        vec4 vLight = Fetch(lightPositions, fLight, vRows.y);\n"
+	"        vec3 vToLight = vLight.xyz - vEyePosition;\n"
+	"        float fDistance = length(vToLight);\n"
+	"        float fFalloff = max(1.0 - fDistance / vLight.w, 0.0);\n"
+	"        float fDiffuse = max(dot(vNormal, vToLight / max(fDistance, 1e-6)), 0.0);\n"
+	"        vDiffuse += Fetch(lightColors, fLight, vRows.y).rgb * (fDiffuse * fFalloff * fFalloff);\n"
+	"        }\n"
+	"    gl_FragColor = vec4(vColor.rgb * vDiffuse, vColor.a);\n"
+	"    }\n";
+
+class GLClusteredLightShader
+	{
+	public:
+		GLClusteredLightShader(void) {
+			uiProgram = 0;
+			memset(uiTextures, 0, sizeof(uiTextures));
+			nIndexRows = nLightRows = 1;
+			}
+
+		~GLClusteredLightShader(void) {
+			if(uiTextures[0] != 0)
+				glDeleteTextures(4, uiTextures);
+			}
+
+		// Compile the shader (through shaderManager, which owns it) and make
+		// the textures. Texture units 1 to 4 are used, unit 0 is left alone.
+		bool Init(GLShaderManager& shaderManager) {
+			uiProgram = shaderManager.LoadShaderPairSrcWithAttributes("GLTClusteredPointLightDiff",
+					GLClusteredLightShaderSource<0>::szVertex, GLClusteredLightShaderSource<0>::szFragment, 2,
+					GLT_ATTRIBUTE_VERTEX, "vVertex", GLT_ATTRIBUTE_NORMAL, "vNormal");
+			if(uiProgram == 0)
+				return false;
+
+			const char *szSamplers[4] = { "clusterTable", "lightIndexes", "lightPositions", "lightColors" };
+			glUseProgram(uiProgram);
+			for(int i = 0; i < 4; i++)
+				glUniform1i(glGetUniformLocation(uiProgram, szSamplers[i]), i + 1);
+			iMVMatrix = glGetUniformLocation(uiProgram, "mvMatrix");
+			iPMatrix = glGetUniformLocation(uiProgram, "pMatrix");
+			iColor = glGetUniformLocation(uiProgram, "vColor");
+			iGrid = glGetUniformLocation(uiProgram, "vGrid");
+			iTileScale = glGetUniformLocation(uiProgram, "vTileScale");
+			iSlice = glGetUniformLocation(uiProgram, "vSlice");
+			iRows = glGetUniformLocation(uiProgram, "vRows");
+
+			glGenTextures(4, uiTextures);
+			for(int i = 0; i < 4; i++) {
+				glActiveTexture(GL_TEXTURE1 + i);
+				glBindTexture(GL_TEXTURE_2D, uiTextures[i]);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+				}
+			glActiveTexture(GL_TEXTURE0);
+			return true;
+			}
+
+		// Send this frame's lists and lights (after clusters.Assign()).
+		// pColors holds one RGB color per light.
+		void Upload(const GLLightClusters& clusters, const M3DVector3f *pColors) {
+			int nClusters = clusters.GetClusterCount();
+			const unsigned int *pOffsets = clusters.GetClusterOffsets();
+			nGridX = clusters.GetGridX(); nGridY = clusters.GetGridY(); nGridZ = clusters.GetGridZ();
+			clusters.GetSliceParams(fSliceScale, fSliceBias);
+
+			// (first, count) per cluster; a row of the texture per slice
+			texels.resize(size_t(nClusters) * 2);
+			for(int c = 0; c < nClusters; c++) {
+				texels[size_t(c) * 2] = float(pOffsets[c]);
+				texels[size_t(c) * 2 + 1] = float(pOffsets[c + 1] - pOffsets[c]);
+				}
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, uiTextures[0]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA32F_ARB, nGridX * nGridY, nGridZ, 0, GL_LUMINANCE_ALPHA, GL_FLOAT, &texels[0]);
+
+			int nIndexes = clusters.GetIndexCount();
+			nIndexRows = nIndexes / GLT_CLUSTER_TEXTURE_WIDTH + 1;
+			texels.assign(size_t(nIndexRows) * GLT_CLUSTER_TEXTURE_WIDTH, 0.0f);
+			const unsigned int *pIndexes = clusters.GetLightIndexes();
+			for(int i = 0; i < nIndexes; i++)
+				texels[i] = float(pIndexes[i]);
+			glActiveTexture(GL_TEXTURE2);
+			glBindTexture(GL_TEXTURE_2D, uiTextures[1]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE32F_ARB, GLT_CLUSTER_TEXTURE_WIDTH, nIndexRows, 0, GL_LUMINANCE, GL_FLOAT, &texels[0]);
+
+			int nCount = clusters.GetLightCount();
+			const float *x = clusters.GetEyeX(), *y = clusters.GetEyeY(), *z = clusters.GetEyeZ(), *r = clusters.GetRadius();
+			nLightRows = nCount / GLT_CLUSTER_TEXTURE_WIDTH + 1;
+			texels.assign(size_t(nLightRows) * GLT_CLUSTER_TEXTURE_WIDTH * 4, 0.0f);
+			for(int i = 0; i < nCount; i++) {
+				float *p = &texels[size_t(i) * 4];
+				p[0] = x[i]; p[1] = y[i]; p[2] = z[i]; p[3] = r[i];
+				}
+			glActiveTexture(GL_TEXTURE3);
+			glBindTexture(GL_TEXTURE_2D, uiTextures[2]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F_ARB, GLT_CLUSTER_TEXTURE_WIDTH, nLightRows, 0, GL_RGBA, GL_FLOAT, &texels[0]);
+
+			for(int i = 0; i < nCount; i++) {
+				float *p = &texels[size_t(i) * 4];
+				p[0] = pColors[i][0]; p[1] = pColors[i][1]; p[2] = pColors[i][2]; p[3] = 1.0f;
+				}
+			glActiveTexture(GL_TEXTURE4);
+			glBindTexture(GL_TEXTURE_2D, uiTextures[3]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F_ARB, GLT_CLUSTER_TEXTURE_WIDTH, nLightRows, 0, GL_RGBA, GL_FLOAT, &texels[0]);
+			glActiveTexture(GL_TEXTURE0);
+			}
+
+		// Like UseStockShader(GLT_SHADER_POINT_LIGHT_DIFF, ...), with the
+		// viewport size in place of the light position
+		void Use(const M3DMatrix44f mModelView, const M3DMatrix44f mProjection, const M3DVector4f vColor, int iViewportWidth, int iViewportHeight) {
+			glUseProgram(uiProgram);
+			glUniformMatrix4fv(iMVMatrix, 1, GL_FALSE, mModelView);
+			glUniformMatrix4fv(iPMatrix, 1, GL_FALSE, mProjection);
+			glUniform4fv(iColor, 1, vColor);
+			glUniform3f(iGrid, float(nGridX), float(nGridY), float(nGridZ));
+			glUniform2f(iTileScale, float(nGridX) / float(iViewportWidth), float(nGridY) / float(iViewportHeight));
+			glUniform2f(iSlice, fSliceScale, fSliceBias);
+			glUniform2f(iRows, float(nIndexRows), float(nLightRows));
+			for(int i = 0; i < 4; i++) {
+				glActiveTexture(GL_TEXTURE1 + i);
+				glBindTexture(GL_TEXTURE_2D, uiTextures[i]);
+				}
+			glActiveTexture(GL_TEXTURE0);
+			}
+
+	protected:
+		GLuint				uiProgram;
+		GLuint				uiTextures[4];
+		GLint				iMVMatrix, iPMatrix, iColor, iGrid, iTileScale, iSlice, iRows;
+		int					nGridX, nGridY, nGridZ;
+		int					nIndexRows, nLightRows;
+		float				fSliceScale, fSliceBias;
+		std::vector<float>	texels;
+
+	private:
+		GLClusteredLightShader(const GLClusteredLightShader&);
+		GLClusteredLightShader& operator=(const GLClusteredLightShader&);
+	};
+
+#endif
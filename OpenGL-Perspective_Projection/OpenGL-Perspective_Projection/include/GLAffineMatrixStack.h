@@ -0,0 +1,185 @@
+// GLAffineMatrixStack.h
+// GLMatrixStack for model-view (and model) transforms, which are always affine.
+// It keeps 3x4 matrices (M3DMatrix34f), so every push, pop and multiply moves
+// and computes a quarter less, and the result can go straight into a 3x4
+// instance buffer (GLAffineInstanceBuffer.h). It has the same functions as
+// GLMatrixStack, except that nothing that would make the matrix non-affine
+// (a projection) can be loaded.
+//
+// Shaders still take 4x4s, so get the model-view-projection matrix with
+// m3dMatrixMultiply44Affine34(mMVP, mProjection, modelView.GetMatrix()), or
+// GetMatrix(M3DMatrix44f) for the full 4x4.
+
+#ifndef __GLT_AFFINE_MATRIX_STACK
+#define __GLT_AFFINE_MATRIX_STACK
+
+#include "GLMatrixStack.h"
+
+class GLAffineMatrixStack
+	{
+	public:
+		// Like GLMatrixStack, iStackDepth is only a starting size
+		GLAffineMatrixStack(int iStackDepth = 16) {
+			stackDepth = 0;
+			stackPointer = 0;
+			pStack = NULL;
+			pGeneration = NULL;
+			Grow(iStackDepth);
+			m3dLoadIdentity34(pStack[0]);
+			lastError = GLT_STACK_NOERROR;
+			pGeneration[0] = nLastGeneration = 0;
+			}
+
+		~GLAffineMatrixStack(void) {
+			m3dAlignedFree(pStack);
+			}
+
+
+		inline void LoadIdentity(void) {
+			m3dLoadIdentity34(pStack[stackPointer]);
+			Touch();
+			}
+
+		inline void LoadMatrix(const M3DMatrix34f mMatrix) {
+			m3dCopyMatrix34(pStack[stackPointer], mMatrix);
+			Touch();
+			}
+
+		// The bottom row of mMatrix is ignored
+		inline void LoadMatrix44(const M3DMatrix44f mMatrix) {
+			m3dMatrix44ToAffine34(pStack[stackPointer], mMatrix);
+			Touch();
+			}
+
+		inline void LoadMatrix(GLFrame& frame) {
+			frame.GetAffineMatrix(pStack[stackPointer]);
+			Touch();
+			}
+
+		inline void MultMatrix(const M3DMatrix34f mMatrix) {
+			m3dMatrixMultiply34(pStack[stackPointer], pStack[stackPointer], mMatrix);
+			Touch();
+			}
+
+		inline void MultMatrix44(const M3DMatrix44f mMatrix) {
+			M3DMatrix34f m;
+			m3dMatrix44ToAffine34(m, mMatrix);
+			MultMatrix(m);
+			}
+
+		inline void MultMatrix(GLFrame& frame) {
+			M3DMatrix34f m;
+			frame.GetAffineMatrix(m);
+			MultMatrix(m);
+			}
+
+		inline void PushMatrix(void) {
+			if(stackPointer + 1 < stackDepth || Grow(stackDepth * 2)) {
+				stackPointer++;
+				m3dCopyMatrix34(pStack[stackPointer], pStack[stackPointer-1]);
+				pGeneration[stackPointer] = pGeneration[stackPointer-1];
+				}
+			else
+				lastError = GLT_STACK_OVERFLOW;
+			}
+
+		void PushMatrix(const M3DMatrix34f mMatrix) {
+			if(stackPointer + 1 < stackDepth || Grow(stackDepth * 2)) {
+				stackPointer++;
+				m3dCopyMatrix34(pStack[stackPointer], mMatrix);
+				Touch();
+				}
+			else
+				lastError = GLT_STACK_OVERFLOW;
+			}
+
+		void PushMatrix(GLFrame& frame) {
+			if(stackPointer + 1 < stackDepth || Grow(stackDepth * 2)) {
+				stackPointer++;
+				frame.GetAffineMatrix(pStack[stackPointer]);
+				Touch();
+				}
+			else
+				lastError = GLT_STACK_OVERFLOW;
+			}
+
+		inline void PopMatrix(void) {
+			if(stackPointer > 0)
+				stackPointer--;
+			else
+				lastError = GLT_STACK_UNDERFLOW;
+			}
+
+		void Scale(GLfloat x, GLfloat y, GLfloat z) {
+			m3dMultScale34(pStack[stackPointer], x, y, z);
+			Touch();
+			}
+
+		void Translate(GLfloat x, GLfloat y, GLfloat z) {
+			m3dMultTranslation34(pStack[stackPointer], x, y, z);
+			Touch();
+			}
+
+		void Rotate(GLfloat angle, GLfloat x, GLfloat y, GLfloat z) {
+			m3dMultRotation34(pStack[stackPointer], float(m3dDegToRad(angle)), x, y, z);
+			Touch();
+			}
+
+		void Scalev(const M3DVector3f vScale) { Scale(vScale[0], vScale[1], vScale[2]); }
+		void Translatev(const M3DVector3f vTranslate) { Translate(vTranslate[0], vTranslate[1], vTranslate[2]); }
+		void Rotatev(GLfloat angle, M3DVector3f vAxis) { Rotate(angle, vAxis[0], vAxis[1], vAxis[2]); }
+
+		// The top matrix as a 3x4 (16 byte aligned), or expanded to a 4x4
+		const M3DMatrix34f& GetMatrix(void) { return pStack[stackPointer]; }
+		void GetMatrix(M3DMatrix44f mMatrix) { m3dAffine34ToMatrix44(mMatrix, pStack[stackPointer]); }
+
+		void GetInverseMatrix(M3DMatrix34f mInverse) { m3dInvertAffine34(mInverse, pStack[stackPointer]); }
+
+		// See GLMatrixStack
+		inline unsigned int GetGeneration(void) const { return pGeneration[stackPointer]; }
+		inline int GetDepth(void) const { return stackPointer + 1; }
+		inline int GetCapacity(void) const { return stackDepth; }
+
+		inline GLT_STACK_ERROR GetLastError(void) {
+			GLT_STACK_ERROR retval = lastError;
+			lastError = GLT_STACK_NOERROR;
+			return retval;
+			}
+
+	protected:
+		inline void Touch(void) { pGeneration[stackPointer] = ++nLastGeneration; }
+
+		// Matrices then generations, in one 64 byte aligned block
+		bool Grow(int nLevels) {
+			if(nLevels < 16)
+				nLevels = 16;
+			unsigned char *p = (unsigned char *)m3dAlignedAlloc((sizeof(M3DMatrix34f) + sizeof(unsigned int)) * size_t(nLevels), 64);
+			if(p == NULL)
+				return false;
+
+			unsigned int *pNewGeneration = (unsigned int *)(p + sizeof(M3DMatrix34f) * nLevels);
+			if(pStack != NULL) {
+				memcpy(p, pStack, sizeof(M3DMatrix34f) * (stackPointer + 1));
+				memcpy(pNewGeneration, pGeneration, sizeof(unsigned int) * (stackPointer + 1));
+				}
+			m3dAlignedFree(pStack);
+
+			pStack = (M3DMatrix34f *)p;
+			pGeneration = pNewGeneration;
+			stackDepth = nLevels;
+			return true;
+			}
+
+		GLT_STACK_ERROR		lastError;
+		int					stackDepth;
+		int					stackPointer;
+		M3DMatrix34f		*pStack;
+		unsigned int		*pGeneration;
+		unsigned int		nLastGeneration;
+
+	private:
+		GLAffineMatrixStack(const GLAffineMatrixStack&);
+		GLAffineMatrixStack& operator=(const GLAffineMatrixStack&);
+	};
+
+#endif
@@ -0,0 +1,428 @@
+// GLMatrixCommandList.h
+// Record a fixed sequence of matrix stack operations once and replay it every
+// frame. Most RenderScene functions push, translate, rotate and pop the same way
+// every frame, and only a few numbers (an angle, the camera) change. Here the
+// numbers that change are parameters, and Replay() only redoes the operations
+// that depend on a parameter that changed since the last replay. Every other
+// matrix is kept from the last frame, so the static parts of a scene cost no
+// matrix math at all.
+//
+// Record with the same calls as GLMatrixStack. Emit() marks a place where a
+// matrix is used (a draw) and returns the index to fetch it with later:
+//
+//		GLMatrixCommandList scene;
+//		int iCamera = scene.AddMatrixParameter("camera");
+//		int iRot = scene.AddParameter("yRot");
+//		scene.LoadMatrix(scene.MatrixParam(iCamera));
+//		int iFloor = scene.Emit();
+//		scene.Translate(0.0f, 0.0f, -2.5f);
+//		scene.PushMatrix();
+//			scene.Rotate(scene.Param(iRot), 0.0f, 1.0f, 0.0f);
+//			int iTorus = scene.Emit();
+//		scene.PopMatrix();
+//		scene.Rotate(scene.Param(iRot, -3.0f), 0.0f, 1.0f, 0.0f);	// -3 * yRot
+//		scene.Translate(0.8f, 0.0f, 0.0f);
+//		int iSphere = scene.Emit();
+//
+// and then each frame:
+//
+//		scene.SetMatrixParameter(iCamera, mCamera);
+//		scene.SetParameter(iRot, yRot);
+//		scene.Replay();
+//		... scene.GetMatrix(iTorus) ...
+//
+// The results are exactly what the same calls on a GLMatrixStack give.
+
+#ifndef __GLT_MATRIX_COMMAND_LIST
+#define __GLT_MATRIX_COMMAND_LIST
+
+#include "GLMatrixStack.h"
+#include <string.h>
+
+// One float argument: a constant, or a parameter slot times a constant.
+// Plain floats convert to it, so constants can be passed as usual.
+struct GLMatrixArg
+	{
+	GLMatrixArg(float fConstant) { fValue = fConstant; iSlot = -1; }
+	GLMatrixArg(int iParameter, float fScale) { fValue = fScale; iSlot = iParameter; }
+
+	float	fValue;		// The constant, or the scale for a parameter
+	int		iSlot;		// Parameter slot, or -1
+	};
+
+// A matrix argument: a matrix parameter slot
+struct GLMatrixParamRef
+	{
+	explicit GLMatrixParamRef(int iParameter) { iSlot = iParameter; }
+	int		iSlot;
+	};
+
+class GLMatrixCommandList
+	{
+	public:
+		GLMatrixCommandList(void) {
+			pOps = NULL; pResults = NULL; pOutputs = NULL;
+			pParams = NULL; pMatrixParams = NULL; pStack = NULL;
+			nOps = nOpCapacity = nOutputs = nOutputCapacity = 0;
+			nParams = nMatrixParams = 0;
+			nReplays = 0; nReplayedOps = 0; nLastEvaluated = 0;
+			Clear();
+			}
+
+		~GLMatrixCommandList(void) {
+			Free();
+			}
+
+		// Forget the recording and all parameters
+		void Clear(void) {
+			Free();
+			nOps = nOutputs = nParams = nMatrixParams = 0;
+			nReplays = nReplayedOps = 0;
+			iTop = AddOp(GLT_MATRIX_OP_IDENTITY, -1);
+			}
+
+
+		///////////////////////////////////////////////////////////////////////
+		// Parameters. Slots are numbered from 0 in the order they are added.
+		int AddParameter(const char *szName, float fValue = 0.0f) {
+			GLMatrixParameter *pNew = new GLMatrixParameter[nParams + 1];
+			for(int i = 0; i < nParams; i++)
+				pNew[i] = pParams[i];
+			delete [] pParams;
+			pParams = pNew;
+
+			SetName(pParams[nParams].szName, szName);
+			pParams[nParams].fValue = fValue;
+			pParams[nParams].bChanged = true;
+			pParams[nParams].iFirstUse = -1;
+			return nParams++;
+			}
+
+		int AddMatrixParameter(const char *szName) {
+			GLMatrixParameter44 *pNew = new GLMatrixParameter44[nMatrixParams + 1];
+			for(int i = 0; i < nMatrixParams; i++)
+				pNew[i] = pMatrixParams[i];
+			delete [] pMatrixParams;
+			pMatrixParams = pNew;
+
+			SetName(pMatrixParams[nMatrixParams].szName, szName);
+			m3dLoadIdentity44(pMatrixParams[nMatrixParams].mValue);
+			pMatrixParams[nMatrixParams].bChanged = true;
+			pMatrixParams[nMatrixParams].iFirstUse = -1;
+			return nMatrixParams++;
+			}
+
+		// Slot for a name, or -1
+		int FindParameter(const char *szName) const {
+			for(int i = 0; i < nParams; i++)
+				if(strcmp(pParams[i].szName, szName) == 0)
+					return i;
+			return -1;
+			}
+
+		int FindMatrixParameter(const char *szName) const {
+			for(int i = 0; i < nMatrixParams; i++)
+				if(strcmp(pMatrixParams[i].szName, szName) == 0)
+					return i;
+			return -1;
+			}
+
+		// Setting a parameter to the value it already has doesn't count as a change
+		inline void SetParameter(int iSlot, float fValue) {
+			if(pParams[iSlot].fValue != fValue) {
+				pParams[iSlot].fValue = fValue;
+				pParams[iSlot].bChanged = true;
+				}
+			}
+
+		inline float GetParameter(int iSlot) const { return pParams[iSlot].fValue; }
+
+		void SetMatrixParameter(int iSlot, const M3DMatrix44f mValue) {
+			if(memcmp(pMatrixParams[iSlot].mValue, mValue, sizeof(M3DMatrix44f)) != 0) {
+				m3dCopyMatrix44(pMatrixParams[iSlot].mValue, mValue);
+				pMatrixParams[iSlot].bChanged = true;
+				}
+			}
+
+		// Use a parameter as an argument, optionally scaled
+		inline GLMatrixArg Param(int iSlot, float fScale = 1.0f) const { return GLMatrixArg(iSlot, fScale); }
+		inline GLMatrixParamRef MatrixParam(int iSlot) const { return GLMatrixParamRef(iSlot); }
+
+
+		///////////////////////////////////////////////////////////////////////
+		// Recording, same as GLMatrixStack. The list starts out with the
+		// identity on top.
+		void LoadIdentity(void) { iTop = AddOp(GLT_MATRIX_OP_IDENTITY, -1); }
+
+		void LoadMatrix(const M3DMatrix44f mMatrix) {
+			iTop = AddOp(GLT_MATRIX_OP_LOAD, -1);
+			m3dCopyMatrix44(pOps[iTop].mMatrix, mMatrix);
+			}
+
+		void LoadMatrix(GLMatrixParamRef matrix) {
+			iTop = AddOp(GLT_MATRIX_OP_LOAD_PARAM, -1);
+			UseMatrixParameter(matrix.iSlot);
+			}
+
+		void MultMatrix(const M3DMatrix44f mMatrix) {
+			iTop = AddOp(GLT_MATRIX_OP_MULT, iTop);
+			m3dCopyMatrix44(pOps[iTop].mMatrix, mMatrix);
+			}
+
+		void MultMatrix(GLMatrixParamRef matrix) {
+			iTop = AddOp(GLT_MATRIX_OP_MULT_PARAM, iTop);
+			UseMatrixParameter(matrix.iSlot);
+			}
+
+		void Translate(GLMatrixArg x, GLMatrixArg y, GLMatrixArg z) { AddTransform(GLT_MATRIX_OP_TRANSLATE, 0.0f, x, y, z); }
+		void Rotate(GLMatrixArg angle, GLMatrixArg x, GLMatrixArg y, GLMatrixArg z) { AddTransform(GLT_MATRIX_OP_ROTATE, angle, x, y, z); }
+		void Scale(GLMatrixArg x, GLMatrixArg y, GLMatrixArg z) { AddTransform(GLT_MATRIX_OP_SCALE, 0.0f, x, y, z); }
+
+		// Pushing doesn't compute anything, it just remembers what the top was
+		void PushMatrix(void) {
+			if(nStackDepth == nStackCapacity) {
+				nStackCapacity = (nStackCapacity < 16) ? 16 : nStackCapacity * 2;
+				int *pNew = new int[nStackCapacity];
+				if(nStackDepth > 0)
+					memcpy(pNew, pStack, sizeof(int) * nStackDepth);
+				delete [] pStack;
+				pStack = pNew;
+				}
+			pStack[nStackDepth++] = iTop;
+			}
+
+		void PopMatrix(void) {
+			if(nStackDepth > 0)
+				iTop = pStack[--nStackDepth];
+			}
+
+		// Mark the current top as a result, and return its index for GetMatrix()
+		int Emit(void) {
+			if(nOutputs == nOutputCapacity) {
+				nOutputCapacity = (nOutputCapacity < 8) ? 8 : nOutputCapacity * 2;
+				int *pNew = new int[nOutputCapacity];
+				if(nOutputs > 0)
+					memcpy(pNew, pOutputs, sizeof(int) * nOutputs);
+				delete [] pOutputs;
+				pOutputs = pNew;
+				}
+			pOutputs[nOutputs] = iTop;
+			return nOutputs++;
+			}
+
+
+		///////////////////////////////////////////////////////////////////////
+		// Bring every result up to date. Each operation is redone only if one of
+		// its parameters changed or the matrix it starts from was redone. Nothing
+		// before the first use of a changed parameter is even looked at. Returns
+		// how many operations were evaluated (0 when nothing changed).
+		int Replay(void) {
+			// Operations recorded since the last replay have never been evaluated
+			int iStart = nReplayedOps;
+			for(int i = 0; i < nParams; i++)
+				if(pParams[i].bChanged && pParams[i].iFirstUse >= 0 && pParams[i].iFirstUse < iStart)
+					iStart = pParams[i].iFirstUse;
+			for(int i = 0; i < nMatrixParams; i++)
+				if(pMatrixParams[i].bChanged && pMatrixParams[i].iFirstUse >= 0 && pMatrixParams[i].iFirstUse < iStart)
+					iStart = pMatrixParams[i].iFirstUse;
+
+			nReplays++;
+			int nEvaluated = 0;
+			for(int i = iStart; i < nOps; i++) {
+				GLMatrixOp &op = pOps[i];
+				bool bDirty = (i >= nReplayedOps) || (op.iInput >= 0 && pOps[op.iInput].nEvaluated == nReplays);
+				for(int a = 0; a < 4 && !bDirty; a++)
+					bDirty = (op.iSlot[a] >= 0 && pParams[op.iSlot[a]].bChanged);
+				if(!bDirty && op.iMatrixSlot >= 0)
+					bDirty = pMatrixParams[op.iMatrixSlot].bChanged;
+
+				if(bDirty) {
+					Evaluate(i);
+					op.nEvaluated = nReplays;
+					nEvaluated++;
+					}
+				}
+
+			for(int i = 0; i < nParams; i++)
+				pParams[i].bChanged = false;
+			for(int i = 0; i < nMatrixParams; i++)
+				pMatrixParams[i].bChanged = false;
+			nReplayedOps = nOps;
+			nLastEvaluated = nEvaluated;
+			return nEvaluated;
+			}
+
+		// A result from the last Replay()
+		inline const M3DMatrix44f& GetMatrix(int iOutput) const { return pResults[pOutputs[iOutput]]; }
+
+		// True if that result changed in the last Replay(), so anything made from
+		// it (an MVP, a uniform upload) needs doing again
+		inline bool IsChanged(int iOutput) const { return pOps[pOutputs[iOutput]].nEvaluated == nReplays; }
+
+		inline int GetOpCount(void) const { return nOps; }
+		inline int GetOutputCount(void) const { return nOutputs; }
+		inline int GetLastEvaluatedCount(void) const { return nLastEvaluated; }
+
+	protected:
+		enum GLT_MATRIX_OP { GLT_MATRIX_OP_IDENTITY, GLT_MATRIX_OP_LOAD, GLT_MATRIX_OP_LOAD_PARAM,
+							 GLT_MATRIX_OP_MULT, GLT_MATRIX_OP_MULT_PARAM,
+							 GLT_MATRIX_OP_TRANSLATE, GLT_MATRIX_OP_ROTATE, GLT_MATRIX_OP_SCALE };
+
+		enum { GLT_MATRIX_LIST_NAME_LENGTH = 32 };
+
+		struct GLMatrixOp {
+			GLT_MATRIX_OP	op;
+			int				iInput;			// The operation whose result this one starts from, or -1
+			float			fArgs[4];		// Constants, or scales for the parameters
+			int				iSlot[4];		// Parameter for each argument, or -1
+			int				iMatrixSlot;	// Matrix parameter, or -1
+			unsigned int	nEvaluated;		// Replay this was last evaluated in
+			M3DMatrix44f	mMatrix;		// Constant matrix for LOAD and MULT
+			};
+
+		struct GLMatrixParameter {
+			char	szName[GLT_MATRIX_LIST_NAME_LENGTH];
+			float	fValue;
+			bool	bChanged;
+			int		iFirstUse;		// First operation that uses it, or -1
+			};
+
+		struct GLMatrixParameter44 {
+			char			szName[GLT_MATRIX_LIST_NAME_LENGTH];
+			M3DMatrix44f	mValue;
+			bool			bChanged;
+			int				iFirstUse;
+			};
+
+		static void SetName(char *szDest, const char *szName) {
+			strncpy(szDest, szName ? szName : "", GLT_MATRIX_LIST_NAME_LENGTH - 1);
+			szDest[GLT_MATRIX_LIST_NAME_LENGTH - 1] = '\0';
+			}
+
+		int AddOp(GLT_MATRIX_OP op, int iInput) {
+			if(nOps == nOpCapacity) {
+				int nNewCapacity = (nOpCapacity < 16) ? 16 : nOpCapacity * 2;
+				GLMatrixOp *pNewOps = new GLMatrixOp[nNewCapacity];
+				M3DMatrix44f *pNewResults = (M3DMatrix44f *)m3dAlignedAlloc(sizeof(M3DMatrix44f) * nNewCapacity, 64);
+				if(nOps > 0) {
+					memcpy(pNewOps, pOps, sizeof(GLMatrixOp) * nOps);
+					memcpy(pNewResults, pResults, sizeof(M3DMatrix44f) * nOps);
+					}
+				delete [] pOps;
+				m3dAlignedFree(pResults);
+				pOps = pNewOps;
+				pResults = pNewResults;
+				nOpCapacity = nNewCapacity;
+				}
+
+			GLMatrixOp &newOp = pOps[nOps];
+			newOp.op = op;
+			newOp.iInput = iInput;
+			for(int a = 0; a < 4; a++) {
+				newOp.fArgs[a] = 0.0f;
+				newOp.iSlot[a] = -1;
+				}
+			newOp.iMatrixSlot = -1;
+			newOp.nEvaluated = 0;
+			return nOps++;
+			}
+
+		void AddTransform(GLT_MATRIX_OP op, GLMatrixArg a0, GLMatrixArg a1, GLMatrixArg a2, GLMatrixArg a3) {
+			iTop = AddOp(op, iTop);
+			const GLMatrixArg *pArgs[4] = { &a0, &a1, &a2, &a3 };
+			for(int a = 0; a < 4; a++) {
+				pOps[iTop].fArgs[a] = pArgs[a]->fValue;
+				pOps[iTop].iSlot[a] = pArgs[a]->iSlot;
+				if(pArgs[a]->iSlot >= 0 && pParams[pArgs[a]->iSlot].iFirstUse < 0)
+					pParams[pArgs[a]->iSlot].iFirstUse = iTop;
+				}
+			}
+
+		void UseMatrixParameter(int iSlot) {
+			pOps[iTop].iMatrixSlot = iSlot;
+			if(pMatrixParams[iSlot].iFirstUse < 0)
+				pMatrixParams[iSlot].iFirstUse = iTop;
+			}
+
+		inline float Arg(const GLMatrixOp &op, int a) const {
+			return (op.iSlot[a] < 0) ? op.fArgs[a] : pParams[op.iSlot[a]].fValue * op.fArgs[a];
+			}
+
+		// The same kernels GLMatrixStack uses, so the results match it exactly
+		void Evaluate(int i) {
+			const GLMatrixOp &op = pOps[i];
+			M3DMatrix44f &m = pResults[i];
+			if(op.iInput >= 0)
+				m3dCopyMatrix44(m, pResults[op.iInput]);
+
+			switch(op.op) {
+				case GLT_MATRIX_OP_IDENTITY:
+					m3dLoadIdentity44(m);
+					break;
+				case GLT_MATRIX_OP_LOAD:
+					m3dCopyMatrix44(m, op.mMatrix);
+					break;
+				case GLT_MATRIX_OP_LOAD_PARAM:
+					m3dCopyMatrix44(m, pMatrixParams[op.iMatrixSlot].mValue);
+					break;
+				case GLT_MATRIX_OP_MULT:
+					m3dFastMatrixMultiply44(m, m, op.mMatrix);
+					break;
+				case GLT_MATRIX_OP_MULT_PARAM:
+					m3dFastMatrixMultiply44(m, m, pMatrixParams[op.iMatrixSlot].mValue);
+					break;
+				case GLT_MATRIX_OP_TRANSLATE:
+					m3dMultTranslation44(m, Arg(op, 1), Arg(op, 2), Arg(op, 3));
+					break;
+				case GLT_MATRIX_OP_ROTATE:
+					m3dMultRotation44(m, float(m3dDegToRad(Arg(op, 0))), Arg(op, 1), Arg(op, 2), Arg(op, 3));
+					break;
+				case GLT_MATRIX_OP_SCALE:
+					m3dMultScale44(m, Arg(op, 1), Arg(op, 2), Arg(op, 3));
+					break;
+				}
+			}
+
+		void Free(void) {
+			delete [] pOps;
+			m3dAlignedFree(pResults);
+			delete [] pOutputs;
+			delete [] pParams;
+			delete [] pMatrixParams;
+			delete [] pStack;
+			pOps = NULL; pResults = NULL; pOutputs = NULL;
+			pParams = NULL; pMatrixParams = NULL; pStack = NULL;
+			nOpCapacity = nOutputCapacity = 0;
+			nStackDepth = nStackCapacity = 0;
+			}
+
+		GLMatrixOp				*pOps;
+		M3DMatrix44f			*pResults;		// Result of each operation, 64 byte aligned
+		int						nOps;
+		int						nOpCapacity;
+
+		int						*pOutputs;		// Operation for each Emit()
+		int						nOutputs;
+		int						nOutputCapacity;
+
+		GLMatrixParameter		*pParams;
+		int						nParams;
+		GLMatrixParameter44		*pMatrixParams;
+		int						nMatrixParams;
+
+		// Recording state
+		int						iTop;
+		int						*pStack;		// Top at each PushMatrix()
+		int						nStackDepth;
+		int						nStackCapacity;
+
+		unsigned int			nReplays;
+		int						nReplayedOps;	// Operations that existed at the last Replay()
+		int						nLastEvaluated;
+
+	private:
+		GLMatrixCommandList(const GLMatrixCommandList&);
+		GLMatrixCommandList& operator=(const GLMatrixCommandList&);
+	};
+
+#endif
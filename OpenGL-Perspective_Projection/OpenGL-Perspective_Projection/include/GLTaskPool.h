@@ -0,0 +1,172 @@
+// GLTaskPool.h
+// A small work stealing thread pool for splitting per-frame CPU work (the
+// transform hierarchy update, culling) across cores.
+//
+// Run() hands the pool one task and returns once it, and every task it
+// spawned, has finished. The calling thread works too, as thread 0. A task
+// can Spawn() more tasks; they go on the back of the spawning thread's own
+// queue, and that thread takes work from the back (the newest, smallest
+// pieces first) while idle threads steal from the front of other queues (the
+// oldest, largest pieces).
+//
+// A task is a function pointer, a context pointer and a range, so nothing is
+// allocated per task:
+//
+//		static void CullRange(void *pContext, int iBegin, int iEnd, int iParam, int iThread);
+//		...
+//		GLTask task = { CullRange, &scene, 0, nObjects, 0 };
+//		taskPool.Run(task);
+
+#ifndef __GLT_TASK_POOL
+#define __GLT_TASK_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct GLTask
+	{
+	// iThread is the index (0 to GetThreadCount() - 1) of the thread running
+	// the task, for Spawn() and per-thread results
+	void	(*pRun)(void *pContext, int iBegin, int iEnd, int iParam, int iThread);
+	void	*pContext;
+	int		iBegin;
+	int		iEnd;
+	int		iParam;
+	};
+
+class GLTaskPool
+	{
+	public:
+		// nThreads counts the calling thread; 0 means one per core
+		GLTaskPool(int nThreads = 0) {
+			if(nThreads <= 0)
+				nThreads = int(std::thread::hardware_concurrency());
+			if(nThreads <= 0)
+				nThreads = 1;
+
+			nThreadCount = nThreads;
+			pQueues = new Queue[nThreads];
+			nPending = 0;
+			nJob = 0;
+			bQuit = false;
+			for(int i = 1; i < nThreads; i++)
+				workers.push_back(std::thread(&GLTaskPool::WorkerMain, this, i));
+			}
+
+		~GLTaskPool(void) {
+			{
+			std::lock_guard<std::mutex> lock(sleepLock);
+			bQuit = true;
+			}
+			wake.notify_all();
+			for(size_t i = 0; i < workers.size(); i++)
+				workers[i].join();
+			delete [] pQueues;
+			}
+
+		inline int GetThreadCount(void) const { return nThreadCount; }
+
+		// Run task and everything it spawns, on all the threads. Not reentrant:
+		// call it from one thread, and never from inside a task.
+		void Run(const GLTask& task) {
+			nPending.store(1);
+			Push(0, task);
+			if(nThreadCount > 1) {
+				{
+				std::lock_guard<std::mutex> lock(sleepLock);
+				nJob++;
+				}
+				wake.notify_all();
+				}
+			Work(0);
+			}
+
+		// Only from inside a running task, with the iThread it was given
+		inline void Spawn(int iThread, const GLTask& task) {
+			nPending.fetch_add(1);
+			Push(iThread, task);
+			}
+
+	protected:
+		struct Queue
+			{
+			std::mutex			lock;
+			std::deque<GLTask>	tasks;
+			};
+
+		void Push(int iThread, const GLTask& task) {
+			std::lock_guard<std::mutex> lock(pQueues[iThread].lock);
+			pQueues[iThread].tasks.push_back(task);
+			}
+
+		// Own queue from the back, then everyone else's from the front
+		bool Take(int iThread, GLTask& task) {
+			{
+			Queue& own = pQueues[iThread];
+			std::lock_guard<std::mutex> lock(own.lock);
+			if(!own.tasks.empty()) {
+				task = own.tasks.back();
+				own.tasks.pop_back();
+				return true;
+				}
+			}
+
+			for(int i = 1; i < nThreadCount; i++) {
+				Queue& victim = pQueues[(iThread + i) % nThreadCount];
+				std::lock_guard<std::mutex> lock(victim.lock);
+				if(!victim.tasks.empty()) {
+					task = victim.tasks.front();
+					victim.tasks.pop_front();
+					return true;
+					}
+				}
+			return false;
+			}
+
+		// Until nothing is left queued or running
+		void Work(int iThread) {
+			GLTask task;
+			while(nPending.load() > 0) {
+				if(Take(iThread, task)) {
+					task.pRun(task.pContext, task.iBegin, task.iEnd, task.iParam, iThread);
+					nPending.fetch_sub(1);
+					}
+				else
+					std::this_thread::yield();
+				}
+			}
+
+		void WorkerMain(int iThread) {
+			unsigned int nSeen = 0;
+			for(;;) {
+				{
+				std::unique_lock<std::mutex> lock(sleepLock);
+				while(!bQuit && nJob == nSeen)
+					wake.wait(lock);
+				if(bQuit)
+					return;
+				nSeen = nJob;
+				}
+				Work(iThread);
+				}
+			}
+
+		int							nThreadCount;
+		Queue						*pQueues;
+		std::vector<std::thread>	workers;
+		std::atomic<int>			nPending;	// Tasks queued or running
+		std::mutex					sleepLock;
+		std::condition_variable		wake;
+		unsigned int				nJob;		// Bumped by Run() to wake the workers
+		bool						bQuit;
+
+	private:
+		GLTaskPool(const GLTaskPool&);
+		GLTaskPool& operator=(const GLTaskPool&);
+	};
+
+#endif
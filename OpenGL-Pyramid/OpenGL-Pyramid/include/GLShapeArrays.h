@@ -0,0 +1,160 @@
+// GLShapeArrays.h
+// Array versions of the gltMakeSphere/Torus/Cylinder generators.
+// The GLTriangleBatch versions call sin and cos for every vertex of every
+// triangle, look every vertex up again to weld it, and top out at 65536 vertices
+// because of their GLushort indexes. These fill plain indexed arrays instead:
+// a (columns + 1) x (rows + 1) grid of vertices, with the seam vertices
+// duplicated so the texture coordinates wrap, and GLuint indexes for
+// columns * rows * 2 triangles (counter clockwise, facing out). All the sines
+// and cosines come from two m3dMakeRing tables, one per direction, so a
+// million vertex mesh needs a few thousand trig calls instead of millions.
+// Upload the arrays to your own buffer objects.
+//
+// Size the arrays with gltGetShapeArraySizes. pNorms and pTexCoords may be
+// NULL if they are not needed.
+
+#ifndef __GLT_SHAPE_ARRAYS
+#define __GLT_SHAPE_ARRAYS
+
+#include "GLTools.h"
+#include "math3d.h"
+
+inline void gltGetShapeArraySizes(GLint nColumns, GLint nRows, GLuint &nVerts, GLuint &nIndexes)
+	{
+	nVerts = GLuint(nColumns + 1) * GLuint(nRows + 1);
+	nIndexes = GLuint(nColumns) * GLuint(nRows) * 6;
+	}
+
+// Two triangles per grid cell. Row r, column c is vertex r * (nColumns + 1) + c.
+inline void gltMakeGridIndexes(GLuint *pIndexes, GLint nColumns, GLint nRows)
+	{
+	GLuint nStride = GLuint(nColumns + 1);
+	for(GLint r = 0; r < nRows; r++)
+		for(GLint c = 0; c < nColumns; c++)
+			{
+			GLuint v0 = GLuint(r) * nStride + GLuint(c);
+			GLuint v1 = v0 + nStride;
+			*pIndexes++ = v0; *pIndexes++ = v1; *pIndexes++ = v0 + 1;
+			*pIndexes++ = v1; *pIndexes++ = v1 + 1; *pIndexes++ = v0 + 1;
+			}
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Same shape and orientation as gltMakeSphere: centered on the origin, poles on
+// the Z axis. iSlices columns around, iStacks rows from +Z down to -Z.
+inline void gltMakeSphereArrays(M3DVector3f *pVerts, M3DVector3f *pNorms, M3DVector2f *pTexCoords, GLuint *pIndexes,
+								GLfloat fRadius, GLint iSlices, GLint iStacks)
+	{
+	float *pSinTheta = new float[(iSlices + 1) * 2 + (iStacks + 1) * 2];
+	float *pCosTheta = pSinTheta + iSlices + 1;
+	float *pSinRho = pCosTheta + iSlices + 1;
+	float *pCosRho = pSinRho + iStacks + 1;
+	m3dMakeRing(pSinTheta, pCosTheta, iSlices + 1, 0.0, M3D_2PI / iSlices);
+	m3dMakeRing(pSinRho, pCosRho, iStacks + 1, 0.0, M3D_PI / iStacks);
+
+	GLuint n = 0;
+	for(GLint i = 0; i <= iStacks; i++)
+		for(GLint j = 0; j <= iSlices; j++, n++)
+			{
+			float x = -pSinTheta[j] * pSinRho[i];
+			float y = pCosTheta[j] * pSinRho[i];
+			float z = pCosRho[i];
+
+			pVerts[n][0] = x * fRadius; pVerts[n][1] = y * fRadius; pVerts[n][2] = z * fRadius;
+			if(pNorms) {
+				pNorms[n][0] = x; pNorms[n][1] = y; pNorms[n][2] = z;
+				}
+			if(pTexCoords) {
+				pTexCoords[n][0] = float(j) / float(iSlices);
+				pTexCoords[n][1] = 1.0f - float(i) / float(iStacks);
+				}
+			}
+
+	gltMakeGridIndexes(pIndexes, iSlices, iStacks);
+	delete [] pSinTheta;
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Same shape and orientation as gltMakeTorus: lying in the XY plane around the
+// Z axis. numMajor steps around the ring, numMinor around the tube.
+inline void gltMakeTorusArrays(M3DVector3f *pVerts, M3DVector3f *pNorms, M3DVector2f *pTexCoords, GLuint *pIndexes,
+							   GLfloat majorRadius, GLfloat minorRadius, GLint numMajor, GLint numMinor)
+	{
+	float *pSinA = new float[(numMajor + 1) * 2 + (numMinor + 1) * 2];
+	float *pCosA = pSinA + numMajor + 1;
+	float *pSinB = pCosA + numMajor + 1;
+	float *pCosB = pSinB + numMinor + 1;
+	m3dMakeRing(pSinA, pCosA, numMajor + 1, 0.0, M3D_2PI / numMajor);
+	m3dMakeRing(pSinB, pCosB, numMinor + 1, 0.0, M3D_2PI / numMinor);
+
+	// Rows go around the ring, columns around the tube
+	GLuint n = 0;
+	for(GLint i = 0; i <= numMajor; i++)
+		for(GLint j = 0; j <= numMinor; j++, n++)
+			{
+			float r = minorRadius * pCosB[j] + majorRadius;
+
+			pVerts[n][0] = pCosA[i] * r;
+			pVerts[n][1] = pSinA[i] * r;
+			pVerts[n][2] = minorRadius * pSinB[j];
+			if(pNorms) {
+				pNorms[n][0] = pCosA[i] * pCosB[j];
+				pNorms[n][1] = pSinA[i] * pCosB[j];
+				pNorms[n][2] = pSinB[j];
+				}
+			if(pTexCoords) {
+				pTexCoords[n][0] = float(i) / float(numMajor);
+				pTexCoords[n][1] = float(j) / float(numMinor);
+				}
+			}
+
+	gltMakeGridIndexes(pIndexes, numMinor, numMajor);
+	delete [] pSinA;
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Same shape and orientation as gltMakeCylinder: the base circle sits at z = 0
+// and the top at z = fLength. No end caps, just like the original.
+inline void gltMakeCylinderArrays(M3DVector3f *pVerts, M3DVector3f *pNorms, M3DVector2f *pTexCoords, GLuint *pIndexes,
+								  GLfloat baseRadius, GLfloat topRadius, GLfloat fLength, GLint numSlices, GLint numStacks)
+	{
+	float *pSinTheta = new float[(numSlices + 1) * 2];
+	float *pCosTheta = pSinTheta + numSlices + 1;
+	m3dMakeRing(pSinTheta, pCosTheta, numSlices + 1, 0.0, M3D_2PI / numSlices);
+
+	// The side slopes in when the top is smaller, so the normals tip up
+	float fSlope = (fLength != 0.0f) ? (baseRadius - topRadius) / fLength : 0.0f;
+	float fNormScale = 1.0f / sqrtf(1.0f + fSlope * fSlope);
+
+	GLuint n = 0;
+	for(GLint i = 0; i <= numStacks; i++)
+		{
+		float t = float(i) / float(numStacks);
+		float fRadius = baseRadius + (topRadius - baseRadius) * t;
+		float z = fLength * t;
+
+		for(GLint j = 0; j <= numSlices; j++, n++)
+			{
+			pVerts[n][0] = fRadius * pSinTheta[j];
+			pVerts[n][1] = fRadius * pCosTheta[j];
+			pVerts[n][2] = z;
+			if(pNorms) {
+				pNorms[n][0] = pSinTheta[j] * fNormScale;
+				pNorms[n][1] = pCosTheta[j] * fNormScale;
+				pNorms[n][2] = fSlope * fNormScale;
+				}
+			if(pTexCoords) {
+				pTexCoords[n][0] = float(j) / float(numSlices);
+				pTexCoords[n][1] = t;
+				}
+			}
+		}
+
+	gltMakeGridIndexes(pIndexes, numSlices, numStacks);
+	delete [] pSinTheta;
+	}
+
+#endif
@@ -0,0 +1,162 @@
+// GLTangentTriangleBatch.h
+// A GLTriangleBatch with a fourth vertex attribute, the tangent, for normal
+// mapping. Tangents are worked out for the whole mesh when End() is called
+// (m3dCalculateTangentArray) and go into their own buffer object, bound to
+// GLT_ATTRIBUTE_TANGENT as a vec4: xyz is the tangent and w is +1 or -1, so
+// the vertex shader can rebuild the bitangent as cross(vNormal, vTangent.xyz) * vTangent.w.
+// Bind the attribute name when you load the shader:
+//
+//		gltLoadShaderPairWithAttributes("Bump.vp", "Bump.fp", 4,
+//				GLT_ATTRIBUTE_VERTEX, "vVertex", GLT_ATTRIBUTE_NORMAL, "vNormal",
+//				GLT_ATTRIBUTE_TEXTURE0, "vTexture0", GLT_ATTRIBUTE_TANGENT, "vTangent");
+//
+// Nothing is computed at draw time.
+//
+// GLTriangleBatch::End() is not virtual, so the library's gltMakeSphere and
+// gltMakeTorus would skip the tangents. The overloads at the bottom of this file
+// build the same shapes straight into a GLTangentTriangleBatch, so switching a
+// model to normal mapping is just a change of batch type.
+
+#ifndef __GLT_TANGENT_TRIANGLE_BATCH
+#define __GLT_TANGENT_TRIANGLE_BATCH
+
+#include <GLTriangleBatch.h>
+#include <GLShapeArrays.h>
+#include <math3dSIMD.h>
+
+// The stock shaders stop at GLT_ATTRIBUTE_TEXTURE3; tangents take the next slot
+#define GLT_ATTRIBUTE_TANGENT	GLT_ATTRIBUTE_LAST
+
+class GLTangentTriangleBatch : public GLTriangleBatch
+	{
+	public:
+		GLTangentTriangleBatch(void) { tangentBuffer = 0; }
+
+		virtual ~GLTangentTriangleBatch(void)
+			{
+			if(tangentBuffer != 0)
+				glDeleteBuffers(1, &tangentBuffer);
+			}
+
+		// Load already indexed arrays (for example from GLShapeArrays.h) in place
+		// of BeginMesh/AddTriangle, which has to search for every vertex it adds.
+		// Call End() afterwards as usual. The indexes are GLushort once they are
+		// in the batch, so nVerts can be at most 65536.
+		bool CopyMesh(const M3DVector3f *pNewVerts, const M3DVector3f *pNewNorms, const M3DVector2f *pNewTexCoords, GLuint nVerts,
+					  const GLuint *pNewIndexes, GLuint nIndexes)
+			{
+			if(nVerts > 65536)
+				return false;
+
+			delete [] pIndexes;
+			delete [] pVerts;
+			delete [] pNorms;
+			delete [] pTexCoords;
+
+			pIndexes = new GLushort[nIndexes];
+			pVerts = new M3DVector3f[nVerts];
+			pNorms = new M3DVector3f[nVerts];
+			pTexCoords = new M3DVector2f[nVerts];
+			for(GLuint i = 0; i < nIndexes; i++)
+				pIndexes[i] = GLushort(pNewIndexes[i]);
+			memcpy(pVerts, pNewVerts, sizeof(M3DVector3f) * nVerts);
+			memcpy(pNorms, pNewNorms, sizeof(M3DVector3f) * nVerts);
+			memcpy(pTexCoords, pNewTexCoords, sizeof(M3DVector2f) * nVerts);
+
+			nMaxIndexes = nNumIndexes = nIndexes;
+			nNumVerts = nVerts;
+			return true;
+			}
+
+		// Same as GLTriangleBatch::End(), plus the tangent buffer
+		void End(void)
+			{
+			if(pVerts == NULL || pNorms == NULL || pTexCoords == NULL || nNumVerts == 0) {
+				GLTriangleBatch::End();
+				return;
+				}
+
+			M3DVector4f *pTangents = new M3DVector4f[nNumVerts];
+			m3dCalculateTangentArray(pTangents, pVerts, pNorms, pTexCoords, int(nNumVerts), pIndexes, int(nNumIndexes));
+
+			// This uploads the other arrays, sets up the vertex array object and
+			// frees the client side copies
+			GLTriangleBatch::End();
+
+#ifndef OPENGL_ES
+			glBindVertexArray(vertexArrayBufferObject);
+#endif
+			if(tangentBuffer == 0)
+				glGenBuffers(1, &tangentBuffer);
+			glBindBuffer(GL_ARRAY_BUFFER, tangentBuffer);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 4 * nNumVerts, pTangents, GL_STATIC_DRAW);
+#ifndef OPENGL_ES
+			glEnableVertexAttribArray(GLT_ATTRIBUTE_TANGENT);
+			glVertexAttribPointer(GLT_ATTRIBUTE_TANGENT, 4, GL_FLOAT, GL_FALSE, 0, 0);
+			glBindVertexArray(0);
+#endif
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+			delete [] pTangents;
+			}
+
+		virtual void Draw(void)
+			{
+#ifdef OPENGL_ES
+			// No vertex array objects, so the tangents are bound every time
+			glBindBuffer(GL_ARRAY_BUFFER, tangentBuffer);
+			glEnableVertexAttribArray(GLT_ATTRIBUTE_TANGENT);
+			glVertexAttribPointer(GLT_ATTRIBUTE_TANGENT, 4, GL_FLOAT, GL_FALSE, 0, 0);
+#endif
+			GLTriangleBatch::Draw();
+#ifdef OPENGL_ES
+			glDisableVertexAttribArray(GLT_ATTRIBUTE_TANGENT);
+#endif
+			}
+
+	protected:
+		GLuint tangentBuffer;
+	};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Normal mapped versions of gltMakeSphere and gltMakeTorus. Same shape, size
+// and orientation as the library versions, built with the GLShapeArrays.h
+// generators instead of AddTriangle.
+inline void gltMakeSphere(GLTangentTriangleBatch& sphereBatch, GLfloat fRadius, GLint iSlices, GLint iStacks)
+	{
+	GLuint nVerts, nIndexes;
+	gltGetShapeArraySizes(iSlices, iStacks, nVerts, nIndexes);
+
+	M3DVector3f *pVerts = new M3DVector3f[nVerts * 2];
+	M3DVector2f *pTexCoords = new M3DVector2f[nVerts];
+	GLuint *pIndexes = new GLuint[nIndexes];
+	gltMakeSphereArrays(pVerts, pVerts + nVerts, pTexCoords, pIndexes, fRadius, iSlices, iStacks);
+
+	if(sphereBatch.CopyMesh(pVerts, pVerts + nVerts, pTexCoords, nVerts, pIndexes, nIndexes))
+		sphereBatch.End();
+
+	delete [] pVerts;
+	delete [] pTexCoords;
+	delete [] pIndexes;
+	}
+
+inline void gltMakeTorus(GLTangentTriangleBatch& torusBatch, GLfloat majorRadius, GLfloat minorRadius, GLint numMajor, GLint numMinor)
+	{
+	GLuint nVerts, nIndexes;
+	gltGetShapeArraySizes(numMinor, numMajor, nVerts, nIndexes);
+
+	M3DVector3f *pVerts = new M3DVector3f[nVerts * 2];
+	M3DVector2f *pTexCoords = new M3DVector2f[nVerts];
+	GLuint *pIndexes = new GLuint[nIndexes];
+	gltMakeTorusArrays(pVerts, pVerts + nVerts, pTexCoords, pIndexes, majorRadius, minorRadius, numMajor, numMinor);
+
+	if(torusBatch.CopyMesh(pVerts, pVerts + nVerts, pTexCoords, nVerts, pIndexes, nIndexes))
+		torusBatch.End();
+
+	delete [] pVerts;
+	delete [] pTexCoords;
+	delete [] pIndexes;
+	}
+
+#endif
@@ -0,0 +1,408 @@
+// math3dTemplates.h
+// Templated front end for the Math3D library.
+// m3d::Vec<N,T> and m3d::Mat<N,T> have exactly the layout of the C array
+// typedefs (M3DVector3f, M3DMatrix44f, ...), so the two can be used together
+// freely. AsVec()/AsMat() view an existing array as a Vec/Mat without copying,
+// and a Vec/Mat converts to a plain pointer for any m3d* function.
+//
+// Arithmetic builds expression objects instead of temporaries, and nothing is
+// computed until the result is assigned. Matrix products are evaluated
+// left to right straight into the destination, and the common transforms
+// (Translate, Rotate, Scale) are applied in place by only touching the
+// columns they change. So
+//
+//		m3d::AsMat(mModel) = m3d::Translate(x, y, z) * m3d::Rotate(a, 0, 1, 0) * m3d::Scale(s, s, s);
+//
+// is one pass over mModel with no 64 byte temporaries, and gives the same
+// bits as the same sequence of GLMatrixStack calls.
+//
+// Expressions hold references to their operands, so they are meant to be
+// assigned in the same statement they are written in, not stored with auto.
+
+#ifndef __MATH3D_TEMPLATES__
+#define __MATH3D_TEMPLATES__
+
+#include "math3d.h"
+
+namespace m3d {
+
+// Same ordering as GLT_MATRIX_CLASS in GLMatrixStack.h
+enum { MATRIX_GENERAL = 0, MATRIX_AFFINE, MATRIX_RIGID };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Vectors
+
+template <class D, int N, typename T> struct VecExpr
+	{
+	constexpr const D& Self(void) const { return static_cast<const D&>(*this); }
+	constexpr T operator[](int i) const { return Self()[i]; }
+	};
+
+template <int N, typename T> struct Vec : public VecExpr<Vec<N, T>, N, T>
+	{
+	T v[N];
+
+	constexpr Vec(void) : v{} {}
+	constexpr Vec(T x, T y) : v{x, y} {}
+	constexpr Vec(T x, T y, T z) : v{x, y, z} {}
+	constexpr Vec(T x, T y, T z, T w) : v{x, y, z, w} {}
+	Vec(const T *p) { for(int i = 0; i < N; i++) v[i] = p[i]; }
+
+	// Elementwise expressions read only their own element, so assigning
+	// one into a vector it reads from is safe.
+	template <class E> constexpr Vec(const VecExpr<E, N, T>& e) : v{}
+		{ for(int i = 0; i < N; i++) v[i] = e[i]; }
+
+	template <class E> Vec& operator=(const VecExpr<E, N, T>& e)
+		{ for(int i = 0; i < N; i++) v[i] = e[i]; return *this; }
+
+	constexpr T& operator[](int i) { return v[i]; }
+	constexpr const T& operator[](int i) const { return v[i]; }
+
+	operator T*(void) { return v; }
+	operator const T*(void) const { return v; }
+	};
+
+template <class L, class R, int N, typename T> struct VecSum : public VecExpr<VecSum<L, R, N, T>, N, T>
+	{
+	const L& l; const R& r;
+	constexpr VecSum(const L& a, const R& b) : l(a), r(b) {}
+	constexpr T operator[](int i) const { return l[i] + r[i]; }
+	};
+
+template <class L, class R, int N, typename T> struct VecDifference : public VecExpr<VecDifference<L, R, N, T>, N, T>
+	{
+	const L& l; const R& r;
+	constexpr VecDifference(const L& a, const R& b) : l(a), r(b) {}
+	constexpr T operator[](int i) const { return l[i] - r[i]; }
+	};
+
+template <class E, int N, typename T> struct VecScaled : public VecExpr<VecScaled<E, N, T>, N, T>
+	{
+	const E& e; T s;
+	constexpr VecScaled(const E& a, T b) : e(a), s(b) {}
+	constexpr T operator[](int i) const { return e[i] * s; }
+	};
+
+template <class L, class R, int N, typename T>
+constexpr VecSum<L, R, N, T> operator+(const VecExpr<L, N, T>& a, const VecExpr<R, N, T>& b)
+	{ return VecSum<L, R, N, T>(a.Self(), b.Self()); }
+
+template <class L, class R, int N, typename T>
+constexpr VecDifference<L, R, N, T> operator-(const VecExpr<L, N, T>& a, const VecExpr<R, N, T>& b)
+	{ return VecDifference<L, R, N, T>(a.Self(), b.Self()); }
+
+template <class E, int N, typename T>
+constexpr VecScaled<E, N, T> operator*(const VecExpr<E, N, T>& a, T s)
+	{ return VecScaled<E, N, T>(a.Self(), s); }
+
+template <class E, int N, typename T>
+constexpr VecScaled<E, N, T> operator*(T s, const VecExpr<E, N, T>& a)
+	{ return VecScaled<E, N, T>(a.Self(), s); }
+
+template <class L, class R, int N, typename T>
+constexpr T Dot(const VecExpr<L, N, T>& a, const VecExpr<R, N, T>& b)
+	{
+	T d = a[0] * b[0];
+	for(int i = 1; i < N; i++)
+		d += a[i] * b[i];
+	return d;
+	}
+
+template <class L, class R, typename T>
+constexpr Vec<3, T> Cross(const VecExpr<L, 3, T>& u, const VecExpr<R, 3, T>& v)
+	{ return Vec<3, T>(u[1]*v[2] - v[1]*u[2], -u[0]*v[2] + v[0]*u[2], u[0]*v[1] - v[0]*u[1]); }
+
+template <class E, int N, typename T>
+inline T Length(const VecExpr<E, N, T>& a)
+	{ return T(sqrt(Dot(a, a))); }
+
+template <class E, int N, typename T>
+inline Vec<N, T> Normalize(const VecExpr<E, N, T>& a)
+	{ return Vec<N, T>(a * (T(1) / Length(a))); }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Matrices, column major like everything else in math3d.
+// Every matrix expression knows how to
+//	EvalInto(m)		write itself into m
+//	ApplyRight(m)	replace m with m * itself, in place
+//	Aliases(p)		does it read from p
+//	LeadAliases(p)	would EvalInto(p) followed by the rest of the chain read p
+//					after it was overwritten
+//	Class()			MATRIX_RIGID, MATRIX_AFFINE or MATRIX_GENERAL
+
+template <class D, int N, typename T> struct MatExpr
+	{
+	constexpr const D& Self(void) const { return static_cast<const D&>(*this); }
+	};
+
+template <int N, typename T> struct Mat : public MatExpr<Mat<N, T>, N, T>
+	{
+	T m[N * N];
+
+	constexpr Mat(void) : m{} {}
+	Mat(const T *p) { for(int i = 0; i < N * N; i++) m[i] = p[i]; }
+
+	template <class E> Mat(const MatExpr<E, N, T>& e) : m{}
+		{ e.Self().EvalInto(m); }
+
+	template <class E> Mat& operator=(const MatExpr<E, N, T>& e)
+		{
+		const E& expr = e.Self();
+		if(expr.LeadAliases(m)) {
+			T mTemp[N * N];
+			expr.EvalInto(mTemp);
+			for(int i = 0; i < N * N; i++) m[i] = mTemp[i];
+			}
+		else
+			expr.EvalInto(m);
+		return *this;
+		}
+
+	// m = m * e. Nothing is copied unless e reads from m itself.
+	template <class E> Mat& operator*=(const MatExpr<E, N, T>& e)
+		{
+		const E& expr = e.Self();
+		if(expr.Aliases(m)) {
+			T mRight[N * N];
+			expr.EvalInto(mRight);
+			Mat<N, T>::ApplyRight(m, mRight);
+			}
+		else
+			expr.ApplyRight(m);
+		return *this;
+		}
+
+	static constexpr Mat Identity(void)
+		{
+		Mat<N, T> r;
+		for(int i = 0; i < N; i++) r.m[i * N + i] = T(1);
+		return r;
+		}
+
+	constexpr T& operator()(int row, int col) { return m[col * N + row]; }
+	constexpr const T& operator()(int row, int col) const { return m[col * N + row]; }
+
+	operator T*(void) { return m; }
+	operator const T*(void) const { return m; }
+
+	// Expression interface
+	void EvalInto(T *d) const { if(d != m) for(int i = 0; i < N * N; i++) d[i] = m[i]; }
+	void ApplyRight(T *d) const { ApplyRight(d, m); }
+	bool Aliases(const T *p) const { return p == m; }
+	bool LeadAliases(const T *) const { return false; }
+	int Class(void) const
+		{
+		for(int i = 0; i < N - 1; i++)
+			if(m[i * N + N - 1] != T(0)) return MATRIX_GENERAL;
+		return (m[N * N - 1] == T(1)) ? MATRIX_AFFINE : MATRIX_GENERAL;
+		}
+
+	// d = d * b one row at a time, so only one row of scratch is needed. The
+	// sum order matches m3dMatrixMultiply44, so the results are identical.
+	static void ApplyRight(T *d, const T *b)
+		{
+		for(int i = 0; i < N; i++) {
+			T row[N];
+			for(int j = 0; j < N; j++) {
+				T s = d[i] * b[j * N];
+				for(int k = 1; k < N; k++)
+					s += d[k * N + i] * b[j * N + k];
+				row[j] = s;
+				}
+			for(int j = 0; j < N; j++)
+				d[j * N + i] = row[j];
+			}
+		}
+	};
+
+template <class L, class R, int N, typename T> struct MatProduct : public MatExpr<MatProduct<L, R, N, T>, N, T>
+	{
+	// Leaf matrices are held by reference, the small transform nodes by value
+	const L l; const R r;
+	MatProduct(const L& a, const R& b) : l(a), r(b) {}
+
+	void EvalInto(T *d) const { l.EvalInto(d); r.ApplyRight(d); }
+	void ApplyRight(T *d) const { l.ApplyRight(d); r.ApplyRight(d); }
+	bool Aliases(const T *p) const { return l.Aliases(p) || r.Aliases(p); }
+	bool LeadAliases(const T *p) const { return l.LeadAliases(p) || r.Aliases(p); }
+	int Class(void) const { int a = l.Class(), b = r.Class(); return (a < b) ? a : b; }
+	};
+
+// Reference to a leaf matrix inside a product, so products never copy one
+template <int N, typename T> struct MatRef : public MatExpr<MatRef<N, T>, N, T>
+	{
+	const Mat<N, T>& mat;
+	MatRef(const Mat<N, T>& a) : mat(a) {}
+
+	void EvalInto(T *d) const { mat.EvalInto(d); }
+	void ApplyRight(T *d) const { mat.ApplyRight(d); }
+	bool Aliases(const T *p) const { return mat.Aliases(p); }
+	bool LeadAliases(const T *p) const { return mat.LeadAliases(p); }
+	int Class(void) const { return mat.Class(); }
+	};
+
+template <class E> struct MatOperand { typedef E Type; };
+template <int N, typename T> struct MatOperand< Mat<N, T> > { typedef MatRef<N, T> Type; };
+
+template <class L, class R, int N, typename T>
+inline MatProduct<typename MatOperand<L>::Type, typename MatOperand<R>::Type, N, T>
+operator*(const MatExpr<L, N, T>& a, const MatExpr<R, N, T>& b)
+	{ return MatProduct<typename MatOperand<L>::Type, typename MatOperand<R>::Type, N, T>(a.Self(), b.Self()); }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The usual transforms as 4x4 expressions. Applied on the right they only
+// touch the columns they change.
+
+template <typename T> struct TranslateExpr : public MatExpr<TranslateExpr<T>, 4, T>
+	{
+	T x, y, z;
+	constexpr TranslateExpr(T a, T b, T c) : x(a), y(b), z(c) {}
+
+	void EvalInto(T *d) const
+		{
+		for(int i = 0; i < 16; i++) d[i] = (i % 5 == 0) ? T(1) : T(0);
+		d[12] = x; d[13] = y; d[14] = z;
+		}
+	void ApplyRight(T *d) const
+		{
+		for(int i = 0; i < 4; i++)
+			d[12 + i] = d[i] * x + d[4 + i] * y + d[8 + i] * z + d[12 + i];
+		}
+	bool Aliases(const T *) const { return false; }
+	bool LeadAliases(const T *) const { return false; }
+	int Class(void) const { return MATRIX_RIGID; }
+	};
+
+template <typename T> struct ScaleExpr : public MatExpr<ScaleExpr<T>, 4, T>
+	{
+	T x, y, z;
+	constexpr ScaleExpr(T a, T b, T c) : x(a), y(b), z(c) {}
+
+	void EvalInto(T *d) const
+		{
+		for(int i = 0; i < 16; i++) d[i] = T(0);
+		d[0] = x; d[5] = y; d[10] = z; d[15] = T(1);
+		}
+	void ApplyRight(T *d) const
+		{
+		for(int i = 0; i < 4; i++) {
+			d[i] *= x; d[4 + i] *= y; d[8 + i] *= z;
+			}
+		}
+	bool Aliases(const T *) const { return false; }
+	bool LeadAliases(const T *) const { return false; }
+	int Class(void) const { return MATRIX_AFFINE; }
+	};
+
+template <typename T> struct RotateExpr : public MatExpr<RotateExpr<T>, 4, T>
+	{
+	T r[9];		// 3x3 rotation, column major
+
+	// Same formula as m3dRotationMatrix44, so the results match it exactly
+	RotateExpr(T angle, T x, T y, T z)
+		{
+		T mag = T(sqrt(x*x + y*y + z*z));
+		if(mag == T(0)) {
+			r[0] = T(1); r[1] = T(0); r[2] = T(0);
+			r[3] = T(0); r[4] = T(1); r[5] = T(0);
+			r[6] = T(0); r[7] = T(0); r[8] = T(1);
+			return;
+			}
+
+		T s = T(sin(angle)), c = T(cos(angle));
+		x /= mag; y /= mag; z /= mag;
+		T xx = x * x, yy = y * y, zz = z * z;
+		T xy = x * y, yz = y * z, zx = z * x;
+		T xs = x * s, ys = y * s, zs = z * s;
+		T one_c = T(1) - c;
+
+		r[0] = (one_c * xx) + c;  r[3] = (one_c * xy) - zs; r[6] = (one_c * zx) + ys;
+		r[1] = (one_c * xy) + zs; r[4] = (one_c * yy) + c;  r[7] = (one_c * yz) - xs;
+		r[2] = (one_c * zx) - ys; r[5] = (one_c * yz) + xs; r[8] = (one_c * zz) + c;
+		}
+
+	void EvalInto(T *d) const
+		{
+		d[0] = r[0]; d[1] = r[1]; d[2]  = r[2]; d[3]  = T(0);
+		d[4] = r[3]; d[5] = r[4]; d[6]  = r[5]; d[7]  = T(0);
+		d[8] = r[6]; d[9] = r[7]; d[10] = r[8]; d[11] = T(0);
+		d[12] = T(0); d[13] = T(0); d[14] = T(0); d[15] = T(1);
+		}
+	void ApplyRight(T *d) const
+		{
+		for(int i = 0; i < 4; i++) {
+			T a0 = d[i], a1 = d[4 + i], a2 = d[8 + i];
+			d[i]     = a0 * r[0] + a1 * r[1] + a2 * r[2];
+			d[4 + i] = a0 * r[3] + a1 * r[4] + a2 * r[5];
+			d[8 + i] = a0 * r[6] + a1 * r[7] + a2 * r[8];
+			}
+		}
+	bool Aliases(const T *) const { return false; }
+	bool LeadAliases(const T *) const { return false; }
+	int Class(void) const { return MATRIX_RIGID; }
+	};
+
+template <typename T> constexpr TranslateExpr<T> Translate(T x, T y, T z) { return TranslateExpr<T>(x, y, z); }
+template <typename T> constexpr ScaleExpr<T> Scale(T x, T y, T z) { return ScaleExpr<T>(x, y, z); }
+
+// Angle in radians, like m3dRotationMatrix44
+template <typename T> inline RotateExpr<T> Rotate(T angle, T x, T y, T z) { return RotateExpr<T>(angle, x, y, z); }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Matrix times vector
+
+template <class E, typename T> inline Vec<4, T> operator*(const MatExpr<E, 4, T>& e, const Vec<4, T>& v)
+	{
+	Mat<4, T> mat(e);
+	return Vec<4, T>(mat.m[0] * v[0] + mat.m[4] * v[1] + mat.m[8]  * v[2] + mat.m[12] * v[3],
+					 mat.m[1] * v[0] + mat.m[5] * v[1] + mat.m[9]  * v[2] + mat.m[13] * v[3],
+					 mat.m[2] * v[0] + mat.m[6] * v[1] + mat.m[10] * v[2] + mat.m[14] * v[3],
+					 mat.m[3] * v[0] + mat.m[7] * v[1] + mat.m[11] * v[2] + mat.m[15] * v[3]);
+	}
+
+template <class E, typename T> inline Vec<3, T> operator*(const MatExpr<E, 3, T>& e, const Vec<3, T>& v)
+	{
+	Mat<3, T> mat(e);
+	return Vec<3, T>(mat.m[0] * v[0] + mat.m[3] * v[1] + mat.m[6] * v[2],
+					 mat.m[1] * v[0] + mat.m[4] * v[1] + mat.m[7] * v[2],
+					 mat.m[2] * v[0] + mat.m[5] * v[1] + mat.m[8] * v[2]);
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Views of the plain math3d arrays, no copying
+
+template <int S> struct MatDimension { };
+template <> struct MatDimension<9> { enum { N = 3 }; };
+template <> struct MatDimension<16> { enum { N = 4 }; };
+
+template <typename T, int N> inline Vec<N, T>& AsVec(T (&v)[N])
+	{ return *reinterpret_cast<Vec<N, T> *>(v); }
+
+template <typename T, int N> inline const Vec<N, T>& AsVec(const T (&v)[N])
+	{ return *reinterpret_cast<const Vec<N, T> *>(v); }
+
+template <typename T, int S> inline Mat<MatDimension<S>::N, T>& AsMat(T (&m)[S])
+	{ return *reinterpret_cast<Mat<MatDimension<S>::N, T> *>(m); }
+
+template <typename T, int S> inline const Mat<MatDimension<S>::N, T>& AsMat(const T (&m)[S])
+	{ return *reinterpret_cast<const Mat<MatDimension<S>::N, T> *>(m); }
+
+typedef Vec<2, float>	Vec2f;
+typedef Vec<3, float>	Vec3f;
+typedef Vec<4, float>	Vec4f;
+typedef Mat<3, float>	Mat3f;
+typedef Mat<4, float>	Mat4f;
+typedef Vec<3, double>	Vec3d;
+typedef Vec<4, double>	Vec4d;
+typedef Mat<3, double>	Mat3d;
+typedef Mat<4, double>	Mat4d;
+
+}	// namespace m3d
+
+#endif
@@ -12,6 +12,7 @@
 #include "GLBatch.h"
 #include "GLMatrixStack.h"
 #include "GLGeometryTransform.h"
+#include "GLTransformHierarchy.h"
 #include "StopWatch.h"
 
 #include <math.h>
@@ -37,6 +38,11 @@ GLBatch                  floorBatch;        // 地板批处理
 GLTriangleBatch          sphereBatch;       // 球批处理
 GLFrame                  cameraFrame;       // 角色帧 照相机角色帧（全剧照相机实例）
 
+// 圆环和公转球体的层级变换：圆环和公转球体都挂在平移节点下面，每帧只改自己的局部矩阵，
+// 两次绘制（镜像和正常）共用一次Update()算出的世界矩阵
+GLTransformHierarchy     sceneGraph;
+int                      iSongAndDance, iTorus, iOrbit;
+
 // 纹理标记数组
 GLuint uiTextures[3];
 
@@ -153,6 +159,14 @@ void SetupRC() {
         // 对spheres数组终的每个顶点，设置顶点数据
         spheres[i].SetOrigin(x, 0.0f, z);
     }
+    
+    // 圆环和公转球体的父节点：沿着z轴移动2.5个单位
+    M3DMatrix44f mTranslate;
+    m3dTranslationMatrix44(mTranslate, 0.0f, 0.2f, -2.5f);
+    iSongAndDance = sceneGraph.AddNode();
+    sceneGraph.SetLocalMatrix(iSongAndDance, mTranslate);
+    iTorus = sceneGraph.AddNode(iSongAndDance);
+    iOrbit = sceneGraph.AddNode(iSongAndDance);
 }
 
 void ShutdownRC() {
@@ -177,7 +191,7 @@ void ChangeSize(int w, int h) {
     modelViewMatrix.LoadIdentity();
 }
 
-void DrawSongAndDance(GLfloat yRot) {
+void DrawSongAndDance() {
     static GLfloat vWhite[] = { 1.0f, 1.0f, 1.0f, 1.0f };
     static GLfloat vLightPos[] = {  0.0f, 3.0f, 0.0f, 1.0f };
     /*
@@ -212,10 +226,18 @@ void DrawSongAndDance(GLfloat yRot) {
      绑定纹理
      */
     glBindTexture(GL_TEXTURE_2D, uiTextures[2]);
-    // 循环绘制50个悬浮球体，绘制一个压栈一个，绘制完成出栈一个
+    // 直接从当前的模型视图投影矩阵求出视景体的6个平面（世界坐标系），
+    // 镜像那一遍的矩阵里带着Scale(1,-1,1)也一样适用，看不见的球体不画
+    viewFrustum.ExtractPlanes(transformPipeline.GetModelViewProjectionMatrix());
+    // 一次算出50个悬浮球体的模型视图矩阵，再循环绘制
+    static M3DMatrix44f mSphereModelView[NUM_SPHERES];
+    transformPipeline.GetModelViewProjectionMatrices(spheres, NUM_SPHERES, mSphereModelView, NULL);
     for (int i = 0; i < NUM_SPHERES; i++) {
-        modelViewMatrix.PushMatrix();
-        modelViewMatrix.MultMatrix(spheres[i]);
+        M3DVector3f vCenter;
+        spheres[i].GetOrigin(vCenter);
+        if (!viewFrustum.TestSphere(vCenter, 0.1f)) {
+            continue;
+        }
         /*
          绘制光源，修改着色器管理器
          参数1: GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF
@@ -225,16 +247,11 @@ void DrawSongAndDance(GLfloat yRot) {
          参数5: 反射颜色
          参数6: 颜色（使用纹理则不用颜色）
          */
-        shaderManager.UseStockShader(GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF, modelViewMatrix.GetMatrix(), transformPipeline.GetProjectionMatrix(), vLightTransformed, vWhite, 0);
+        shaderManager.UseStockShader(GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF, mSphereModelView[i], transformPipeline.GetProjectionMatrix(), vLightTransformed, vWhite, 0);
         sphereBatch.Draw();
-        modelViewMatrix.PopMatrix();
     }
-    // 绘制旋转圆环
-    modelViewMatrix.Translate(0.0f, 0.2f, -2.5f);     // modelViewMatrix 顶部矩阵沿着z轴移动2.5个单位
-    // 保存平移（公转自转）
-    modelViewMatrix.PushMatrix();
-    // modelmodelViewMatrix 顶部矩阵旋转yRot度
-    modelViewMatrix.Rotate(yRot, 0.0f, 1.0f, 0.0f);
+    // 绘制旋转圆环，压入圆环节点的世界矩阵（平移后自转，角度在 RenderScene 里设置）
+    sceneGraph.PushWorldMatrix(modelViewMatrix, iTorus);
     
     // 绑定纹理
     glBindTexture(GL_TEXTURE_2D, uiTextures[1]);
@@ -253,9 +270,8 @@ void DrawSongAndDance(GLfloat yRot) {
     // 恢复矩阵
     modelViewMatrix.PopMatrix();
     
-    // 绘制公转球体
-    modelViewMatrix.Rotate(yRot * -2.0f, 0.0f, 1.0f, 0.0f);
-    modelViewMatrix.Translate(0.8f, 0.0f, 0.0f);
+    // 绘制公转球体，压入公转球体节点的世界矩阵
+    sceneGraph.PushWorldMatrix(modelViewMatrix, iOrbit);
     // 绑定纹理
     glBindTexture(GL_TEXTURE_2D, uiTextures[2]);
     /*
@@ -269,6 +285,9 @@ void DrawSongAndDance(GLfloat yRot) {
      */
     shaderManager.UseStockShader(GLT_SHADER_TEXTURE_POINT_LIGHT_DIFF, modelViewMatrix.GetMatrix(), transformPipeline.GetProjectionMatrix(), vLightTransformed, vWhite, 0);
     sphereBatch.Draw();
+    
+    // 恢复矩阵
+    modelViewMatrix.PopMatrix();
 }
 
 void RenderScene() {
@@ -278,6 +297,15 @@ void RenderScene() {
     static CStopWatch rotTimer;
     GLfloat yRot = rotTimer.GetElapsedSeconds() * 60.0f;
     
+    // 更新圆环（自转yRot度）和公转球体（公转-2*yRot度，半径0.8）的局部矩阵
+    M3DMatrix44f mLocal;
+    m3dRotationMatrix44(mLocal, m3dDegToRad(yRot), 0.0f, 1.0f, 0.0f);
+    sceneGraph.SetLocalMatrix(iTorus, mLocal);
+    m3dRotationMatrix44(mLocal, m3dDegToRad(yRot * -2.0f), 0.0f, 1.0f, 0.0f);
+    m3dMultTranslation44(mLocal, 0.8f, 0.0f, 0.0f);
+    sceneGraph.SetLocalMatrix(iOrbit, mLocal);
+    sceneGraph.Update();
+    
     //清楚颜色缓存区和深度缓冲区
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     
@@ -307,7 +335,7 @@ void RenderScene() {
      */
     glFrontFace(GL_CW);
     // 绘制地面以外其他部分
-    DrawSongAndDance(yRot);
+    DrawSongAndDance();
     glFrontFace(GL_CCW);
     // 绘制完，恢复矩阵
     modelViewMatrix.PopMatrix();
@@ -336,7 +364,7 @@ void RenderScene() {
     // 取消混合
     glDisable(GL_BLEND);
     // 绘制地面以外其他部分
-    DrawSongAndDance(yRot);
+    DrawSongAndDance();
     // 绘制完，恢复矩阵
     modelViewMatrix.PopMatrix();
     
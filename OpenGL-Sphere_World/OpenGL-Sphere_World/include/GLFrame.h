@@ -45,6 +45,37 @@ class GLFrame
         M3DVector3f vForward;	// Where am I going?
         M3DVector3f vUp;		// Which way is up?
 
+		// Optional quaternion orientation. When it is on, rotations are
+		// composed here and vForward/vUp are just read back out of it.
+		M3DQuaternion qOrientation;
+		bool bQuaternion;
+
+		// Compose a rotation into the quaternion, on the local (right) or
+		// world (left) side, and refresh the axes from it. Keeping the
+		// quaternion unit length keeps the axes orthonormal for free.
+		void QuatRotate(float fAngle, float x, float y, float z, bool bLocal)
+			{
+			M3DQuaternion qRotate;
+			m3dQuatFromAxisAngle(qRotate, fAngle, x, y, z);
+
+			if(bLocal)
+				m3dQuatMultiply(qOrientation, qOrientation, qRotate);
+			else
+				m3dQuatMultiply(qOrientation, qRotate, qOrientation);
+
+			m3dQuatNormalize(qOrientation);
+			m3dQuatGetAxes(NULL, vUp, vForward, qOrientation);
+			}
+
+		// Rebuild the quaternion after the axes were set directly
+		void QuatFromAxes(void)
+			{
+			M3DVector3f vXAxis;
+			m3dCrossProduct3(vXAxis, vUp, vForward);
+			m3dQuatFromAxes(qOrientation, vXAxis, vUp, vForward);
+			m3dQuatNormalize(qOrientation);
+			}
+
     public:
 		// Default position and orientation. At the origin, looking
 		// down the positive Z axis (right handed coordinate system).
@@ -57,9 +88,62 @@ class GLFrame
 
 			// Forward is -Z (default OpenGL)
             vForward[0] = 0.0f; vForward[1] = 0.0f; vForward[2] = -1.0f;
+
+			// The same orientation, half a turn around Y
+			qOrientation[0] = 0.0f; qOrientation[1] = 1.0f; qOrientation[2] = 0.0f; qOrientation[3] = 0.0f;
+			bQuaternion = false;
             }
 
 
+		/////////////////////////////////////////////////////////////
+		// Keep the orientation as a quaternion. Incremental rotations get
+		// cheaper and never drift out of orthonormal, so Normalize() is not
+		// needed. The forward and up vectors are still there to read.
+		void SetQuaternionMode(bool bEnable)
+			{
+			if(bEnable && !bQuaternion)
+				QuatFromAxes();
+			bQuaternion = bEnable;
+			}
+
+		inline bool GetQuaternionMode(void) { return bQuaternion; }
+
+		// Orientation as a quaternion, in either mode
+		void GetOrientation(M3DQuaternion q)
+			{
+			if(bQuaternion) {
+				memcpy(q, qOrientation, sizeof(M3DQuaternion));
+				return;
+				}
+
+			M3DVector3f vXAxis;
+			m3dCrossProduct3(vXAxis, vUp, vForward);
+			m3dQuatFromAxes(q, vXAxis, vUp, vForward);
+			}
+
+		void SetOrientation(const M3DQuaternion q)
+			{
+			memcpy(qOrientation, q, sizeof(M3DQuaternion));
+			m3dQuatNormalize(qOrientation);
+			m3dQuatGetAxes(NULL, vUp, vForward, qOrientation);
+			}
+
+		// Smoothly blend between two frames, e.g. to ease a camera toward a
+		// target. The origin is interpolated linearly, the orientation by slerp.
+		void Interpolate(GLFrame& frameFrom, GLFrame& frameTo, float t)
+			{
+			M3DQuaternion qFrom, qTo, q;
+			frameFrom.GetOrientation(qFrom);
+			frameTo.GetOrientation(qTo);
+			m3dQuatSlerp(q, qFrom, qTo, t);
+
+			vOrigin[0] = frameFrom.vOrigin[0] + (frameTo.vOrigin[0] - frameFrom.vOrigin[0]) * t;
+			vOrigin[1] = frameFrom.vOrigin[1] + (frameTo.vOrigin[1] - frameFrom.vOrigin[1]) * t;
+			vOrigin[2] = frameFrom.vOrigin[2] + (frameTo.vOrigin[2] - frameFrom.vOrigin[2]) * t;
+			SetOrientation(q);
+			}
+
+
         /////////////////////////////////////////////////////////////
         // Set Location
         inline void SetOrigin(const M3DVector3f vPoint) {
@@ -78,20 +162,24 @@ class GLFrame
         /////////////////////////////////////////////////////////////
         // Set Forward Direction
         inline void SetForwardVector(const M3DVector3f vDirection) {
-			m3dCopyVector3(vForward, vDirection); }
+			m3dCopyVector3(vForward, vDirection);
+			if(bQuaternion) QuatFromAxes(); }
 
         inline void SetForwardVector(float x, float y, float z)
-            { vForward[0] = x; vForward[1] = y; vForward[2] = z; }
+            { vForward[0] = x; vForward[1] = y; vForward[2] = z;
+			if(bQuaternion) QuatFromAxes(); }
 
         inline void GetForwardVector(M3DVector3f vVector) { m3dCopyVector3(vVector, vForward); }
 
         /////////////////////////////////////////////////////////////
         // Set Up Direction
         inline void SetUpVector(const M3DVector3f vDirection) {
-			m3dCopyVector3(vUp, vDirection); }
+			m3dCopyVector3(vUp, vDirection);
+			if(bQuaternion) QuatFromAxes(); }
 
         inline void SetUpVector(float x, float y, float z)
-			{ vUp[0] = x; vUp[1] = y; vUp[2] = z; }
+			{ vUp[0] = x; vUp[1] = y; vUp[2] = z;
+			if(bQuaternion) QuatFromAxes(); }
 
         inline void GetUpVector(M3DVector3f vVector) { m3dCopyVector3(vVector, vUp); }
 
@@ -178,6 +266,58 @@ class GLFrame
 			}
 
 
+		///////////////////////////////////////////////////////////////////////
+		// Same matrix as GetMatrix, as a 3x4 affine matrix (see M3DMatrix34f)
+		void GetAffineMatrix(M3DMatrix34f matrix, bool bRotationOnly = false)
+			{
+			M3DVector3f vXAxis;
+			m3dCrossProduct3(vXAxis, vUp, vForward);
+
+			// The axes are the first three columns
+			matrix[0] = vXAxis[0];	matrix[1] = vUp[0];	matrix[2]  = vForward[0];
+			matrix[4] = vXAxis[1];	matrix[5] = vUp[1];	matrix[6]  = vForward[1];
+			matrix[8] = vXAxis[2];	matrix[9] = vUp[2];	matrix[10] = vForward[2];
+
+			if(bRotationOnly == true)
+				matrix[3] = matrix[7] = matrix[11] = 0.0f;
+			else
+				{
+				matrix[3] = vOrigin[0];
+				matrix[7] = vOrigin[1];
+				matrix[11] = vOrigin[2];
+				}
+			}
+
+		// Inverse of GetMatrix. The frame is always orthonormal, so the
+		// rotation is just transposed and the origin rotated back.
+		void GetInverseMatrix(M3DMatrix44f matrix, bool bRotationOnly = false)
+			{
+			M3DVector3f vXAxis;
+			m3dCrossProduct3(vXAxis, vUp, vForward);
+
+			// Axes become the rows
+			matrix[0] = vXAxis[0];	matrix[4] = vXAxis[1];	matrix[8] = vXAxis[2];
+			matrix[1] = vUp[0];		matrix[5] = vUp[1];		matrix[9] = vUp[2];
+			matrix[2] = vForward[0];	matrix[6] = vForward[1];	matrix[10] = vForward[2];
+			matrix[3] = 0.0f;		matrix[7] = 0.0f;		matrix[11] = 0.0f;
+
+			if(bRotationOnly == true)
+				{
+				matrix[12] = 0.0f;
+				matrix[13] = 0.0f;
+				matrix[14] = 0.0f;
+				}
+			else
+				{
+				matrix[12] = -m3dDotProduct3(vXAxis, vOrigin);
+				matrix[13] = -m3dDotProduct3(vUp, vOrigin);
+				matrix[14] = -m3dDotProduct3(vForward, vOrigin);
+				}
+
+			matrix[15] = 1.0f;
+			}
+
+
 
        ////////////////////////////////////////////////////////////////////////
        // Assemble the camera matrix
@@ -233,6 +373,11 @@ class GLFrame
 		// Rotate around local Y
         void RotateLocalY(float fAngle)
 			{
+			if(bQuaternion) {
+				QuatRotate(fAngle, 0.0f, 1.0f, 0.0f, true);
+				return;
+				}
+
 	        M3DMatrix44f rotMat;
 
 			// Just Rotate around the up vector
@@ -253,6 +398,11 @@ class GLFrame
 		// Rotate around local Z
         void RotateLocalZ(float fAngle)
 			{
+			if(bQuaternion) {
+				QuatRotate(fAngle, 0.0f, 0.0f, 1.0f, true);
+				return;
+				}
+
 			M3DMatrix44f rotMat;
 
 			// Only the up vector needs to be rotated
@@ -268,6 +418,11 @@ class GLFrame
 
 		void RotateLocalX(float fAngle)
 			{
+			if(bQuaternion) {
+				QuatRotate(fAngle, 1.0f, 0.0f, 0.0f, true);
+				return;
+				}
+
 			M3DMatrix33f rotMat;
 			M3DVector3f  localX;
 			M3DVector3f  rotVec;
@@ -291,6 +446,12 @@ class GLFrame
 		// if the matrix is long-lived and frequently transformed.
 		void Normalize(void)
 			{
+			if(bQuaternion) {
+				m3dQuatNormalize(qOrientation);
+				m3dQuatGetAxes(NULL, vUp, vForward, qOrientation);
+				return;
+				}
+
 			M3DVector3f vCross;
 
 			// Calculate cross product of up and forward vectors
@@ -308,6 +469,11 @@ class GLFrame
 		// Rotate in world coordinates...
 		void RotateWorld(float fAngle, float x, float y, float z)
 			{
+			if(bQuaternion) {
+				QuatRotate(fAngle, x, y, z, false);
+				return;
+				}
+
             M3DMatrix44f rotMat;
 
 			// Create the Rotation matrix
@@ -332,6 +498,11 @@ class GLFrame
         // Rotate around a local axis
         void RotateLocal(float fAngle, float x, float y, float z) 
             {
+			if(bQuaternion) {
+				QuatRotate(fAngle, x, y, z, true);
+				return;
+				}
+
             M3DVector3f vWorldVect;
 			M3DVector3f vLocalVect;
 			m3dLoadVector3(vLocalVect, x, y, z);
@@ -376,17 +547,13 @@ class GLFrame
             vNewWorld[1] = vWorld[1] - vOrigin[1];
             vNewWorld[2] = vWorld[2] - vOrigin[2];
 
-            // Create the rotation matrix based on the vectors
-			M3DMatrix44f rotMat;
-            M3DMatrix44f invMat;
-			GetMatrix(rotMat, true);
-
-			// Do the rotation based on inverted matrix
-            m3dInvertMatrix44(invMat, rotMat);
+            // The inverse rotation is the transpose, so just project onto each axis
+			M3DVector3f vXAxis;
+			m3dCrossProduct3(vXAxis, vUp, vForward);
 
-			vLocal[0] = invMat[0] * vNewWorld[0] + invMat[4] * vNewWorld[1] + invMat[8] *  vNewWorld[2];	
-			vLocal[1] = invMat[1] * vNewWorld[0] + invMat[5] * vNewWorld[1] + invMat[9] *  vNewWorld[2];	
-			vLocal[2] = invMat[2] * vNewWorld[0] + invMat[6] * vNewWorld[1] + invMat[10] * vNewWorld[2];	
+			vLocal[0] = m3dDotProduct3(vXAxis, vNewWorld);
+			vLocal[1] = m3dDotProduct3(vUp, vNewWorld);
+			vLocal[2] = m3dDotProduct3(vForward, vNewWorld);
             }
         
         /////////////////////////////////////////////////////////////////////////////
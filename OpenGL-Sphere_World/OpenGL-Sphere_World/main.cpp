@@ -13,9 +13,15 @@
 #include "GLMatrixStack.h"
 #include "GLGeometryTransform.h"
 #include "StopWatch.h"
+#include "math3dSIMD.h"
+#include "GLSplinePath.h"
+#include "GLShapeArrays.h"
+#include "GLOcclusionBuffer.h"
+#include "GLLightClusters.h"
 
 #include <math.h>
 #include <stdio.h>
+#include <float.h>
 
 #ifdef __APPLE__
 #include <glut/glut.h>
@@ -41,12 +47,65 @@ GLTriangleBatch     sphereBatch;            // 球批处理类
 // 角色帧 照相机角色帧
 GLFrame             cameraFrame;
 
+// 鼠标拾取: 小球球心(SoA)、半径，以及被选中的小球
+M3DVectorStream3    sphereCenters;
+float               sphereRadius[NUM_SPHERES];
+int                 pickedSphere = -1;
+int                 windowWidth = 800, windowHeight = 600;
+
+// 空格键开关的照相机漫游路径，沿路径匀速飞行
+GLSplinePath        cameraTour;
+bool                bTouring = false;
+CStopWatch          tourTime;
+
+// 软件遮挡剔除: 圆环作为遮挡物在CPU上画进低分辨率深度缓冲区，被圆环挡住的小球不画
+// GLTriangleBatch 在End()之后不保留顶点，所以遮挡物用同样形状的数组另建一份(面数少一些)
+GLOcclusionBuffer   occlusionBuffer;
+GLTaskPool          taskPool;
+M3DVector3f         *pTorusOccluderVerts = NULL;
+GLuint              *pTorusOccluderIndexes = NULL;
+GLuint              nTorusOccluderVerts = 0, nTorusOccluderIndexes = 0;
+
+// 分簇光照: 很多个在地板上方游动的彩色点光源。默认还是原来的单个光源，按L键切换到分簇光照
+// 视景体切成 16 x 8 x 24 个簇，每帧在CPU上(多线程)算出每个簇受哪些光源照射，着色器只算所在簇的光源
+#define NUM_LIGHTS 1024
+GLLightClusters         lightClusters;
+GLClusteredLightShader  clusteredShader;
+float               lightX[NUM_LIGHTS], lightY[NUM_LIGHTS], lightZ[NUM_LIGHTS], lightRadius[NUM_LIGHTS];
+float               lightAnchor[NUM_LIGHTS][3], lightPhase[NUM_LIGHTS];
+M3DVector3f         lightColors[NUM_LIGHTS];
+bool                bClusteredLights = false, bHaveClusteredShader = false;
+
 void SetupRC() {
     shaderManager.InitializeStockShaders();
     glEnable(GL_DEPTH_TEST);
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     // 绘制圆环
     gltMakeTorus(torusBatch, 0.4f, 0.15f, 30.0f, 30.0f);
+    // 圆环的遮挡物: 16 x 8 个格子。遮挡物不能比画出来的圆环大，但格子很粗:
+    // 内圈的弦比圆环内侧更靠近中心轴 (约 0.005)，而画出来的 30 x 30 网格在外圈
+    // 又比真正的圆环小一点 (约 0.004)，所以管子半径从 0.15 缩到 0.14，
+    // 遮挡物每个三角形离圆环中心线都不超过 0.145，整个包在画出来的圆环 (0.146) 里面
+    gltGetShapeArraySizes(16, 8, nTorusOccluderVerts, nTorusOccluderIndexes);
+    pTorusOccluderVerts = new M3DVector3f[nTorusOccluderVerts];
+    pTorusOccluderIndexes = new GLuint[nTorusOccluderIndexes];
+    gltMakeTorusArrays(pTorusOccluderVerts, NULL, NULL, pTorusOccluderIndexes, 0.4f, 0.14f, 16, 8);
+    occlusionBuffer.SetCullFace(true);
+    
+    // 分簇光照的着色器和光源: 位置、半径、颜色都随机
+    // 着色器编译失败时L键不起作用；默认不开，没开时也不分配光源、不上传纹理
+    bHaveClusteredShader = clusteredShader.Init(shaderManager);
+    bClusteredLights = false;
+    for (int i = 0; i < NUM_LIGHTS; i++) {
+        lightAnchor[i][0] = float(rand() % 4000 - 2000) * 0.01f;
+        lightAnchor[i][1] = float(rand() % 100) * 0.006f - 0.3f;
+        lightAnchor[i][2] = float(rand() % 4000 - 2000) * 0.01f;
+        lightPhase[i] = float(rand() % 628) * 0.01f;
+        lightRadius[i] = 0.6f + float(rand() % 100) * 0.009f;
+        lightColors[i][0] = 0.2f + float(rand() % 100) * 0.008f;
+        lightColors[i][1] = 0.2f + float(rand() % 100) * 0.008f;
+        lightColors[i][2] = 0.2f + float(rand() % 100) * 0.008f;
+    }
     // 绘制球体
     gltMakeSphere(sphereBatch, 0.1f, 26.0f, 13.0f);
     // 绘制地板
@@ -68,6 +127,26 @@ void SetupRC() {
         GLfloat z = (GLfloat)(((rand() % 400) - 200) * 0.1f);
         spheres[i].SetOrigin(x, 0.0f, z);
     }
+    
+    // 拾取用的球心数组，小球不会移动，只需要填一次
+    sphereCenters.Resize(NUM_SPHERES);
+    for (int i = 0; i < NUM_SPHERES; i++) {
+        M3DVector3f vCenter;
+        spheres[i].GetOrigin(vCenter);
+        sphereCenters.Set(i, vCenter);
+        sphereRadius[i] = 0.1f;
+    }
+    
+    // 漫游路径: 绕着圆环和小球一圈，高低起伏
+    M3DVector3f vTourPoints[8];
+    for (int i = 0; i < 8; i++) {
+        float fAngle = float(i) * float(M3D_2PI) / 8.0f;
+        float fRadius = (i % 2) ? 4.0f : 7.0f;
+        vTourPoints[i][0] = fRadius * cosf(fAngle);
+        vTourPoints[i][1] = 0.3f + 0.4f * float(i % 3);
+        vTourPoints[i][2] = fRadius * sinf(fAngle) - 2.5f;
+    }
+    cameraTour.SetPoints(vTourPoints, 8, true);
 }
 
 void ChangeSize(int w, int h) {
@@ -75,28 +154,67 @@ void ChangeSize(int w, int h) {
         h = 1;
     }
     glViewport(0, 0, w, h);
+    windowWidth = w;
+    windowHeight = h;
     // 设置投影矩阵
     viewFrustum.SetPerspective(35.0f, float(w)/float(h), 1.0f, 100.0f);
     // 将投影矩阵添加到projectionMatrix中
     projectionMatrix.LoadMatrix(viewFrustum.GetProjectionMatrix());
     transformPipeline.SetMatrixStacks(modelViewMatrix, projectionMatrix);
+    // 投影变了，簇也要重新划分
+    lightClusters.SetProjection(viewFrustum.GetProjectionMatrix());
 }
 
 void RenderScene() {
     static GLfloat vFloorColor[] = { 0.0f, 1.0f, 0.0f, 1.0f };
     static GLfloat vTrousColor[] = { 1.0f, 0.0f, 0.0f, 1.0f };
     static GLfloat vSphereColor[] = { 0.0f, 0.0f, 1.0f, 0.0f };
+    static GLfloat vPickedColor[] = { 1.0f, 1.0f, 0.0f, 1.0f };
     // 基于时间动画
     static CStopWatch rotTime;
     float yRot = rotTime.GetElapsedSeconds() * 60.0f;
     
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
     // modelViewMatrix.PushMatrix();
     
+    // 漫游时每秒沿路径前进2个单位
+    if (bTouring) {
+        cameraTour.GetFrame(tourTime.GetElapsedSeconds() * 2.0f, cameraFrame);
+    }
+    
     // 设置观察者矩阵
     M3DMatrix44f mCamera;
     cameraFrame.GetCameraMatrix(mCamera);
+    
+    // 在第一个GL调用之前光栅化遮挡物，这时GPU还在画上一帧
+    static CStopWatch occlusionTime, titleTime;
+    static float fOcclusionMs = 0.0f;
+    occlusionTime.Reset();
+    M3DMatrix44f mViewProjection, mTorusModel;
+    m3dMatrixMultiply44(mViewProjection, viewFrustum.GetProjectionMatrix(), mCamera);
+    m3dTranslationMatrix44(mTorusModel, 0.0f, 0.0f, -2.5f);
+    m3dMultRotation44(mTorusModel, float(m3dDegToRad(yRot)), 0.0f, 1.0f, 0.0f);
+    occlusionBuffer.Begin(mViewProjection);
+    occlusionBuffer.AddOccluder(mTorusModel, pTorusOccluderVerts, nTorusOccluderVerts, pTorusOccluderIndexes, nTorusOccluderIndexes);
+    occlusionBuffer.Rasterize(taskPool);
+    fOcclusionMs += occlusionTime.GetElapsedSeconds() * 1000.0f;
+    
+    // 光源绕各自的位置转圈，然后分配到簇里，传给着色器
+    static CStopWatch lightTime;
+    static float fLightMs = 0.0f;
+    if (bClusteredLights) {
+        lightTime.Reset();
+        float fTime = rotTime.GetElapsedSeconds();
+        for (int i = 0; i < NUM_LIGHTS; i++) {
+            lightX[i] = lightAnchor[i][0] + 0.8f * cosf(fTime + lightPhase[i]);
+            lightY[i] = lightAnchor[i][1];
+            lightZ[i] = lightAnchor[i][2] + 0.8f * sinf(fTime + lightPhase[i]);
+        }
+        lightClusters.Assign(taskPool, mCamera, lightX, lightY, lightZ, lightRadius, NUM_LIGHTS);
+        fLightMs += lightTime.GetElapsedSeconds() * 1000.0f;
+        clusteredShader.Upload(lightClusters, lightColors);
+    }
+    
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     modelViewMatrix.PushMatrix(mCamera);
     
     // 添加光源
@@ -111,9 +229,25 @@ void RenderScene() {
     floorBatch.Draw();
     
     // 绘制悬浮随机小球体
+    // 先用视景体一次剔除所有小球（每位一个小球，1表示可见），看不见的小球不画
+    static unsigned int uiSphereVisible[(NUM_SPHERES + 31) / 32];
+    viewFrustum.Transform(cameraFrame);
+    viewFrustum.TestSpheres(sphereCenters.x, sphereCenters.y, sphereCenters.z, sphereRadius, NUM_SPHERES, uiSphereVisible);
+    
+    // 一次算出所有小球的模型视图矩阵，不必每个小球都压栈、相乘、出栈
+    static M3DMatrix44f mSphereModelView[NUM_SPHERES];
+    transformPipeline.GetModelViewProjectionMatrices(spheres, NUM_SPHERES, mSphereModelView, NULL);
+    static int nFrames = 0, nOccluded = 0;
     for (int i = 0; i < NUM_SPHERES; i++) {
-        modelViewMatrix.PushMatrix();
-        modelViewMatrix.MultMatrix(spheres[i]);
+        if (!(uiSphereVisible[i >> 5] & (1u << (i & 31)))) {
+            continue;
+        }
+        // 在视景体里，但被圆环完全挡住
+        M3DVector3f vCenter = { sphereCenters.x[i], sphereCenters.y[i], sphereCenters.z[i] };
+        if (!occlusionBuffer.TestSphere(vCenter, sphereRadius[i])) {
+            nOccluded++;
+            continue;
+        }
         // shaderManager.UseStockShader(GLT_SHADER_FLAT, transformPipeline.GetModelViewProjectionMatrix(), vSphereColor);
         /*
          默认光源着色器
@@ -123,9 +257,13 @@ void RenderScene() {
          参数4:光源位置
          参数5:漫反射的颜色
          */
-        shaderManager.UseStockShader(GLT_SHADER_POINT_LIGHT_DIFF, transformPipeline.GetModelViewMatrix(), transformPipeline.GetProjectionMatrix(), vLightEyePos, vSphereColor);
+        if (bClusteredLights) {
+            clusteredShader.Use(mSphereModelView[i], transformPipeline.GetProjectionMatrix(), (i == pickedSphere) ? vPickedColor : vSphereColor, windowWidth, windowHeight);
+        }
+        else {
+            shaderManager.UseStockShader(GLT_SHADER_POINT_LIGHT_DIFF, mSphereModelView[i], transformPipeline.GetProjectionMatrix(), vLightEyePos, (i == pickedSphere) ? vPickedColor : vSphereColor);
+        }
         sphereBatch.Draw();
-        modelViewMatrix.PopMatrix();
     }
     
     // 向屏幕z轴负方向移动2.5个单位
@@ -137,7 +275,12 @@ void RenderScene() {
     
     // 绘制圆环
     // shaderManager.UserStockShader(GLT_SHADER_FLAT, transformPipeline.GetModelViewProjectionMatrix(), vTrousColor);
-    shaderManager.UseStockShader(GLT_SHADER_POINT_LIGHT_DIFF, transformPipeline.GetModelViewMatrix(), transformPipeline.GetProjectionMatrix(), vLightEyePos, vTrousColor);
+    if (bClusteredLights) {
+        clusteredShader.Use(transformPipeline.GetModelViewMatrix(), transformPipeline.GetProjectionMatrix(), vTrousColor, windowWidth, windowHeight);
+    }
+    else {
+        shaderManager.UseStockShader(GLT_SHADER_POINT_LIGHT_DIFF, transformPipeline.GetModelViewMatrix(), transformPipeline.GetProjectionMatrix(), vLightEyePos, vTrousColor);
+    }
     torusBatch.Draw();
     modelViewMatrix.PopMatrix();
     
@@ -152,6 +295,19 @@ void RenderScene() {
     
     modelViewMatrix.PopMatrix();
     
+    // 每秒在标题栏显示一次帧率、平均每帧被遮挡的小球数、光栅化和光源分簇的耗时
+    nFrames++;
+    if (titleTime.GetElapsedSeconds() >= 1.0f) {
+        char szTitle[256];
+        sprintf(szTitle, "OpenGL SphereWorld - %.0f fps, occluded %.1f spheres, occlusion raster %.3f ms, %d lights assigned in %.3f ms",
+                float(nFrames) / titleTime.GetElapsedSeconds(), float(nOccluded) / float(nFrames), fOcclusionMs / float(nFrames),
+                bClusteredLights ? NUM_LIGHTS : 1, fLightMs / float(nFrames));
+        glutSetWindowTitle(szTitle);
+        nFrames = nOccluded = 0;
+        fOcclusionMs = fLightMs = 0.0f;
+        titleTime.Reset();
+    }
+    
     glutSwapBuffers();
     glutPostRedisplay();
 }
@@ -173,6 +329,36 @@ void SpecialKeys(int key, int x, int y) {
     }
 }
 
+void KeyPressFunc(unsigned char key, int x, int y) {
+    if (key == ' ') {
+        bTouring = !bTouring;
+        tourTime.Reset();
+    }
+    else if (key == 'l' || key == 'L') {
+        bClusteredLights = !bClusteredLights && bHaveClusteredShader;
+    }
+}
+
+// 鼠标左键拾取小球: 从照相机发出一条穿过鼠标位置的射线，一次测试所有小球
+void MouseClick(int button, int state, int x, int y) {
+    if (button != GLUT_LEFT_BUTTON || state != GLUT_DOWN) {
+        return;
+    }
+    // 屏幕坐标 -> 归一化设备坐标 -> 照相机空间的方向
+    const M3DMatrix44f& mProjection = viewFrustum.GetProjectionMatrix();
+    float nx = 2.0f * float(x) / float(windowWidth) - 1.0f;
+    float ny = 1.0f - 2.0f * float(y) / float(windowHeight);
+    // 照相机帧的X轴指向左边，Z轴指向前方
+    M3DVector3f vLocal = { -nx / mProjection[0], ny / mProjection[5], 1.0f };
+    M3DVector3f vOrigin, vDir;
+    cameraFrame.GetOrigin(vOrigin);
+    cameraFrame.LocalToWorld(vLocal, vDir, true);
+    m3dNormalizeVector3(vDir);
+    
+    float fDistance = FLT_MAX;
+    pickedSphere = m3dRaySphereStream(fDistance, vOrigin, vDir, sphereCenters.x, sphereCenters.y, sphereCenters.z, sphereRadius, NUM_SPHERES);
+}
+
 int main(int argc, char* argv[]) {
     gltSetWorkingDirectory(argv[0]);
     glutInit(&argc, argv);
@@ -182,6 +368,8 @@ int main(int argc, char* argv[]) {
     glutReshapeFunc(ChangeSize);
     glutDisplayFunc(RenderScene);
     glutSpecialFunc(SpecialKeys);
+    glutMouseFunc(MouseClick);
+    glutKeyboardFunc(KeyPressFunc);
     
     GLenum err = glewInit();
     if (GLEW_OK != err) {
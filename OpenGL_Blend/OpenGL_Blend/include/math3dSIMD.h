@@ -0,0 +1,2315 @@
+// math3dSIMD.h
+// Batch (array) companions to the Math3d library.
+// The routines in math3d.h work on one vector or matrix at a time, which is fine
+// for a camera or a handful of objects but means one function call per vertex
+// whenever a whole array has to be processed on the CPU (picking, skinning, culling,
+// etc.). The functions here take whole arrays and use SSE/AVX when the compiler
+// makes them available. Every routine has a plain scalar fallback that produces
+// the same results as calling the single vector version in a loop, so this header
+// is safe to include on any platform math3d.h itself supports.
+//
+// Two memory layouts are supported:
+//   Array of structures (AoS) - M3DVector3f/M3DVector4f arrays, as used by GLBatch
+//   Structure of arrays (SoA) - separate x[], y[], z[] streams
+// SoA streams are the fastest layout for SIMD work and should be preferred for
+// data that lives only on the CPU.
+
+#ifndef _MATH3D_SIMD_LIBRARY__
+#define _MATH3D_SIMD_LIBRARY__
+
+#include <math3d.h>
+#include <stdlib.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Instruction set selection. The array routines are compile time decisions only;
+// build with -mavx (or /arch:AVX) to get the wider code paths. The matrix routines
+// further down pick their code path at run time instead (see m3dGetSIMDLevel).
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define M3D_SIMD_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define M3D_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define M3D_SIMD_AVX
+#include <immintrin.h>
+#endif
+
+// Run time dispatch needs a way to compile AVX code in a file that is not built
+// with -mavx, and a way to ask the CPU what it has.
+#if defined(M3D_SIMD_SSE) && (defined(__GNUC__) || defined(_MSC_VER))
+#define M3D_SIMD_DISPATCH
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define M3D_TARGET_AVX
+#define M3D_TARGET_AVX512
+#else
+#include <cpuid.h>
+#define M3D_TARGET_AVX		__attribute__((target("avx")))
+#define M3D_TARGET_AVX512	__attribute__((target("avx512f")))
+#endif
+
+// The dispatched multiplies are only bit identical to m3dMatrixMultiply44 when
+// every multiply and add is rounded on its own. GCC fuses them into FMA
+// instructions by default wherever FMA is available (the AVX-512 kernels, or
+// any -mfma / -march=native build), so those kernels turn contraction off for
+// themselves: M3D_NO_FP_CONTRACT on the function for GCC, and
+// M3D_NO_FP_CONTRACT_BODY as the first line of the body for clang.
+#if defined(__GNUC__) && !defined(__clang__)
+#define M3D_NO_FP_CONTRACT		__attribute__((optimize("fp-contract=off")))
+#else
+#define M3D_NO_FP_CONTRACT
+#endif
+#ifdef __clang__
+#define M3D_NO_FP_CONTRACT_BODY	_Pragma("clang fp contract(off)")
+#else
+#define M3D_NO_FP_CONTRACT_BODY
+#endif
+#endif
+
+
+#ifdef M3D_SIMD_SSE
+///////////////////////////////////////////////////////////////////////////////
+// Helpers for moving four tightly packed M3DVector3f's in and out of SoA form.
+// a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+inline void m3dSSELoadVectors3(const float *p, __m128 &x, __m128 &y, __m128 &z)
+	{
+	__m128 a = _mm_loadu_ps(p);
+	__m128 b = _mm_loadu_ps(p + 4);
+	__m128 c = _mm_loadu_ps(p + 8);
+
+	x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+	y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+					   _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), c, _MM_SHUFFLE(3, 0, 2, 0));
+	}
+
+inline void m3dSSEStoreVectors3(float *p, __m128 x, __m128 y, __m128 z)
+	{
+	__m128 a = _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+							  _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 b = _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+							  _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 c = _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+							  _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	_mm_storeu_ps(p, a);
+	_mm_storeu_ps(p + 4, b);
+	_mm_storeu_ps(p + 8, c);
+	}
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Transform an array of points (w assumed to be 1) by a 4x4 matrix. This is
+// m3dTransformVector3 over nCount points. vOut and v may be the same array.
+inline void m3dTransformVectorArray3(M3DVector3f *vOut, const M3DVector3f *v, const M3DMatrix44f m, int nCount)
+	{
+	int i = 0;
+
+#ifdef M3D_SIMD_SSE
+	const __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]);
+	const __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]);
+	const __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]);
+	const __m128 m12 = _mm_set1_ps(m[12]), m13 = _mm_set1_ps(m[13]), m14 = _mm_set1_ps(m[14]);
+
+	for(; i + 4 <= nCount; i += 4)
+		{
+		__m128 x, y, z;
+		m3dSSELoadVectors3(v[i], x, y, z);
+
+		__m128 ox = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, x), _mm_mul_ps(m4, y)), _mm_mul_ps(m8, z)), m12);
+		__m128 oy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, x), _mm_mul_ps(m5, y)), _mm_mul_ps(m9, z)), m13);
+		__m128 oz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, x), _mm_mul_ps(m6, y)), _mm_mul_ps(m10, z)), m14);
+
+		m3dSSEStoreVectors3(vOut[i], ox, oy, oz);
+		}
+#endif
+
+	// Whatever is left over (or everything, without SSE)
+	for(; i < nCount; i++)
+		{
+		M3DVector3f vTemp;
+		m3dTransformVector3(vTemp, v[i], m);
+		m3dCopyVector3(vOut[i], vTemp);
+		}
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Full four component transform over an array. This is m3dTransformVector4 over
+// nCount vectors, use it for directions (w = 0) or homogeneous points.
+// vOut and v may be the same array.
+inline void m3dTransformVectorArray4(M3DVector4f *vOut, const M3DVector4f *v, const M3DMatrix44f m, int nCount)
+	{
+	int i = 0;
+
+#if defined(M3D_SIMD_AVX)
+	// Two vectors per register, each 128 bit lane does one of them
+	const __m256 c0 = _mm256_broadcast_ps((const __m128 *)&m[0]);
+	const __m256 c1 = _mm256_broadcast_ps((const __m128 *)&m[4]);
+	const __m256 c2 = _mm256_broadcast_ps((const __m128 *)&m[8]);
+	const __m256 c3 = _mm256_broadcast_ps((const __m128 *)&m[12]);
+
+	for(; i + 2 <= nCount; i += 2)
+		{
+		__m256 p = _mm256_loadu_ps(v[i]);
+		__m256 r = _mm256_mul_ps(c0, _mm256_permute_ps(p, 0x00));
+		r = _mm256_add_ps(r, _mm256_mul_ps(c1, _mm256_permute_ps(p, 0x55)));
+		r = _mm256_add_ps(r, _mm256_mul_ps(c2, _mm256_permute_ps(p, 0xAA)));
+		r = _mm256_add_ps(r, _mm256_mul_ps(c3, _mm256_permute_ps(p, 0xFF)));
+		_mm256_storeu_ps(vOut[i], r);
+		}
+#elif defined(M3D_SIMD_SSE)
+	const __m128 c0 = _mm_loadu_ps(&m[0]);
+	const __m128 c1 = _mm_loadu_ps(&m[4]);
+	const __m128 c2 = _mm_loadu_ps(&m[8]);
+	const __m128 c3 = _mm_loadu_ps(&m[12]);
+
+	for(; i < nCount; i++)
+		{
+		__m128 p = _mm_loadu_ps(v[i]);
+		__m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(p, p, 0x00));
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(p, p, 0x55)));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(p, p, 0xAA)));
+		r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(p, p, 0xFF)));
+		_mm_storeu_ps(vOut[i], r);
+		}
+#endif
+
+	for(; i < nCount; i++)
+		{
+		M3DVector4f vTemp;
+		m3dTransformVector4(vTemp, v[i], m);
+		m3dCopyVector4(vOut[i], vTemp);
+		}
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Transform nCount points held as three separate streams (SoA). Output streams
+// may alias the input streams. No alignment is required, but 16 (SSE) or 32 (AVX)
+// byte aligned streams are faster.
+inline void m3dTransformVectorStream3(float *xOut, float *yOut, float *zOut,
+									  const float *x, const float *y, const float *z,
+									  const M3DMatrix44f m, int nCount)
+	{
+	int i = 0;
+
+#if defined(M3D_SIMD_AVX)
+	const __m256 m0 = _mm256_set1_ps(m[0]), m1 = _mm256_set1_ps(m[1]), m2 = _mm256_set1_ps(m[2]);
+	const __m256 m4 = _mm256_set1_ps(m[4]), m5 = _mm256_set1_ps(m[5]), m6 = _mm256_set1_ps(m[6]);
+	const __m256 m8 = _mm256_set1_ps(m[8]), m9 = _mm256_set1_ps(m[9]), m10 = _mm256_set1_ps(m[10]);
+	const __m256 m12 = _mm256_set1_ps(m[12]), m13 = _mm256_set1_ps(m[13]), m14 = _mm256_set1_ps(m[14]);
+
+	for(; i + 8 <= nCount; i += 8)
+		{
+		__m256 vx = _mm256_loadu_ps(x + i);
+		__m256 vy = _mm256_loadu_ps(y + i);
+		__m256 vz = _mm256_loadu_ps(z + i);
+
+		__m256 ox = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, vx), _mm256_mul_ps(m4, vy)), _mm256_mul_ps(m8, vz)), m12);
+		__m256 oy = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m1, vx), _mm256_mul_ps(m5, vy)), _mm256_mul_ps(m9, vz)), m13);
+		__m256 oz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m2, vx), _mm256_mul_ps(m6, vy)), _mm256_mul_ps(m10, vz)), m14);
+
+		_mm256_storeu_ps(xOut + i, ox);
+		_mm256_storeu_ps(yOut + i, oy);
+		_mm256_storeu_ps(zOut + i, oz);
+		}
+#endif
+
+#if defined(M3D_SIMD_SSE)
+	{
+	const __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]);
+	const __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]);
+	const __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]);
+	const __m128 m12 = _mm_set1_ps(m[12]), m13 = _mm_set1_ps(m[13]), m14 = _mm_set1_ps(m[14]);
+
+	for(; i + 4 <= nCount; i += 4)
+		{
+		__m128 vx = _mm_loadu_ps(x + i);
+		__m128 vy = _mm_loadu_ps(y + i);
+		__m128 vz = _mm_loadu_ps(z + i);
+
+		__m128 ox = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, vx), _mm_mul_ps(m4, vy)), _mm_mul_ps(m8, vz)), m12);
+		__m128 oy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, vx), _mm_mul_ps(m5, vy)), _mm_mul_ps(m9, vz)), m13);
+		__m128 oz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, vx), _mm_mul_ps(m6, vy)), _mm_mul_ps(m10, vz)), m14);
+
+		_mm_storeu_ps(xOut + i, ox);
+		_mm_storeu_ps(yOut + i, oy);
+		_mm_storeu_ps(zOut + i, oz);
+		}
+	}
+#endif
+
+	for(; i < nCount; i++)
+		{
+		float fx = x[i], fy = y[i], fz = z[i];
+		xOut[i] = m[0] * fx + m[4] * fy + m[8] *  fz + m[12];
+		yOut[i] = m[1] * fx + m[5] * fy + m[9] *  fz + m[13];
+		zOut[i] = m[2] * fx + m[6] * fy + m[10] * fz + m[14];
+		}
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Bulk world to window projection. m3dProjectXYZ multiplies by the modelview
+// and then the projection matrix for every point; these take the combined
+// modelview projection matrix (GLGeometryTransform::GetModelViewProjectionMatrix,
+// or m3dMatrixMultiply44(mvp, projection, modelview)) so each point costs
+// one matrix transform. The window mapping and the w close to zero rule
+// are the same as m3dProjectXYZ. Because the matrix is composed first the
+// results can differ from m3dProjectXYZ in the last bit or so.
+//
+// pFlags (may be NULL) gets a mask for each point, 0 when the point is on
+// screen. The return value is the number of points with a 0 mask (or 0 when
+// pFlags is NULL).
+#define M3D_PROJECT_BEHIND		0x01	// w <= 0, the point is behind the eye
+#define M3D_PROJECT_OUTSIDE		0x02	// outside the viewport in x or y
+#define M3D_PROJECT_DEPTH		0x04	// in front of the near or past the far plane
+
+// Spread the four bits of a movemask out to the low bit of four bytes, and
+// count the lanes with no flags, so the SIMD loops can store the masks four
+// at a time.
+inline void m3dProjectStoreFlags4(unsigned char *pFlags, int &nVisible, int behind, int outside, int depth)
+	{
+	static const unsigned int spread[16] = {
+		0x00000000, 0x00000001, 0x00000100, 0x00000101, 0x00010000, 0x00010001, 0x00010100, 0x00010101,
+		0x01000000, 0x01000001, 0x01000100, 0x01000101, 0x01010000, 0x01010001, 0x01010100, 0x01010101 };
+	static const unsigned char clear[16] = { 4, 3, 3, 2, 3, 2, 2, 1, 3, 2, 2, 1, 2, 1, 1, 0 };
+
+	unsigned int packed = spread[behind] * M3D_PROJECT_BEHIND | spread[outside] * M3D_PROJECT_OUTSIDE | spread[depth] * M3D_PROJECT_DEPTH;
+	pFlags[0] = (unsigned char)packed;
+	pFlags[1] = (unsigned char)(packed >> 8);
+	pFlags[2] = (unsigned char)(packed >> 16);
+	pFlags[3] = (unsigned char)(packed >> 24);
+	nVisible += clear[behind | outside | depth];
+	}
+
+inline int m3dProjectStream3(float *xOut, float *yOut, float *zOut, unsigned char *pFlags,
+							 const float *x, const float *y, const float *z,
+							 const M3DMatrix44f mModelViewProjection, const int iViewPort[4], int nCount)
+	{
+	const float *m = mModelViewProjection;
+	const float vx0 = float(iViewPort[0]), vy0 = float(iViewPort[1]);
+	const float vw = float(iViewPort[2]), vh = float(iViewPort[3]);
+	int nVisible = 0;
+	int i = 0;
+
+#if defined(M3D_SIMD_AVX)
+	{
+	const __m256 m0 = _mm256_set1_ps(m[0]), m1 = _mm256_set1_ps(m[1]), m2 = _mm256_set1_ps(m[2]), m3 = _mm256_set1_ps(m[3]);
+	const __m256 m4 = _mm256_set1_ps(m[4]), m5 = _mm256_set1_ps(m[5]), m6 = _mm256_set1_ps(m[6]), m7 = _mm256_set1_ps(m[7]);
+	const __m256 m8 = _mm256_set1_ps(m[8]), m9 = _mm256_set1_ps(m[9]), m10 = _mm256_set1_ps(m[10]), m11 = _mm256_set1_ps(m[11]);
+	const __m256 m12 = _mm256_set1_ps(m[12]), m13 = _mm256_set1_ps(m[13]), m14 = _mm256_set1_ps(m[14]), m15 = _mm256_set1_ps(m[15]);
+	const __m256 one = _mm256_set1_ps(1.0f), half = _mm256_set1_ps(0.5f), zero = _mm256_setzero_ps();
+	const __m256 eps = _mm256_set1_ps(0.000001f), absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	const __m256 ox = _mm256_set1_ps(vx0), oy = _mm256_set1_ps(vy0), sw = _mm256_set1_ps(vw), sh = _mm256_set1_ps(vh);
+
+	for(; i + 8 <= nCount; i += 8)
+		{
+		__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i);
+
+		__m256 cx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m0, px), _mm256_mul_ps(m4, py)), _mm256_mul_ps(m8, pz)), m12);
+		__m256 cy = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m1, px), _mm256_mul_ps(m5, py)), _mm256_mul_ps(m9, pz)), m13);
+		__m256 cz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m2, px), _mm256_mul_ps(m6, py)), _mm256_mul_ps(m10, pz)), m14);
+		__m256 cw = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m3, px), _mm256_mul_ps(m7, py)), _mm256_mul_ps(m11, pz)), m15);
+
+		// No divide when w is too close to zero, as in m3dProjectXYZ
+		__m256 tiny = _mm256_cmp_ps(_mm256_and_ps(cw, absMask), eps, _CMP_LT_OQ);
+		__m256 div = _mm256_blendv_ps(_mm256_div_ps(one, cw), one, tiny);
+		cx = _mm256_mul_ps(cx, div); cy = _mm256_mul_ps(cy, div); cz = _mm256_mul_ps(cz, div);
+
+		_mm256_storeu_ps(xOut + i, _mm256_add_ps(ox, _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(one, cx), sw), half)));
+		_mm256_storeu_ps(yOut + i, _mm256_add_ps(oy, _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(one, cy), sh), half)));
+		_mm256_storeu_ps(zOut + i, cz);
+
+		if(pFlags) {
+			int behind = _mm256_movemask_ps(_mm256_cmp_ps(cw, zero, _CMP_LE_OQ));
+			int outside = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_max_ps(_mm256_and_ps(cx, absMask), _mm256_and_ps(cy, absMask)), one, _CMP_GT_OQ));
+			int depth = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_and_ps(cz, absMask), one, _CMP_GT_OQ));
+			m3dProjectStoreFlags4(pFlags + i, nVisible, behind & 15, outside & 15, depth & 15);
+			m3dProjectStoreFlags4(pFlags + i + 4, nVisible, behind >> 4, outside >> 4, depth >> 4);
+			}
+		}
+	}
+#endif
+
+#if defined(M3D_SIMD_SSE)
+	{
+	const __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]), m3 = _mm_set1_ps(m[3]);
+	const __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]), m7 = _mm_set1_ps(m[7]);
+	const __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]), m11 = _mm_set1_ps(m[11]);
+	const __m128 m12 = _mm_set1_ps(m[12]), m13 = _mm_set1_ps(m[13]), m14 = _mm_set1_ps(m[14]), m15 = _mm_set1_ps(m[15]);
+	const __m128 one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f), zero = _mm_setzero_ps();
+	const __m128 eps = _mm_set1_ps(0.000001f), sign = _mm_set1_ps(-0.0f);
+	const __m128 ox = _mm_set1_ps(vx0), oy = _mm_set1_ps(vy0), sw = _mm_set1_ps(vw), sh = _mm_set1_ps(vh);
+
+	for(; i + 4 <= nCount; i += 4)
+		{
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i);
+
+		__m128 cx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, px), _mm_mul_ps(m4, py)), _mm_mul_ps(m8, pz)), m12);
+		__m128 cy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, px), _mm_mul_ps(m5, py)), _mm_mul_ps(m9, pz)), m13);
+		__m128 cz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m2, px), _mm_mul_ps(m6, py)), _mm_mul_ps(m10, pz)), m14);
+		__m128 cw = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m3, px), _mm_mul_ps(m7, py)), _mm_mul_ps(m11, pz)), m15);
+
+		__m128 tiny = _mm_cmplt_ps(_mm_andnot_ps(sign, cw), eps);
+		__m128 div = _mm_or_ps(_mm_and_ps(tiny, one), _mm_andnot_ps(tiny, _mm_div_ps(one, cw)));
+		cx = _mm_mul_ps(cx, div); cy = _mm_mul_ps(cy, div); cz = _mm_mul_ps(cz, div);
+
+		_mm_storeu_ps(xOut + i, _mm_add_ps(ox, _mm_mul_ps(_mm_mul_ps(_mm_add_ps(one, cx), sw), half)));
+		_mm_storeu_ps(yOut + i, _mm_add_ps(oy, _mm_mul_ps(_mm_mul_ps(_mm_add_ps(one, cy), sh), half)));
+		_mm_storeu_ps(zOut + i, cz);
+
+		if(pFlags) {
+			int behind = _mm_movemask_ps(_mm_cmple_ps(cw, zero));
+			int outside = _mm_movemask_ps(_mm_cmpgt_ps(_mm_max_ps(_mm_andnot_ps(sign, cx), _mm_andnot_ps(sign, cy)), one));
+			int depth = _mm_movemask_ps(_mm_cmpgt_ps(_mm_andnot_ps(sign, cz), one));
+			m3dProjectStoreFlags4(pFlags + i, nVisible, behind, outside, depth);
+			}
+		}
+	}
+#endif
+
+	for(; i < nCount; i++)
+		{
+		float px = x[i], py = y[i], pz = z[i];
+		float cx = m[0] * px + m[4] * py + m[8] *  pz + m[12];
+		float cy = m[1] * px + m[5] * py + m[9] *  pz + m[13];
+		float cz = m[2] * px + m[6] * py + m[10] * pz + m[14];
+		float cw = m[3] * px + m[7] * py + m[11] * pz + m[15];
+
+		float div = (fabsf(cw) < 0.000001f) ? 1.0f : 1.0f / cw;
+		cx *= div; cy *= div; cz *= div;
+
+		xOut[i] = vx0 + (1.0f + cx) * vw * 0.5f;
+		yOut[i] = vy0 + (1.0f + cy) * vh * 0.5f;
+		zOut[i] = cz;
+
+		if(pFlags) {
+			pFlags[i] = (unsigned char)(((cw <= 0.0f) ? M3D_PROJECT_BEHIND : 0) |
+										((fabsf(cx) > 1.0f || fabsf(cy) > 1.0f) ? M3D_PROJECT_OUTSIDE : 0) |
+										((fabsf(cz) > 1.0f) ? M3D_PROJECT_DEPTH : 0));
+			nVisible += (pFlags[i] == 0);
+			}
+		}
+
+	return pFlags ? nVisible : 0;
+	}
+
+
+// Array (AoS) version with the same results, for points that live in an
+// M3DVector3f array. The output may be the input array.
+inline int m3dProjectArrayXYZ(M3DVector3f *vOut, unsigned char *pFlags, const M3DVector3f *v,
+							  const M3DMatrix44f mModelViewProjection, const int iViewPort[4], int nCount)
+	{
+	// Work through the array in small SoA blocks that stay in the L1 cache
+	float x[64], y[64], z[64];
+	int nVisible = 0;
+
+	for(int nBase = 0; nBase < nCount; nBase += 64)
+		{
+		int n = (nCount - nBase < 64) ? nCount - nBase : 64;
+		for(int i = 0; i < n; i++)
+			{
+			x[i] = v[nBase + i][0]; y[i] = v[nBase + i][1]; z[i] = v[nBase + i][2];
+			}
+
+		nVisible += m3dProjectStream3(x, y, z, pFlags ? pFlags + nBase : NULL, x, y, z, mModelViewProjection, iViewPort, n);
+
+		for(int i = 0; i < n; i++)
+			{
+			vOut[nBase + i][0] = x[i]; vOut[nBase + i][1] = y[i]; vOut[nBase + i][2] = z[i];
+			}
+		}
+
+	return nVisible;
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+// Bulk SoA kernels
+// These are the stream versions of the single vector routines in math3d.h.
+// Every result is computed with the same operations in the same order as the
+// single vector version, so a stream gives the same answers as a loop, just
+// 4 (SSE) or 8 (AVX) at a time. Output streams may be the same as input
+// streams. Alignment is not required; M3DVectorStream3 below gives 64 byte
+// aligned streams.
+
+// pDots[i] = m3dDotProduct3(u[i], v[i])
+inline void m3dDotProductStream3(float *pDots, const float *ux, const float *uy, const float *uz,
+								 const float *vx, const float *vy, const float *vz, int nCount)
+	{
+	int i = 0;
+
+#if defined(M3D_SIMD_AVX)
+	for(; i + 8 <= nCount; i += 8)
+		_mm256_storeu_ps(pDots + i, _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(_mm256_loadu_ps(ux + i), _mm256_loadu_ps(vx + i)),
+			_mm256_mul_ps(_mm256_loadu_ps(uy + i), _mm256_loadu_ps(vy + i))),
+			_mm256_mul_ps(_mm256_loadu_ps(uz + i), _mm256_loadu_ps(vz + i))));
+#endif
+#if defined(M3D_SIMD_SSE)
+	for(; i + 4 <= nCount; i += 4)
+		_mm_storeu_ps(pDots + i, _mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_loadu_ps(ux + i), _mm_loadu_ps(vx + i)),
+			_mm_mul_ps(_mm_loadu_ps(uy + i), _mm_loadu_ps(vy + i))),
+			_mm_mul_ps(_mm_loadu_ps(uz + i), _mm_loadu_ps(vz + i))));
+#endif
+
+	for(; i < nCount; i++)
+		pDots[i] = ux[i]*vx[i] + uy[i]*vy[i] + uz[i]*vz[i];
+	}
+
+
+// r[i] = m3dCrossProduct3(u[i], v[i])
+inline void m3dCrossProductStream3(float *rx, float *ry, float *rz,
+								   const float *ux, const float *uy, const float *uz,
+								   const float *vx, const float *vy, const float *vz, int nCount)
+	{
+	int i = 0;
+
+#if defined(M3D_SIMD_AVX)
+	for(; i + 8 <= nCount; i += 8)
+		{
+		__m256 ax = _mm256_loadu_ps(ux + i), ay = _mm256_loadu_ps(uy + i), az = _mm256_loadu_ps(uz + i);
+		__m256 bx = _mm256_loadu_ps(vx + i), by = _mm256_loadu_ps(vy + i), bz = _mm256_loadu_ps(vz + i);
+		_mm256_storeu_ps(rx + i, _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(by, az)));
+		_mm256_storeu_ps(ry + i, _mm256_sub_ps(_mm256_mul_ps(bx, az), _mm256_mul_ps(ax, bz)));
+		_mm256_storeu_ps(rz + i, _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(bx, ay)));
+		}
+#endif
+#if defined(M3D_SIMD_SSE)
+	for(; i + 4 <= nCount; i += 4)
+		{
+		__m128 ax = _mm_loadu_ps(ux + i), ay = _mm_loadu_ps(uy + i), az = _mm_loadu_ps(uz + i);
+		__m128 bx = _mm_loadu_ps(vx + i), by = _mm_loadu_ps(vy + i), bz = _mm_loadu_ps(vz + i);
+		_mm_storeu_ps(rx + i, _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(by, az)));
+		_mm_storeu_ps(ry + i, _mm_sub_ps(_mm_mul_ps(bx, az), _mm_mul_ps(ax, bz)));
+		_mm_storeu_ps(rz + i, _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(bx, ay)));
+		}
+#endif
+
+	for(; i < nCount; i++)
+		{
+		M3DVector3f u = { ux[i], uy[i], uz[i] }, v = { vx[i], vy[i], vz[i] }, r;
+		m3dCrossProduct3(r, u, v);
+		rx[i] = r[0]; ry[i] = r[1]; rz[i] = r[2];
+		}
+	}
+
+
+// pLengths[i] = m3dGetVectorLength3(v[i])
+inline void m3dGetVectorLengthStream3(float *pLengths, const float *x, const float *y, const float *z, int nCount)
+	{
+	m3dDotProductStream3(pLengths, x, y, z, x, y, z, nCount);
+
+	int i = 0;
+#if defined(M3D_SIMD_AVX)
+	for(; i + 8 <= nCount; i += 8)
+		_mm256_storeu_ps(pLengths + i, _mm256_sqrt_ps(_mm256_loadu_ps(pLengths + i)));
+#endif
+#if defined(M3D_SIMD_SSE)
+	for(; i + 4 <= nCount; i += 4)
+		_mm_storeu_ps(pLengths + i, _mm_sqrt_ps(_mm_loadu_ps(pLengths + i)));
+#endif
+	for(; i < nCount; i++)
+		pLengths[i] = sqrtf(pLengths[i]);
+	}
+
+
+// m3dNormalizeVector3 on every vector. Zero length vectors give NaNs, just
+// like the single vector version.
+inline void m3dNormalizeVectorStream3(float *xOut, float *yOut, float *zOut,
+									  const float *x, const float *y, const float *z, int nCount)
+	{
+	int i = 0;
+
+#if defined(M3D_SIMD_AVX)
+	const __m256 one8 = _mm256_set1_ps(1.0f);
+	for(; i + 8 <= nCount; i += 8)
+		{
+		__m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i), vz = _mm256_loadu_ps(z + i);
+		__m256 s = _mm256_div_ps(one8, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(
+						_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)), _mm256_mul_ps(vz, vz))));
+		_mm256_storeu_ps(xOut + i, _mm256_mul_ps(vx, s));
+		_mm256_storeu_ps(yOut + i, _mm256_mul_ps(vy, s));
+		_mm256_storeu_ps(zOut + i, _mm256_mul_ps(vz, s));
+		}
+#endif
+#if defined(M3D_SIMD_SSE)
+	const __m128 one4 = _mm_set1_ps(1.0f);
+	for(; i + 4 <= nCount; i += 4)
+		{
+		__m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+		__m128 s = _mm_div_ps(one4, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz))));
+		_mm_storeu_ps(xOut + i, _mm_mul_ps(vx, s));
+		_mm_storeu_ps(yOut + i, _mm_mul_ps(vy, s));
+		_mm_storeu_ps(zOut + i, _mm_mul_ps(vz, s));
+		}
+#endif
+
+	for(; i < nCount; i++)
+		{
+		M3DVector3f v = { x[i], y[i], z[i] };
+		m3dNormalizeVector3(v);
+		xOut[i] = v[0]; yOut[i] = v[1]; zOut[i] = v[2];
+		}
+	}
+
+
+// pDistances[i] = m3dGetDistanceToPlane(p[i], plane)
+inline void m3dGetDistanceToPlaneStream3(float *pDistances, const float *x, const float *y, const float *z,
+										 const M3DVector4f plane, int nCount)
+	{
+	int i = 0;
+
+#if defined(M3D_SIMD_AVX)
+	{
+	const __m256 a = _mm256_set1_ps(plane[0]), b = _mm256_set1_ps(plane[1]);
+	const __m256 c = _mm256_set1_ps(plane[2]), d = _mm256_set1_ps(plane[3]);
+	for(; i + 8 <= nCount; i += 8)
+		_mm256_storeu_ps(pDistances + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(_mm256_loadu_ps(x + i), a), _mm256_mul_ps(_mm256_loadu_ps(y + i), b)),
+			_mm256_mul_ps(_mm256_loadu_ps(z + i), c)), d));
+	}
+#endif
+#if defined(M3D_SIMD_SSE)
+	{
+	const __m128 a = _mm_set1_ps(plane[0]), b = _mm_set1_ps(plane[1]);
+	const __m128 c = _mm_set1_ps(plane[2]), d = _mm_set1_ps(plane[3]);
+	for(; i + 4 <= nCount; i += 4)
+		_mm_storeu_ps(pDistances + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(_mm_loadu_ps(x + i), a), _mm_mul_ps(_mm_loadu_ps(y + i), b)),
+			_mm_mul_ps(_mm_loadu_ps(z + i), c)), d));
+	}
+#endif
+
+	for(; i < nCount; i++)
+		pDistances[i] = x[i]*plane[0] + y[i]*plane[1] + z[i]*plane[2] + plane[3];
+	}
+
+
+// Bounding box of a stream of points. nCount must be at least one.
+inline void m3dGetMinMaxStream3(M3DVector3f vMin, M3DVector3f vMax, const float *x, const float *y, const float *z, int nCount)
+	{
+	float mn[3] = { x[0], y[0], z[0] };
+	float mx[3] = { x[0], y[0], z[0] };
+	int i = 0;
+
+#if defined(M3D_SIMD_SSE)
+	if(nCount >= 4) {
+		__m128 nx = _mm_loadu_ps(x), ny = _mm_loadu_ps(y), nz = _mm_loadu_ps(z);
+		__m128 px = nx, py = ny, pz = nz;
+		for(i = 4; i + 4 <= nCount; i += 4)
+			{
+			__m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+			nx = _mm_min_ps(nx, vx); ny = _mm_min_ps(ny, vy); nz = _mm_min_ps(nz, vz);
+			px = _mm_max_ps(px, vx); py = _mm_max_ps(py, vy); pz = _mm_max_ps(pz, vz);
+			}
+
+		// Fold the four lanes down
+		float f[4];
+		_mm_storeu_ps(f, nx); mn[0] = fminf(fminf(f[0], f[1]), fminf(f[2], f[3]));
+		_mm_storeu_ps(f, ny); mn[1] = fminf(fminf(f[0], f[1]), fminf(f[2], f[3]));
+		_mm_storeu_ps(f, nz); mn[2] = fminf(fminf(f[0], f[1]), fminf(f[2], f[3]));
+		_mm_storeu_ps(f, px); mx[0] = fmaxf(fmaxf(f[0], f[1]), fmaxf(f[2], f[3]));
+		_mm_storeu_ps(f, py); mx[1] = fmaxf(fmaxf(f[0], f[1]), fmaxf(f[2], f[3]));
+		_mm_storeu_ps(f, pz); mx[2] = fmaxf(fmaxf(f[0], f[1]), fmaxf(f[2], f[3]));
+		}
+#endif
+
+	for(; i < nCount; i++)
+		{
+		if(x[i] < mn[0]) mn[0] = x[i];
+		if(y[i] < mn[1]) mn[1] = y[i];
+		if(z[i] < mn[2]) mn[2] = z[i];
+		if(x[i] > mx[0]) mx[0] = x[i];
+		if(y[i] > mx[1]) mx[1] = y[i];
+		if(z[i] > mx[2]) mx[2] = z[i];
+		}
+
+	m3dCopyVector3(vMin, mn);
+	m3dCopyVector3(vMax, mx);
+	}
+
+
+// pSin[i], pCos[i] = m3dSinCos(pAngles[i]). Same reduction, polynomials and
+// operation order as m3dSinCos, so the results are identical to it. Either
+// output may be NULL, and either may be the same array as pAngles.
+inline void m3dSinCosStream(float *pSin, float *pCos, const float *pAngles, int nCount)
+	{
+	int i = 0;
+
+#if defined(M3D_SIMD_AVX)
+	{
+	const __m256 twoDivPi = _mm256_set1_ps(M3D_2_DIV_PI_F);
+	const __m256 pA = _mm256_set1_ps(M3D_PI_DIV_2_F_A), pB = _mm256_set1_ps(M3D_PI_DIV_2_F_B), pC = _mm256_set1_ps(M3D_PI_DIV_2_F_C);
+	const __m256 s1 = _mm256_set1_ps(-1.9515295891e-4f), s2 = _mm256_set1_ps(8.3321608736e-3f), s3 = _mm256_set1_ps(-1.6666654611e-1f);
+	const __m256 c1 = _mm256_set1_ps(2.443315711809948e-5f), c2 = _mm256_set1_ps(-1.388731625493765e-3f), c3 = _mm256_set1_ps(4.166664568298827e-2f);
+	const __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f), quarter = _mm256_set1_ps(0.25f);
+	const __m256 four = _mm256_set1_ps(4.0f), sign = _mm256_set1_ps(-0.0f);
+
+	for(; i + 8 <= nCount; i += 8)
+		{
+		__m256 a = _mm256_loadu_ps(pAngles + i);
+		__m256 k = _mm256_round_ps(_mm256_mul_ps(a, twoDivPi), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256 x = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(a, _mm256_mul_ps(k, pA)), _mm256_mul_ps(k, pB)), _mm256_mul_ps(k, pC));
+		__m256 x2 = _mm256_mul_ps(x, x);
+
+		__m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(s1, x2), s2), x2), s3), x2), x), x);
+		__m256 c = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(c1, x2), c2), x2), c3), x2), x2),
+											   _mm256_mul_ps(half, x2)), one);
+
+		// Quadrant 0..3 as a float, then masks for the swap and the two sign flips
+		__m256 q = _mm256_sub_ps(k, _mm256_mul_ps(four, _mm256_floor_ps(_mm256_mul_ps(k, quarter))));
+		__m256 odd = _mm256_or_ps(_mm256_cmp_ps(q, one, _CMP_EQ_OQ), _mm256_cmp_ps(q, _mm256_set1_ps(3.0f), _CMP_EQ_OQ));
+		__m256 sinNeg = _mm256_and_ps(_mm256_cmp_ps(q, _mm256_set1_ps(2.0f), _CMP_GE_OQ), sign);
+		__m256 cosNeg = _mm256_and_ps(_mm256_or_ps(_mm256_cmp_ps(q, one, _CMP_EQ_OQ), _mm256_cmp_ps(q, _mm256_set1_ps(2.0f), _CMP_EQ_OQ)), sign);
+
+		__m256 rs = _mm256_xor_ps(_mm256_blendv_ps(s, c, odd), sinNeg);
+		__m256 rc = _mm256_xor_ps(_mm256_blendv_ps(c, s, odd), cosNeg);
+		if(pSin) _mm256_storeu_ps(pSin + i, rs);
+		if(pCos) _mm256_storeu_ps(pCos + i, rc);
+		}
+	}
+#endif
+
+#if defined(M3D_SIMD_SSE2)
+	{
+	const __m128 twoDivPi = _mm_set1_ps(M3D_2_DIV_PI_F);
+	const __m128 pA = _mm_set1_ps(M3D_PI_DIV_2_F_A), pB = _mm_set1_ps(M3D_PI_DIV_2_F_B), pC = _mm_set1_ps(M3D_PI_DIV_2_F_C);
+	const __m128 s1 = _mm_set1_ps(-1.9515295891e-4f), s2 = _mm_set1_ps(8.3321608736e-3f), s3 = _mm_set1_ps(-1.6666654611e-1f);
+	const __m128 c1 = _mm_set1_ps(2.443315711809948e-5f), c2 = _mm_set1_ps(-1.388731625493765e-3f), c3 = _mm_set1_ps(4.166664568298827e-2f);
+	const __m128 half = _mm_set1_ps(0.5f), one = _mm_set1_ps(1.0f), sign = _mm_set1_ps(-0.0f);
+
+	for(; i + 4 <= nCount; i += 4)
+		{
+		__m128 a = _mm_loadu_ps(pAngles + i);
+		__m128i ki = _mm_cvtps_epi32(_mm_mul_ps(a, twoDivPi));	// Rounds to nearest even, like nearbyintf
+		__m128 k = _mm_cvtepi32_ps(ki);
+		__m128 x = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(a, _mm_mul_ps(k, pA)), _mm_mul_ps(k, pB)), _mm_mul_ps(k, pC));
+		__m128 x2 = _mm_mul_ps(x, x);
+
+		__m128 s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(s1, x2), s2), x2), s3), x2), x), x);
+		__m128 c = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(c1, x2), c2), x2), c3), x2), x2),
+										 _mm_mul_ps(half, x2)), one);
+
+		// Bit 0 of the quadrant swaps sin and cos, bit 1 flips both signs
+		__m128 odd = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(ki, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+		__m128 flip = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(ki, _mm_set1_epi32(2)), 30));
+		__m128 rs = _mm_or_ps(_mm_and_ps(odd, c), _mm_andnot_ps(odd, s));
+		__m128 rc = _mm_or_ps(_mm_and_ps(odd, _mm_xor_ps(s, sign)), _mm_andnot_ps(odd, c));
+		rs = _mm_xor_ps(rs, flip);
+		rc = _mm_xor_ps(rc, flip);
+		if(pSin) _mm_storeu_ps(pSin + i, rs);
+		if(pCos) _mm_storeu_ps(pCos + i, rc);
+		}
+	}
+#endif
+
+	for(; i < nCount; i++)
+		{
+		float s, c;
+		m3dSinCos(pAngles[i], s, c);
+		if(pSin) pSin[i] = s;
+		if(pCos) pCos[i] = c;
+		}
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+// Ray queries
+// Picking and line of sight tests against whole streams of spheres or axis
+// aligned boxes. Each returns the index of the nearest object the ray hits,
+// or -1, and replaces fDistance with the distance to that hit. On the way in
+// fDistance is the farthest distance to consider, so pass FLT_MAX for an
+// unlimited ray or the segment length for a line of sight test. vDir must be
+// unit length, as it must for m3dRaySphereTest. A ray that starts inside an
+// object hits it at distance 0. Ties go to the lowest index. Indexes are
+// tracked in float lanes, so nCount must stay below 16 million.
+
+// Scalar min/max with the same NaN behaviour as _mm_min_ps/_mm_max_ps (the
+// second operand wins), so the scalar tails match the SIMD lanes exactly.
+inline float m3dRayMin(float a, float b) { return (a < b) ? a : b; }
+inline float m3dRayMax(float a, float b) { return (a > b) ? a : b; }
+
+// Fold per lane results down to the nearest hit, lowest index first on ties
+inline int m3dRayPickLane(float &fDistance, const float *pDist, const float *pIndex, int nLanes)
+	{
+	int iHit = -1;
+	for(int l = 0; l < nLanes; l++)
+		if(pIndex[l] >= 0.0f && (pDist[l] < fDistance || (pDist[l] == fDistance && int(pIndex[l]) < iHit)))
+			{
+			fDistance = pDist[l];
+			iHit = int(pIndex[l]);
+			}
+	return iHit;
+	}
+
+
+// Spheres are given as center streams and a radius stream. Same arithmetic as
+// m3dRaySphereTest: the entry distance is a - sqrt(r^2 - d^2 + a^2), where a
+// is the distance along the ray to the closest approach to the center.
+inline int m3dRaySphereStream(float &fDistance, const M3DVector3f vOrigin, const M3DVector3f vDir,
+							  const float *cx, const float *cy, const float *cz, const float *pRadius, int nCount)
+	{
+	int iHit = -1;
+	int i = 0;
+
+#if defined(M3D_SIMD_AVX)
+	if(nCount >= 8) {
+		const __m256 ox = _mm256_set1_ps(vOrigin[0]), oy = _mm256_set1_ps(vOrigin[1]), oz = _mm256_set1_ps(vOrigin[2]);
+		const __m256 dx = _mm256_set1_ps(vDir[0]), dy = _mm256_set1_ps(vDir[1]), dz = _mm256_set1_ps(vDir[2]);
+		const __m256 zero = _mm256_setzero_ps(), eight = _mm256_set1_ps(8.0f);
+		__m256 best = _mm256_set1_ps(fDistance);
+		__m256 bestIndex = _mm256_set1_ps(-1.0f);
+		__m256 index = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+
+		for(; i + 8 <= nCount; i += 8, index = _mm256_add_ps(index, eight))
+			{
+			__m256 lx = _mm256_sub_ps(_mm256_loadu_ps(cx + i), ox);
+			__m256 ly = _mm256_sub_ps(_mm256_loadu_ps(cy + i), oy);
+			__m256 lz = _mm256_sub_ps(_mm256_loadu_ps(cz + i), oz);
+			__m256 r = _mm256_loadu_ps(pRadius + i);
+			__m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lx, dx), _mm256_mul_ps(ly, dy)), _mm256_mul_ps(lz, dz));
+			__m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lx, lx), _mm256_mul_ps(ly, ly)), _mm256_mul_ps(lz, lz));
+			__m256 disc = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(r, r), d2), _mm256_mul_ps(a, a));
+			__m256 s = _mm256_sqrt_ps(_mm256_max_ps(disc, zero));
+			__m256 t = _mm256_max_ps(_mm256_sub_ps(a, s), zero);
+
+			// Hit if the ray passes inside the sphere and leaves it in front of the origin
+			__m256 hit = _mm256_and_ps(_mm256_cmp_ps(disc, zero, _CMP_GT_OQ), _mm256_cmp_ps(_mm256_add_ps(a, s), zero, _CMP_GE_OQ));
+			hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, best, _CMP_LT_OQ));
+			best = _mm256_blendv_ps(best, t, hit);
+			bestIndex = _mm256_blendv_ps(bestIndex, index, hit);
+			}
+
+		float fDist[8], fIndex[8];
+		_mm256_storeu_ps(fDist, best);
+		_mm256_storeu_ps(fIndex, bestIndex);
+		iHit = m3dRayPickLane(fDistance, fDist, fIndex, 8);
+		}
+#endif
+
+#if defined(M3D_SIMD_SSE)
+	if(nCount - i >= 4) {
+		const __m128 ox = _mm_set1_ps(vOrigin[0]), oy = _mm_set1_ps(vOrigin[1]), oz = _mm_set1_ps(vOrigin[2]);
+		const __m128 dx = _mm_set1_ps(vDir[0]), dy = _mm_set1_ps(vDir[1]), dz = _mm_set1_ps(vDir[2]);
+		const __m128 zero = _mm_setzero_ps(), four = _mm_set1_ps(4.0f);
+		__m128 best = _mm_set1_ps(fDistance);
+		__m128 bestIndex = _mm_set1_ps(-1.0f);
+		__m128 index = _mm_add_ps(_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_set1_ps(float(i)));
+
+		for(; i + 4 <= nCount; i += 4, index = _mm_add_ps(index, four))
+			{
+			__m128 lx = _mm_sub_ps(_mm_loadu_ps(cx + i), ox);
+			__m128 ly = _mm_sub_ps(_mm_loadu_ps(cy + i), oy);
+			__m128 lz = _mm_sub_ps(_mm_loadu_ps(cz + i), oz);
+			__m128 r = _mm_loadu_ps(pRadius + i);
+			__m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, dx), _mm_mul_ps(ly, dy)), _mm_mul_ps(lz, dz));
+			__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz));
+			__m128 disc = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(r, r), d2), _mm_mul_ps(a, a));
+			__m128 s = _mm_sqrt_ps(_mm_max_ps(disc, zero));
+			__m128 t = _mm_max_ps(_mm_sub_ps(a, s), zero);
+
+			__m128 hit = _mm_and_ps(_mm_cmpgt_ps(disc, zero), _mm_cmpge_ps(_mm_add_ps(a, s), zero));
+			hit = _mm_and_ps(hit, _mm_cmplt_ps(t, best));
+			best = _mm_or_ps(_mm_and_ps(hit, t), _mm_andnot_ps(hit, best));
+			bestIndex = _mm_or_ps(_mm_and_ps(hit, index), _mm_andnot_ps(hit, bestIndex));
+			}
+
+		float fDist[4], fIndex[4];
+		_mm_storeu_ps(fDist, best);
+		_mm_storeu_ps(fIndex, bestIndex);
+		int iLane = m3dRayPickLane(fDistance, fDist, fIndex, 4);
+		if(iLane >= 0)
+			iHit = iLane;
+		}
+#endif
+
+	for(; i < nCount; i++)
+		{
+		float lx = cx[i] - vOrigin[0], ly = cy[i] - vOrigin[1], lz = cz[i] - vOrigin[2];
+		float a = lx*vDir[0] + ly*vDir[1] + lz*vDir[2];
+		float d2 = lx*lx + ly*ly + lz*lz;
+		float disc = pRadius[i]*pRadius[i] - d2 + a*a;
+		float s = sqrtf(m3dRayMax(disc, 0.0f));
+		float t = m3dRayMax(a - s, 0.0f);
+		if(disc > 0.0f && a + s >= 0.0f && t < fDistance)
+			{
+			fDistance = t;
+			iHit = i;
+			}
+		}
+
+	return iHit;
+	}
+
+
+// Boxes are given as min and max corner streams. Standard slab test, with the
+// reciprocal of the direction worked out once per ray. A ray that lies exactly
+// in the plane of a box face may or may not hit that box.
+inline int m3dRayBoxStream(float &fDistance, const M3DVector3f vOrigin, const M3DVector3f vDir,
+						   const float *minX, const float *minY, const float *minZ,
+						   const float *maxX, const float *maxY, const float *maxZ, int nCount)
+	{
+	const float ix = 1.0f / vDir[0], iy = 1.0f / vDir[1], iz = 1.0f / vDir[2];
+	int iHit = -1;
+	int i = 0;
+
+#if defined(M3D_SIMD_AVX)
+	if(nCount >= 8) {
+		const __m256 ox = _mm256_set1_ps(vOrigin[0]), oy = _mm256_set1_ps(vOrigin[1]), oz = _mm256_set1_ps(vOrigin[2]);
+		const __m256 rx = _mm256_set1_ps(ix), ry = _mm256_set1_ps(iy), rz = _mm256_set1_ps(iz);
+		const __m256 zero = _mm256_setzero_ps(), eight = _mm256_set1_ps(8.0f);
+		__m256 best = _mm256_set1_ps(fDistance);
+		__m256 bestIndex = _mm256_set1_ps(-1.0f);
+		__m256 index = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+
+		for(; i + 8 <= nCount; i += 8, index = _mm256_add_ps(index, eight))
+			{
+			__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(minX + i), ox), rx);
+			__m256 t2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(maxX + i), ox), rx);
+			__m256 tNear = _mm256_min_ps(t1, t2), tFar = _mm256_max_ps(t1, t2);
+			t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(minY + i), oy), ry);
+			t2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(maxY + i), oy), ry);
+			tNear = _mm256_max_ps(tNear, _mm256_min_ps(t1, t2)); tFar = _mm256_min_ps(tFar, _mm256_max_ps(t1, t2));
+			t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(minZ + i), oz), rz);
+			t2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(maxZ + i), oz), rz);
+			tNear = _mm256_max_ps(tNear, _mm256_min_ps(t1, t2)); tFar = _mm256_min_ps(tFar, _mm256_max_ps(t1, t2));
+			tNear = _mm256_max_ps(tNear, zero);
+
+			__m256 hit = _mm256_and_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ), _mm256_cmp_ps(tNear, best, _CMP_LT_OQ));
+			best = _mm256_blendv_ps(best, tNear, hit);
+			bestIndex = _mm256_blendv_ps(bestIndex, index, hit);
+			}
+
+		float fDist[8], fIndex[8];
+		_mm256_storeu_ps(fDist, best);
+		_mm256_storeu_ps(fIndex, bestIndex);
+		iHit = m3dRayPickLane(fDistance, fDist, fIndex, 8);
+		}
+#endif
+
+#if defined(M3D_SIMD_SSE)
+	if(nCount - i >= 4) {
+		const __m128 ox = _mm_set1_ps(vOrigin[0]), oy = _mm_set1_ps(vOrigin[1]), oz = _mm_set1_ps(vOrigin[2]);
+		const __m128 rx = _mm_set1_ps(ix), ry = _mm_set1_ps(iy), rz = _mm_set1_ps(iz);
+		const __m128 zero = _mm_setzero_ps(), four = _mm_set1_ps(4.0f);
+		__m128 best = _mm_set1_ps(fDistance);
+		__m128 bestIndex = _mm_set1_ps(-1.0f);
+		__m128 index = _mm_add_ps(_mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f), _mm_set1_ps(float(i)));
+
+		for(; i + 4 <= nCount; i += 4, index = _mm_add_ps(index, four))
+			{
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minX + i), ox), rx);
+			__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxX + i), ox), rx);
+			__m128 tNear = _mm_min_ps(t1, t2), tFar = _mm_max_ps(t1, t2);
+			t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minY + i), oy), ry);
+			t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxY + i), oy), ry);
+			tNear = _mm_max_ps(tNear, _mm_min_ps(t1, t2)); tFar = _mm_min_ps(tFar, _mm_max_ps(t1, t2));
+			t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(minZ + i), oz), rz);
+			t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(maxZ + i), oz), rz);
+			tNear = _mm_max_ps(tNear, _mm_min_ps(t1, t2)); tFar = _mm_min_ps(tFar, _mm_max_ps(t1, t2));
+			tNear = _mm_max_ps(tNear, zero);
+
+			__m128 hit = _mm_and_ps(_mm_cmple_ps(tNear, tFar), _mm_cmplt_ps(tNear, best));
+			best = _mm_or_ps(_mm_and_ps(hit, tNear), _mm_andnot_ps(hit, best));
+			bestIndex = _mm_or_ps(_mm_and_ps(hit, index), _mm_andnot_ps(hit, bestIndex));
+			}
+
+		float fDist[4], fIndex[4];
+		_mm_storeu_ps(fDist, best);
+		_mm_storeu_ps(fIndex, bestIndex);
+		int iLane = m3dRayPickLane(fDistance, fDist, fIndex, 4);
+		if(iLane >= 0)
+			iHit = iLane;
+		}
+#endif
+
+	for(; i < nCount; i++)
+		{
+		float t1 = (minX[i] - vOrigin[0]) * ix, t2 = (maxX[i] - vOrigin[0]) * ix;
+		float tNear = m3dRayMin(t1, t2), tFar = m3dRayMax(t1, t2);
+		t1 = (minY[i] - vOrigin[1]) * iy; t2 = (maxY[i] - vOrigin[1]) * iy;
+		tNear = m3dRayMax(tNear, m3dRayMin(t1, t2)); tFar = m3dRayMin(tFar, m3dRayMax(t1, t2));
+		t1 = (minZ[i] - vOrigin[2]) * iz; t2 = (maxZ[i] - vOrigin[2]) * iz;
+		tNear = m3dRayMax(tNear, m3dRayMin(t1, t2)); tFar = m3dRayMin(tFar, m3dRayMax(t1, t2));
+		tNear = m3dRayMax(tNear, 0.0f);
+		if(tNear <= tFar && tNear < fDistance)
+			{
+			fDistance = tNear;
+			iHit = i;
+			}
+		}
+
+	return iHit;
+	}
+
+
+// Packet versions: nRays rays against the same spheres or boxes, for example
+// line of sight from many actors at once. pHits[r] and pDistances[r] work
+// like the return value and fDistance above for ray r. With SSE four rays are
+// traced side by side, so each object is loaded once per four rays instead of
+// once per ray; that wins when there are more rays than SIMD lanes of objects.
+inline void m3dRaySpherePacket(int *pHits, float *pDistances, const M3DVector3f *vOrigins, const M3DVector3f *vDirs, int nRays,
+							   const float *cx, const float *cy, const float *cz, const float *pRadius, int nCount)
+	{
+	int r = 0;
+
+#if defined(M3D_SIMD_SSE)
+	const __m128 zero = _mm_setzero_ps();
+	for(; r + 4 <= nRays; r += 4)
+		{
+		__m128 ox, oy, oz, dx, dy, dz;
+		m3dSSELoadVectors3(vOrigins[r], ox, oy, oz);
+		m3dSSELoadVectors3(vDirs[r], dx, dy, dz);
+		__m128 best = _mm_loadu_ps(pDistances + r);
+		__m128 bestIndex = _mm_set1_ps(-1.0f);
+
+		for(int i = 0; i < nCount; i++)
+			{
+			__m128 lx = _mm_sub_ps(_mm_set1_ps(cx[i]), ox);
+			__m128 ly = _mm_sub_ps(_mm_set1_ps(cy[i]), oy);
+			__m128 lz = _mm_sub_ps(_mm_set1_ps(cz[i]), oz);
+			__m128 rad = _mm_set1_ps(pRadius[i]);
+			__m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, dx), _mm_mul_ps(ly, dy)), _mm_mul_ps(lz, dz));
+			__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz));
+			__m128 disc = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(rad, rad), d2), _mm_mul_ps(a, a));
+			__m128 s = _mm_sqrt_ps(_mm_max_ps(disc, zero));
+			__m128 t = _mm_max_ps(_mm_sub_ps(a, s), zero);
+
+			__m128 hit = _mm_and_ps(_mm_cmpgt_ps(disc, zero), _mm_cmpge_ps(_mm_add_ps(a, s), zero));
+			hit = _mm_and_ps(hit, _mm_cmplt_ps(t, best));
+			best = _mm_or_ps(_mm_and_ps(hit, t), _mm_andnot_ps(hit, best));
+			bestIndex = _mm_or_ps(_mm_and_ps(hit, _mm_set1_ps(float(i))), _mm_andnot_ps(hit, bestIndex));
+			}
+
+		float fIndex[4];
+		_mm_storeu_ps(pDistances + r, best);
+		_mm_storeu_ps(fIndex, bestIndex);
+		for(int l = 0; l < 4; l++)
+			pHits[r + l] = int(fIndex[l]);
+		}
+#endif
+
+	for(; r < nRays; r++)
+		pHits[r] = m3dRaySphereStream(pDistances[r], vOrigins[r], vDirs[r], cx, cy, cz, pRadius, nCount);
+	}
+
+
+inline void m3dRayBoxPacket(int *pHits, float *pDistances, const M3DVector3f *vOrigins, const M3DVector3f *vDirs, int nRays,
+							const float *minX, const float *minY, const float *minZ,
+							const float *maxX, const float *maxY, const float *maxZ, int nCount)
+	{
+	int r = 0;
+
+#if defined(M3D_SIMD_SSE)
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	for(; r + 4 <= nRays; r += 4)
+		{
+		__m128 ox, oy, oz, rx, ry, rz;
+		m3dSSELoadVectors3(vOrigins[r], ox, oy, oz);
+		m3dSSELoadVectors3(vDirs[r], rx, ry, rz);
+		rx = _mm_div_ps(one, rx); ry = _mm_div_ps(one, ry); rz = _mm_div_ps(one, rz);
+		__m128 best = _mm_loadu_ps(pDistances + r);
+		__m128 bestIndex = _mm_set1_ps(-1.0f);
+
+		for(int i = 0; i < nCount; i++)
+			{
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(minX[i]), ox), rx);
+			__m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(maxX[i]), ox), rx);
+			__m128 tNear = _mm_min_ps(t1, t2), tFar = _mm_max_ps(t1, t2);
+			t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(minY[i]), oy), ry);
+			t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(maxY[i]), oy), ry);
+			tNear = _mm_max_ps(tNear, _mm_min_ps(t1, t2)); tFar = _mm_min_ps(tFar, _mm_max_ps(t1, t2));
+			t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(minZ[i]), oz), rz);
+			t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(maxZ[i]), oz), rz);
+			tNear = _mm_max_ps(tNear, _mm_min_ps(t1, t2)); tFar = _mm_min_ps(tFar, _mm_max_ps(t1, t2));
+			tNear = _mm_max_ps(tNear, zero);
+
+			__m128 hit = _mm_and_ps(_mm_cmple_ps(tNear, tFar), _mm_cmplt_ps(tNear, best));
+			best = _mm_or_ps(_mm_and_ps(hit, tNear), _mm_andnot_ps(hit, best));
+			bestIndex = _mm_or_ps(_mm_and_ps(hit, _mm_set1_ps(float(i))), _mm_andnot_ps(hit, bestIndex));
+			}
+
+		float fIndex[4];
+		_mm_storeu_ps(pDistances + r, best);
+		_mm_storeu_ps(fIndex, bestIndex);
+		for(int l = 0; l < 4; l++)
+			pHits[r + l] = int(fIndex[l]);
+		}
+#endif
+
+	for(; r < nRays; r++)
+		pHits[r] = m3dRayBoxStream(pDistances[r], vOrigins[r], vDirs[r], minX, minY, minZ, maxX, maxY, maxZ, nCount);
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Aligned memory for streams (and anything else that wants SIMD alignment).
+// nAlignment must be a power of two, and a multiple of sizeof(void *).
+inline void *m3dAlignedAlloc(size_t nBytes, size_t nAlignment)
+	{
+#ifdef _MSC_VER
+	return _aligned_malloc(nBytes, nAlignment);
+#else
+	void *p = NULL;
+	if(posix_memalign(&p, nAlignment, nBytes) != 0)
+		return NULL;
+	return p;
+#endif
+	}
+
+inline void m3dAlignedFree(void *p)
+	{
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// A stream of 3 component vectors kept as separate x[], y[] and z[] arrays.
+// All three arrays are 64 byte aligned and padded out to a multiple of 16
+// floats, so whole SIMD registers can always be loaded from them. Feed x, y
+// and z straight to the stream kernels above:
+//
+//		M3DVectorStream3 normals(nVerts);
+//		normals.LoadArray(pNorms, nVerts);
+//		m3dNormalizeVectorStream3(normals.x, normals.y, normals.z,
+//								  normals.x, normals.y, normals.z, normals.GetCount());
+class M3DVectorStream3
+	{
+	public:
+		float	*x;
+		float	*y;
+		float	*z;
+
+		M3DVectorStream3(int nInitialCount = 0)
+			{
+			x = y = z = NULL;
+			nCount = nCapacity = 0;
+			Resize(nInitialCount);
+			}
+
+		~M3DVectorStream3(void) { m3dAlignedFree(x); }
+
+		inline int GetCount(void) const { return nCount; }
+
+		// Change the number of vectors. Existing vectors are kept, new ones are
+		// not initialized. Shrinking never gives memory back.
+		void Resize(int nNewCount)
+			{
+			if(nNewCount > nCapacity) {
+				int nNewCapacity = (nNewCount + 15) & ~15;
+				float *p = (float *)m3dAlignedAlloc(sizeof(float) * 3 * nNewCapacity, 64);
+				if(p == NULL)
+					return;
+
+				if(nCount > 0) {
+					memcpy(p, x, sizeof(float) * nCount);
+					memcpy(p + nNewCapacity, y, sizeof(float) * nCount);
+					memcpy(p + 2 * nNewCapacity, z, sizeof(float) * nCount);
+					}
+				m3dAlignedFree(x);
+
+				x = p;
+				y = p + nNewCapacity;
+				z = p + 2 * nNewCapacity;
+				nCapacity = nNewCapacity;
+				}
+			nCount = nNewCount;
+			}
+
+		inline void Set(int i, const M3DVector3f v) { x[i] = v[0]; y[i] = v[1]; z[i] = v[2]; }
+		inline void Get(int i, M3DVector3f v) const { v[0] = x[i]; v[1] = y[i]; v[2] = z[i]; }
+
+		// Convert from and to an ordinary M3DVector3f array (e.g. GLTriangleBatch data)
+		void LoadArray(const M3DVector3f *v, int nVectors)
+			{
+			Resize(nVectors);
+			int i = 0;
+#ifdef M3D_SIMD_SSE
+			for(; i + 4 <= nVectors; i += 4)
+				{
+				__m128 vx, vy, vz;
+				m3dSSELoadVectors3(v[i], vx, vy, vz);
+				_mm_store_ps(x + i, vx);
+				_mm_store_ps(y + i, vy);
+				_mm_store_ps(z + i, vz);
+				}
+#endif
+			for(; i < nVectors; i++)
+				Set(i, v[i]);
+			}
+
+		void StoreArray(M3DVector3f *v) const
+			{
+			int i = 0;
+#ifdef M3D_SIMD_SSE
+			for(; i + 4 <= nCount; i += 4)
+				m3dSSEStoreVectors3(v[i], _mm_load_ps(x + i), _mm_load_ps(y + i), _mm_load_ps(z + i));
+#endif
+			for(; i < nCount; i++)
+				Get(i, v[i]);
+			}
+
+	private:
+		int		nCount;
+		int		nCapacity;
+
+		// Streams own their memory, so no copying
+		M3DVectorStream3(const M3DVectorStream3&);
+		M3DVectorStream3& operator=(const M3DVectorStream3&);
+	};
+
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+// Whole mesh tangent basis
+// m3dCalculateTangentBasis gives the tangent of a single triangle. This does
+// the whole indexed mesh in one go: every triangle adds its (unnormalized)
+// texture space s and t directions to its three vertices, then every vertex
+// gets its s direction made orthogonal to the normal and normalized, with w
+// holding the handedness (+1 or -1) so a shader can rebuild the bitangent as
+// cross(normal, tangent.xyz) * tangent.w. Triangles with degenerate texture
+// coordinates add nothing; a vertex that ends up with no tangent gets an
+// arbitrary one perpendicular to its normal. The normals must be unit length.
+// INDEX is GLushort or GLuint, whichever the mesh uses.
+
+// One vertex: vSum and vT are the summed s and t directions
+inline void m3dFinishTangent(M3DVector4f vTangent, const M3DVector3f n, const M3DVector3f vSum, const M3DVector3f vT)
+	{
+	M3DVector3f vS, vC;
+	float d = m3dDotProduct3(n, vSum);
+	for(int a = 0; a < 3; a++)
+		vS[a] = vSum[a] - n[a] * d;
+	if(m3dGetVectorLengthSquared3(vS) < 1e-20f) {
+		// No usable texture direction; any vector in the tangent plane will do
+		M3DVector3f vAxis = { 1.0f, 0.0f, 0.0f };
+		if(fabsf(n[0]) > 0.9f) {
+			vAxis[0] = 0.0f;
+			vAxis[1] = 1.0f;
+			}
+		m3dCrossProduct3(vC, vAxis, n);
+		m3dCrossProduct3(vS, n, vC);
+		}
+	m3dNormalizeVector3(vS);
+
+	m3dCrossProduct3(vC, n, vS);
+	vTangent[0] = vS[0];
+	vTangent[1] = vS[1];
+	vTangent[2] = vS[2];
+	vTangent[3] = (m3dDotProduct3(vC, vT) < 0.0f) ? -1.0f : 1.0f;
+	}
+
+template <class INDEX>
+void m3dCalculateTangentArray(M3DVector4f *pTangents, const M3DVector3f *pVerts, const M3DVector3f *pNorms,
+							  const M3DVector2f *pTexCoords, int nVerts, const INDEX *pIndexes, int nIndexes)
+	{
+	M3DVectorStream3 sDir(nVerts), tDir(nVerts);
+	for(int i = 0; i < nVerts; i++)
+		sDir.x[i] = sDir.y[i] = sDir.z[i] = tDir.x[i] = tDir.y[i] = tDir.z[i] = 0.0f;
+
+	// Pass 1: per triangle directions, four triangles at a time, then added
+	// into the vertices they belong to
+	int nTriangles = nIndexes / 3;
+	for(int nBase = 0; nBase < nTriangles; nBase += 4)
+		{
+		int n = (nTriangles - nBase < 4) ? nTriangles - nBase : 4;
+		float e1[3][4], e2[3][4], uv[4][4], s[3][4], t[3][4];
+		for(int l = 0; l < 4; l++)
+			{
+			const INDEX *pTri = pIndexes + 3 * (nBase + ((l < n) ? l : 0));
+			const float *v0 = pVerts[pTri[0]], *v1 = pVerts[pTri[1]], *v2 = pVerts[pTri[2]];
+			const float *c0 = pTexCoords[pTri[0]], *c1 = pTexCoords[pTri[1]], *c2 = pTexCoords[pTri[2]];
+			for(int a = 0; a < 3; a++)
+				{
+				e1[a][l] = v1[a] - v0[a];
+				e2[a][l] = v2[a] - v0[a];
+				}
+			uv[0][l] = c1[0] - c0[0]; uv[1][l] = c1[1] - c0[1];
+			uv[2][l] = c2[0] - c0[0]; uv[3][l] = c2[1] - c0[1];
+			}
+
+#if defined(M3D_SIMD_SSE)
+		{
+		__m128 du1 = _mm_loadu_ps(uv[0]), dv1 = _mm_loadu_ps(uv[1]), du2 = _mm_loadu_ps(uv[2]), dv2 = _mm_loadu_ps(uv[3]);
+		__m128 det = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(du2, dv1));
+		__m128 valid = _mm_cmpneq_ps(det, _mm_setzero_ps());
+		__m128 r = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.0f), _mm_or_ps(det, _mm_andnot_ps(valid, _mm_set1_ps(1.0f)))));
+		for(int a = 0; a < 3; a++)
+			{
+			__m128 a1 = _mm_loadu_ps(e1[a]), a2 = _mm_loadu_ps(e2[a]);
+			_mm_storeu_ps(s[a], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(a1, dv2), _mm_mul_ps(a2, dv1)), r));
+			_mm_storeu_ps(t[a], _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(a2, du1), _mm_mul_ps(a1, du2)), r));
+			}
+		}
+#else
+		for(int l = 0; l < 4; l++)
+			{
+			float det = uv[0][l] * uv[3][l] - uv[2][l] * uv[1][l];
+			float r = (det != 0.0f) ? 1.0f / det : 0.0f;
+			for(int a = 0; a < 3; a++)
+				{
+				s[a][l] = (e1[a][l] * uv[3][l] - e2[a][l] * uv[1][l]) * r;
+				t[a][l] = (e2[a][l] * uv[0][l] - e1[a][l] * uv[2][l]) * r;
+				}
+			}
+#endif
+
+		for(int l = 0; l < n; l++)
+			{
+			const INDEX *pTri = pIndexes + 3 * (nBase + l);
+			for(int k = 0; k < 3; k++)
+				{
+				int v = int(pTri[k]);
+				sDir.x[v] += s[0][l]; sDir.y[v] += s[1][l]; sDir.z[v] += s[2][l];
+				tDir.x[v] += t[0][l]; tDir.y[v] += t[1][l]; tDir.z[v] += t[2][l];
+				}
+			}
+		}
+
+	// Pass 2: Gram-Schmidt and handedness per vertex
+	int i = 0;
+#if defined(M3D_SIMD_SSE)
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), sign = _mm_set1_ps(-0.0f);
+	const __m128 tiny = _mm_set1_ps(1e-20f);
+	for(; i + 4 <= nVerts; i += 4)
+		{
+		__m128 nx, ny, nz;
+		m3dSSELoadVectors3(pNorms[i], nx, ny, nz);
+		__m128 sx = _mm_load_ps(sDir.x + i), sy = _mm_load_ps(sDir.y + i), sz = _mm_load_ps(sDir.z + i);
+
+		__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, sx), _mm_mul_ps(ny, sy)), _mm_mul_ps(nz, sz));
+		sx = _mm_sub_ps(sx, _mm_mul_ps(nx, d));
+		sy = _mm_sub_ps(sy, _mm_mul_ps(ny, d));
+		sz = _mm_sub_ps(sz, _mm_mul_ps(nz, d));
+		__m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, sx), _mm_mul_ps(sy, sy)), _mm_mul_ps(sz, sz));
+		if(_mm_movemask_ps(_mm_cmplt_ps(len2, tiny)) != 0) {
+			// Somebody in this block needs the fallback tangent
+			for(int l = i; l < i + 4; l++)
+				{
+				M3DVector3f vS = { sDir.x[l], sDir.y[l], sDir.z[l] }, vT = { tDir.x[l], tDir.y[l], tDir.z[l] };
+				m3dFinishTangent(pTangents[l], pNorms[l], vS, vT);
+				}
+			continue;
+			}
+
+		__m128 inv = _mm_div_ps(one, _mm_sqrt_ps(len2));
+		sx = _mm_mul_ps(sx, inv); sy = _mm_mul_ps(sy, inv); sz = _mm_mul_ps(sz, inv);
+
+		// w = sign of dot(cross(n, s), t)
+		__m128 cx = _mm_sub_ps(_mm_mul_ps(ny, sz), _mm_mul_ps(nz, sy));
+		__m128 cy = _mm_sub_ps(_mm_mul_ps(nz, sx), _mm_mul_ps(nx, sz));
+		__m128 cz = _mm_sub_ps(_mm_mul_ps(nx, sy), _mm_mul_ps(ny, sx));
+		__m128 h = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_load_ps(tDir.x + i)), _mm_mul_ps(cy, _mm_load_ps(tDir.y + i))),
+							  _mm_mul_ps(cz, _mm_load_ps(tDir.z + i)));
+		__m128 w = _mm_or_ps(one, _mm_and_ps(_mm_cmplt_ps(h, zero), sign));
+
+		_MM_TRANSPOSE4_PS(sx, sy, sz, w);
+		_mm_storeu_ps(pTangents[i], sx);
+		_mm_storeu_ps(pTangents[i + 1], sy);
+		_mm_storeu_ps(pTangents[i + 2], sz);
+		_mm_storeu_ps(pTangents[i + 3], w);
+		}
+#endif
+
+	for(; i < nVerts; i++)
+		{
+		M3DVector3f vS = { sDir.x[i], sDir.y[i], sDir.z[i] }, vT = { tDir.x[i], tDir.y[i], tDir.z[i] };
+		m3dFinishTangent(pTangents[i], pNorms[i], vS, vT);
+		}
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+// Run time dispatched matrix multiply and inverse
+// m3dMatrixMultiply44 and m3dInvertMatrix44 are called for every matrix stack
+// operation. The versions below pick the widest code path the CPU supports the
+// first time they are called, and fall back to the math3d.cpp versions when no
+// SIMD path is available. Unlike the originals, product may be the same array
+// as a or b.
+//
+// Accuracy: the SSE/AVX/AVX-512 multiplies do the same operations in the same
+// order as m3dMatrixMultiply44, and give bit identical results as long as the
+// multiplies and adds are not fused into FMAs. The kernels are marked
+// M3D_NO_FP_CONTRACT for that (see the top of this file); a compiler that
+// ignores it needs -ffp-contract=off for the promise to hold. The SSE inverse
+// uses 2x2 block cofactors instead of 3x3 ones, so it is not bit identical to
+// m3dInvertMatrix44; for well conditioned matrices the two agree to within about
+// 1e-5 of the largest element of the inverse.
+enum M3D_SIMD_LEVEL { M3D_SIMD_LEVEL_NONE = 0, M3D_SIMD_LEVEL_SSE2, M3D_SIMD_LEVEL_AVX, M3D_SIMD_LEVEL_AVX512 };
+
+typedef void (*M3DMatrixMultiply44Func)(M3DMatrix44f product, const M3DMatrix44f a, const M3DMatrix44f b);
+typedef void (*M3DInvertMatrix44Func)(M3DMatrix44f mInverse, const M3DMatrix44f m);
+typedef void (*M3DMatrixMultiplyArray44Func)(M3DMatrix44f *pProducts, const M3DMatrix44f a, const M3DMatrix44f *pB, int nCount);
+typedef int (*M3DCullSphereStreamFunc)(unsigned int *pVisible, const float *x, const float *y, const float *z, const float *r,
+									   int nCount, const M3DVector4f *pPlanes, int nPlanes);
+typedef int (*M3DSphereBoxStreamFunc)(int *pHits, const float *x, const float *y, const float *z, const float *r,
+									  int nCount, const M3DVector3f vMin, const M3DVector3f vMax);
+
+
+#ifdef M3D_SIMD_DISPATCH
+///////////////////////////////////////////////////////////////////////////////
+// Ask the CPU (and the OS, for the wide register state) what we can use.
+inline M3D_SIMD_LEVEL m3dDetectSIMDLevel(void)
+	{
+	unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+	unsigned int xcr0 = 0;
+
+#ifdef _MSC_VER
+	int regs[4];
+	__cpuid(regs, 1);
+	ecx = (unsigned int)regs[2]; edx = (unsigned int)regs[3];
+#else
+	if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return M3D_SIMD_LEVEL_NONE;
+#endif
+
+	if(!(edx & (1u << 26)))			// SSE2
+		return M3D_SIMD_LEVEL_NONE;
+
+	// AVX needs the CPU bit, and the OS saving the YMM registers (OSXSAVE + XCR0)
+	if(!(ecx & (1u << 27)) || !(ecx & (1u << 28)))
+		return M3D_SIMD_LEVEL_SSE2;
+
+#ifdef _MSC_VER
+	xcr0 = (unsigned int)_xgetbv(0);
+#else
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	xcr0 = eax;
+#endif
+	if((xcr0 & 0x06) != 0x06)
+		return M3D_SIMD_LEVEL_SSE2;
+
+	// AVX-512 Foundation, plus the OS saving the opmask and ZMM state
+#ifdef _MSC_VER
+	__cpuidex(regs, 7, 0);
+	ebx = (unsigned int)regs[1];
+#else
+	ebx = 0;
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+#endif
+	if((ebx & (1u << 16)) && (xcr0 & 0xE6) == 0xE6)
+		return M3D_SIMD_LEVEL_AVX512;
+
+	return M3D_SIMD_LEVEL_AVX;
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE2, one column of the product at a time
+M3D_NO_FP_CONTRACT inline void m3dMatrixMultiply44SSE(M3DMatrix44f product, const M3DMatrix44f a, const M3DMatrix44f b)
+	{
+	M3D_NO_FP_CONTRACT_BODY
+	__m128 a0 = _mm_loadu_ps(a);
+	__m128 a1 = _mm_loadu_ps(a + 4);
+	__m128 a2 = _mm_loadu_ps(a + 8);
+	__m128 a3 = _mm_loadu_ps(a + 12);
+	__m128 b0 = _mm_loadu_ps(b);
+	__m128 b1 = _mm_loadu_ps(b + 4);
+	__m128 b2 = _mm_loadu_ps(b + 8);
+	__m128 b3 = _mm_loadu_ps(b + 12);
+
+#define M3D_COLUMN(bc) _mm_add_ps(_mm_add_ps(_mm_add_ps( \
+		_mm_mul_ps(a0, _mm_shuffle_ps(bc, bc, 0x00)), _mm_mul_ps(a1, _mm_shuffle_ps(bc, bc, 0x55))), \
+		_mm_mul_ps(a2, _mm_shuffle_ps(bc, bc, 0xAA))), _mm_mul_ps(a3, _mm_shuffle_ps(bc, bc, 0xFF)))
+	__m128 p0 = M3D_COLUMN(b0);
+	__m128 p1 = M3D_COLUMN(b1);
+	__m128 p2 = M3D_COLUMN(b2);
+	__m128 p3 = M3D_COLUMN(b3);
+#undef M3D_COLUMN
+
+	_mm_storeu_ps(product, p0);
+	_mm_storeu_ps(product + 4, p1);
+	_mm_storeu_ps(product + 8, p2);
+	_mm_storeu_ps(product + 12, p3);
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX, two columns of the product per register
+M3D_NO_FP_CONTRACT M3D_TARGET_AVX inline void m3dMatrixMultiply44AVX(M3DMatrix44f product, const M3DMatrix44f a, const M3DMatrix44f b)
+	{
+	M3D_NO_FP_CONTRACT_BODY
+	__m128 c;
+	c = _mm_loadu_ps(a);		__m256 a0 = _mm256_insertf128_ps(_mm256_castps128_ps256(c), c, 1);
+	c = _mm_loadu_ps(a + 4);	__m256 a1 = _mm256_insertf128_ps(_mm256_castps128_ps256(c), c, 1);
+	c = _mm_loadu_ps(a + 8);	__m256 a2 = _mm256_insertf128_ps(_mm256_castps128_ps256(c), c, 1);
+	c = _mm_loadu_ps(a + 12);	__m256 a3 = _mm256_insertf128_ps(_mm256_castps128_ps256(c), c, 1);
+	__m256 b01 = _mm256_loadu_ps(b);
+	__m256 b23 = _mm256_loadu_ps(b + 8);
+
+#define M3D_COLUMNS(bc) _mm256_add_ps(_mm256_add_ps(_mm256_add_ps( \
+		_mm256_mul_ps(a0, _mm256_permute_ps(bc, 0x00)), _mm256_mul_ps(a1, _mm256_permute_ps(bc, 0x55))), \
+		_mm256_mul_ps(a2, _mm256_permute_ps(bc, 0xAA))), _mm256_mul_ps(a3, _mm256_permute_ps(bc, 0xFF)))
+	__m256 p01 = M3D_COLUMNS(b01);
+	__m256 p23 = M3D_COLUMNS(b23);
+#undef M3D_COLUMNS
+
+	_mm256_storeu_ps(product, p01);
+	_mm256_storeu_ps(product + 8, p23);
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX-512, the whole product in one register
+M3D_NO_FP_CONTRACT M3D_TARGET_AVX512 inline void m3dMatrixMultiply44AVX512(M3DMatrix44f product, const M3DMatrix44f a, const M3DMatrix44f b)
+	{
+	M3D_NO_FP_CONTRACT_BODY
+	__m512 a0 = _mm512_broadcast_f32x4(_mm_loadu_ps(a));
+	__m512 a1 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 4));
+	__m512 a2 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 8));
+	__m512 a3 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 12));
+	__m512 bm = _mm512_loadu_ps(b);
+
+	__m512 p = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(
+				_mm512_mul_ps(a0, _mm512_permute_ps(bm, 0x00)), _mm512_mul_ps(a1, _mm512_permute_ps(bm, 0x55))),
+				_mm512_mul_ps(a2, _mm512_permute_ps(bm, 0xAA))), _mm512_mul_ps(a3, _mm512_permute_ps(bm, 0xFF)));
+
+	_mm512_storeu_ps(product, p);
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// One matrix times many: pProducts[i] = a * pB[i]. The columns of a stay in
+// registers for the whole array. pProducts may be the same array as pB.
+M3D_NO_FP_CONTRACT inline void m3dMatrixMultiplyArray44SSE(M3DMatrix44f *pProducts, const M3DMatrix44f a, const M3DMatrix44f *pB, int nCount)
+	{
+	M3D_NO_FP_CONTRACT_BODY
+	__m128 a0 = _mm_loadu_ps(a);
+	__m128 a1 = _mm_loadu_ps(a + 4);
+	__m128 a2 = _mm_loadu_ps(a + 8);
+	__m128 a3 = _mm_loadu_ps(a + 12);
+
+#define M3D_COLUMN(bc) _mm_add_ps(_mm_add_ps(_mm_add_ps( \
+		_mm_mul_ps(a0, _mm_shuffle_ps(bc, bc, 0x00)), _mm_mul_ps(a1, _mm_shuffle_ps(bc, bc, 0x55))), \
+		_mm_mul_ps(a2, _mm_shuffle_ps(bc, bc, 0xAA))), _mm_mul_ps(a3, _mm_shuffle_ps(bc, bc, 0xFF)))
+	for(int i = 0; i < nCount; i++)
+		{
+		const float *b = pB[i];
+		float *product = pProducts[i];
+		__m128 b0 = _mm_loadu_ps(b);
+		__m128 b1 = _mm_loadu_ps(b + 4);
+		__m128 b2 = _mm_loadu_ps(b + 8);
+		__m128 b3 = _mm_loadu_ps(b + 12);
+
+		_mm_storeu_ps(product, M3D_COLUMN(b0));
+		_mm_storeu_ps(product + 4, M3D_COLUMN(b1));
+		_mm_storeu_ps(product + 8, M3D_COLUMN(b2));
+		_mm_storeu_ps(product + 12, M3D_COLUMN(b3));
+		}
+#undef M3D_COLUMN
+	}
+
+M3D_NO_FP_CONTRACT M3D_TARGET_AVX inline void m3dMatrixMultiplyArray44AVX(M3DMatrix44f *pProducts, const M3DMatrix44f a, const M3DMatrix44f *pB, int nCount)
+	{
+	M3D_NO_FP_CONTRACT_BODY
+	__m128 c;
+	c = _mm_loadu_ps(a);		__m256 a0 = _mm256_insertf128_ps(_mm256_castps128_ps256(c), c, 1);
+	c = _mm_loadu_ps(a + 4);	__m256 a1 = _mm256_insertf128_ps(_mm256_castps128_ps256(c), c, 1);
+	c = _mm_loadu_ps(a + 8);	__m256 a2 = _mm256_insertf128_ps(_mm256_castps128_ps256(c), c, 1);
+	c = _mm_loadu_ps(a + 12);	__m256 a3 = _mm256_insertf128_ps(_mm256_castps128_ps256(c), c, 1);
+
+#define M3D_COLUMNS(bc) _mm256_add_ps(_mm256_add_ps(_mm256_add_ps( \
+		_mm256_mul_ps(a0, _mm256_permute_ps(bc, 0x00)), _mm256_mul_ps(a1, _mm256_permute_ps(bc, 0x55))), \
+		_mm256_mul_ps(a2, _mm256_permute_ps(bc, 0xAA))), _mm256_mul_ps(a3, _mm256_permute_ps(bc, 0xFF)))
+	for(int i = 0; i < nCount; i++)
+		{
+		__m256 b01 = _mm256_loadu_ps(pB[i]);
+		__m256 b23 = _mm256_loadu_ps(pB[i] + 8);
+
+		_mm256_storeu_ps(pProducts[i], M3D_COLUMNS(b01));
+		_mm256_storeu_ps(pProducts[i] + 8, M3D_COLUMNS(b23));
+		}
+#undef M3D_COLUMNS
+	}
+
+M3D_NO_FP_CONTRACT M3D_TARGET_AVX512 inline void m3dMatrixMultiplyArray44AVX512(M3DMatrix44f *pProducts, const M3DMatrix44f a, const M3DMatrix44f *pB, int nCount)
+	{
+	M3D_NO_FP_CONTRACT_BODY
+	__m512 a0 = _mm512_broadcast_f32x4(_mm_loadu_ps(a));
+	__m512 a1 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 4));
+	__m512 a2 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 8));
+	__m512 a3 = _mm512_broadcast_f32x4(_mm_loadu_ps(a + 12));
+
+	for(int i = 0; i < nCount; i++)
+		{
+		__m512 bm = _mm512_loadu_ps(pB[i]);
+		__m512 p = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(
+					_mm512_mul_ps(a0, _mm512_permute_ps(bm, 0x00)), _mm512_mul_ps(a1, _mm512_permute_ps(bm, 0x55))),
+					_mm512_mul_ps(a2, _mm512_permute_ps(bm, 0xAA))), _mm512_mul_ps(a3, _mm512_permute_ps(bm, 0xFF)));
+		_mm512_storeu_ps(pProducts[i], p);
+		}
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE2 general inverse. The matrix is split into four 2x2 blocks
+//	| A B |
+//	| C D |
+// and the inverse is built from their determinants and adjugates, which maps
+// much better onto four wide registers than expanding 3x3 cofactors.
+// Like m3dInvertMatrix44, a singular matrix produces infinities/NaNs.
+inline void m3dInvertMatrix44SSE(M3DMatrix44f mInverse, const M3DMatrix44f m)
+	{
+#define M3D_SWIZZLE(v, x, y, z, w)	_mm_shuffle_ps(v, v, _MM_SHUFFLE(w, z, y, x))
+#define M3D_SHUFFLE(v1, v2, x, y, z, w)	_mm_shuffle_ps(v1, v2, _MM_SHUFFLE(w, z, y, x))
+
+	__m128 c0 = _mm_loadu_ps(m);
+	__m128 c1 = _mm_loadu_ps(m + 4);
+	__m128 c2 = _mm_loadu_ps(m + 8);
+	__m128 c3 = _mm_loadu_ps(m + 12);
+
+	// 2x2 blocks, each stored as (00, 01, 10, 11)
+	__m128 A = _mm_movelh_ps(c0, c1);
+	__m128 B = _mm_movehl_ps(c1, c0);
+	__m128 C = _mm_movelh_ps(c2, c3);
+	__m128 D = _mm_movehl_ps(c3, c2);
+
+	// Determinants of the four blocks as (|A| |B| |C| |D|)
+	__m128 detSub = _mm_sub_ps(
+		_mm_mul_ps(M3D_SHUFFLE(c0, c2, 0, 2, 0, 2), M3D_SHUFFLE(c1, c3, 1, 3, 1, 3)),
+		_mm_mul_ps(M3D_SHUFFLE(c0, c2, 1, 3, 1, 3), M3D_SHUFFLE(c1, c3, 0, 2, 0, 2)));
+	__m128 detA = M3D_SWIZZLE(detSub, 0, 0, 0, 0);
+	__m128 detB = M3D_SWIZZLE(detSub, 1, 1, 1, 1);
+	__m128 detC = M3D_SWIZZLE(detSub, 2, 2, 2, 2);
+	__m128 detD = M3D_SWIZZLE(detSub, 3, 3, 3, 3);
+
+	// 2x2 block products: X*Y, adj(X)*Y and X*adj(Y)
+#define M3D_MAT2MUL(v1, v2)	_mm_add_ps(_mm_mul_ps(v1, M3D_SWIZZLE(v2, 0, 3, 0, 3)), \
+								   _mm_mul_ps(M3D_SWIZZLE(v1, 1, 0, 3, 2), M3D_SWIZZLE(v2, 2, 1, 2, 1)))
+#define M3D_MAT2ADJMUL(v1, v2)	_mm_sub_ps(_mm_mul_ps(M3D_SWIZZLE(v1, 3, 3, 0, 0), v2), \
+								   _mm_mul_ps(M3D_SWIZZLE(v1, 1, 1, 2, 2), M3D_SWIZZLE(v2, 2, 3, 0, 1)))
+#define M3D_MAT2MULADJ(v1, v2)	_mm_sub_ps(_mm_mul_ps(v1, M3D_SWIZZLE(v2, 3, 0, 3, 0)), \
+								   _mm_mul_ps(M3D_SWIZZLE(v1, 1, 0, 3, 2), M3D_SWIZZLE(v2, 2, 1, 2, 1)))
+
+	__m128 D_C = M3D_MAT2ADJMUL(D, C);
+	__m128 A_B = M3D_MAT2ADJMUL(A, B);
+	__m128 X_ = _mm_sub_ps(_mm_mul_ps(detD, A), M3D_MAT2MUL(B, D_C));
+	__m128 W_ = _mm_sub_ps(_mm_mul_ps(detA, D), M3D_MAT2MUL(C, A_B));
+	__m128 Y_ = _mm_sub_ps(_mm_mul_ps(detB, C), M3D_MAT2MULADJ(D, A_B));
+	__m128 Z_ = _mm_sub_ps(_mm_mul_ps(detC, B), M3D_MAT2MULADJ(A, D_C));
+
+#undef M3D_MAT2MUL
+#undef M3D_MAT2ADJMUL
+#undef M3D_MAT2MULADJ
+
+	// |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+	__m128 detM = _mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC));
+	__m128 tr = _mm_mul_ps(A_B, M3D_SWIZZLE(D_C, 0, 2, 1, 3));
+	tr = _mm_add_ps(tr, M3D_SWIZZLE(tr, 2, 3, 0, 1));
+	tr = _mm_add_ps(tr, M3D_SWIZZLE(tr, 1, 0, 3, 2));
+	detM = _mm_sub_ps(detM, tr);
+
+	__m128 rDetM = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), detM);
+	X_ = _mm_mul_ps(X_, rDetM);
+	Y_ = _mm_mul_ps(Y_, rDetM);
+	Z_ = _mm_mul_ps(Z_, rDetM);
+	W_ = _mm_mul_ps(W_, rDetM);
+
+	// Undo the adjugate shuffles while putting the blocks back together
+	_mm_storeu_ps(mInverse,      M3D_SHUFFLE(X_, Y_, 3, 1, 3, 1));
+	_mm_storeu_ps(mInverse + 4,  M3D_SHUFFLE(X_, Y_, 2, 0, 2, 0));
+	_mm_storeu_ps(mInverse + 8,  M3D_SHUFFLE(Z_, W_, 3, 1, 3, 1));
+	_mm_storeu_ps(mInverse + 12, M3D_SHUFFLE(Z_, W_, 2, 0, 2, 0));
+
+#undef M3D_SWIZZLE
+#undef M3D_SHUFFLE
+	}
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Sphere culling against a set of planes, 32 spheres per output word. Bit
+// (i & 31) of pVisible[i >> 5] is set when sphere i is not fully behind any
+// plane, which is GLFrustum::TestSphere's rule: with
+// d = m3dGetDistanceToPlane(center, plane), a sphere is culled by the first
+// plane where d + r <= 0. The distance is summed in the same order, and the
+// SIMD paths compare d <= -r, which is the same test for finite radii, so
+// every path gives the same bits as a loop of TestSphere calls. Unused bits
+// of the last word are zero. Returns the number of visible spheres.
+inline int m3dBitCount32(unsigned int v)
+	{
+	v = v - ((v >> 1) & 0x55555555u);
+	v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+	return int((((v + (v >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+	}
+
+// The words from iBegin (a multiple of 32) to the end, one sphere at a time
+inline int m3dCullSphereStreamScalar(unsigned int *pVisible, const float *x, const float *y, const float *z, const float *r,
+									 int nCount, const M3DVector4f *pPlanes, int nPlanes, int iBegin = 0)
+	{
+	int nVisible = 0;
+	for(int i = iBegin; i < nCount; i += 32)
+		{
+		int n = (nCount - i < 32) ? nCount - i : 32;
+		unsigned int word = 0;
+		for(int j = 0; j < n; j++)
+			{
+			M3DVector3f vCenter = { x[i + j], y[i + j], z[i + j] };
+			int p = 0;
+			while(p < nPlanes && !(m3dGetDistanceToPlane(vCenter, pPlanes[p]) + r[i + j] <= 0.0f))
+				p++;
+			if(p == nPlanes)
+				word |= 1u << j;
+			}
+		pVisible[i >> 5] = word;
+		nVisible += m3dBitCount32(word);
+		}
+	return nVisible;
+	}
+
+#ifdef M3D_SIMD_DISPATCH
+// Four spheres per compare. A lane is culled once any plane's compare says so;
+// the lanes are only combined into a word at the end.
+inline int m3dCullSphereStreamSSE(unsigned int *pVisible, const float *x, const float *y, const float *z, const float *r,
+								  int nCount, const M3DVector4f *pPlanes, int nPlanes)
+	{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	int nVisible = 0;
+	int i = 0;
+
+
+	for(; i + 32 <= nCount; i += 32)
+		{
+		unsigned int word = 0;
+		for(int j = 0; j < 32; j += 4)
+			{
+			__m128 px = _mm_loadu_ps(x + i + j), py = _mm_loadu_ps(y + i + j);
+			__m128 pz = _mm_loadu_ps(z + i + j), nr = _mm_xor_ps(_mm_loadu_ps(r + i + j), sign);
+			__m128 culled = _mm_setzero_ps();
+			for(int p = 0; p < nPlanes; p++)
+				{
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(px, _mm_load1_ps(&pPlanes[p][0])), _mm_mul_ps(py, _mm_load1_ps(&pPlanes[p][1]))),
+					_mm_mul_ps(pz, _mm_load1_ps(&pPlanes[p][2]))), _mm_load1_ps(&pPlanes[p][3]));
+				culled = _mm_or_ps(culled, _mm_cmple_ps(d, nr));
+				}
+			word |= (unsigned int)(_mm_movemask_ps(culled) ^ 15) << j;
+			}
+		pVisible[i >> 5] = word;
+		nVisible += m3dBitCount32(word);
+		}
+
+	return nVisible + m3dCullSphereStreamScalar(pVisible, x, y, z, r, nCount, pPlanes, nPlanes, i);
+	}
+
+// Eight spheres per compare
+M3D_TARGET_AVX inline int m3dCullSphereStreamAVX(unsigned int *pVisible, const float *x, const float *y, const float *z, const float *r,
+												 int nCount, const M3DVector4f *pPlanes, int nPlanes)
+	{
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	int nVisible = 0;
+	int i = 0;
+
+	for(; i + 32 <= nCount; i += 32)
+		{
+		unsigned int word = 0;
+		for(int j = 0; j < 32; j += 8)
+			{
+			__m256 px = _mm256_loadu_ps(x + i + j), py = _mm256_loadu_ps(y + i + j);
+			__m256 pz = _mm256_loadu_ps(z + i + j), nr = _mm256_xor_ps(_mm256_loadu_ps(r + i + j), sign);
+			__m256 culled = _mm256_setzero_ps();
+			for(int p = 0; p < nPlanes; p++)
+				{
+				__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(px, _mm256_broadcast_ss(&pPlanes[p][0])), _mm256_mul_ps(py, _mm256_broadcast_ss(&pPlanes[p][1]))),
+					_mm256_mul_ps(pz, _mm256_broadcast_ss(&pPlanes[p][2]))), _mm256_broadcast_ss(&pPlanes[p][3]));
+				culled = _mm256_or_ps(culled, _mm256_cmp_ps(d, nr, _CMP_LE_OQ));
+				}
+			word |= (unsigned int)(_mm256_movemask_ps(culled) ^ 255) << j;
+			}
+		pVisible[i >> 5] = word;
+		nVisible += m3dBitCount32(word);
+		}
+
+	return nVisible + m3dCullSphereStreamScalar(pVisible, x, y, z, r, nCount, pPlanes, nPlanes, i);
+	}
+
+// Sixteen spheres per compare, straight into a mask register
+M3D_TARGET_AVX512 inline int m3dCullSphereStreamAVX512(unsigned int *pVisible, const float *x, const float *y, const float *z, const float *r,
+													   int nCount, const M3DVector4f *pPlanes, int nPlanes)
+	{
+	const __m512 zero = _mm512_setzero_ps();
+	int nVisible = 0;
+	int i = 0;
+
+	for(; i + 32 <= nCount; i += 32)
+		{
+		unsigned int word = 0;
+		for(int j = 0; j < 32; j += 16)
+			{
+			__m512 px = _mm512_loadu_ps(x + i + j), py = _mm512_loadu_ps(y + i + j);
+			__m512 pz = _mm512_loadu_ps(z + i + j), nr = _mm512_sub_ps(zero, _mm512_loadu_ps(r + i + j));
+
+			// Each compare only keeps the lanes still visible (not d <= -r)
+			__mmask16 visible = 0xFFFF;
+			for(int p = 0; p < nPlanes; p++)
+				{
+				__m512 d = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(
+					_mm512_mul_ps(px, _mm512_set1_ps(pPlanes[p][0])), _mm512_mul_ps(py, _mm512_set1_ps(pPlanes[p][1]))),
+					_mm512_mul_ps(pz, _mm512_set1_ps(pPlanes[p][2]))), _mm512_set1_ps(pPlanes[p][3]));
+				visible = _mm512_mask_cmp_ps_mask(visible, d, nr, _CMP_NLE_UQ);
+				}
+			word |= (unsigned int)visible << j;
+			}
+		pVisible[i >> 5] = word;
+		nVisible += m3dBitCount32(word);
+		}
+
+	return nVisible + m3dCullSphereStreamScalar(pVisible, x, y, z, r, nCount, pPlanes, nPlanes, i);
+	}
+#endif
+
+inline int m3dCullSphereStreamNone(unsigned int *pVisible, const float *x, const float *y, const float *z, const float *r,
+								   int nCount, const M3DVector4f *pPlanes, int nPlanes)
+	{ return m3dCullSphereStreamScalar(pVisible, x, y, z, r, nCount, pPlanes, nPlanes); }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Which spheres touch an axis aligned box. The indices of the spheres whose
+// squared distance from the box, (dx * dx + dy * dy) + dz * dz with each d the
+// distance outside the box's slab on that axis, is <= r * r go to pHits in
+// ascending order, and the count is returned. pHits needs room for nCount.
+// Every path does the same operations in the same order, so they all pick the
+// same spheres.
+//
+// The SIMD paths write every lane's index and only advance past the ones that
+// hit, so nothing is written beyond the hits found so far plus the lanes
+// being looked at.
+inline int m3dSphereBoxStreamScalar(int *pHits, const float *x, const float *y, const float *z, const float *r,
+									int nCount, const M3DVector3f vMin, const M3DVector3f vMax, int iBegin = 0)
+	{
+	int nHits = 0;
+	for(int i = iBegin; i < nCount; i++)
+		{
+		float dx = m3dRayMax(m3dRayMax(vMin[0] - x[i], x[i] - vMax[0]), 0.0f);
+		float dy = m3dRayMax(m3dRayMax(vMin[1] - y[i], y[i] - vMax[1]), 0.0f);
+		float dz = m3dRayMax(m3dRayMax(vMin[2] - z[i], z[i] - vMax[2]), 0.0f);
+		pHits[nHits] = i;
+		nHits += ((dx * dx + dy * dy) + dz * dz <= r[i] * r[i]) ? 1 : 0;
+		}
+	return nHits;
+	}
+
+#ifdef M3D_SIMD_DISPATCH
+inline int m3dSphereBoxStreamSSE(int *pHits, const float *x, const float *y, const float *z, const float *r,
+								 int nCount, const M3DVector3f vMin, const M3DVector3f vMax)
+	{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 minX = _mm_set1_ps(vMin[0]), minY = _mm_set1_ps(vMin[1]), minZ = _mm_set1_ps(vMin[2]);
+	const __m128 maxX = _mm_set1_ps(vMax[0]), maxY = _mm_set1_ps(vMax[1]), maxZ = _mm_set1_ps(vMax[2]);
+	int nHits = 0;
+	int i = 0;
+
+	for(; i + 4 <= nCount; i += 4)
+		{
+		__m128 px = _mm_loadu_ps(x + i), py = _mm_loadu_ps(y + i), pz = _mm_loadu_ps(z + i), pr = _mm_loadu_ps(r + i);
+		__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minX, px), _mm_sub_ps(px, maxX)), zero);
+		__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minY, py), _mm_sub_ps(py, maxY)), zero);
+		__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(minZ, pz), _mm_sub_ps(pz, maxZ)), zero);
+		__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		int mask = _mm_movemask_ps(_mm_cmple_ps(d2, _mm_mul_ps(pr, pr)));
+		for(int j = 0; j < 4; j++)
+			{
+			pHits[nHits] = i + j;
+			nHits += (mask >> j) & 1;
+			}
+		}
+
+	return nHits + m3dSphereBoxStreamScalar(pHits + nHits, x, y, z, r, nCount, vMin, vMax, i);
+	}
+
+M3D_TARGET_AVX inline int m3dSphereBoxStreamAVX(int *pHits, const float *x, const float *y, const float *z, const float *r,
+												int nCount, const M3DVector3f vMin, const M3DVector3f vMax)
+	{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 minX = _mm256_set1_ps(vMin[0]), minY = _mm256_set1_ps(vMin[1]), minZ = _mm256_set1_ps(vMin[2]);
+	const __m256 maxX = _mm256_set1_ps(vMax[0]), maxY = _mm256_set1_ps(vMax[1]), maxZ = _mm256_set1_ps(vMax[2]);
+	int nHits = 0;
+	int i = 0;
+
+	for(; i + 8 <= nCount; i += 8)
+		{
+		__m256 px = _mm256_loadu_ps(x + i), py = _mm256_loadu_ps(y + i), pz = _mm256_loadu_ps(z + i), pr = _mm256_loadu_ps(r + i);
+		__m256 dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minX, px), _mm256_sub_ps(px, maxX)), zero);
+		__m256 dy = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minY, py), _mm256_sub_ps(py, maxY)), zero);
+		__m256 dz = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minZ, pz), _mm256_sub_ps(pz, maxZ)), zero);
+		__m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		int mask = _mm256_movemask_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(pr, pr), _CMP_LE_OQ));
+		for(int j = 0; j < 8; j++)
+			{
+			pHits[nHits] = i + j;
+			nHits += (mask >> j) & 1;
+			}
+		}
+
+	return nHits + m3dSphereBoxStreamScalar(pHits + nHits, x, y, z, r, nCount, vMin, vMax, i);
+	}
+
+// The hits' indices are packed straight out of the mask register
+M3D_TARGET_AVX512 inline int m3dSphereBoxStreamAVX512(int *pHits, const float *x, const float *y, const float *z, const float *r,
+													  int nCount, const M3DVector3f vMin, const M3DVector3f vMax)
+	{
+	const __m512 zero = _mm512_setzero_ps();
+	const __m512 minX = _mm512_set1_ps(vMin[0]), minY = _mm512_set1_ps(vMin[1]), minZ = _mm512_set1_ps(vMin[2]);
+	const __m512 maxX = _mm512_set1_ps(vMax[0]), maxY = _mm512_set1_ps(vMax[1]), maxZ = _mm512_set1_ps(vMax[2]);
+	const __m512i lanes = _mm512_set_epi32(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+	int nHits = 0;
+	int i = 0;
+
+	for(; i + 16 <= nCount; i += 16)
+		{
+		__m512 px = _mm512_loadu_ps(x + i), py = _mm512_loadu_ps(y + i), pz = _mm512_loadu_ps(z + i), pr = _mm512_loadu_ps(r + i);
+		__m512 dx = _mm512_max_ps(_mm512_max_ps(_mm512_sub_ps(minX, px), _mm512_sub_ps(px, maxX)), zero);
+		__m512 dy = _mm512_max_ps(_mm512_max_ps(_mm512_sub_ps(minY, py), _mm512_sub_ps(py, maxY)), zero);
+		__m512 dz = _mm512_max_ps(_mm512_max_ps(_mm512_sub_ps(minZ, pz), _mm512_sub_ps(pz, maxZ)), zero);
+		__m512 d2 = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+		__mmask16 hits = _mm512_cmp_ps_mask(d2, _mm512_mul_ps(pr, pr), _CMP_LE_OQ);
+		_mm512_mask_compressstoreu_epi32(pHits + nHits, hits, _mm512_add_epi32(lanes, _mm512_set1_epi32(i)));
+		nHits += m3dBitCount32(hits);
+		}
+
+	return nHits + m3dSphereBoxStreamScalar(pHits + nHits, x, y, z, r, nCount, vMin, vMax, i);
+	}
+#endif
+
+inline int m3dSphereBoxStreamNone(int *pHits, const float *x, const float *y, const float *z, const float *r,
+								  int nCount, const M3DVector3f vMin, const M3DVector3f vMax)
+	{ return m3dSphereBoxStreamScalar(pHits, x, y, z, r, nCount, vMin, vMax); }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// The library versions don't allow the product to alias a source matrix
+inline void m3dMatrixMultiply44Scalar(M3DMatrix44f product, const M3DMatrix44f a, const M3DMatrix44f b)
+	{
+	M3DMatrix44f mTemp;
+	m3dMatrixMultiply44(mTemp, a, b);
+	m3dCopyMatrix44(product, mTemp);
+	}
+
+inline void m3dMatrixMultiplyArray44Scalar(M3DMatrix44f *pProducts, const M3DMatrix44f a, const M3DMatrix44f *pB, int nCount)
+	{
+	for(int i = 0; i < nCount; i++)
+		m3dMatrixMultiply44Scalar(pProducts[i], a, pB[i]);
+	}
+
+inline void m3dInvertMatrix44Scalar(M3DMatrix44f mInverse, const M3DMatrix44f m)
+	{
+	M3DMatrix44f mTemp;
+	m3dInvertMatrix44(mTemp, m);
+	m3dCopyMatrix44(mInverse, mTemp);
+	}
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Dispatch state. Detected once, the first time any of these are used.
+struct M3DSIMDDispatch
+	{
+	M3D_SIMD_LEVEL			level;
+	M3DMatrixMultiply44Func	matrixMultiply44;
+	M3DInvertMatrix44Func	invertMatrix44;
+	M3DMatrixMultiplyArray44Func	matrixMultiplyArray44;
+	M3DCullSphereStreamFunc	cullSphereStream;
+	M3DSphereBoxStreamFunc	sphereBoxStream;
+	};
+
+inline M3D_SIMD_LEVEL m3dGetSupportedSIMDLevel(void)
+	{
+#ifdef M3D_SIMD_DISPATCH
+	static const M3D_SIMD_LEVEL supported = m3dDetectSIMDLevel();
+	return supported;
+#else
+	return M3D_SIMD_LEVEL_NONE;
+#endif
+	}
+
+inline M3DSIMDDispatch m3dMakeSIMDDispatch(M3D_SIMD_LEVEL level)
+	{
+	M3DSIMDDispatch dispatch;
+
+	if(level > m3dGetSupportedSIMDLevel())
+		level = m3dGetSupportedSIMDLevel();
+
+	dispatch.level = level;
+	dispatch.matrixMultiply44 = m3dMatrixMultiply44Scalar;
+	dispatch.invertMatrix44 = m3dInvertMatrix44Scalar;
+	dispatch.matrixMultiplyArray44 = m3dMatrixMultiplyArray44Scalar;
+	dispatch.cullSphereStream = m3dCullSphereStreamNone;
+	dispatch.sphereBoxStream = m3dSphereBoxStreamNone;
+
+#ifdef M3D_SIMD_DISPATCH
+	if(level >= M3D_SIMD_LEVEL_SSE2) {
+		dispatch.matrixMultiply44 = m3dMatrixMultiply44SSE;
+		dispatch.invertMatrix44 = m3dInvertMatrix44SSE;
+		dispatch.matrixMultiplyArray44 = m3dMatrixMultiplyArray44SSE;
+		dispatch.cullSphereStream = m3dCullSphereStreamSSE;
+		dispatch.sphereBoxStream = m3dSphereBoxStreamSSE;
+		}
+	if(level == M3D_SIMD_LEVEL_AVX) {
+		dispatch.matrixMultiply44 = m3dMatrixMultiply44AVX;
+		dispatch.matrixMultiplyArray44 = m3dMatrixMultiplyArray44AVX;
+		dispatch.cullSphereStream = m3dCullSphereStreamAVX;
+		dispatch.sphereBoxStream = m3dSphereBoxStreamAVX;
+		}
+	if(level == M3D_SIMD_LEVEL_AVX512) {
+		dispatch.matrixMultiply44 = m3dMatrixMultiply44AVX512;
+		dispatch.matrixMultiplyArray44 = m3dMatrixMultiplyArray44AVX512;
+		dispatch.cullSphereStream = m3dCullSphereStreamAVX512;
+		dispatch.sphereBoxStream = m3dSphereBoxStreamAVX512;
+		}
+#endif
+
+	return dispatch;
+	}
+
+inline M3DSIMDDispatch& m3dGetSIMDDispatch(void)
+	{
+	static M3DSIMDDispatch dispatch = m3dMakeSIMDDispatch(m3dGetSupportedSIMDLevel());
+	return dispatch;
+	}
+
+// Which code path is in use
+inline M3D_SIMD_LEVEL m3dGetSIMDLevel(void) { return m3dGetSIMDDispatch().level; }
+
+// Force a narrower code path (for comparisons and benchmarks). Asking for more
+// than the CPU supports gets the best supported path instead.
+inline void m3dSetSIMDLevel(M3D_SIMD_LEVEL level) { m3dGetSIMDDispatch() = m3dMakeSIMDDispatch(level); }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// Drop in replacements for m3dMatrixMultiply44 and m3dInvertMatrix44
+inline void m3dFastMatrixMultiply44(M3DMatrix44f product, const M3DMatrix44f a, const M3DMatrix44f b)
+	{ m3dGetSIMDDispatch().matrixMultiply44(product, a, b); }
+
+inline void m3dFastInvertMatrix44(M3DMatrix44f mInverse, const M3DMatrix44f m)
+	{ m3dGetSIMDDispatch().invertMatrix44(mInverse, m); }
+
+// One matrix times an array of matrices, pProducts[i] = a * pB[i]. This is the
+// building block for transforming many objects by one camera/projection.
+// pProducts may be the same array as pB.
+inline void m3dMatrixMultiplyArray44(M3DMatrix44f *pProducts, const M3DMatrix44f a, const M3DMatrix44f *pB, int nCount)
+	{ m3dGetSIMDDispatch().matrixMultiplyArray44(pProducts, a, pB, nCount); }
+
+// Visibility bits for nCount spheres (SoA centers and radii) against nPlanes
+// planes whose normals point in, as described above m3dCullSphereStreamScalar.
+// pVisible needs (nCount + 31) / 32 words. GLFrustum::TestSpheres passes the
+// frustum's six planes.
+inline int m3dCullSphereStream(unsigned int *pVisible, const float *x, const float *y, const float *z, const float *r,
+							   int nCount, const M3DVector4f *pPlanes, int nPlanes)
+	{ return m3dGetSIMDDispatch().cullSphereStream(pVisible, x, y, z, r, nCount, pPlanes, nPlanes); }
+
+// Indices of the spheres (SoA centers and radii) that touch the box, as
+// described above m3dSphereBoxStreamScalar; returns how many. Light culling
+// (GLLightClusters) runs this once per cluster.
+inline int m3dSphereBoxStream(int *pHits, const float *x, const float *y, const float *z, const float *r,
+							  int nCount, const M3DVector3f vMin, const M3DVector3f vMax)
+	{ return m3dGetSIMDDispatch().sphereBoxStream(pHits, x, y, z, r, nCount, vMin, vMax); }
+
+
+///////////////////////////////////////////////////////////////////////////////
+// In place m = m * T for the simple matrices a matrix stack gets multiplied by.
+// A translation only changes the last column and a scale only the first three,
+// so these skip building the full matrix and the 64 multiply product. The sums
+// are done in the same order as m3dFastMatrixMultiply44, so the results match
+// multiplying by m3dTranslationMatrix44/m3dScaleMatrix44/m3dRotationMatrix44.
+#ifdef M3D_SIMD_SSE
+#define M3D_LOAD_COLUMNS(m)	__m128 c0 = _mm_loadu_ps(m), c1 = _mm_loadu_ps(m + 4), c2 = _mm_loadu_ps(m + 8)
+#endif
+
+inline void m3dMultTranslation44(M3DMatrix44f m, float x, float y, float z)
+	{
+#ifdef M3D_SIMD_SSE
+	M3D_LOAD_COLUMNS(m);
+	_mm_storeu_ps(m + 12, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(x)), _mm_mul_ps(c1, _mm_set1_ps(y))),
+											  _mm_mul_ps(c2, _mm_set1_ps(z))), _mm_loadu_ps(m + 12)));
+#else
+	for(int i = 0; i < 4; i++)
+		m[12 + i] = ((m[i] * x + m[4 + i] * y) + m[8 + i] * z) + m[12 + i];
+#endif
+	}
+
+inline void m3dMultScale44(M3DMatrix44f m, float x, float y, float z)
+	{
+#ifdef M3D_SIMD_SSE
+	M3D_LOAD_COLUMNS(m);
+	_mm_storeu_ps(m, _mm_mul_ps(c0, _mm_set1_ps(x)));
+	_mm_storeu_ps(m + 4, _mm_mul_ps(c1, _mm_set1_ps(y)));
+	_mm_storeu_ps(m + 8, _mm_mul_ps(c2, _mm_set1_ps(z)));
+#else
+	for(int i = 0; i < 4; i++) {
+		m[i] *= x;
+		m[4 + i] *= y;
+		m[8 + i] *= z;
+		}
+#endif
+	}
+
+// m = m * R for a 3x3 rotation (or any linear part) stored in the upper left of
+// a 4x4. The last column of m doesn't change.
+inline void m3dMultLinear44(M3DMatrix44f m, const M3DMatrix44f r)
+	{
+#ifdef M3D_SIMD_SSE
+	M3D_LOAD_COLUMNS(m);
+#define M3D_COLUMN(j) _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(r[j * 4])), _mm_mul_ps(c1, _mm_set1_ps(r[j * 4 + 1]))), \
+								 _mm_mul_ps(c2, _mm_set1_ps(r[j * 4 + 2])))
+	__m128 p0 = M3D_COLUMN(0);
+	__m128 p1 = M3D_COLUMN(1);
+	__m128 p2 = M3D_COLUMN(2);
+#undef M3D_COLUMN
+	_mm_storeu_ps(m, p0);
+	_mm_storeu_ps(m + 4, p1);
+	_mm_storeu_ps(m + 8, p2);
+#else
+	M3DMatrix44f mTemp;
+	m3dCopyMatrix44(mTemp, m);
+	for(int j = 0; j < 3; j++)
+		for(int i = 0; i < 4; i++)
+			m[j * 4 + i] = (mTemp[i] * r[j * 4] + mTemp[4 + i] * r[j * 4 + 1]) + mTemp[8 + i] * r[j * 4 + 2];
+#endif
+	}
+
+// m = m * Rotation about one of the principal axes. Only two columns change:
+// (a, b) become (a*c + b*s, b*c - a*s). The third is scaled by the rotation's
+// diagonal term, which is (1 - c) + c and not always exactly 1.
+inline void m3dMultAxisRotation44(float *a, float *b, float *k, float s, float c)
+	{
+	float one = (1.0f - c) + c;
+#ifdef M3D_SIMD_SSE
+	__m128 va = _mm_loadu_ps(a), vb = _mm_loadu_ps(b);
+	__m128 vs = _mm_set1_ps(s), vc = _mm_set1_ps(c);
+	_mm_storeu_ps(a, _mm_add_ps(_mm_mul_ps(va, vc), _mm_mul_ps(vb, vs)));
+	_mm_storeu_ps(b, _mm_add_ps(_mm_mul_ps(va, _mm_set1_ps(-s)), _mm_mul_ps(vb, vc)));
+	if(one != 1.0f)
+		_mm_storeu_ps(k, _mm_mul_ps(_mm_loadu_ps(k), _mm_set1_ps(one)));
+#else
+	for(int i = 0; i < 4; i++) {
+		float fa = a[i], fb = b[i];
+		a[i] = fa * c + fb * s;
+		b[i] = fa * -s + fb * c;
+		if(one != 1.0f)
+			k[i] *= one;
+		}
+#endif
+	}
+
+// Same as multiplying by m3dRotationMatrix44(angle, x, y, z). Angle in radians.
+// Rotations about the X, Y or Z axis (the usual case) take the short path.
+inline void m3dMultRotation44(M3DMatrix44f m, float angle, float x, float y, float z)
+	{
+	if((y == 0.0f) + (z == 0.0f) + (x == 0.0f) == 2) {
+		// The library works the sine and cosine out in double precision
+		float s = float(sin(angle));
+		float c = float(cos(angle));
+		if(x != 0.0f)
+			m3dMultAxisRotation44(m + 4, m + 8, m, (x > 0.0f) ? s : -s, c);
+		else if(y != 0.0f)
+			m3dMultAxisRotation44(m + 8, m, m + 4, (y > 0.0f) ? s : -s, c);
+		else
+			m3dMultAxisRotation44(m, m + 4, m + 8, (z > 0.0f) ? s : -s, c);
+		return;
+		}
+
+	M3DMatrix44f mRotate;
+	m3dRotationMatrix44(mRotate, angle, x, y, z);
+	m3dMultLinear44(m, mRotate);
+	}
+
+#ifdef M3D_SIMD_SSE
+#undef M3D_LOAD_COLUMNS
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////
+// 3x4 affine matrices (M3DMatrix34f, row major). One row per register, and the
+// bottom row that is always 0, 0, 0, 1 is never loaded or multiplied. product
+// may be the same matrix as a or b.
+#ifdef M3D_SIMD_SSE
+// The row of the product for one row of a
+inline __m128 m3dSSEAffineRow34(__m128 ar, __m128 b0, __m128 b1, __m128 b2)
+	{
+	const __m128 vW = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+	return _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(ar, ar, 0x00), b0),
+											_mm_mul_ps(_mm_shuffle_ps(ar, ar, 0x55), b1)),
+											_mm_mul_ps(_mm_shuffle_ps(ar, ar, 0xAA), b2)),
+											_mm_mul_ps(ar, vW));
+	}
+#endif
+
+inline void m3dMatrixMultiply34(M3DMatrix34f product, const M3DMatrix34f a, const M3DMatrix34f b)
+	{
+#ifdef M3D_SIMD_SSE
+	__m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4), b2 = _mm_loadu_ps(b + 8);
+	__m128 p0 = m3dSSEAffineRow34(_mm_loadu_ps(a), b0, b1, b2);
+	__m128 p1 = m3dSSEAffineRow34(_mm_loadu_ps(a + 4), b0, b1, b2);
+	__m128 p2 = m3dSSEAffineRow34(_mm_loadu_ps(a + 8), b0, b1, b2);
+	_mm_storeu_ps(product, p0);
+	_mm_storeu_ps(product + 4, p1);
+	_mm_storeu_ps(product + 8, p2);
+#else
+	M3DMatrix34f mTemp;
+	for(int i = 0; i < 12; i += 4)
+		for(int j = 0; j < 4; j++)
+			mTemp[i + j] = ((a[i] * b[j] + a[i + 1] * b[4 + j]) + a[i + 2] * b[8 + j]) + ((j == 3) ? a[i + 3] : 0.0f);
+	m3dCopyMatrix34(product, mTemp);
+#endif
+	}
+
+// pProducts[i] = a * pB[i], e.g. a camera matrix times every instance's model
+// matrix. pProducts may be the same array as pB.
+inline void m3dMatrixMultiplyArray34(M3DMatrix34f *pProducts, const M3DMatrix34f a, const M3DMatrix34f *pB, int nCount)
+	{
+#ifdef M3D_SIMD_SSE
+	// a's rows are the broadcasts here, so swap the roles: each output row is
+	// a combination of the rows of pB[i]
+	const __m128 a00 = _mm_set1_ps(a[0]), a01 = _mm_set1_ps(a[1]), a02 = _mm_set1_ps(a[2]);
+	const __m128 a10 = _mm_set1_ps(a[4]), a11 = _mm_set1_ps(a[5]), a12 = _mm_set1_ps(a[6]);
+	const __m128 a20 = _mm_set1_ps(a[8]), a21 = _mm_set1_ps(a[9]), a22 = _mm_set1_ps(a[10]);
+	const __m128 t0 = _mm_set_ps(a[3], 0.0f, 0.0f, 0.0f), t1 = _mm_set_ps(a[7], 0.0f, 0.0f, 0.0f), t2 = _mm_set_ps(a[11], 0.0f, 0.0f, 0.0f);
+	for(int i = 0; i < nCount; i++)
+		{
+		const float *b = pB[i];
+		__m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4), b2 = _mm_loadu_ps(b + 8);
+		float *p = pProducts[i];
+		_mm_storeu_ps(p, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a00, b0), _mm_mul_ps(a01, b1)), _mm_mul_ps(a02, b2)), t0));
+		_mm_storeu_ps(p + 4, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a10, b0), _mm_mul_ps(a11, b1)), _mm_mul_ps(a12, b2)), t1));
+		_mm_storeu_ps(p + 8, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(a20, b0), _mm_mul_ps(a21, b1)), _mm_mul_ps(a22, b2)), t2));
+		}
+#else
+	for(int i = 0; i < nCount; i++)
+		m3dMatrixMultiply34(pProducts[i], a, pB[i]);
+#endif
+	}
+
+// product = a * b for a full 4x4 a (a projection) and an affine b, as a 4x4.
+// This is the model-view-projection matrix from a 3x4 model-view, 48
+// multiplies instead of 64. product may be the same matrix as a.
+inline void m3dMatrixMultiply44Affine34(M3DMatrix44f product, const M3DMatrix44f a, const M3DMatrix34f b)
+	{
+#ifdef M3D_SIMD_SSE
+	__m128 a0 = _mm_loadu_ps(a), a1 = _mm_loadu_ps(a + 4), a2 = _mm_loadu_ps(a + 8), a3 = _mm_loadu_ps(a + 12);
+#define M3D_COLUMN(j) _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[j])), _mm_mul_ps(a1, _mm_set1_ps(b[4 + j]))), \
+								 _mm_mul_ps(a2, _mm_set1_ps(b[8 + j])))
+	__m128 p0 = M3D_COLUMN(0);
+	__m128 p1 = M3D_COLUMN(1);
+	__m128 p2 = M3D_COLUMN(2);
+	__m128 p3 = _mm_add_ps(M3D_COLUMN(3), a3);
+#undef M3D_COLUMN
+	_mm_storeu_ps(product, p0);
+	_mm_storeu_ps(product + 4, p1);
+	_mm_storeu_ps(product + 8, p2);
+	_mm_storeu_ps(product + 12, p3);
+#else
+	M3DMatrix44f mTemp;
+	for(int j = 0; j < 4; j++)
+		for(int i = 0; i < 4; i++)
+			mTemp[j * 4 + i] = (a[i] * b[j] + a[4 + i] * b[4 + j]) + a[8 + i] * b[8 + j] + ((j == 3) ? a[12 + i] : 0.0f);
+	m3dCopyMatrix44(product, mTemp);
+#endif
+	}
+
+// In place m = m * T, like m3dMultTranslation44 and friends above
+inline void m3dMultTranslation34(M3DMatrix34f m, float x, float y, float z)
+	{
+	for(int i = 0; i < 12; i += 4)
+		m[i + 3] = ((m[i] * x + m[i + 1] * y) + m[i + 2] * z) + m[i + 3];
+	}
+
+inline void m3dMultScale34(M3DMatrix34f m, float x, float y, float z)
+	{
+#ifdef M3D_SIMD_SSE
+	const __m128 s = _mm_set_ps(1.0f, z, y, x);
+	_mm_storeu_ps(m, _mm_mul_ps(_mm_loadu_ps(m), s));
+	_mm_storeu_ps(m + 4, _mm_mul_ps(_mm_loadu_ps(m + 4), s));
+	_mm_storeu_ps(m + 8, _mm_mul_ps(_mm_loadu_ps(m + 8), s));
+#else
+	for(int i = 0; i < 12; i += 4) {
+		m[i] *= x;
+		m[i + 1] *= y;
+		m[i + 2] *= z;
+		}
+#endif
+	}
+
+// Rotation about axis 0, 1 or 2 (X, Y, Z), as in m3dMultAxisRotation44: in
+// every row two elements rotate into each other and the third is scaled by
+// the diagonal term.
+inline void m3dMultAxisRotation34(M3DMatrix34f m, int iAxis, float s, float c)
+	{
+	float one = (1.0f - c) + c;
+#ifdef M3D_SIMD_SSE
+	// row * vScale + swapped row * vCross, one row per register
+	__m128 r0 = _mm_loadu_ps(m), r1 = _mm_loadu_ps(m + 4), r2 = _mm_loadu_ps(m + 8);
+	__m128 vScale, vCross;
+#define M3D_ROTATE(imm) \
+		_mm_storeu_ps(m, _mm_add_ps(_mm_mul_ps(r0, vScale), _mm_mul_ps(_mm_shuffle_ps(r0, r0, imm), vCross))); \
+		_mm_storeu_ps(m + 4, _mm_add_ps(_mm_mul_ps(r1, vScale), _mm_mul_ps(_mm_shuffle_ps(r1, r1, imm), vCross))); \
+		_mm_storeu_ps(m + 8, _mm_add_ps(_mm_mul_ps(r2, vScale), _mm_mul_ps(_mm_shuffle_ps(r2, r2, imm), vCross)))
+	switch(iAxis) {
+		case 0:
+			vScale = _mm_set_ps(1.0f, c, c, one);
+			vCross = _mm_set_ps(0.0f, -s, s, 0.0f);
+			M3D_ROTATE(_MM_SHUFFLE(3, 1, 2, 0));
+			break;
+		case 1:
+			vScale = _mm_set_ps(1.0f, c, one, c);
+			vCross = _mm_set_ps(0.0f, s, 0.0f, -s);
+			M3D_ROTATE(_MM_SHUFFLE(3, 0, 1, 2));
+			break;
+		default:
+			vScale = _mm_set_ps(1.0f, one, c, c);
+			vCross = _mm_set_ps(0.0f, 0.0f, -s, s);
+			M3D_ROTATE(_MM_SHUFFLE(3, 2, 0, 1));
+		}
+#undef M3D_ROTATE
+#else
+	// The two elements that rotate, and the one that is scaled
+	static const int iRotate[3][3] = { { 1, 2, 0 }, { 2, 0, 1 }, { 0, 1, 2 } };
+	int a = iRotate[iAxis][0], b = iRotate[iAxis][1], k = iRotate[iAxis][2];
+	for(int i = 0; i < 12; i += 4) {
+		float fa = m[i + a], fb = m[i + b];
+		m[i + a] = fa * c + fb * s;
+		m[i + b] = fa * -s + fb * c;
+		m[i + k] *= one;
+		}
+#endif
+	}
+
+// Angle in radians, same as m3dMultRotation44
+inline void m3dMultRotation34(M3DMatrix34f m, float angle, float x, float y, float z)
+	{
+	if((y == 0.0f) + (z == 0.0f) + (x == 0.0f) == 2) {
+		float s = float(sin(angle));
+		float c = float(cos(angle));
+		if(x != 0.0f)
+			m3dMultAxisRotation34(m, 0, (x > 0.0f) ? s : -s, c);
+		else if(y != 0.0f)
+			m3dMultAxisRotation34(m, 1, (y > 0.0f) ? s : -s, c);
+		else
+			m3dMultAxisRotation34(m, 2, (z > 0.0f) ? s : -s, c);
+		return;
+		}
+
+	M3DMatrix44f mRotate;
+	M3DMatrix34f mAffine;
+	m3dRotationMatrix44(mRotate, angle, x, y, z);
+	m3dMatrix44ToAffine34(mAffine, mRotate);
+	m3dMatrixMultiply34(m, m, mAffine);
+	}
+
+#endif